@@ -0,0 +1,765 @@
+/*
+
+GFX Lightweight OpenGLES 2.0 Game and Graphics Engine
+
+Copyright (C) 2011 Romain Marucchi-Foino http://gfx.sio2interactive.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of
+this software. Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that
+you wrote the original software. If you use this software in a product, an acknowledgment
+in the product would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented
+as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#include "gfx.h"
+
+/*!
+	\file allocator.cpp
+
+    \brief Frame scoped linear allocator and fixed size pools for the engine structures.
+
+	\details The engine structures (TEXTURE, PROGRAM, SHADER, SOUND, LIGHT, THREAD and
+	NAVIGATION) are taken from fixed size POOL instead of being allocated one by one, the
+	released elements are reused right away so creating and destroying objects during the
+	game does not fragment the heap. The frame ARENA is a scratch buffer for the data that
+	only live for the current frame: ARENA_alloc only move a cursor, and ALLOCATOR_frame
+	release everything at once. The frame ARENA is not thread safe, use it from the main
+	thread only.
+	
+	The blocks of the ARENA and the POOL, as well as the memory of Bullet, Recast, Detour and
+	libpng, go through the allocation hooks set with ALLOCATOR_set_hook (malloc and free by
+	default).
+	
+	When GFX_TRACK_ALLOCATION is defined (debug builds), every allocation of the engine is
+	recorded in a hash table under a tag, in order to know the memory used by each subsystem:
+	the files defining ALLOCATOR_TAG before including gfx.h have their malloc, calloc, realloc
+	and free replaced by the tracked wrappers, the hooks of Bullet, Recast, Detour and libpng
+	record their blocks, and libvorbis is routed to the wrappers by vorbis/os_types.h. A block
+	freed outside of the tracking (or allocated outside of it) is simply ignored. In release
+	builds the wrappers and the table are compiled out.
+*/
+
+
+//! Global engine allocators.
+ALLOCATOR allocator = { malloc,
+						free,
+						NULL,
+						{ POOL_INITIALIZER( TEXTURE   , 64 ),
+						  POOL_INITIALIZER( PROGRAM   , 32 ),
+						  POOL_INITIALIZER( SHADER    , 64 ),
+						  POOL_INITIALIZER( SOUND	  , 32 ),
+						  POOL_INITIALIZER( LIGHT	  , 16 ),
+						  POOL_INITIALIZER( THREAD	  , 8  ),
+						  POOL_INITIALIZER( NAVIGATION, 4  ) }
+						#ifdef GFX_TRACK_ALLOCATION
+						, { }, 0, 0, NULL, PTHREAD_MUTEX_INITIALIZER
+						#endif
+						};
+
+
+/*!
+	Create a new linear allocator.
+	
+	\param[in] size The size of the buffer in bytes.
+	
+	\return Return a new ARENA structure pointer.
+*/
+ARENA *ARENA_init( unsigned int size )
+{
+	ARENA *arena = ( ARENA * ) calloc( 1, sizeof( ARENA ) );
+	
+	arena->size	  = size;
+	arena->buffer = ( unsigned char * ) allocator.alloc_hook( size + ALLOCATOR_ALIGNMENT );
+	
+	ALLOCATOR_TRACK( arena->buffer, size + ALLOCATOR_ALIGNMENT, ALLOCATOR_TAG_ALLOCATOR );
+	
+	return arena;
+}
+
+
+/*!
+	Free a previously initialized ARENA, the blocks it returned are not valid anymore.
+	
+	\param[in,out] arena A valid ARENA structure pointer.
+	
+	\return Return a NULL ARENA structure pointer.
+*/
+ARENA *ARENA_free( ARENA *arena )
+{
+	ARENA_reset( arena );
+	
+	ALLOCATOR_UNTRACK( arena->buffer );
+	
+	allocator.free_hook( arena->buffer );
+	
+	free( arena );
+	return NULL;
+}
+
+
+/*!
+	Take a block from an ARENA. When the buffer is full the block is allocated with the
+	allocation hook and released by the next ARENA_reset, increase the size of the ARENA if
+	the peak is often over it.
+	
+	\param[in,out] arena A valid ARENA structure pointer.
+	\param[in] size The size of the block in bytes.
+	
+	\return Return a block aligned on ALLOCATOR_ALIGNMENT bytes, uninitialized.
+*/
+void *ARENA_alloc( ARENA *arena, unsigned int size )
+{
+	unsigned char *start = ( unsigned char * )( ( ( size_t )arena->buffer + ALLOCATOR_ALIGNMENT - 1 ) & ~( ( size_t )ALLOCATOR_ALIGNMENT - 1 ) );
+	
+	void *ptr;
+	
+	size = ( size + ALLOCATOR_ALIGNMENT - 1 ) & ~( ALLOCATOR_ALIGNMENT - 1 );
+	
+	arena->used += size;
+	
+	if( arena->used > arena->peak ) arena->peak = arena->used;
+	
+	if( arena->position + size <= arena->size )
+	{
+		ptr = &start[ arena->position ];
+		
+		arena->position += size;
+		
+		return ptr;
+	}
+	
+	ptr = allocator.alloc_hook( size );
+	
+	ALLOCATOR_TRACK( ptr, size, ALLOCATOR_TAG_ALLOCATOR );
+	
+	++arena->n_overflow;
+	
+	arena->overflow = ( void ** ) realloc( arena->overflow,
+										   arena->n_overflow * sizeof( void * ) );
+	
+	arena->overflow[ arena->n_overflow - 1 ] = ptr;
+	
+	return ptr;
+}
+
+
+/*!
+	Release all the blocks of an ARENA at once.
+	
+	\param[in,out] arena A valid ARENA structure pointer.
+*/
+void ARENA_reset( ARENA *arena )
+{
+	unsigned int i = 0;
+	
+	while( i != arena->n_overflow )
+	{
+		ALLOCATOR_UNTRACK( arena->overflow[ i ] );
+		
+		allocator.free_hook( arena->overflow[ i ] );
+		++i;
+	}
+	
+	if( arena->overflow )
+	{
+		free( arena->overflow );
+		arena->overflow = NULL;
+	}
+	
+	arena->n_overflow = 0;
+	arena->position	  = 0;
+	arena->used		  = 0;
+}
+
+
+/*!
+	Take an element from a POOL, a new block is allocated when there is no free element left.
+	
+	\param[in,out] pool A valid POOL structure pointer.
+	
+	\return Return an element cleared to zero (like calloc).
+*/
+void *POOL_alloc( POOL *pool )
+{
+	void *ptr;
+	
+	pthread_mutex_lock( &pool->mutex );
+	
+	if( !pool->free_list )
+	{
+		unsigned int i = 0;
+		
+		unsigned char *block = ( unsigned char * ) allocator.alloc_hook( pool->size * pool->n_element + ALLOCATOR_ALIGNMENT ),
+					  *start = ( unsigned char * )( ( ( size_t )block + ALLOCATOR_ALIGNMENT - 1 ) & ~( ( size_t )ALLOCATOR_ALIGNMENT - 1 ) );
+		
+		ALLOCATOR_TRACK( block, pool->size * pool->n_element + ALLOCATOR_ALIGNMENT, ALLOCATOR_TAG_ALLOCATOR );
+		
+		++pool->n_block;
+		
+		pool->block = ( unsigned char ** ) realloc( pool->block,
+													pool->n_block * sizeof( unsigned char * ) );
+		
+		pool->block[ pool->n_block - 1 ] = block;
+		
+		// Chain the elements in order, the first one on top of the list.
+		while( i != pool->n_element )
+		{
+			*( void ** )&start[ i * pool->size ] = ( i + 1 ) != pool->n_element ? &start[ ( i + 1 ) * pool->size ] : NULL;
+			++i;
+		}
+		
+		pool->free_list = start;
+	}
+	
+	ptr = pool->free_list;
+	
+	pool->free_list = *( void ** )ptr;
+	
+	++pool->n_used;
+	
+	if( pool->n_used > pool->peak ) pool->peak = pool->n_used;
+	
+	pthread_mutex_unlock( &pool->mutex );
+	
+	memset( ptr, 0, pool->size );
+	
+	return ptr;
+}
+
+
+/*!
+	Give an element back to its POOL, it will be returned by the next POOL_alloc.
+	
+	\param[in,out] pool A valid POOL structure pointer.
+	\param[in] ptr An element returned by POOL_alloc on the same pool, or NULL.
+*/
+void POOL_release( POOL *pool, void *ptr )
+{
+	if( !ptr ) return;
+	
+	pthread_mutex_lock( &pool->mutex );
+	
+	*( void ** )ptr = pool->free_list;
+	
+	pool->free_list = ptr;
+	
+	--pool->n_used;
+	
+	pthread_mutex_unlock( &pool->mutex );
+}
+
+
+/*!
+	Give the blocks of a POOL back to the system. The elements still in use are not valid
+	anymore, the pool can be used again afterward.
+	
+	\param[in,out] pool A valid POOL structure pointer.
+	
+	\return Return a NULL POOL structure pointer.
+*/
+POOL *POOL_free( POOL *pool )
+{
+	unsigned int i = 0;
+	
+	pthread_mutex_lock( &pool->mutex );
+	
+	while( i != pool->n_block )
+	{
+		ALLOCATOR_UNTRACK( pool->block[ i ] );
+		
+		allocator.free_hook( pool->block[ i ] );
+		++i;
+	}
+	
+	if( pool->block ) free( pool->block );
+	
+	pool->n_block	= 0;
+	pool->block		= NULL;
+	pool->free_list = NULL;
+	pool->n_used	= 0;
+	
+	pthread_mutex_unlock( &pool->mutex );
+	
+	return NULL;
+}
+
+
+//! Allocate a block with the allocation hook and record it under a tag. This function is used internally.
+void *ALLOCATOR_hook_alloc( size_t size, unsigned char tag )
+{
+	void *ptr = allocator.alloc_hook( size );
+	
+	ALLOCATOR_TRACK( ptr, size, tag );
+	
+	return ptr;
+}
+
+
+//! Bullet allocation adapter.
+void *ALLOCATOR_bt_alloc( size_t size )
+{ return ALLOCATOR_hook_alloc( size, ALLOCATOR_TAG_PHYSICS ); }
+
+
+//! Bullet, Recast and Detour free adapter.
+void ALLOCATOR_bt_free( void *ptr )
+{
+	ALLOCATOR_UNTRACK( ptr );
+	
+	allocator.free_hook( ptr );
+}
+
+
+//! Recast allocation adapter.
+void *ALLOCATOR_rc_alloc( int size, rcAllocHint hint )
+{ return ALLOCATOR_hook_alloc( size, ALLOCATOR_TAG_NAVIGATION ); }
+
+
+//! Detour allocation adapter.
+void *ALLOCATOR_dt_alloc( int size, dtAllocHint hint )
+{ return ALLOCATOR_hook_alloc( size, ALLOCATOR_TAG_NAVIGATION ); }
+
+
+/*!
+	libpng allocation adapter, to pass to png_create_read_struct_2.
+	
+	\param[in] structp The png structure (unused).
+	\param[in] size The size in bytes.
+*/
+void *ALLOCATOR_png_alloc( png_structp structp, png_size_t size )
+{ return ALLOCATOR_hook_alloc( size, ALLOCATOR_TAG_TEXTURE ); }
+
+
+/*!
+	libpng free adapter, to pass to png_create_read_struct_2.
+	
+	\param[in] structp The png structure (unused).
+	\param[in] ptr The block to free.
+*/
+void ALLOCATOR_png_free( png_structp structp, png_voidp ptr )
+{ ALLOCATOR_bt_free( ptr ); }
+
+
+/*!
+	Create the frame ARENA and route the allocations of Bullet, Recast and Detour through the
+	allocation hooks. Have to be called once, before creating any physic world or navigation
+	mesh.
+	
+	\param[in] frame_size The size in bytes of the frame ARENA, 0 to use ALLOCATOR_FRAME_SIZE.
+*/
+void ALLOCATOR_init( unsigned int frame_size )
+{
+	if( !allocator.frame ) allocator.frame = ARENA_init( frame_size ? frame_size : ALLOCATOR_FRAME_SIZE );
+	
+	btAlignedAllocSetCustom( ALLOCATOR_bt_alloc, ALLOCATOR_bt_free );
+	
+	rcAllocSetCustom( ALLOCATOR_rc_alloc, ALLOCATOR_bt_free );
+	
+	dtAllocSetCustom( ALLOCATOR_dt_alloc, ALLOCATOR_bt_free );
+}
+
+
+/*!
+	Free the frame ARENA and the blocks of the engine pools, every engine structure have to be
+	freed first.
+*/
+void ALLOCATOR_free( void )
+{
+	unsigned int i = 0;
+	
+	if( allocator.frame ) allocator.frame = ARENA_free( allocator.frame );
+	
+	while( i != POOL_MAX )
+	{
+		POOL_free( &allocator.pool[ i ] );
+		++i;
+	}
+}
+
+
+/*!
+	Set the allocation hooks, for example to use the allocator of the application. The hooks
+	have to be set before ALLOCATOR_init and before any engine structure is created, since the
+	blocks already allocated are released with the new free hook.
+	
+	\param[in] alloc_hook The allocation function (same as malloc).
+	\param[in] free_hook The free function (same as free).
+*/
+void ALLOCATOR_set_hook( ALLOCATORALLOC *alloc_hook, ALLOCATORFREE *free_hook )
+{
+	allocator.alloc_hook = alloc_hook;
+	allocator.free_hook	 = free_hook;
+}
+
+
+/*!
+	Release the scratch blocks of the previous frame, call it once at the beginning of every
+	frame. The per frame allocation statistics are also restarted.
+*/
+void ALLOCATOR_frame( void )
+{
+	if( allocator.frame ) ARENA_reset( allocator.frame );
+	
+	#ifdef GFX_TRACK_ALLOCATION
+	{
+		unsigned int i = 0;
+		
+		pthread_mutex_lock( &allocator.mutex );
+		
+		while( i != ALLOCATOR_TAG_MAX )
+		{
+			ALLOCATORSTATS *allocatorstats = &allocator.allocatorstats[ i ];
+			
+			allocatorstats->last_frame_alloc = allocatorstats->frame_alloc;
+			allocatorstats->last_frame_bytes = allocatorstats->frame_bytes;
+			
+			allocatorstats->frame_alloc = 0;
+			allocatorstats->frame_bytes = 0;
+			
+			++i;
+		}
+		
+		pthread_mutex_unlock( &allocator.mutex );
+	}
+	#endif
+}
+
+
+/*!
+	Print the usage of the frame ARENA and of the engine pools in the console, followed by the
+	statistics of every tag when the allocations are tracked.
+*/
+void ALLOCATOR_print( void )
+{
+	static const char *name[ POOL_MAX ] = { "TEXTURE", "PROGRAM", "SHADER", "SOUND", "LIGHT", "THREAD", "NAVIGATION" };
+	
+	unsigned int i = 0;
+	
+	if( allocator.frame )
+	{
+		console_print( "frame: %dKB/%dKB peak:%dKB overflow:%d\n",
+					   allocator.frame->used >> 10,
+					   allocator.frame->size >> 10,
+					   allocator.frame->peak >> 10,
+					   allocator.frame->n_overflow );
+	}
+	
+	while( i != POOL_MAX )
+	{
+		POOL *pool = &allocator.pool[ i ];
+		
+		console_print( "%s: %d used, peak:%d, %d block(s) of %d\n",
+					   name[ i ],
+					   pool->n_used,
+					   pool->peak,
+					   pool->n_block,
+					   pool->n_element );
+		++i;
+	}
+	
+	#ifdef GFX_TRACK_ALLOCATION
+	
+		// The names of the tags, in the same order as the ALLOCATOR_TAG enum.
+		static const char *tag_name[ ALLOCATOR_TAG_MAX ] = { "GENERAL", "ALLOCATOR", "MEMORY", "TEXTURE", "MESH", "SHADER", "AUDIO", "PHYSICS", "NAVIGATION", "FONT", "THREAD" };
+	
+		i = 0;
+		while( i != ALLOCATOR_TAG_MAX )
+		{
+			ALLOCATORSTATS allocatorstats;
+			
+			ALLOCATOR_get_stats( i, &allocatorstats );
+			
+			console_print( "%s: %dKB peak:%dKB block(s):%d alloc:%d frame:%d/%dKB\n",
+						   tag_name[ i ],
+						   ( unsigned int )( allocatorstats.current >> 10 ),
+						   ( unsigned int )( allocatorstats.peak >> 10 ),
+						   allocatorstats.n_block,
+						   allocatorstats.n_alloc,
+						   allocatorstats.last_frame_alloc,
+						   ( unsigned int )( allocatorstats.last_frame_bytes >> 10 ) );
+			++i;
+		}
+	
+	#endif
+}
+
+
+/*!
+	Get the allocation statistics of a tag, this function does not need a GL context.
+	
+	\param[in] tag The tag, ALLOCATOR_TAG_GENERAL, ALLOCATOR_TAG_TEXTURE etc.
+	\param[out] allocatorstats The statistics of the tag.
+	
+	\return Return 1 if the statistics are available, 0 if the allocations are not tracked (release build).
+*/
+unsigned char ALLOCATOR_get_stats( unsigned int tag, ALLOCATORSTATS *allocatorstats )
+{
+	memset( allocatorstats, 0, sizeof( ALLOCATORSTATS ) );
+	
+	#ifdef GFX_TRACK_ALLOCATION
+	
+		if( tag >= ALLOCATOR_TAG_MAX ) return 0;
+		
+		pthread_mutex_lock( &allocator.mutex );
+		
+		memcpy( allocatorstats, &allocator.allocatorstats[ tag ], sizeof( ALLOCATORSTATS ) );
+		
+		pthread_mutex_unlock( &allocator.mutex );
+		
+		return 1;
+	
+	#else
+	
+		return 0;
+	
+	#endif
+}
+
+
+#ifdef GFX_TRACK_ALLOCATION
+
+/*!
+	Return the slot of the hash table for an address. This function is used internally.
+	
+	\param[in] ptr The address of the block.
+*/
+unsigned int ALLOCATOR_get_slot( void *ptr )
+{
+	size_t key = ( size_t )ptr >> 4;
+	
+	return ( unsigned int )( ( key ^ ( key >> 15 ) ) * 2654435761u ) & ( allocator.max_record - 1 );
+}
+
+
+/*!
+	Insert a record in the hash table, the mutex have to be locked. This function is used internally.
+	
+	\param[in] ptr The address of the block.
+	\param[in] size The size of the block in bytes.
+	\param[in] tag The tag of the block.
+*/
+void ALLOCATOR_insert( void *ptr, size_t size, unsigned char tag )
+{
+	unsigned int slot;
+	
+	if( ( allocator.n_record + 1 ) << 1 > allocator.max_record )
+	{
+		unsigned int i = 0,
+					 max_record = allocator.max_record;
+		
+		ALLOCATORRECORD *record = allocator.record;
+		
+		allocator.max_record = max_record ? max_record << 1 : 4096;
+		allocator.record	 = ( ALLOCATORRECORD * ) calloc( allocator.max_record, sizeof( ALLOCATORRECORD ) );
+		allocator.n_record	 = 0;
+		
+		while( i != max_record )
+		{
+			if( record[ i ].ptr ) ALLOCATOR_insert( record[ i ].ptr, record[ i ].size, record[ i ].tag );
+			++i;
+		}
+		
+		if( record ) free( record );
+	}
+	
+	slot = ALLOCATOR_get_slot( ptr );
+	
+	while( allocator.record[ slot ].ptr && allocator.record[ slot ].ptr != ptr )
+	{ slot = ( slot + 1 ) & ( allocator.max_record - 1 ); }
+	
+	if( allocator.record[ slot ].ptr )
+	{
+		// The block have been freed without being untracked, forget it.
+		ALLOCATORSTATS *allocatorstats = &allocator.allocatorstats[ allocator.record[ slot ].tag ];
+		
+		allocatorstats->current -= allocator.record[ slot ].size;
+		--allocatorstats->n_block;
+	}
+	else ++allocator.n_record;
+	
+	allocator.record[ slot ].ptr  = ptr;
+	allocator.record[ slot ].size = size;
+	allocator.record[ slot ].tag  = tag;
+}
+
+
+/*!
+	Record a block under a tag.
+	
+	\param[in] ptr The address of the block, NULL is ignored.
+	\param[in] size The size of the block in bytes.
+	\param[in] tag The tag of the block.
+*/
+void ALLOCATOR_track( void *ptr, size_t size, unsigned char tag )
+{
+	ALLOCATORSTATS *allocatorstats = &allocator.allocatorstats[ tag ];
+	
+	if( !ptr ) return;
+	
+	pthread_mutex_lock( &allocator.mutex );
+	
+	ALLOCATOR_insert( ptr, size, tag );
+	
+	allocatorstats->current += size;
+	
+	if( allocatorstats->current > allocatorstats->peak ) allocatorstats->peak = allocatorstats->current;
+	
+	++allocatorstats->n_block;
+	++allocatorstats->n_alloc;
+	++allocatorstats->frame_alloc;
+	
+	allocatorstats->frame_bytes += size;
+	
+	pthread_mutex_unlock( &allocator.mutex );
+}
+
+
+/*!
+	Forget a block, call it before the block is freed. Unknown blocks are ignored.
+	
+	\param[in] ptr The address of the block.
+	
+	\return Return the size of the block, 0 if it was not tracked.
+*/
+size_t ALLOCATOR_untrack( void *ptr )
+{
+	unsigned int slot,
+				 next;
+	
+	size_t size = 0;
+	
+	if( !ptr ) return 0;
+	
+	pthread_mutex_lock( &allocator.mutex );
+	
+	if( !allocator.n_record )
+	{
+		pthread_mutex_unlock( &allocator.mutex );
+		return 0;
+	}
+	
+	slot = ALLOCATOR_get_slot( ptr );
+	
+	while( allocator.record[ slot ].ptr && allocator.record[ slot ].ptr != ptr )
+	{ slot = ( slot + 1 ) & ( allocator.max_record - 1 ); }
+	
+	if( allocator.record[ slot ].ptr )
+	{
+		ALLOCATORSTATS *allocatorstats = &allocator.allocatorstats[ allocator.record[ slot ].tag ];
+		
+		size = allocator.record[ slot ].size;
+		
+		allocatorstats->current -= size;
+		--allocatorstats->n_block;
+		
+		--allocator.n_record;
+		
+		// Shift back the following records of the cluster, so the probing never stop on a hole.
+		next = slot;
+		
+		while( 1 )
+		{
+			unsigned int home;
+			
+			next = ( next + 1 ) & ( allocator.max_record - 1 );
+			
+			if( !allocator.record[ next ].ptr ) break;
+			
+			home = ALLOCATOR_get_slot( allocator.record[ next ].ptr );
+			
+			if( ( ( next - home ) & ( allocator.max_record - 1 ) ) >= ( ( next - slot ) & ( allocator.max_record - 1 ) ) )
+			{
+				allocator.record[ slot ] = allocator.record[ next ];
+				
+				slot = next;
+			}
+		}
+		
+		allocator.record[ slot ].ptr = NULL;
+	}
+	
+	pthread_mutex_unlock( &allocator.mutex );
+	
+	return size;
+}
+
+
+//! Tracked malloc, used through the malloc macro of the files defining ALLOCATOR_TAG.
+void *ALLOCATOR_track_malloc( size_t size, unsigned char tag )
+{
+	void *ptr = malloc( size );
+	
+	ALLOCATOR_track( ptr, size, tag );
+	
+	return ptr;
+}
+
+
+//! Tracked calloc, used through the calloc macro of the files defining ALLOCATOR_TAG.
+void *ALLOCATOR_track_calloc( size_t n, size_t size, unsigned char tag )
+{
+	void *ptr = calloc( n, size );
+	
+	ALLOCATOR_track( ptr, n * size, tag );
+	
+	return ptr;
+}
+
+
+//! Tracked realloc, used through the realloc macro of the files defining ALLOCATOR_TAG.
+void *ALLOCATOR_track_realloc( void *ptr, size_t size, unsigned char tag )
+{
+	void *block;
+	
+	// Untrack first, another thread could get the same address as soon as it is released.
+	size_t old_size = ALLOCATOR_untrack( ptr );
+	
+	block = realloc( ptr, size );
+	
+	if( block ) ALLOCATOR_track( block, size, tag );
+	
+	// The old block is still valid if realloc fails.
+	else if( size && old_size ) ALLOCATOR_track( ptr, old_size, tag );
+	
+	return block;
+}
+
+
+//! Tracked free, used through the free macro of the files defining ALLOCATOR_TAG.
+void ALLOCATOR_track_free( void *ptr )
+{
+	ALLOCATOR_untrack( ptr );
+	
+	free( ptr );
+}
+
+
+//! libvorbis malloc, see vorbis/os_types.h.
+extern "C" void *ALLOCATOR_ogg_malloc( size_t size )
+{ return ALLOCATOR_track_malloc( size, ALLOCATOR_TAG_AUDIO ); }
+
+
+//! libvorbis calloc, see vorbis/os_types.h.
+extern "C" void *ALLOCATOR_ogg_calloc( size_t n, size_t size )
+{ return ALLOCATOR_track_calloc( n, size, ALLOCATOR_TAG_AUDIO ); }
+
+
+//! libvorbis realloc, see vorbis/os_types.h.
+extern "C" void *ALLOCATOR_ogg_realloc( void *ptr, size_t size )
+{ return ALLOCATOR_track_realloc( ptr, size, ALLOCATOR_TAG_AUDIO ); }
+
+
+//! libvorbis free, see vorbis/os_types.h.
+extern "C" void ALLOCATOR_ogg_free( void *ptr )
+{ ALLOCATOR_track_free( ptr ); }
+
+#endif
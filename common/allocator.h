@@ -0,0 +1,313 @@
+/*
+
+GFX Lightweight OpenGLES 2.0 Game and Graphics Engine
+
+Copyright (C) 2011 Romain Marucchi-Foino http://gfx.sio2interactive.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of
+this software. Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that
+you wrote the original software. If you use this software in a product, an acknowledgment
+in the product would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented
+as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+/*!
+	\file allocator.h
+
+    \brief Contains structure definitions and functions to use with the frame ARENA and the POOL allocators.
+*/
+
+
+#if !defined( GFX_TRACK_ALLOCATION ) && ( defined( DEBUG ) || defined( _DEBUG ) )
+	//! Track the allocations per tag, enabled in debug builds (or by defining it in the project). \sa ALLOCATOR_get_stats
+	#define GFX_TRACK_ALLOCATION
+#endif
+
+
+//! The alignment in bytes of the blocks returned by an ARENA or a POOL.
+#define ALLOCATOR_ALIGNMENT		16
+
+//! The default size in bytes of the frame ARENA. \sa ALLOCATOR_init
+#define ALLOCATOR_FRAME_SIZE	1048576
+
+
+//! The allocation hook prototype (same as malloc).
+typedef void *( ALLOCATORALLOC( size_t ) );
+
+//! The free hook prototype (same as free).
+typedef void( ALLOCATORFREE( void * ) );
+
+
+//! Structure definition of a linear allocator, every block is released at once by ARENA_reset.
+typedef struct
+{
+	//! The size of the buffer in bytes.
+	unsigned int	size;
+	
+	//! The number of bytes used in the buffer.
+	unsigned int	position;
+	
+	//! The highest number of bytes requested between two resets (including the overflow).
+	unsigned int	peak;
+	
+	//! The number of bytes requested since the last reset (including the overflow).
+	unsigned int	used;
+	
+	//! The buffer the blocks are taken from.
+	unsigned char	*buffer;
+	
+	//! The number of blocks allocated with the allocation hook because the buffer was full.
+	unsigned int	n_overflow;
+	
+	//! Array of overflow blocks, released by ARENA_reset.
+	void			**overflow;
+	
+} ARENA;
+
+
+//! Structure definition of a fixed size allocator, the elements are taken from blocks that are never returned to the system until POOL_free.
+typedef struct
+{
+	//! The size of an element in bytes (a multiple of ALLOCATOR_ALIGNMENT).
+	unsigned int	size;
+	
+	//! The number of elements per block.
+	unsigned int	n_element;
+	
+	//! The number of blocks.
+	unsigned int	n_block;
+	
+	//! Array of blocks.
+	unsigned char	**block;
+	
+	//! The first free element, each free element store the address of the next one.
+	void			*free_list;
+	
+	//! The number of elements in use.
+	unsigned int	n_used;
+	
+	//! The highest number of elements in use.
+	unsigned int	peak;
+	
+	//! The mutex protecting the pool.
+	pthread_mutex_t	mutex;
+	
+} POOL;
+
+
+//! Static initializer of a POOL of n_element elements per block for a given structure.
+#define POOL_INITIALIZER( type, n_element ) { ( sizeof( type ) + ALLOCATOR_ALIGNMENT - 1 ) & ~( ALLOCATOR_ALIGNMENT - 1 ), n_element, 0, NULL, NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER }
+
+
+enum
+{
+	POOL_TEXTURE	= 0,
+	POOL_PROGRAM	= 1,
+	POOL_SHADER		= 2,
+	POOL_SOUND		= 3,
+	POOL_LIGHT		= 4,
+	POOL_THREAD		= 5,
+	POOL_NAVIGATION = 6,
+	
+	//! The number of engine pools.
+	POOL_MAX		= 7
+};
+
+
+enum
+{
+	//! Allocations of the files that do not define ALLOCATOR_TAG.
+	ALLOCATOR_TAG_GENERAL	 = 0,
+	
+	//! The blocks of the ARENA and the POOL.
+	ALLOCATOR_TAG_ALLOCATOR	 = 1,
+	
+	//! Files, APK and PAK.
+	ALLOCATOR_TAG_MEMORY	 = 2,
+	
+	//! Textures, texture streaming, atlases and libpng.
+	ALLOCATOR_TAG_TEXTURE	 = 3,
+	
+	//! OBJ, MD5 and the stream buffers.
+	ALLOCATOR_TAG_MESH		 = 4,
+	
+	//! Shaders and programs.
+	ALLOCATOR_TAG_SHADER	 = 5,
+	
+	//! Sounds and libvorbis.
+	ALLOCATOR_TAG_AUDIO		 = 6,
+	
+	//! Bullet.
+	ALLOCATOR_TAG_PHYSICS	 = 7,
+	
+	//! Navigation, Recast and Detour.
+	ALLOCATOR_TAG_NAVIGATION = 8,
+	
+	//! Fonts.
+	ALLOCATOR_TAG_FONT		 = 9,
+	
+	//! Threads and workers.
+	ALLOCATOR_TAG_THREAD	 = 10,
+	
+	//! The number of tags.
+	ALLOCATOR_TAG_MAX		 = 11
+};
+
+
+//! Structure definition of the allocation statistics of a tag. \sa ALLOCATOR_get_stats
+typedef struct
+{
+	//! The number of bytes currently allocated.
+	size_t			current;
+	
+	//! The highest number of bytes allocated at once.
+	size_t			peak;
+	
+	//! The number of blocks currently allocated.
+	unsigned int	n_block;
+	
+	//! The total number of allocations (realloc included).
+	unsigned int	n_alloc;
+	
+	//! The number of allocations during the current frame.
+	unsigned int	frame_alloc;
+	
+	//! The number of bytes allocated during the current frame.
+	size_t			frame_bytes;
+	
+	//! The number of allocations during the previous frame.
+	unsigned int	last_frame_alloc;
+	
+	//! The number of bytes allocated during the previous frame.
+	size_t			last_frame_bytes;
+	
+} ALLOCATORSTATS;
+
+
+//! Structure definition of a tracked block.
+typedef struct
+{
+	//! The address of the block, NULL for an empty slot.
+	void			*ptr;
+	
+	//! The size of the block in bytes.
+	size_t			size;
+	
+	//! The tag of the block.
+	unsigned char	tag;
+	
+} ALLOCATORRECORD;
+
+
+//! Structure definition of the engine allocators.
+typedef struct
+{
+	//! The allocation hook used by the ARENA and POOL blocks and the bundled libraries.
+	ALLOCATORALLOC	*alloc_hook;
+	
+	//! The free hook.
+	ALLOCATORFREE	*free_hook;
+	
+	//! The scratch ARENA reset every frame, NULL until ALLOCATOR_init. \sa ALLOCATOR_frame
+	ARENA			*frame;
+	
+	//! The pools of the engine structures, indexed by POOL_TEXTURE, POOL_PROGRAM etc.
+	POOL			pool[ POOL_MAX ];
+	
+	#ifdef GFX_TRACK_ALLOCATION
+	
+		//! The statistics of each tag.
+		ALLOCATORSTATS	allocatorstats[ ALLOCATOR_TAG_MAX ];
+		
+		//! The number of tracked blocks.
+		unsigned int	n_record;
+		
+		//! The number of slots of the hash table (a power of two).
+		unsigned int	max_record;
+		
+		//! The hash table of the tracked blocks, indexed by address.
+		ALLOCATORRECORD	*record;
+		
+		//! The mutex protecting the tracking.
+		pthread_mutex_t	mutex;
+	
+	#endif
+	
+} ALLOCATOR;
+
+//! Global engine allocators. Declared as extern in allocator.h and implemented in allocator.cpp
+extern ALLOCATOR allocator;
+
+
+ARENA *ARENA_init( unsigned int size );
+
+ARENA *ARENA_free( ARENA *arena );
+
+void *ARENA_alloc( ARENA *arena, unsigned int size );
+
+void ARENA_reset( ARENA *arena );
+
+void *POOL_alloc( POOL *pool );
+
+void POOL_release( POOL *pool, void *ptr );
+
+POOL *POOL_free( POOL *pool );
+
+void ALLOCATOR_init( unsigned int frame_size );
+
+void ALLOCATOR_free( void );
+
+void ALLOCATOR_set_hook( ALLOCATORALLOC *alloc_hook, ALLOCATORFREE *free_hook );
+
+void ALLOCATOR_frame( void );
+
+void *ALLOCATOR_png_alloc( png_structp structp, png_size_t size );
+
+void ALLOCATOR_png_free( png_structp structp, png_voidp ptr );
+
+void ALLOCATOR_print( void );
+
+unsigned char ALLOCATOR_get_stats( unsigned int tag, ALLOCATORSTATS *allocatorstats );
+
+#ifdef GFX_TRACK_ALLOCATION
+
+	void ALLOCATOR_track( void *ptr, size_t size, unsigned char tag );
+
+	size_t ALLOCATOR_untrack( void *ptr );
+
+	void *ALLOCATOR_track_malloc( size_t size, unsigned char tag );
+
+	void *ALLOCATOR_track_calloc( size_t n, size_t size, unsigned char tag );
+
+	void *ALLOCATOR_track_realloc( void *ptr, size_t size, unsigned char tag );
+
+	void ALLOCATOR_track_free( void *ptr );
+
+	//! Record a block allocated outside of the tracked wrappers.
+	#define ALLOCATOR_TRACK( ptr, size, tag ) ALLOCATOR_track( ptr, size, tag )
+
+	//! Forget a block before freeing it outside of the tracked wrappers.
+	#define ALLOCATOR_UNTRACK( ptr ) ALLOCATOR_untrack( ptr )
+
+#else
+
+	#define ALLOCATOR_TRACK( ptr, size, tag )
+
+	#define ALLOCATOR_UNTRACK( ptr )
+
+#endif
+
+#endif
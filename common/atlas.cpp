@@ -0,0 +1,848 @@
+/*
+
+GFX Lightweight OpenGLES 2.0 Game and Graphics Engine
+
+Copyright (C) 2011 Romain Marucchi-Foino http://gfx.sio2interactive.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of
+this software. Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that
+you wrote the original software. If you use this software in a product, an acknowledgment
+in the product would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented
+as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#define ALLOCATOR_TAG ALLOCATOR_TAG_TEXTURE
+
+#include "gfx.h"
+
+/*!
+	\file atlas.cpp
+
+    \brief Pack many small textures into shared pages.
+
+	\details Every TEXTURE_draw of a small UI or prop texture cost a bind and usually a
+	separate draw call. An ATLAS copy the texels of many textures into a few large pages
+	using a skyline bottom-left packer, and give for each entry the UV scale and offset to
+	apply to its original UVs. Each entry is surrounded by a border of replicated texels
+	so filtering and the first mipmap levels do not bleed between neighbours. An ATLAS
+	can be packed at load time with ATLAS_add and ATLAS_pack, or cooked offline with
+	ATLAS_save and loaded back with ATLAS_load.
+*/
+
+
+/*!
+	Create a new empty ATLAS.
+
+	\param[in] name The internal name of the atlas.
+	\param[in] width The width of the pages (should be a power of two).
+	\param[in] height The height of the pages (should be a power of two).
+	\param[in] padding The number of texels replicated around each entry, use at least
+	2^n texels to prevent bleeding up to the mipmap level n.
+
+	\return Return a new ATLAS structure pointer.
+*/
+ATLAS *ATLAS_init( char *name, unsigned int width, unsigned int height, unsigned int padding )
+{
+	ATLAS *atlas = ( ATLAS * ) calloc( 1, sizeof( ATLAS ) );
+
+	strcpy( atlas->name, name );
+
+	atlas->width   = width;
+	atlas->height  = height;
+	atlas->padding = padding;
+
+	return atlas;
+}
+
+
+/*!
+	Free an ATLAS and the TEXTURE of its pages.
+
+	\param[in,out] atlas A valid ATLAS structure pointer.
+
+	\return Return a NULL ATLAS structure pointer.
+*/
+ATLAS *ATLAS_free( ATLAS *atlas )
+{
+	unsigned int i = 0;
+
+	while( i != atlas->n_atlasentry )
+	{
+		if( atlas->atlasentry[ i ].texel_array ) free( atlas->atlasentry[ i ].texel_array );
+		++i;
+	}
+
+	i = 0;
+	while( i != atlas->n_atlaspage )
+	{
+		TEXTURE_free( atlas->atlaspage[ i ].texture );
+
+		if( atlas->atlaspage[ i ].atlasnode ) free( atlas->atlaspage[ i ].atlasnode );
+
+		++i;
+	}
+
+	if( atlas->atlasentry ) free( atlas->atlasentry );
+
+	if( atlas->atlaspage ) free( atlas->atlaspage );
+
+	free( atlas );
+	return NULL;
+}
+
+
+/*!
+	Queue the texels of a texture to be packed in the atlas. The texels are copied and
+	converted to RGBA, the texture can be freed right after.
+
+	\param[in,out] atlas A valid ATLAS structure pointer.
+	\param[in] name The name of the entry. \sa ATLAS_get_entry
+	\param[in] texture A valid TEXTURE structure pointer that contain an uncompressed 8 bits per channel texel array.
+
+	\return Return the index of the new entry, or -1 if the texture cannot be added.
+*/
+int ATLAS_add( ATLAS *atlas, char *name, TEXTURE *texture )
+{
+	unsigned int i = 0,
+				 n_texel = texture->width * texture->height;
+
+	ATLASENTRY *atlasentry;
+
+	if( !texture->texel_array || texture->compression || texture->texel_type != GL_UNSIGNED_BYTE )
+	{
+		console_print( "ATLAS: %s is not an uncompressed 8 bits texture.\n", name );
+		return -1;
+	}
+
+	if( texture->width  + ( atlas->padding << 1 ) > atlas->width ||
+		texture->height + ( atlas->padding << 1 ) > atlas->height )
+	{
+		console_print( "ATLAS: %s does not fit in a %dx%d page.\n", name, atlas->width, atlas->height );
+		return -1;
+	}
+
+	++atlas->n_atlasentry;
+
+	atlas->atlasentry = ( ATLASENTRY * ) realloc( atlas->atlasentry,
+												  atlas->n_atlasentry * sizeof( ATLASENTRY ) );
+
+	atlasentry = &atlas->atlasentry[ atlas->n_atlasentry - 1 ];
+
+	memset( atlasentry, 0, sizeof( ATLASENTRY ) );
+
+	strcpy( atlasentry->name, name );
+
+	atlasentry->page	= ATLAS_NO_PAGE;
+	atlasentry->width	= texture->width;
+	atlasentry->height	= texture->height;
+
+	atlasentry->texel_array = ( unsigned char * ) malloc( n_texel << 2 );
+
+	while( i != n_texel )
+	{
+		unsigned char *src = &texture->texel_array[ i * texture->byte ],
+					  *dst = &atlasentry->texel_array[ i << 2 ];
+
+		switch( texture->byte )
+		{
+			case 1:
+			{
+				dst[ 0 ] = dst[ 1 ] = dst[ 2 ] = src[ 0 ];
+				dst[ 3 ] = 255;
+
+				break;
+			}
+
+			case 2:
+			{
+				dst[ 0 ] = dst[ 1 ] = dst[ 2 ] = src[ 0 ];
+				dst[ 3 ] = src[ 1 ];
+
+				break;
+			}
+
+			case 3:
+			{
+				memcpy( dst, src, 3 );
+				dst[ 3 ] = 255;
+
+				break;
+			}
+
+			case 4:
+			{
+				memcpy( dst, src, 4 );
+
+				break;
+			}
+		}
+
+		++i;
+	}
+
+	return atlas->n_atlasentry - 1;
+}
+
+
+/*!
+	Helper function to load a texture file and queue it to be packed in the atlas.
+
+	\param[in,out] atlas A valid ATLAS structure pointer.
+	\param[in] name The name of the entry. \sa ATLAS_get_entry
+	\param[in] filename The texture file to load.
+	\param[in] relative_path Determine if the filename is a relative (1) or absolute (0) path.
+
+	\return Return the index of the new entry, or -1 if the texture cannot be added.
+*/
+int ATLAS_add_file( ATLAS *atlas, char *name, char *filename, unsigned char relative_path )
+{
+	int index;
+
+	TEXTURE *texture;
+
+	MEMORY *m = mopen( filename, relative_path );
+
+	if( !m ) return -1;
+
+	texture = TEXTURE_init( name );
+
+	TEXTURE_load( texture, m );
+
+	mclose( m );
+
+	index = ATLAS_add( atlas, name, texture );
+
+	TEXTURE_free( texture );
+
+	return index;
+}
+
+
+/*!
+	Create a new empty page. This function is used internally.
+
+	\param[in,out] atlas A valid ATLAS structure pointer.
+
+	\return Return the new ATLASPAGE structure pointer.
+*/
+ATLASPAGE *ATLAS_add_page( ATLAS *atlas )
+{
+	ATLASPAGE *atlaspage;
+
+	++atlas->n_atlaspage;
+
+	atlas->atlaspage = ( ATLASPAGE * ) realloc( atlas->atlaspage,
+												atlas->n_atlaspage * sizeof( ATLASPAGE ) );
+
+	atlaspage = &atlas->atlaspage[ atlas->n_atlaspage - 1 ];
+
+	atlaspage->texture = TEXTURE_init( atlas->name );
+
+	atlaspage->texture->width			= atlas->width;
+	atlaspage->texture->height			= atlas->height;
+	atlaspage->texture->byte			= 4;
+	atlaspage->texture->size			= atlas->width * atlas->height * 4;
+	atlaspage->texture->internal_format =
+	atlaspage->texture->format			= GL_RGBA;
+	atlaspage->texture->texel_type		= GL_UNSIGNED_BYTE;
+	atlaspage->texture->texel_array		= ( unsigned char * ) calloc( 1, atlaspage->texture->size );
+
+	atlaspage->n_atlasnode = 1;
+
+	atlaspage->atlasnode = ( ATLASNODE * ) malloc( sizeof( ATLASNODE ) );
+
+	atlaspage->atlasnode[ 0 ].x		= 0;
+	atlaspage->atlasnode[ 0 ].y		= 0;
+	atlaspage->atlasnode[ 0 ].width	= atlas->width;
+
+	return atlaspage;
+}
+
+
+/*!
+	Find the lowest position of a rectangle starting at a segment of the skyline. This
+	function is used internally.
+
+	\param[in] atlas A valid ATLAS structure pointer.
+	\param[in] atlaspage The page to look in.
+	\param[in] index The segment where the rectangle start.
+	\param[in] width The width of the rectangle.
+	\param[in] height The height of the rectangle.
+
+	\return Return the top position of the rectangle, or -1 if it does not fit.
+*/
+int ATLAS_fit( ATLAS *atlas, ATLASPAGE *atlaspage, unsigned int index, unsigned int width, unsigned int height )
+{
+	unsigned int y	  = 0,
+				 left = width;
+
+	if( atlaspage->atlasnode[ index ].x + width > atlas->width ) return -1;
+
+	while( left )
+	{
+		if( index == atlaspage->n_atlasnode ) return -1;
+
+		ATLASNODE *atlasnode = &atlaspage->atlasnode[ index ];
+
+		if( atlasnode->y > y ) y = atlasnode->y;
+
+		if( y + height > atlas->height ) return -1;
+
+		left = left > atlasnode->width ? left - atlasnode->width : 0;
+
+		++index;
+	}
+
+	return y;
+}
+
+
+/*!
+	Raise the skyline of a page under a new rectangle. This function is used internally.
+
+	\param[in,out] atlaspage The page to update.
+	\param[in] index The segment where the rectangle start.
+	\param[in] x The left position of the rectangle.
+	\param[in] y The bottom of the rectangle (its top position plus its height).
+	\param[in] width The width of the rectangle.
+*/
+void ATLAS_insert( ATLASPAGE *atlaspage, unsigned int index, unsigned int x, unsigned int y, unsigned int width )
+{
+	unsigned int i = index + 1;
+
+	++atlaspage->n_atlasnode;
+
+	atlaspage->atlasnode = ( ATLASNODE * ) realloc( atlaspage->atlasnode,
+													atlaspage->n_atlasnode * sizeof( ATLASNODE ) );
+
+	memmove( &atlaspage->atlasnode[ index + 1 ],
+			 &atlaspage->atlasnode[ index ],
+			 ( atlaspage->n_atlasnode - index - 1 ) * sizeof( ATLASNODE ) );
+
+	atlaspage->atlasnode[ index ].x		= x;
+	atlaspage->atlasnode[ index ].y		= y;
+	atlaspage->atlasnode[ index ].width	= width;
+
+	// Shrink or remove the segments covered by the new one.
+	while( i != atlaspage->n_atlasnode )
+	{
+		ATLASNODE *atlasnode = &atlaspage->atlasnode[ i ];
+
+		unsigned int right = x + width;
+
+		if( atlasnode->x >= right ) break;
+
+		if( atlasnode->x + atlasnode->width > right )
+		{
+			atlasnode->width -= right - atlasnode->x;
+			atlasnode->x	  = right;
+
+			break;
+		}
+
+		--atlaspage->n_atlasnode;
+
+		memmove( &atlaspage->atlasnode[ i ],
+				 &atlaspage->atlasnode[ i + 1 ],
+				 ( atlaspage->n_atlasnode - i ) * sizeof( ATLASNODE ) );
+	}
+
+	// Merge the neighbour segments at the same height.
+	i = 0;
+	while( i + 1 < atlaspage->n_atlasnode )
+	{
+		if( atlaspage->atlasnode[ i ].y == atlaspage->atlasnode[ i + 1 ].y )
+		{
+			atlaspage->atlasnode[ i ].width += atlaspage->atlasnode[ i + 1 ].width;
+
+			--atlaspage->n_atlasnode;
+
+			memmove( &atlaspage->atlasnode[ i + 1 ],
+					 &atlaspage->atlasnode[ i + 2 ],
+					 ( atlaspage->n_atlasnode - i - 1 ) * sizeof( ATLASNODE ) );
+		}
+		else ++i;
+	}
+}
+
+
+/*!
+	Copy the texels of an entry in its page and replicate its border into the padding.
+	This function is used internally.
+
+	\param[in,out] atlas A valid ATLAS structure pointer.
+	\param[in] atlasentry The packed entry to copy.
+*/
+void ATLAS_blit( ATLAS *atlas, ATLASENTRY *atlasentry )
+{
+	int i = -( int )atlas->padding,
+		j,
+		padding = atlas->padding;
+
+	unsigned char *texel_array = atlas->atlaspage[ atlasentry->page ].texture->texel_array;
+
+	while( i != ( int )atlasentry->height + padding )
+	{
+		int y = CLAMP( i, 0, ( int )atlasentry->height - 1 );
+
+		unsigned char *src = &atlasentry->texel_array[ y * atlasentry->width * 4 ],
+					  *dst = &texel_array[ ( ( atlasentry->y + i ) * atlas->width + atlasentry->x ) * 4 ];
+
+		memcpy( dst, src, atlasentry->width * 4 );
+
+		j = 1;
+		while( j <= padding )
+		{
+			memcpy( dst - j * 4, src, 4 );
+
+			memcpy( dst + ( atlasentry->width + j - 1 ) * 4, src + ( atlasentry->width - 1 ) * 4, 4 );
+
+			++j;
+		}
+
+		++i;
+	}
+}
+
+
+/*!
+	Update the UV scale and offset of an entry from its position. This function is used internally.
+
+	\param[in] atlas A valid ATLAS structure pointer.
+	\param[in,out] atlasentry A packed ATLASENTRY structure pointer.
+*/
+void ATLAS_set_uv( ATLAS *atlas, ATLASENTRY *atlasentry )
+{
+	atlasentry->scale.x	 = ( float )atlasentry->width  / ( float )atlas->width;
+	atlasentry->scale.y	 = ( float )atlasentry->height / ( float )atlas->height;
+	atlasentry->offset.x = ( float )atlasentry->x / ( float )atlas->width;
+	atlasentry->offset.y = ( float )atlasentry->y / ( float )atlas->height;
+}
+
+
+/*!
+	Sort the entries from the tallest to the shortest. This function is used internally as qsort callback.
+*/
+int ATLAS_compare( const void *a, const void *b )
+{
+	ATLASENTRY *atlasentry_a = *( ATLASENTRY ** )a,
+			   *atlasentry_b = *( ATLASENTRY ** )b;
+
+	if( atlasentry_a->height != atlasentry_b->height ) return atlasentry_a->height > atlasentry_b->height ? -1 : 1;
+
+	if( atlasentry_a->width != atlasentry_b->width ) return atlasentry_a->width > atlasentry_b->width ? -1 : 1;
+
+	return 0;
+}
+
+
+/*!
+	Pack all the entries queued since the last call in the pages of the atlas, using a
+	skyline bottom-left heuristic on the entries sorted by height. New pages are created
+	as needed. The pages that have already been uploaded by ATLAS_build are not reused.
+
+	\param[in,out] atlas A valid ATLAS structure pointer.
+
+	\return Return the number of pages of the atlas.
+*/
+unsigned int ATLAS_pack( ATLAS *atlas )
+{
+	unsigned int i		 = 0,
+				 n_entry = 0;
+
+	ATLASENTRY **atlasentry = ( ATLASENTRY ** ) malloc( ( atlas->n_atlasentry + 1 ) * sizeof( ATLASENTRY * ) );
+
+	while( i != atlas->n_atlasentry )
+	{
+		if( atlas->atlasentry[ i ].page == ATLAS_NO_PAGE )
+		{
+			atlasentry[ n_entry ] = &atlas->atlasentry[ i ];
+			++n_entry;
+		}
+
+		++i;
+	}
+
+	qsort( atlasentry, n_entry, sizeof( ATLASENTRY * ), ATLAS_compare );
+
+	i = 0;
+	while( i != n_entry )
+	{
+		unsigned int j		 = 0,
+					 width	 = atlasentry[ i ]->width  + ( atlas->padding << 1 ),
+					 height	 = atlasentry[ i ]->height + ( atlas->padding << 1 ),
+					 best_node = 0,
+					 best_page = ATLAS_NO_PAGE,
+					 best_y	   = 0,
+					 best_width = 0;
+
+		while( j != atlas->n_atlaspage )
+		{
+			ATLASPAGE *atlaspage = &atlas->atlaspage[ j ];
+
+			unsigned int k = 0;
+
+			if( atlaspage->texture->texel_array )
+			{
+				while( k != atlaspage->n_atlasnode )
+				{
+					int y = ATLAS_fit( atlas, atlaspage, k, width, height );
+
+					// Keep the lowest position, then the tightest segment.
+					if( y != -1 &&
+						( best_page == ATLAS_NO_PAGE ||
+						  ( unsigned int )y < best_y ||
+						  ( ( unsigned int )y == best_y && atlaspage->atlasnode[ k ].width < best_width ) ) )
+					{
+						best_page  = j;
+						best_node  = k;
+						best_y	   = y;
+						best_width = atlaspage->atlasnode[ k ].width;
+					}
+
+					++k;
+				}
+			}
+
+			// Fill the pages in order.
+			if( best_page != ATLAS_NO_PAGE ) break;
+
+			++j;
+		}
+
+		if( best_page == ATLAS_NO_PAGE )
+		{
+			ATLAS_add_page( atlas );
+
+			best_page = atlas->n_atlaspage - 1;
+			best_node = 0;
+			best_y	  = 0;
+		}
+
+		atlasentry[ i ]->page = best_page;
+		atlasentry[ i ]->x	  = atlas->atlaspage[ best_page ].atlasnode[ best_node ].x + atlas->padding;
+		atlasentry[ i ]->y	  = best_y + atlas->padding;
+
+		ATLAS_insert( &atlas->atlaspage[ best_page ],
+					  best_node,
+					  atlasentry[ i ]->x - atlas->padding,
+					  best_y + height,
+					  width );
+
+		ATLAS_blit( atlas, atlasentry[ i ] );
+
+		ATLAS_set_uv( atlas, atlasentry[ i ] );
+
+		free( atlasentry[ i ]->texel_array );
+		atlasentry[ i ]->texel_array = NULL;
+
+		++i;
+	}
+
+	free( atlasentry );
+
+	return atlas->n_atlaspage;
+}
+
+
+/*!
+	Pack the pending entries and upload the pages. The texels of the pages are released, call
+	ATLAS_save before if you want to cook the atlas.
+
+	\param[in,out] atlas A valid ATLAS structure pointer.
+	\param[in] flags The TEXTURE flags to use for the pages.
+	\param[in] filter The mipmap filtering to use for the pages.
+	\param[in] anisotropic_filter The anisotropic filtering to use for the pages.
+*/
+void ATLAS_build( ATLAS *atlas, unsigned int flags, unsigned char filter, float anisotropic_filter )
+{
+	unsigned int i = 0;
+
+	ATLAS_pack( atlas );
+
+	while( i != atlas->n_atlaspage )
+	{
+		TEXTURE *texture = atlas->atlaspage[ i ].texture;
+
+		if( texture->texel_array )
+		{
+			TEXTURE_generate_id( texture, flags, filter, anisotropic_filter );
+
+			TEXTURE_free_texel_array( texture );
+		}
+
+		++i;
+	}
+}
+
+
+/*!
+	Save a packed atlas to a cooked atlas file, the pages are stored zlib compressed.
+
+	\param[in] atlas A valid ATLAS structure pointer packed but not built yet.
+	\param[in] filename The absolute path of the file to create.
+
+	\return Return 1 if the file have been saved, else 0.
+*/
+unsigned char ATLAS_save( ATLAS *atlas, char *filename )
+{
+	unsigned int i = 0;
+
+	ATLASHEADER atlasheader;
+
+	FILE *f;
+
+	ATLAS_pack( atlas );
+
+	while( i != atlas->n_atlaspage )
+	{
+		if( !atlas->atlaspage[ i ].texture->texel_array ) return 0;
+		++i;
+	}
+
+	f = fopen( filename, "wb" );
+
+	if( !f ) return 0;
+
+	memcpy( atlasheader.identifier, "GFXATLAS", 8 );
+
+	atlasheader.width		 = atlas->width;
+	atlasheader.height		 = atlas->height;
+	atlasheader.padding		 = atlas->padding;
+	atlasheader.n_atlaspage	 = atlas->n_atlaspage;
+	atlasheader.n_atlasentry = atlas->n_atlasentry;
+
+	fwrite( &atlasheader, sizeof( ATLASHEADER ), 1, f );
+
+	i = 0;
+	while( i != atlas->n_atlasentry )
+	{
+		ATLASENTRY *atlasentry = &atlas->atlasentry[ i ];
+
+		fwrite( atlasentry->name, MAX_CHAR, 1, f );
+		fwrite( &atlasentry->page, sizeof( unsigned int ), 1, f );
+		fwrite( &atlasentry->x, sizeof( unsigned int ), 1, f );
+		fwrite( &atlasentry->y, sizeof( unsigned int ), 1, f );
+		fwrite( &atlasentry->width, sizeof( unsigned int ), 1, f );
+		fwrite( &atlasentry->height, sizeof( unsigned int ), 1, f );
+
+		++i;
+	}
+
+	i = 0;
+	while( i != atlas->n_atlaspage )
+	{
+		TEXTURE *texture = atlas->atlaspage[ i ].texture;
+
+		uLongf size = compressBound( texture->size );
+
+		unsigned int compressed_size;
+
+		unsigned char *buffer = ( unsigned char * ) malloc( size );
+
+		compress2( buffer, &size, texture->texel_array, texture->size, 9 );
+
+		compressed_size = ( unsigned int )size;
+
+		fwrite( &compressed_size, sizeof( unsigned int ), 1, f );
+
+		fwrite( buffer, compressed_size, 1, f );
+
+		free( buffer );
+
+		++i;
+	}
+
+	fclose( f );
+
+	return 1;
+}
+
+
+/*!
+	Load a cooked atlas file. The pages are ready to be uploaded with ATLAS_build.
+
+	\param[in] name The internal name of the atlas.
+	\param[in] filename The cooked atlas file to load. \sa ATLAS_save
+	\param[in] relative_path Determine if the filename is a relative (1) or absolute (0) path.
+
+	\return Return a new ATLAS structure pointer, or NULL if the file cannot be loaded.
+*/
+ATLAS *ATLAS_load( char *name, char *filename, unsigned char relative_path )
+{
+	unsigned int i = 0;
+
+	ATLASHEADER atlasheader;
+
+	ATLAS *atlas;
+
+	MEMORY *m = mopen( filename, relative_path );
+
+	if( !m ) return NULL;
+
+	if( mread( m, &atlasheader, sizeof( ATLASHEADER ) ) != sizeof( ATLASHEADER ) ||
+		memcmp( atlasheader.identifier, "GFXATLAS", 8 ) )
+	{
+		console_print( "ATLAS: %s is not a cooked atlas.\n", filename );
+
+		mclose( m );
+		return NULL;
+	}
+
+	atlas = ATLAS_init( name, atlasheader.width, atlasheader.height, atlasheader.padding );
+
+	atlas->n_atlasentry = atlasheader.n_atlasentry;
+
+	atlas->atlasentry = ( ATLASENTRY * ) calloc( atlas->n_atlasentry, sizeof( ATLASENTRY ) );
+
+	while( i != atlas->n_atlasentry )
+	{
+		ATLASENTRY *atlasentry = &atlas->atlasentry[ i ];
+
+		mread( m, atlasentry->name, MAX_CHAR );
+		mread( m, &atlasentry->page, sizeof( unsigned int ) );
+		mread( m, &atlasentry->x, sizeof( unsigned int ) );
+		mread( m, &atlasentry->y, sizeof( unsigned int ) );
+		mread( m, &atlasentry->width, sizeof( unsigned int ) );
+		mread( m, &atlasentry->height, sizeof( unsigned int ) );
+
+		atlasentry->name[ MAX_CHAR - 1 ] = 0;
+
+		ATLAS_set_uv( atlas, atlasentry );
+
+		++i;
+	}
+
+	i = 0;
+	while( i != atlasheader.n_atlaspage )
+	{
+		unsigned int compressed_size = 0;
+
+		uLongf size;
+
+		ATLASPAGE *atlaspage = ATLAS_add_page( atlas );
+
+		mread( m, &compressed_size, sizeof( unsigned int ) );
+
+		size = atlaspage->texture->size;
+
+		if( m->position + compressed_size > m->size ||
+			uncompress( atlaspage->texture->texel_array,
+						&size,
+						&m->buffer[ m->position ],
+						compressed_size ) != Z_OK )
+		{
+			console_print( "ATLAS: %s page %d is corrupted.\n", filename, i );
+		}
+
+		m->position += compressed_size;
+
+		// The free space of a cooked page is unknown, new entries go to new pages.
+		atlaspage->atlasnode[ 0 ].y = atlas->height;
+
+		++i;
+	}
+
+	mclose( m );
+
+	return atlas;
+}
+
+
+/*!
+	Get an atlas entry by name.
+
+	\param[in] atlas A valid ATLAS structure pointer.
+	\param[in] name The name of the entry to look for.
+	\param[in] exact_name Determine if the name have to match exactly (1) or only partially (0).
+
+	\return Return the ATLASENTRY structure pointer, or NULL if not found.
+*/
+ATLASENTRY *ATLAS_get_entry( ATLAS *atlas, const char *name, unsigned char exact_name )
+{
+	unsigned int i = 0;
+
+	while( i != atlas->n_atlasentry )
+	{
+		if( exact_name )
+		{ if( !strcmp( atlas->atlasentry[ i ].name, name ) ) return &atlas->atlasentry[ i ]; }
+
+		else
+		{ if( strstr( atlas->atlasentry[ i ].name, name ) ) return &atlas->atlasentry[ i ]; }
+
+		++i;
+	}
+
+	return NULL;
+}
+
+
+/*!
+	Get the TEXTURE of the page that contain an entry.
+
+	\param[in] atlas A valid ATLAS structure pointer.
+	\param[in] atlasentry A packed ATLASENTRY structure pointer.
+
+	\return Return the TEXTURE structure pointer of the page, or NULL if the entry is not packed.
+*/
+TEXTURE *ATLAS_get_texture( ATLAS *atlas, ATLASENTRY *atlasentry )
+{
+	return atlasentry->page == ATLAS_NO_PAGE ? NULL : atlas->atlaspage[ atlasentry->page ].texture;
+}
+
+
+/*!
+	Remap an array of UVs in the 0..1 range of an entry original texture to the atlas page.
+	Use it to bake the UVs of 2D sprites so they can be batched in a single draw.
+
+	\param[in] atlasentry A packed ATLASENTRY structure pointer.
+	\param[in] n_uv The number of UVs.
+	\param[in,out] uv The array of UVs to remap.
+*/
+void ATLAS_transform_uv( ATLASENTRY *atlasentry, unsigned int n_uv, vec2 *uv )
+{
+	unsigned int i = 0;
+
+	while( i != n_uv )
+	{
+		uv[ i ].x = uv[ i ].x * atlasentry->scale.x + atlasentry->offset.x;
+		uv[ i ].y = uv[ i ].y * atlasentry->scale.y + atlasentry->offset.y;
+
+		++i;
+	}
+}
+
+
+/*!
+	Bind the page of an entry and load its UV scale and offset in the texture matrix, for
+	shaders that transform their UVs with GFX_get_texture_matrix.
+
+	\param[in] atlas A valid ATLAS structure pointer.
+	\param[in] atlasentry A packed ATLASENTRY structure pointer.
+*/
+void ATLAS_draw( ATLAS *atlas, ATLASENTRY *atlasentry )
+{
+	unsigned char matrix_mode = gfx.matrix_mode;
+
+	TEXTURE_draw( atlas->atlaspage[ atlasentry->page ].texture );
+
+	GFX_set_matrix_mode( TEXTURE_MATRIX );
+
+	GFX_load_identity();
+
+	GFX_translate( atlasentry->offset.x, atlasentry->offset.y, 0.0f );
+
+	GFX_scale( atlasentry->scale.x, atlasentry->scale.y, 1.0f );
+
+	GFX_set_matrix_mode( matrix_mode );
+}
@@ -0,0 +1,179 @@
+/*
+
+GFX Lightweight OpenGLES 2.0 Game and Graphics Engine
+
+Copyright (C) 2011 Romain Marucchi-Foino http://gfx.sio2interactive.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of
+this software. Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that
+you wrote the original software. If you use this software in a product, an acknowledgment
+in the product would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented
+as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef ATLAS_H
+#define ATLAS_H
+
+/*!
+	\file atlas.h
+
+    \brief Contains structure definition and functions to use with a texture ATLAS.
+*/
+
+
+//! The page index of an ATLASENTRY that have not been packed yet.
+#define ATLAS_NO_PAGE	0xFFFFFFFF
+
+
+//! Structure definition of a segment of the skyline of an ATLASPAGE.
+typedef struct
+{
+	//! The left position of the segment.
+	unsigned int	x;
+
+	//! The height of the skyline along the segment.
+	unsigned int	y;
+
+	//! The width of the segment.
+	unsigned int	width;
+
+} ATLASNODE;
+
+
+//! Structure definition of a page of an ATLAS.
+typedef struct
+{
+	//! The TEXTURE of the page.
+	TEXTURE			*texture;
+
+	//! The number of segments of the skyline.
+	unsigned int	n_atlasnode;
+
+	//! Array of segments of the skyline, from left to right.
+	ATLASNODE		*atlasnode;
+
+} ATLASPAGE;
+
+
+//! Structure definition of a sub-rectangle of an ATLAS.
+typedef struct
+{
+	//! The name of the entry, usually the name of the original texture.
+	char			name[ MAX_CHAR ];
+
+	//! The index of the page that contain the entry, ATLAS_NO_PAGE until packed.
+	unsigned int	page;
+
+	//! The left position of the entry in the page in texels (padding excluded).
+	unsigned int	x;
+
+	//! The top position of the entry in the page in texels (padding excluded).
+	unsigned int	y;
+
+	//! The width of the entry in texels.
+	unsigned int	width;
+
+	//! The height of the entry in texels.
+	unsigned int	height;
+
+	//! The UV scale to apply to the original UVs of the entry.
+	vec2			scale;
+
+	//! The UV offset to add to the scaled UVs of the entry.
+	vec2			offset;
+
+	//! The RGBA texels of the entry waiting to be packed.
+	unsigned char	*texel_array;
+
+} ATLASENTRY;
+
+
+//! Structure definition of a texture atlas, a set of pages sharing many small textures to reduce the texture binds.
+typedef struct
+{
+	//! The internal name of the atlas.
+	char			name[ MAX_CHAR ];
+
+	//! The width of the pages.
+	unsigned int	width;
+
+	//! The height of the pages.
+	unsigned int	height;
+
+	//! The number of texels replicated around each entry to prevent bleeding between entries when filtering and mipmapping.
+	unsigned int	padding;
+
+	//! The number of pages.
+	unsigned int	n_atlaspage;
+
+	//! Array of pages.
+	ATLASPAGE		*atlaspage;
+
+	//! The number of entries.
+	unsigned int	n_atlasentry;
+
+	//! Array of entries.
+	ATLASENTRY		*atlasentry;
+
+} ATLAS;
+
+
+//! Header of a cooked atlas file. \sa ATLAS_save
+typedef struct
+{
+	//! The file identifier "GFXATLAS".
+	char			identifier[ 8 ];
+
+	//! The width of the pages.
+	unsigned int	width;
+
+	//! The height of the pages.
+	unsigned int	height;
+
+	//! The padding used to pack the entries.
+	unsigned int	padding;
+
+	//! The number of pages.
+	unsigned int	n_atlaspage;
+
+	//! The number of entries.
+	unsigned int	n_atlasentry;
+
+} ATLASHEADER;
+
+
+ATLAS *ATLAS_init( char *name, unsigned int width, unsigned int height, unsigned int padding );
+
+ATLAS *ATLAS_free( ATLAS *atlas );
+
+int ATLAS_add( ATLAS *atlas, char *name, TEXTURE *texture );
+
+int ATLAS_add_file( ATLAS *atlas, char *name, char *filename, unsigned char relative_path );
+
+unsigned int ATLAS_pack( ATLAS *atlas );
+
+void ATLAS_build( ATLAS *atlas, unsigned int flags, unsigned char filter, float anisotropic_filter );
+
+unsigned char ATLAS_save( ATLAS *atlas, char *filename );
+
+ATLAS *ATLAS_load( char *name, char *filename, unsigned char relative_path );
+
+ATLASENTRY *ATLAS_get_entry( ATLAS *atlas, const char *name, unsigned char exact_name );
+
+TEXTURE *ATLAS_get_texture( ATLAS *atlas, ATLASENTRY *atlasentry );
+
+void ATLAS_transform_uv( ATLASENTRY *atlasentry, unsigned int n_uv, vec2 *uv );
+
+void ATLAS_draw( ATLAS *atlas, ATLASENTRY *atlasentry );
+
+#endif
@@ -0,0 +1,160 @@
+/*
+
+GFX Lightweight OpenGLES 2.0 Game and Graphics Engine
+
+Copyright (C) 2011 Romain Marucchi-Foino http://gfx.sio2interactive.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of
+this software. Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that
+you wrote the original software. If you use this software in a product, an acknowledgment
+in the product would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented
+as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+/*!
+	\file atomic.h
+
+    \brief Portable atomic operations on integers and pointers.
+	
+	\details All the operations are full memory barriers (sequentially consistent), which is
+	what the lock-free structures of the engine expect. They are inline since a function call
+	would cost more than the operation itself.
+*/
+
+
+//! Read an integer, the following reads and writes cannot be moved before it.
+inline int ATOMIC_load( volatile int *value )
+{
+	int v = *value;
+	
+	#ifdef _WIN32
+		MemoryBarrier();
+	#else
+		__sync_synchronize();
+	#endif
+	
+	return v;
+}
+
+
+//! Write an integer, the previous and following reads and writes cannot be moved across it.
+inline void ATOMIC_store( volatile int *value, int v )
+{
+	#ifdef _WIN32
+		InterlockedExchange( ( volatile LONG * )value, v );
+	#else
+		__sync_synchronize();
+		*value = v;
+		__sync_synchronize();
+	#endif
+}
+
+
+//! Add to an integer and return the new value.
+inline int ATOMIC_add( volatile int *value, int v )
+{
+	#ifdef _WIN32
+		return InterlockedExchangeAdd( ( volatile LONG * )value, v ) + v;
+	#else
+		return __sync_add_and_fetch( value, v );
+	#endif
+}
+
+
+//! Increment an integer and return the new value.
+inline int ATOMIC_increment( volatile int *value )
+{ return ATOMIC_add( value, 1 ); }
+
+
+//! Decrement an integer and return the new value.
+inline int ATOMIC_decrement( volatile int *value )
+{ return ATOMIC_add( value, -1 ); }
+
+
+//! Replace an integer by v if it is equal to expected, return 1 if it have been replaced.
+inline unsigned char ATOMIC_cas( volatile int *value, int expected, int v )
+{
+	#ifdef _WIN32
+		return InterlockedCompareExchange( ( volatile LONG * )value, v, expected ) == expected;
+	#else
+		return __sync_bool_compare_and_swap( value, expected, v );
+	#endif
+}
+
+
+//! Read a pointer, the following reads and writes cannot be moved before it.
+inline void *ATOMIC_load_ptr( void * volatile *ptr )
+{
+	void *p = *ptr;
+	
+	#ifdef _WIN32
+		MemoryBarrier();
+	#else
+		__sync_synchronize();
+	#endif
+	
+	return p;
+}
+
+
+//! Write a pointer, the previous and following reads and writes cannot be moved across it.
+inline void ATOMIC_store_ptr( void * volatile *ptr, void *p )
+{
+	#ifdef _WIN32
+		InterlockedExchangePointer( ptr, p );
+	#else
+		__sync_synchronize();
+		*ptr = p;
+		__sync_synchronize();
+	#endif
+}
+
+
+//! Replace a pointer by p if it is equal to expected, return 1 if it have been replaced.
+inline unsigned char ATOMIC_cas_ptr( void * volatile *ptr, void *expected, void *p )
+{
+	#ifdef _WIN32
+		return InterlockedCompareExchangePointer( ptr, p, expected ) == expected;
+	#else
+		return __sync_bool_compare_and_swap( ptr, expected, p );
+	#endif
+}
+
+
+//! Full memory barrier.
+inline void ATOMIC_fence( void )
+{
+	#ifdef _WIN32
+		MemoryBarrier();
+	#else
+		__sync_synchronize();
+	#endif
+}
+
+
+//! Tell the CPU the thread is spinning on a value.
+inline void ATOMIC_pause( void )
+{
+	#if defined( _WIN32 )
+		YieldProcessor();
+	#elif defined( __i386__ ) || defined( __x86_64__ )
+		__asm__ __volatile__( "pause" );
+	#elif ( defined( __arm__ ) && defined( __ARM_ARCH_7A__ ) ) || defined( __aarch64__ )
+		__asm__ __volatile__( "yield" );
+	#endif
+}
+
+#endif
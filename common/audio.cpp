@@ -161,28 +161,12 @@ void AUDIO_set_listener( vec3 *location, vec3 *direction, vec3 *up )
 }
 
 
-//! OGG callback to read from a binary stream in memory.
+//! OGG callback to read from a binary stream in memory (loaded or streamed).
 size_t AUDIO_ogg_read( void *ptr, size_t size, size_t read, void *memory_ptr )
 {
-	unsigned int seof,
-				 pos;
-
 	MEMORY *memory = ( MEMORY * )memory_ptr;
 
-	seof = memory->size - memory->position;
-
-	pos = ( ( read * size ) < seof ) ?
-		  pos = read * size :
-		  pos = seof;
-
-	if( pos )
-	{
-		memcpy( ptr, memory->buffer + memory->position, pos );
-		
-		memory->position += pos;
-	}
-
-	return pos;
+	return mread( memory, ptr, ( unsigned int )( read * size ) );
 }
 
 
@@ -201,7 +185,7 @@ int AUDIO_ogg_seek( void *memory_ptr, ogg_int64_t offset, int stride )
 				  pos = ( unsigned int )offset :
 				  pos = memory->size;
 
-			memory->position = pos;
+			mseek( memory, pos, SEEK_SET );
 
 			break;
 		}
@@ -214,7 +198,7 @@ int AUDIO_ogg_seek( void *memory_ptr, ogg_int64_t offset, int stride )
 				  pos = ( unsigned int )offset :
 				  pos = seof;
 
-			memory->position += pos;
+			mseek( memory, pos, SEEK_CUR );
 
 			break;
 		}
@@ -21,6 +21,8 @@ as being the original software.
 
 */
 
+#define ALLOCATOR_TAG ALLOCATOR_TAG_FONT
+
 #include "gfx.h"
 
 
@@ -192,7 +194,9 @@ unsigned char FONT_load( FONT			*font,
 
 /*!
 	Print a dynamic text on screen using the TTF bitmap texture auto-generated by the
-	FONT_load function.
+	FONT_load function. All the characters are drawn using a single draw call, and if
+	the FONT have a STREAMBUFFER the quads are written inside it. The quads are built in the
+	frame ARENA, so this function have to be called from the main thread.
 
 	\param[in] font A valid FONT structure pointer.
 	\param[in] x The X position in screen coordinate where to print the first character contain in the text.
@@ -208,9 +212,67 @@ void FONT_print( FONT *font, float x, float y, char *text, vec4 *color )
 		 texcoord_attribute = PROGRAM_get_vertex_attrib_location( font->program,
 																 ( char * )"TEXCOORD0" );
 
+	unsigned int n_vertex = 0;
+	
+	int offset = -1;
+	
+	// Interleaved POSITION and TEXCOORD0, 6 vertices per character.
+	unsigned int size = strlen( text ) * 6 * sizeof( vec4 );
+	
+	// Scratch data only needed until the draw call, taken from the frame ARENA once the allocator is initialized.
+	vec4 *vertex_data = ( vec4 * )( allocator.frame ? ARENA_alloc( allocator.frame, size ) : malloc( size ) );
+
+	while( *text )
+	{
+		if( *text >= font->first_character &&
+			*text <= ( font->first_character + font->count_character ) )
+		{
+			vec4 *vert = &vertex_data[ n_vertex ];
+			
+			stbtt_aligned_quad quad;
+			
+			stbtt_bakedchar *bakedchar = font->character_data + ( *text - font->first_character );
+			
+			int round_x = STBTT_ifloor( x + bakedchar->xoff );
+			int round_y = STBTT_ifloor( y - bakedchar->yoff );
+			
+			quad.x0 = ( float )round_x;
+			quad.y0 = ( float )round_y;
+			quad.x1 = ( float )round_x + bakedchar->x1 - bakedchar->x0;
+			quad.y1 = ( float )round_y - bakedchar->y1 + bakedchar->y0;
+			
+			quad.s0 = bakedchar->x0 / ( float )font->texture_width;
+			quad.t0 = bakedchar->y0 / ( float )font->texture_width;
+			quad.s1 = bakedchar->x1 / ( float )font->texture_height;
+			quad.t1 = bakedchar->y1 / ( float )font->texture_height;
+			
+			x += bakedchar->xadvance;
+			
+			vert[ 0 ].x = quad.x1; vert[ 0 ].y = quad.y0; vert[ 0 ].z = quad.s1; vert[ 0 ].w = quad.t0;
+			vert[ 1 ].x = quad.x0; vert[ 1 ].y = quad.y0; vert[ 1 ].z = quad.s0; vert[ 1 ].w = quad.t0;
+			vert[ 2 ].x = quad.x1; vert[ 2 ].y = quad.y1; vert[ 2 ].z = quad.s1; vert[ 2 ].w = quad.t1;
+
+			vert[ 3 ].x = quad.x0; vert[ 3 ].y = quad.y0; vert[ 3 ].z = quad.s0; vert[ 3 ].w = quad.t0;
+			vert[ 4 ].x = quad.x0; vert[ 4 ].y = quad.y1; vert[ 4 ].z = quad.s0; vert[ 4 ].w = quad.t1;
+			vert[ 5 ].x = quad.x1; vert[ 5 ].y = quad.y1; vert[ 5 ].z = quad.s1; vert[ 5 ].w = quad.t1;
+			
+			n_vertex += 6;
+		}
+	
+		++text;
+	}
+	
+	if( !n_vertex )
+	{
+		if( !allocator.frame ) free( vertex_data );
+		return;
+	}
+
 	glBindVertexArrayOES( 0 );
 
-	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	if( font->streambuffer ) offset = STREAMBUFFER_write( font->streambuffer, vertex_data, n_vertex * sizeof( vec4 ) );
+
+	if( offset == -1 ) glBindBuffer( GL_ARRAY_BUFFER, 0 );
 	
 	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
 
@@ -243,65 +305,25 @@ void FONT_print( FONT *font, float x, float y, char *text, vec4 *color )
 	
 	glEnableVertexAttribArray( texcoord_attribute );
 
-	while( *text )
-	{
-		if( *text >= font->first_character &&
-			*text <= ( font->first_character + font->count_character ) )
-		{
-			vec2 vert[ 4 ];
-			
-			vec2 uv[ 4 ];
-			
-			stbtt_aligned_quad quad;
-			
-			stbtt_bakedchar *bakedchar = font->character_data + ( *text - font->first_character );
-			
-			int round_x = STBTT_ifloor( x + bakedchar->xoff );
-			int round_y = STBTT_ifloor( y - bakedchar->yoff );
-			
-			quad.x0 = ( float )round_x;
-			quad.y0 = ( float )round_y;
-			quad.x1 = ( float )round_x + bakedchar->x1 - bakedchar->x0;
-			quad.y1 = ( float )round_y - bakedchar->y1 + bakedchar->y0;
-			
-			quad.s0 = bakedchar->x0 / ( float )font->texture_width;
-			quad.t0 = bakedchar->y0 / ( float )font->texture_width;
-			quad.s1 = bakedchar->x1 / ( float )font->texture_height;
-			quad.t1 = bakedchar->y1 / ( float )font->texture_height;
-			
-			x += bakedchar->xadvance;
-			
-			vert[ 0 ].x = quad.x1; vert[ 0 ].y = quad.y0;
-			uv  [ 0 ].x = quad.s1; uv  [ 0 ].y = quad.t0;
-
-			vert[ 1 ].x = quad.x0; vert[ 1 ].y = quad.y0;
-			uv  [ 1 ].x = quad.s0; uv  [ 1 ].y = quad.t0;
-
-			vert[ 2 ].x = quad.x1; vert[ 2 ].y = quad.y1;
-			uv  [ 2 ].x = quad.s1; uv  [ 2 ].y = quad.t1;
+	glVertexAttribPointer( vertex_attribute,
+						   2,
+						   GL_FLOAT,
+						   GL_FALSE,
+						   sizeof( vec4 ),
+						   offset == -1 ? ( void * )&vertex_data[ 0 ].x : BUFFER_OFFSET( offset ) );
 
-			vert[ 3 ].x = quad.x0; vert[ 3 ].y = quad.y1;
-			uv  [ 3 ].x = quad.s0; uv  [ 3 ].y = quad.t1;
+	glVertexAttribPointer( texcoord_attribute,
+						   2,
+						   GL_FLOAT,
+						   GL_FALSE,
+						   sizeof( vec4 ),
+						   offset == -1 ? ( void * )&vertex_data[ 0 ].z : BUFFER_OFFSET( offset + sizeof( vec2 ) ) );
 
-			glVertexAttribPointer( vertex_attribute,
-								   2,
-								   GL_FLOAT,
-								   GL_FALSE,
-								   0,
-								   ( float * )&vert[ 0 ] );
+	glDrawArrays( GL_TRIANGLES, 0, n_vertex );
 
-			glVertexAttribPointer( texcoord_attribute,
-								   2,
-								   GL_FLOAT,
-								   GL_FALSE,
-								   0,
-								   ( float * )&uv[ 0 ] );
+	if( offset != -1 ) glBindBuffer( GL_ARRAY_BUFFER, 0 );
 
-			glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
-		}
-	
-		++text;
-	}
+	if( !allocator.frame ) free( vertex_data );
 
 	glEnable( GL_CULL_FACE );
 	
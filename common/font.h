@@ -62,6 +62,9 @@ typedef struct
 	//! The internal font texture id maintained by OpenGLES.
 	unsigned int	tid;
 
+	//! The STREAMBUFFER to write the text quads into. If NULL the quads are sent from client memory.
+	STREAMBUFFER	*streambuffer;
+
 } FONT;
 
 
@@ -132,6 +132,7 @@ framework can provide.
 	#include "btBulletWorldImporter.h"
 	
 	#include "Recast.h"
+	#include "RecastAlloc.h"
 	#include "DetourDebugDraw.h"
 	#include "DetourNavMesh.h"
 	#include "DetourNavMeshBuilder.h"
@@ -140,12 +141,20 @@ framework can provide.
 
 	#include "vorbisfile.h"
 	#include <sys/time.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
 	#include <unistd.h>
 #elif _ANDROID_
 	#include <jni.h>
 	#include <android/log.h>
 	#include <sys/time.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
 	#include <unistd.h>
+	#include <sys/resource.h>
+	#include <sched.h>
 #else // Android
 	#include <Windows.h>
 	#include <time.h>
@@ -172,6 +181,7 @@ framework can provide.
 	#include "bullet/btBulletWorldImporter.h"
 
 	#include "recast/Recast.h"
+	#include "recast/RecastAlloc.h"
 	#include "detour/DetourDebugDraw.h"
 	#include "detour/DetourNavMesh.h"
 	#include "detour/DetourNavMeshBuilder.h"
@@ -198,15 +208,34 @@ framework can provide.
 #include <ctype.h>
 #include <stdarg.h>
 
+#if defined( __ARM_NEON__ )
+	//! NEON kernels are available.
+	#define GFX_NEON
+	#include <arm_neon.h>
+#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+	//! SSE2 kernels are available.
+	#define GFX_SSE2
+	#include <emmintrin.h>
+#endif
+
 #include "thread.h"
 #include "types.h"
+#include "atomic.h"
+#include "worker.h"
+#include "job.h"
+#include "queue.h"
 #include "matrix.h"
 #include "vector.h"
 #include "utils.h"
+#include "allocator.h"
 #include "memory.h"
+#include "pak.h"
 #include "shader.h"
 #include "program.h"
 #include "texture.h"
+#include "streambuffer.h"
+#include "texturestream.h"
+#include "atlas.h"
 #include "obj.h"
 #include "navigation.h"
 #include "font.h"
@@ -321,4 +350,15 @@ int GFX_project( float objx, float objy, float objz, mat4 *modelview_matrix, mat
 
 int GFX_unproject( float winx, float winy, float winz, mat4 *modelview_matrix, mat4 *projection_matrix, int *viewport_matrix, float *objx, float *objy, float *objz );
 
+
+#if defined( GFX_TRACK_ALLOCATION ) && defined( ALLOCATOR_TAG )
+
+	// The files defining ALLOCATOR_TAG before including gfx.h record their allocations under it.
+	#define malloc( size )		 ALLOCATOR_track_malloc( size, ALLOCATOR_TAG )
+	#define calloc( n, size )	 ALLOCATOR_track_calloc( n, size, ALLOCATOR_TAG )
+	#define realloc( ptr, size ) ALLOCATOR_track_realloc( ptr, size, ALLOCATOR_TAG )
+	#define free( ptr )			 ALLOCATOR_track_free( ptr )
+
+#endif
+
 #endif
@@ -0,0 +1,624 @@
+/*
+
+GFX Lightweight OpenGLES 2.0 Game and Graphics Engine
+
+Copyright (C) 2011 Romain Marucchi-Foino http://gfx.sio2interactive.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of
+this software. Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that
+you wrote the original software. If you use this software in a product, an acknowledgment
+in the product would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented
+as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#define ALLOCATOR_TAG ALLOCATOR_TAG_THREAD
+
+#include "gfx.h"
+
+/*!
+	\file job.cpp
+
+    \brief Work-stealing job scheduler with dependencies, continuations and parallel for.
+
+	\details The scheduler run one thread per core, the thread that call JOBSCHEDULER_init
+	being one of them: it execute jobs while waiting in JOB_wait. Each thread push the jobs it
+	creates at the bottom of its own deque and pop them back in LIFO order, while idle
+	threads steal the oldest jobs from the top of the deques of the others (Chase-Lev deque).
+	Splitting work recursively (JOB_parallel_for, or jobs creating children) thus keep the
+	threads busy without a shared queue.
+	
+	A job is finished once its callback returned and all its children are finished, then
+	its continuations are executed and its parent notified. The jobs are taken from a ring
+	owned by the creating thread and are not freed: a slot is only reused once its job is
+	finished, and JOB_create fail when the JOB_RING_SIZE jobs of the thread are all alive.
+	Jobs can only be created from the thread of JOBSCHEDULER_init and from within other
+	jobs, a job released with JOB_run from another thread being executed right away. Like
+	for the WORKER pool, OpenGLES calls cannot be done inside a job.
+	
+	The compute work of a frame (MD5_update_batch) run on the scheduler. The WORKER pools
+	remain for the tasks pushed from threads outside of the scheduler, or that block on file
+	I/O (texture streaming and pack decompression, and the ETC1 encoder they call), so they
+	never stall the threads of the scheduler.
+*/
+
+
+//! Global job scheduler.
+JOBSCHEDULER jobscheduler;
+
+
+/*!
+	Return the deque of the current thread. This function is used internally.
+	
+	\return Return the deque, or NULL if the scheduler is not started or if the current thread
+	is not one of its threads (a deque can only have one owner).
+*/
+JOBQUEUE *JOBSCHEDULER_get_jobqueue( void )
+{
+	size_t index;
+	
+	if( jobscheduler.state != PLAY ) return NULL;
+	
+	index = ( size_t )pthread_getspecific( jobscheduler.key );
+	
+	return index ? &jobscheduler.jobqueue[ index - 1 ] : NULL;
+}
+
+
+/*!
+	Push a job at the bottom of a deque, only the owner thread can push. This function is used internally.
+	
+	\param[in,out] jobqueue The deque of the current thread.
+	\param[in] job The job ready to be executed.
+	
+	\return Return 1 if the job have been pushed, 0 if the deque is full.
+*/
+unsigned char JOBQUEUE_push( JOBQUEUE *jobqueue, JOB *job )
+{
+	unsigned int bottom = ( unsigned int )jobqueue->bottom,
+				 top	= ( unsigned int )ATOMIC_load( &jobqueue->top );
+	
+	if( bottom - top >= JOB_DEQUE_SIZE ) return 0;
+	
+	jobqueue->job[ bottom & ( JOB_DEQUE_SIZE - 1 ) ] = job;
+	
+	ATOMIC_store( &jobqueue->bottom, ( int )( bottom + 1 ) );
+	
+	return 1;
+}
+
+
+/*!
+	Pop the last job pushed on a deque, only the owner thread can pop. This function is used internally.
+	
+	\param[in,out] jobqueue The deque of the current thread.
+	
+	\return Return a job, or NULL if the deque is empty.
+*/
+JOB *JOBQUEUE_pop( JOBQUEUE *jobqueue )
+{
+	unsigned int bottom = ( unsigned int )jobqueue->bottom - 1,
+				 top;
+	
+	JOB *job;
+	
+	ATOMIC_store( &jobqueue->bottom, ( int )bottom );
+	
+	top = ( unsigned int )ATOMIC_load( &jobqueue->top );
+	
+	if( ( int )( bottom - top ) < 0 )
+	{
+		ATOMIC_store( &jobqueue->bottom, ( int )( bottom + 1 ) );
+		return NULL;
+	}
+	
+	job = jobqueue->job[ bottom & ( JOB_DEQUE_SIZE - 1 ) ];
+	
+	if( bottom != top ) return job;
+	
+	// Last job, race with the thieves for it.
+	if( !ATOMIC_cas( &jobqueue->top, ( int )top, ( int )( top + 1 ) ) ) job = NULL;
+	
+	ATOMIC_store( &jobqueue->bottom, ( int )( bottom + 1 ) );
+	
+	return job;
+}
+
+
+/*!
+	Steal the oldest job of a deque. This function is used internally.
+	
+	\param[in,out] jobqueue The deque of another thread.
+	
+	\return Return a job, or NULL if the deque is empty or another thread took the job first.
+*/
+JOB *JOBQUEUE_steal( JOBQUEUE *jobqueue )
+{
+	unsigned int top	= ( unsigned int )ATOMIC_load( &jobqueue->top ),
+				 bottom = ( unsigned int )ATOMIC_load( &jobqueue->bottom );
+	
+	JOB *job;
+	
+	if( ( int )( bottom - top ) <= 0 ) return NULL;
+	
+	job = jobqueue->job[ top & ( JOB_DEQUE_SIZE - 1 ) ];
+	
+	if( !ATOMIC_cas( &jobqueue->top, ( int )top, ( int )( top + 1 ) ) ) return NULL;
+	
+	return job;
+}
+
+
+/*!
+	Get a job to execute: pop one from the deque of the current thread or steal one from
+	another thread, starting with a random one. This function is used internally.
+	
+	\param[in,out] jobqueue The deque of the current thread.
+	
+	\return Return a job, or NULL if no job is available.
+*/
+JOB *JOBSCHEDULER_get_job( JOBQUEUE *jobqueue )
+{
+	unsigned int i = 0,
+				 index;
+	
+	JOB *job = JOBQUEUE_pop( jobqueue );
+	
+	if( !job && jobscheduler.n_jobqueue > 1 )
+	{
+		// Xorshift
+		jobqueue->seed ^= jobqueue->seed << 13;
+		jobqueue->seed ^= jobqueue->seed >> 17;
+		jobqueue->seed ^= jobqueue->seed << 5;
+		
+		index = jobqueue->seed % jobscheduler.n_jobqueue;
+		
+		while( i != jobscheduler.n_jobqueue && !job )
+		{
+			JOBQUEUE *victim = &jobscheduler.jobqueue[ ( index + i ) % jobscheduler.n_jobqueue ];
+			
+			if( victim != jobqueue ) job = JOBQUEUE_steal( victim );
+			
+			++i;
+		}
+	}
+	
+	if( job ) ATOMIC_decrement( &jobscheduler.n_queued );
+	
+	return job;
+}
+
+
+void JOB_execute( JOB *job );
+
+
+/*!
+	Push a job ready to be executed on the deque of the current thread and wake up a sleeping
+	thread. This function is used internally.
+	
+	\param[in] job The job to schedule.
+*/
+void JOB_schedule( JOB *job )
+{
+	JOBQUEUE *jobqueue = JOBSCHEDULER_get_jobqueue();
+	
+	if( !jobqueue || !JOBQUEUE_push( jobqueue, job ) )
+	{
+		JOB_execute( job );
+		return;
+	}
+	
+	ATOMIC_increment( &jobscheduler.n_queued );
+	
+	if( ATOMIC_load( &jobscheduler.n_sleeping ) )
+	{
+		pthread_mutex_lock( &jobscheduler.mutex );
+		
+		pthread_cond_signal( &jobscheduler.cond );
+		
+		pthread_mutex_unlock( &jobscheduler.mutex );
+	}
+}
+
+
+/*!
+	Mark a job (or one of its children) as finished. Once the job and all its children are
+	finished, its continuations are scheduled and its parent notified. This function is used
+	internally.
+	
+	\param[in] job The job.
+*/
+void JOB_finish( JOB *job )
+{
+	while( job && !ATOMIC_decrement( &job->n_unfinished ) )
+	{
+		JOB *parent = job->parent;
+		
+		int i = 0,
+			n_continuation = ATOMIC_load( &job->n_continuation );
+		
+		while( i != n_continuation )
+		{
+			if( !ATOMIC_decrement( &job->continuation[ i ]->n_dependency ) ) JOB_schedule( job->continuation[ i ] );
+			++i;
+		}
+		
+		// The slot can be reused from now on.
+		ATOMIC_store( &job->live, 0 );
+		
+		job = parent;
+	}
+}
+
+
+/*!
+	Execute a job. A range job is split in two halves until it is smaller than its grain,
+	the second halves being pushed as children for the other threads to steal. This function
+	is used internally.
+	
+	\param[in] job The job.
+*/
+void JOB_execute( JOB *job )
+{
+	if( job->jobrangecallback )
+	{
+		while( job->end - job->start > job->grain )
+		{
+			unsigned int middle = job->start + ( ( job->end - job->start ) >> 1 );
+			
+			JOB *child = JOB_create_child( job, NULL, job->userdata );
+			
+			// No slot left, execute the rest of the range here.
+			if( !child ) break;
+			
+			child->jobrangecallback = job->jobrangecallback;
+			child->start			= middle;
+			child->end				= job->end;
+			child->grain			= job->grain;
+			
+			job->end = middle;
+			
+			JOB_run( child );
+		}
+		
+		job->jobrangecallback( job->userdata, job->start, job->end );
+	}
+	else if( job->jobcallback ) job->jobcallback( job->userdata );
+	
+	JOB_finish( job );
+}
+
+
+/*!
+	The internal thread function of each thread of the scheduler.
+	
+	\param[in] ptr The index of the deque of the thread.
+*/
+void *JOBSCHEDULER_run( void *ptr )
+{
+	JOBQUEUE *jobqueue;
+	
+	pthread_setspecific( jobscheduler.key, ( void * )( ( size_t )ptr + 1 ) );
+	
+	jobqueue = JOBSCHEDULER_get_jobqueue();
+	
+	while( 1 )
+	{
+		unsigned int spin = 0;
+		
+		JOB *job = NULL;
+		
+		while( spin != 64 && !( job = JOBSCHEDULER_get_job( jobqueue ) ) )
+		{
+			ATOMIC_pause();
+			++spin;
+		}
+		
+		if( job )
+		{
+			JOB_execute( job );
+			continue;
+		}
+		
+		pthread_mutex_lock( &jobscheduler.mutex );
+		
+		ATOMIC_increment( &jobscheduler.n_sleeping );
+		
+		while( !ATOMIC_load( &jobscheduler.n_queued ) && jobscheduler.state == PLAY )
+		{ pthread_cond_wait( &jobscheduler.cond, &jobscheduler.mutex ); }
+		
+		ATOMIC_decrement( &jobscheduler.n_sleeping );
+		
+		if( jobscheduler.state != PLAY && !ATOMIC_load( &jobscheduler.n_queued ) )
+		{
+			pthread_mutex_unlock( &jobscheduler.mutex );
+			break;
+		}
+		
+		pthread_mutex_unlock( &jobscheduler.mutex );
+	}
+	
+	return NULL;
+}
+
+
+/*!
+	Start the job scheduler. The calling thread becomes one of the threads of the scheduler:
+	it execute jobs in JOB_wait.
+	
+	\param[in] n_thread The number of threads to create, pass 0 to create one thread per core
+	(minus the calling thread).
+*/
+void JOBSCHEDULER_init( unsigned int n_thread )
+{
+	unsigned int i = 0;
+	
+	if( jobscheduler.state == PLAY ) return;
+	
+	memset( &jobscheduler, 0, sizeof( JOBSCHEDULER ) );
+	
+	jobscheduler.state		= PLAY;
+	jobscheduler.n_thread	= n_thread ? n_thread : WORKER_get_core_count() - 1;
+	jobscheduler.n_jobqueue = jobscheduler.n_thread + 1;
+	
+	jobscheduler.jobqueue = ( JOBQUEUE * ) calloc( jobscheduler.n_jobqueue, sizeof( JOBQUEUE ) );
+	
+	while( i != jobscheduler.n_jobqueue )
+	{
+		jobscheduler.jobqueue[ i ].seed = 2463534242u + i * 2654435761u;
+		++i;
+	}
+	
+	pthread_mutex_init( &jobscheduler.mutex, NULL );
+	
+	pthread_cond_init( &jobscheduler.cond, NULL );
+	
+	pthread_key_create( &jobscheduler.key, NULL );
+	
+	pthread_setspecific( jobscheduler.key, ( void * )1 );
+	
+	if( jobscheduler.n_thread ) jobscheduler.thread = ( pthread_t * ) malloc( jobscheduler.n_thread * sizeof( pthread_t ) );
+	
+	i = 0;
+	while( i != jobscheduler.n_thread )
+	{
+		pthread_create( &jobscheduler.thread[ i ],
+						NULL,
+						JOBSCHEDULER_run,
+						( void * )( size_t )( i + 1 ) );
+		++i;
+	}
+}
+
+
+/*!
+	Stop the job scheduler, the jobs already scheduled are executed before the threads exit.
+	Have to be called from the thread of JOBSCHEDULER_init.
+*/
+void JOBSCHEDULER_free( void )
+{
+	unsigned int i = 0;
+	
+	if( jobscheduler.state != PLAY ) return;
+	
+	pthread_mutex_lock( &jobscheduler.mutex );
+	
+	jobscheduler.state = STOP;
+	
+	pthread_cond_broadcast( &jobscheduler.cond );
+	
+	pthread_mutex_unlock( &jobscheduler.mutex );
+	
+	while( i != jobscheduler.n_thread )
+	{
+		pthread_join( jobscheduler.thread[ i ], NULL );
+		++i;
+	}
+	
+	// Without any thread, the remaining jobs of the first deque are executed here.
+	{
+		JOB *job;
+		
+		while( ( job = JOBSCHEDULER_get_job( &jobscheduler.jobqueue[ 0 ] ) ) ) JOB_execute( job );
+	}
+	
+	pthread_key_delete( jobscheduler.key );
+	
+	pthread_cond_destroy( &jobscheduler.cond );
+	
+	pthread_mutex_destroy( &jobscheduler.mutex );
+	
+	if( jobscheduler.thread ) free( jobscheduler.thread );
+	
+	free( jobscheduler.jobqueue );
+	
+	memset( &jobscheduler, 0, sizeof( JOBSCHEDULER ) );
+}
+
+
+/*!
+	Create a new job, it will only be executed once JOB_run is called (and its dependencies
+	are finished).
+	
+	\param[in] jobcallback The function to execute (can be NULL to only group children or dependencies).
+	\param[in] userdata The pointer to send to the callback.
+	
+	\return Return a new JOB structure pointer, or NULL if the JOB_RING_SIZE jobs of the
+	thread are all alive or if the current thread is not a thread of the scheduler.
+*/
+JOB *JOB_create( JOBCALLBACK *jobcallback, void *userdata )
+{
+	unsigned int i = 0,
+				 generation;
+	
+	JOBQUEUE *jobqueue = JOBSCHEDULER_get_jobqueue();
+	
+	JOB *job = NULL;
+	
+	if( !jobqueue ) return NULL;
+	
+	// Skip the slots of the jobs still queued, running or waiting for their children.
+	while( i != JOB_RING_SIZE )
+	{
+		job = &jobqueue->ring[ jobqueue->ring_index & ( JOB_RING_SIZE - 1 ) ];
+		
+		++jobqueue->ring_index;
+		
+		if( !ATOMIC_load( &job->live ) ) break;
+		
+		++i;
+	}
+	
+	if( i == JOB_RING_SIZE ) return NULL;
+	
+	generation = ( unsigned int )job->generation + 1;
+	
+	memset( job, 0, sizeof( JOB ) );
+	
+	job->jobcallback  = jobcallback;
+	job->userdata	  = userdata;
+	job->n_unfinished = 1;
+	job->n_dependency = 1;
+	job->generation	  = ( int )generation;
+	
+	ATOMIC_store( &job->live, 1 );
+	
+	return job;
+}
+
+
+/*!
+	Create a new job as a child of another one: the parent is not finished (and JOB_wait on
+	it does not return) until the child is finished. The parent must not be finished yet,
+	create the children from its callback or before running it.
+	
+	\param[in,out] parent A valid JOB structure pointer.
+	\param[in] jobcallback The function to execute.
+	\param[in] userdata The pointer to send to the callback.
+	
+	\return Return a new JOB structure pointer, or NULL if the job cannot be created. \sa JOB_create
+*/
+JOB *JOB_create_child( JOB *parent, JOBCALLBACK *jobcallback, void *userdata )
+{
+	JOB *job = JOB_create( jobcallback, userdata );
+	
+	if( !job ) return NULL;
+	
+	ATOMIC_increment( &parent->n_unfinished );
+	
+	job->parent = parent;
+	
+	return job;
+}
+
+
+/*!
+	Make a job wait for another one: the continuation is executed once the job and all its
+	children are finished. Have to be called before JOB_run is called on the job.
+	
+	\param[in,out] job A valid JOB structure pointer that is not running yet.
+	\param[in,out] continuation The job to execute after, that is not running yet.
+	
+	\return Return 1 if the continuation have been added, 0 if the job have already JOB_MAX_CONTINUATION continuations.
+*/
+unsigned char JOB_add_continuation( JOB *job, JOB *continuation )
+{
+	int index = ATOMIC_increment( &job->n_continuation ) - 1;
+	
+	if( index >= JOB_MAX_CONTINUATION )
+	{
+		ATOMIC_decrement( &job->n_continuation );
+		return 0;
+	}
+	
+	ATOMIC_increment( &continuation->n_dependency );
+	
+	job->continuation[ index ] = continuation;
+	
+	return 1;
+}
+
+
+/*!
+	Release a job to the scheduler, it is executed as soon as a thread is available and all
+	the jobs it depends on are finished. From a thread outside of the scheduler the job is
+	executed right away.
+	
+	\param[in] job A valid JOB structure pointer.
+*/
+void JOB_run( JOB *job )
+{
+	if( !ATOMIC_decrement( &job->n_dependency ) ) JOB_schedule( job );
+}
+
+
+/*!
+	Wait until a job and its children are finished. Instead of sleeping, the calling thread
+	execute the jobs available in the meantime (a thread outside of the scheduler only yield).
+	
+	\param[in] job A valid JOB structure pointer that have been released with JOB_run. Once
+	finished its slot can be reused, so JOB_wait have to be called before JOB_RING_SIZE other
+	jobs are created on the same thread.
+*/
+void JOB_wait( JOB *job )
+{
+	int generation = ATOMIC_load( &job->generation );
+	
+	JOBQUEUE *jobqueue = JOBSCHEDULER_get_jobqueue();
+	
+	// Stop as well if the slot have been reused by a new job once this one finished.
+	while( ATOMIC_load( &job->n_unfinished ) && ATOMIC_load( &job->generation ) == generation )
+	{
+		JOB *next = jobqueue ? JOBSCHEDULER_get_job( jobqueue ) : NULL;
+		
+		if( next ) JOB_execute( next );
+		
+		else if( jobqueue ) ATOMIC_pause();
+		
+		else sched_yield();
+	}
+}
+
+
+/*!
+	Create a job calling a function over a range of indices in parallel. Once released with
+	JOB_run, the range is split recursively between the threads until its parts are smaller
+	than the grain.
+	
+	\param[in] jobrangecallback The function to call with the userdata and a [ start, end ) part of the range.
+	\param[in] userdata The pointer to send to the callback.
+	\param[in] count The number of indices, the range is [ 0, count ).
+	\param[in] grain The number of indices below which a part is not split anymore, pass 0 to
+	split the range in about 4 parts per thread. The grain is raised if needed so the range is
+	not split in more than half JOB_RING_SIZE parts.
+	
+	\return Return the job of the whole range, not released yet: add its continuations (if
+	any), then call JOB_run and JOB_wait. Return NULL if the job cannot be created. \sa JOB_create
+*/
+JOB *JOB_parallel_for( JOBRANGECALLBACK *jobrangecallback, void *userdata, unsigned int count, unsigned int grain )
+{
+	unsigned int min_grain = ( count + ( JOB_RING_SIZE >> 1 ) - 1 ) / ( JOB_RING_SIZE >> 1 );
+	
+	JOB *job = JOB_create( NULL, userdata );
+	
+	if( !job ) return NULL;
+	
+	job->jobrangecallback = jobrangecallback;
+	job->end			  = count;
+	job->grain			  = grain ? grain : count / ( jobscheduler.n_jobqueue << 2 );
+	
+	if( job->grain < min_grain ) job->grain = min_grain;
+	
+	if( !job->grain ) job->grain = 1;
+	
+	return job;
+}
@@ -0,0 +1,175 @@
+/*
+
+GFX Lightweight OpenGLES 2.0 Game and Graphics Engine
+
+Copyright (C) 2011 Romain Marucchi-Foino http://gfx.sio2interactive.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of
+this software. Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that
+you wrote the original software. If you use this software in a product, an acknowledgment
+in the product would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented
+as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef JOB_H
+#define JOB_H
+
+/*!
+	\file job.h
+
+    \brief Contains structure definitions and functions to use with the JOB scheduler.
+*/
+
+
+//! The number of jobs each deque can hold (a power of two), a job pushed to a full deque is executed right away.
+#define JOB_DEQUE_SIZE			2048
+
+//! The number of jobs of each thread that can be alive at the same time (a power of two).
+#define JOB_RING_SIZE			2048
+
+//! The maximum number of continuations of a job.
+#define JOB_MAX_CONTINUATION	8
+
+
+//! The job callback prototype.
+typedef void( JOBCALLBACK( void * ) );
+
+//! The range callback prototype of JOB_parallel_for, called with the userdata and a [ start, end ) range.
+typedef void( JOBRANGECALLBACK( void *, unsigned int, unsigned int ) );
+
+
+//! Structure definition of a job. \sa JOB_create
+typedef struct JOB
+{
+	//! The job callback (NULL for a range job or an empty job used to group others).
+	JOBCALLBACK			*jobcallback;
+	
+	//! The range callback of a job created by JOB_parallel_for.
+	JOBRANGECALLBACK	*jobrangecallback;
+	
+	//! Userdata pointer sent to the callback.
+	void				*userdata;
+	
+	//! The first index of the range.
+	unsigned int		start;
+	
+	//! The index after the last index of the range.
+	unsigned int		end;
+	
+	//! The number of indices below which a range is not split anymore.
+	unsigned int		grain;
+	
+	//! The job that waits for this one to finish (if any). \sa JOB_create_child
+	struct JOB			*parent;
+	
+	//! The job itself plus its unfinished children, the job is finished when it reach 0.
+	volatile int		n_unfinished;
+	
+	//! The number of jobs to finish before this one can be executed, plus one until JOB_run is called.
+	volatile int		n_dependency;
+	
+	//! The number of continuations.
+	volatile int		n_continuation;
+	
+	//! The jobs that depend on this one. \sa JOB_add_continuation
+	struct JOB			*continuation[ JOB_MAX_CONTINUATION ];
+	
+	//! Determine if the job is alive: from JOB_create until it is finished and its continuations and parent notified. The slot cannot be reused before.
+	volatile int		live;
+	
+	//! The number of times the slot have been used, to detect that a job have been reused while waiting for it.
+	volatile int		generation;
+	
+} JOB;
+
+
+//! Structure definition of the work-stealing deque and the job ring of a thread.
+typedef struct
+{
+	//! The index of the next job to steal.
+	volatile int	top;
+	
+	//! The index after the last job pushed, only the owner thread push and pop at the bottom.
+	volatile int	bottom;
+	
+	//! The deque of jobs ready to be executed.
+	JOB				*job[ JOB_DEQUE_SIZE ];
+	
+	//! The index of the next slot of the ring to try.
+	unsigned int	ring_index;
+	
+	//! The jobs created by the thread.
+	JOB				ring[ JOB_RING_SIZE ];
+	
+	//! The state of the random generator used to choose the thread to steal from.
+	unsigned int	seed;
+	
+} JOBQUEUE;
+
+
+//! Structure definition of the job scheduler, one thread per core each with its own deque. The thread that call JOBSCHEDULER_init use the first deque.
+typedef struct
+{
+	//! The state of the scheduler, either PLAY or STOP.
+	unsigned char	state;
+	
+	//! The number of threads of the pool (the thread of JOBSCHEDULER_init not included).
+	unsigned int	n_thread;
+	
+	//! Array of threads.
+	pthread_t		*thread;
+	
+	//! The number of deques (n_thread + 1).
+	unsigned int	n_jobqueue;
+	
+	//! Array of deques.
+	JOBQUEUE		*jobqueue;
+	
+	//! The thread specific key holding the index of the deque of the current thread plus one.
+	pthread_key_t	key;
+	
+	//! The number of jobs waiting in the deques.
+	volatile int	n_queued;
+	
+	//! The number of threads sleeping.
+	volatile int	n_sleeping;
+	
+	//! The mutex used to sleep.
+	pthread_mutex_t	mutex;
+	
+	//! Condition signaled when a job is pushed while some threads are sleeping.
+	pthread_cond_t	cond;
+	
+} JOBSCHEDULER;
+
+//! Global job scheduler. Declared as extern in job.h and implemented in job.cpp
+extern JOBSCHEDULER jobscheduler;
+
+
+void JOBSCHEDULER_init( unsigned int n_thread );
+
+void JOBSCHEDULER_free( void );
+
+JOB *JOB_create( JOBCALLBACK *jobcallback, void *userdata );
+
+JOB *JOB_create_child( JOB *parent, JOBCALLBACK *jobcallback, void *userdata );
+
+unsigned char JOB_add_continuation( JOB *job, JOB *continuation );
+
+void JOB_run( JOB *job );
+
+void JOB_wait( JOB *job );
+
+JOB *JOB_parallel_for( JOBRANGECALLBACK *jobrangecallback, void *userdata, unsigned int count, unsigned int grain );
+
+#endif
@@ -51,7 +51,7 @@ LIGHT *LIGHT_create_directional( char *name, vec4 *color, float rotx, float roty
 {
 	vec3 up_axis = { 0.0f, 0.0f, 1.0f };
 	
-	LIGHT *light = ( LIGHT * ) calloc( 1, sizeof( LIGHT ) );
+	LIGHT *light = ( LIGHT * ) POOL_alloc( &allocator.pool[ POOL_LIGHT ] );
 	
 	strcpy( light->name, name );
 
@@ -76,7 +76,7 @@ LIGHT *LIGHT_create_directional( char *name, vec4 *color, float rotx, float roty
 */
 LIGHT *LIGHT_create_point( char *name, vec4 *color, vec3 *position )
 {
-	LIGHT *light = ( LIGHT * ) calloc( 1, sizeof( LIGHT ) );
+	LIGHT *light = ( LIGHT * ) POOL_alloc( &allocator.pool[ POOL_LIGHT ] );
 	
 	strcpy( light->name, name );
 
@@ -161,7 +161,7 @@ LIGHT *LIGHT_create_spot( char *name, vec4 *color, vec3 *position, float rotx, f
 	
 	static vec3 up_axis = { 0.0f, 0.0f, 1.0f };
 
-	LIGHT *light = ( LIGHT * ) calloc( 1, sizeof( LIGHT ) );
+	LIGHT *light = ( LIGHT * ) POOL_alloc( &allocator.pool[ POOL_LIGHT ] );
 
 	strcpy( light->name, name );
 
@@ -260,6 +260,6 @@ void LIGHT_get_position_in_eye_space( LIGHT *light, mat4 *m, vec4 *position )
 */
 LIGHT *LIGHT_free( LIGHT *light )
 {
-	free( light );
+	POOL_release( &allocator.pool[ POOL_LIGHT ], light );
 	return NULL;
 }
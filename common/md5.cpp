@@ -21,6 +21,8 @@ as being the original software.
 
 */
 
+#define ALLOCATOR_TAG ALLOCATOR_TAG_MESH
+
 #include "gfx.h"
 
 /*!
@@ -34,6 +36,58 @@ as being the original software.
 */
 
 
+/*!
+	Compute the joint space bounding box of the weights attached to each joint. Since a skinned
+	vertex is a weighted average of its weights transformed by their joints, the union of these
+	boxes transformed by a pose always contain the skinned mesh. This function is used internally
+	by MD5_load_mesh.
+	
+	\param[in,out] md5 A valid MD5 structure pointer.
+*/
+void MD5_build_bound_joint( MD5 *md5 )
+{
+	unsigned int i = 0,
+				 j;
+	
+	md5->md5bound = ( MD5BOUND * ) calloc( md5->n_joint, sizeof( MD5BOUND ) );
+	
+	while( i != md5->n_mesh )
+	{
+		MD5MESH *md5mesh = &md5->md5mesh[ i ];
+		
+		j = 0;
+		while( j != md5mesh->n_weight )
+		{
+			MD5WEIGHT *md5weight = &md5mesh->md5weight[ j ];
+			
+			MD5BOUND *md5bound = &md5->md5bound[ md5weight->joint ];
+			
+			if( !md5bound->used )
+			{
+				memcpy( &md5bound->min, &md5weight->location, sizeof( vec3 ) );
+				memcpy( &md5bound->max, &md5weight->location, sizeof( vec3 ) );
+				
+				md5bound->used = 1;
+			}
+			else
+			{
+				if( md5weight->location.x < md5bound->min.x ) md5bound->min.x = md5weight->location.x;
+				if( md5weight->location.y < md5bound->min.y ) md5bound->min.y = md5weight->location.y;
+				if( md5weight->location.z < md5bound->min.z ) md5bound->min.z = md5weight->location.z;
+
+				if( md5weight->location.x > md5bound->max.x ) md5bound->max.x = md5weight->location.x;
+				if( md5weight->location.y > md5bound->max.y ) md5bound->max.y = md5weight->location.y;
+				if( md5weight->location.z > md5bound->max.z ) md5bound->max.z = md5weight->location.z;
+			}
+			
+			++j;
+		}
+		
+		++i;
+	}
+}
+
+
 /*!
 	Load a .md5mesh file from disk and create an MD5 structure pointer.
 	
@@ -45,7 +99,7 @@ as being the original software.
 */
 MD5 *MD5_load_mesh( char *filename, unsigned char relative_path )
 {
-	MEMORY *m = mopen( filename, relative_path );
+	MEMORY *m = mopen_stream( filename, relative_path );
 	
 	if( !m ) return NULL;
 	
@@ -58,8 +112,10 @@ MD5 *MD5_load_mesh( char *filename, unsigned char relative_path )
 	md5->scale.y  =
 	md5->scale.z  = 1.0f;
 	md5->visible  = 1;
+	
+	md5->md5lod.rate = 1;
 		
-	char *line = strtok( ( char * )m->buffer, "\n" );
+	char *line = mgets( m );
 	
 	int int_val = 0;
 	
@@ -95,7 +151,7 @@ MD5 *MD5_load_mesh( char *filename, unsigned char relative_path )
 		{
 			unsigned int i = 0;
 			
-			line = strtok( NULL, "\n" );
+			line = mgets( m );
 			
 			while( line[ 0 ] != '}' )
 			{
@@ -115,7 +171,7 @@ MD5 *MD5_load_mesh( char *filename, unsigned char relative_path )
 					++i;
 				}
 				
-				line = strtok( NULL, "\n" );
+				line = mgets( m );
 			}
 		}
 		
@@ -128,7 +184,7 @@ MD5 *MD5_load_mesh( char *filename, unsigned char relative_path )
 			MD5WEIGHT md5weight;
 			
 			
-			line = strtok( NULL, "\n" );
+			line = mgets( m );
 			
 			while( line[ 0 ] != '}' )
 			{
@@ -195,7 +251,7 @@ MD5 *MD5_load_mesh( char *filename, unsigned char relative_path )
 				}
 
 next_mesh_line:
-				line = strtok( NULL, "\n" );
+				line = mgets( m );
 			}
 			
 			unsigned int s = md5->md5mesh[ mesh_index ].n_indice * sizeof( unsigned short );
@@ -212,11 +268,13 @@ next_mesh_line:
 
 next_line:
 
-		line = strtok( NULL, "\n" );
+		line = mgets( m );
 	}
 
 	mclose( m );
 	
+	MD5_build_bound_joint( md5 );
+	
 	return md5;
 	
 
@@ -230,23 +288,151 @@ cleanup:
 }
 
 
+/*!
+	Load a cooked MD5 animation from a MEMORY stream. The MEMORY stream is kept by the action
+	and the tracks directly point inside it, so no per-frame data have to be decoded or copied.
+	This function is used internally by MD5_load_action.
+	
+	\param[in,out] md5 A valid MD5 structure pointer.
+	\param[in,out] md5action The MD5ACTION to load the tracks into.
+	\param[in,out] memory A valid MEMORY structure pointer that contain a cooked animation.
+	
+	\return Return 1 if the action have been loaded, else 0.
+*/
+unsigned char MD5_load_action_cooked( MD5 *md5, MD5ACTION *md5action, MEMORY *memory )
+{
+	unsigned int i = 0,
+				 offset = sizeof( MD5COOKEDHEADER );
+
+	MD5COOKEDHEADER *md5cookedheader = ( MD5COOKEDHEADER * )memory->buffer;
+	
+	if( memory->size < sizeof( MD5COOKEDHEADER ) ||
+		md5cookedheader->version != 1 ||
+		md5cookedheader->n_joint != md5->n_joint ||
+		!md5cookedheader->n_frame ||
+		md5cookedheader->n_frame > 65535 ) return 0;
+	
+	md5action->n_frame = md5cookedheader->n_frame;
+	md5action->fps	   = md5cookedheader->fps;
+	
+	md5action->md5track = ( MD5TRACK * ) malloc( ( md5->n_joint << 1 ) * sizeof( MD5TRACK ) );
+	
+	while( i != ( md5->n_joint << 1 ) )
+	{
+		MD5TRACK *md5track = &md5action->md5track[ i ];
+
+		MD5COOKEDTRACK *md5cookedtrack;
+		
+		unsigned int span;
+		
+		// Every span is checked against the stream before being read, offset never exceed the size.
+		if( memory->size - offset < sizeof( MD5COOKEDTRACK ) ) goto cleanup;
+		
+		md5cookedtrack = ( MD5COOKEDTRACK * )&memory->buffer[ offset ];
+		
+		offset += sizeof( MD5COOKEDTRACK );
+		
+		if( !md5cookedtrack->n_key ||
+			md5cookedtrack->n_key > md5cookedheader->n_frame ||
+			md5cookedtrack->type != ( i & 1 ) ) goto cleanup;
+		
+		span = md5cookedtrack->n_key > 1 ? md5cookedtrack->n_key * 4 * sizeof( unsigned short ) :
+										   3 * sizeof( unsigned short );
+		
+		if( memory->size - offset < span ) goto cleanup;
+		
+		// The sampling bisect the keys, so they have to be strictly increasing frames.
+		if( md5cookedtrack->n_key > 1 )
+		{
+			unsigned short *frame = ( unsigned short * )&memory->buffer[ offset ];
+			
+			unsigned int j = 1;
+			
+			while( j != md5cookedtrack->n_key )
+			{
+				if( frame[ j ] <= frame[ j - 1 ] || frame[ j ] >= md5cookedheader->n_frame ) goto cleanup;
+				++j;
+			}
+		}
+		
+		md5track->n_key = md5cookedtrack->n_key;
+		
+		memcpy( &md5track->min, &md5cookedtrack->min, sizeof( vec3 ) );
+		
+		memcpy( &md5track->scale, &md5cookedtrack->scale, sizeof( vec3 ) );
+
+		md5track->frame = NULL;
+		
+		if( md5track->n_key > 1 )
+		{
+			md5track->frame = ( unsigned short * )&memory->buffer[ offset ];
+			
+			offset += md5track->n_key * sizeof( unsigned short );
+		}
+		
+		md5track->value = ( unsigned short * )&memory->buffer[ offset ];
+		
+		offset += md5track->n_key * 3 * sizeof( unsigned short );
+		
+		offset = ( offset + 3 ) & ~3;
+		
+		if( offset > memory->size ) offset = memory->size;
+		
+		++i;
+	}
+
+	md5action->memory = memory;
+	
+	return 1;
+
+
+cleanup:
+
+	free( md5action->md5track );
+	md5action->md5track = NULL;
+	
+	return 0;
+}
+
+
 /*!
 	Load an .md5action file from disk. If the operation is successfull the function
 	will return the index used by this action MD5 structure pointer action database,
-	else will return -1.
+	else will return -1. The file can either be a text .md5anim or an animation
+	previously cooked using MD5_cook_action, in which case the action is sampled
+	directly from its compressed tracks.
 	
 	\param[in] md5 A valid MD5 structure pointer.
 	\param[in] name The internal name to use for the new action.
 	\param[in] filename The .md5action file to load from disk.
 	\param[in] relative_path Determine if the filename is relative path or an absolute path. 
 	
-	\return Return the new action index (>=0) or -1 if the loading operation fails.
+	\return Return the new action index (>=0) or -1 if the loading operation fails. Actions cannot
+	be loaded on an instance, load them on the MD5 resource before calling MD5_create_instance.
 */
 int MD5_load_action( MD5 *md5, char *name, char *filename, unsigned char relative_path )
 {
-	MEMORY *m = mopen( filename, relative_path );
+	if( md5->resource ) return -1;
+
+	MEMORY *m = mopen_stream( filename, relative_path );
+	
+	char magic[ 4 ] = {""};
+	
+	unsigned char cooked = 0;
 	
-	if( !m ) return -1;	
+	if( !m ) return -1;
+	
+	// A cooked action is sampled straight from its tracks, so it is loaded whole.
+	if( mpeek( m, magic, 4 ) == 4 && !memcmp( magic, "MD5C", 4 ) )
+	{
+		mclose( m );
+		
+		m = mopen( filename, relative_path );
+		
+		if( !m ) return -1;
+		
+		cooked = 1;
+	}
 
 	MD5ACTION *md5action;
 
@@ -265,7 +451,28 @@ int MD5_load_action( MD5 *md5, char *name, char *filename, unsigned char relativ
 	md5action->next_frame = 1;
 
 	
-	char *line = strtok( ( char * )m->buffer, "\n" );
+	if( cooked && m->size > sizeof( MD5COOKEDHEADER ) )
+	{
+		if( !MD5_load_action_cooked( md5, md5action, m ) )
+		{
+			--md5->n_action;
+			
+			md5->md5action = ( MD5ACTION * ) realloc( md5->md5action,
+													  md5->n_action * sizeof( MD5ACTION ) );
+			mclose( m );
+			
+			return -1;
+		}
+		
+		md5action->pose = ( MD5JOINT * ) malloc( md5->n_joint * sizeof( MD5JOINT ) );
+		
+		memcpy( md5action->pose, md5->bind_pose, md5->n_joint * sizeof( MD5JOINT ) );
+		
+		return ( md5->n_action - 1 );
+	}
+
+	
+	char *line = mgets( m );
 	
 	int int_val = 0;
 	
@@ -314,7 +521,7 @@ int MD5_load_action( MD5 *md5, char *name, char *filename, unsigned char relativ
 		{
 			MD5JOINT *md5joint = md5action->frame[ int_val ];
 			
-			line = strtok( NULL, "\n" );
+			line = mgets( m );
 			
 			unsigned int i = 0;
 			
@@ -334,7 +541,7 @@ int MD5_load_action( MD5 *md5, char *name, char *filename, unsigned char relativ
 					vec4_build_w( &md5joint[ i ].rotation );				
 				}
 				
-				line = strtok( NULL, "\n" );
+				line = mgets( m );
 				
 				++i;
 			}
@@ -373,7 +580,7 @@ int MD5_load_action( MD5 *md5, char *name, char *filename, unsigned char relativ
 			
 next_line:
 
-		line = strtok( NULL, "\n" );	
+		line = mgets( m );	
 	}
 
 	mclose( m );
@@ -395,1062 +602,2794 @@ cleanup:
 
 
 /*!
-	Free a valid MD5 structure pointer previously initialized with MD5_load_mesh.
-	
-	\param[in,out] md5 A valid MD5 structure pointer.
+	Quantize a normalized quaternion using the smallest three 48 bits encoding. The
+	largest component is dropped (and rebuilt at decoding time) while the three others
+	are stored on 15 bits each, the index of the dropped component use the remaining bits.
 	
-	\return Return a NULL MD5 structure pointer.
+	\param[out] value The 3 unsigned short to store the encoded quaternion.
+	\param[in] rotation The normalized quaternion to encode.
 */
-MD5 *MD5_free( MD5 *md5 )
+void MD5_encode_rotation( unsigned short *value, vec4 *rotation )
 {
-	unsigned int i = 0,
-			     j;
-
-	MD5_free_mesh_data( md5 );
-
-	while( i != md5->n_mesh )
+	float q[ 4 ] = { rotation->x, rotation->y, rotation->z, rotation->w };
+	
+	unsigned int i = 1,
+				 j = 0,
+				 k = 0,
+				 c[ 3 ];
+	
+	while( i != 4 )
 	{
-		MD5MESH *md5mesh = &md5->md5mesh[ i ];
-		
-		if( md5mesh->md5vertex ) free( md5mesh->md5vertex );
-		
-		if( md5mesh->vertex_data ) free( md5mesh->vertex_data );
-		
-		if( md5mesh->md5triangle ) free( md5mesh->md5triangle );
-		
-		if( md5mesh->md5weight ) free( md5mesh->md5weight );
-
-		if( md5mesh->vbo ) glDeleteBuffers( 1, &md5mesh->vbo );
-
-		if( md5mesh->vbo_indice ) glDeleteBuffers( 1, &md5mesh->vbo_indice );
-		
-		if( md5mesh->vao ) glDeleteVertexArraysOES( 1, &md5mesh->vao );
-		
+		if( fabsf( q[ i ] ) > fabsf( q[ k ] ) ) k = i;
 		++i;
 	}
-
-	if( md5->md5mesh ) free( md5->md5mesh );
 	
-
 	i = 0;
-	while( i != md5->n_action )
+	while( i != 4 )
 	{
-		MD5ACTION *md5action = &md5->md5action[ i ];
-		
-		j = 0;
-		while( j != md5action->n_frame )
+		if( i != k )
 		{
-			free( md5action->frame[ j ] );
+			float v = q[ k ] < 0.0f ? -q[ i ] : q[ i ];
+			
+			v = CLAMP( ( v + 0.70710678f ) / 1.41421356f, 0.0f, 1.0f );
+			
+			c[ j ] = ( unsigned int )( v * 32767.0f + 0.5f );
+			
 			++j;
 		}
 		
-		if( md5action->frame ) free( md5action->frame );
-		
-		if( md5action->pose ) free( md5action->pose );
-
 		++i;
 	}
 	
-	if( md5->md5action ) free( md5->md5action );
-
-	
-	if( md5->bind_pose )
-	{
-		free( md5->bind_pose );
-		md5->bind_pose = NULL;
-	}
-	
-
-	free( md5 );
-	return NULL;
+	value[ 0 ] = ( unsigned short )( ( ( k >> 1 ) << 15 ) | c[ 0 ] );
+	value[ 1 ] = ( unsigned short )( ( ( k &  1 ) << 15 ) | c[ 1 ] );
+	value[ 2 ] = ( unsigned short )c[ 2 ];
 }
 
 
 /*!
-	Free all the indices and triangle data used by the different MD5MESH contains
-	in the MD5 structure pointer pass in parameter. This function should only be
-	called after you call MD5_build as theses data are not necessary anymore for
-	drawing and can help you to save memory.
+	Decode a quaternion encoded by MD5_encode_rotation.
 	
-	\param[in,out] md5 A valid MD5 structure pointer.
+	\param[out] rotation The decoded quaternion.
+	\param[in] value The 3 unsigned short of the encoded quaternion.
 */
-void MD5_free_mesh_data( MD5 *md5 )
+void MD5_decode_rotation( vec4 *rotation, unsigned short *value )
 {
-	unsigned int i = 0;	
-
-	while( i != md5->n_mesh )
-	{
-		MD5MESH *md5mesh = &md5->md5mesh[ i ];
-		
-		if( md5mesh->indice )
-		{
-			free( md5mesh->indice );
-			md5mesh->indice = NULL;
-		}
+	float *q = ( float * )rotation,
+		  l = 1.0f;
 	
-		if( md5mesh->md5triangle )
+	unsigned int i = 0,
+				 j = 0,
+				 k = ( ( value[ 0 ] >> 15 ) << 1 ) | ( value[ 1 ] >> 15 );
+	
+	while( i != 4 )
+	{
+		if( i != k )
 		{
-			free( md5mesh->md5triangle );
-			md5mesh->md5triangle = NULL;
+			q[ i ] = ( ( value[ j ] & 0x7FFF ) / 32767.0f ) * 1.41421356f - 0.70710678f;
+			
+			l -= q[ i ] * q[ i ];
+			
+			++j;
 		}
 		
 		++i;
-	}	
+	}
+	
+	q[ k ] = l > 0.0f ? sqrtf( l ) : 0.0f;
 }
 
 
 /*!
-	Return an MD5ACTION pointer for the action specified by name.
+	Decode the value of a track at a specific key.
 	
-	\param[in] md5 A valid MD5 structure pointer that have some MD5ACTION loaded. \sa MD5_load_action
-	\param[in] name The name of the action that you wish to obtain the MD5ACTION pointer.
-	\param[in] exact_name Determine if the name is the exact string that should be used to find the
-	action in the MD5 structure action database, or if only part of the name string can find the action.
-	
-	\return Return a valid MD5ACTION pointer, else return NULL if the action name wasn't found.
+	\param[in] md5track A valid MD5TRACK structure pointer.
+	\param[in] type Either 0 for a location track or 1 for a rotation track.
+	\param[in] key The index of the key to decode.
+	\param[out] dst A vec3 (location) or a vec4 (rotation) to store the result.
 */
-MD5ACTION *MD5_get_action( MD5 *md5, char *name, unsigned char exact_name )
+void MD5_decode_track_key( MD5TRACK *md5track, unsigned char type, unsigned int key, void *dst )
 {
-	unsigned int i = 0;
+	unsigned short *value = &md5track->value[ key * 3 ];
 	
-	while( i != md5->n_action )
+	if( type ) MD5_decode_rotation( ( vec4 * )dst, value );
+	else
 	{
-		if( exact_name )
-		{ if( !strcmp( md5->md5action[ i ].name, name ) ) return &md5->md5action[ i ]; }
+		vec3 *location = ( vec3 * )dst;
 		
-		else
-		{ if( strstr( md5->md5action[ i ].name, name ) ) return &md5->md5action[ i ]; }
-	
-		++i;
+		location->x = md5track->min.x + value[ 0 ] * md5track->scale.x;
+		location->y = md5track->min.y + value[ 1 ] * md5track->scale.y;
+		location->z = md5track->min.z + value[ 2 ] * md5track->scale.z;
 	}
-	
-	return NULL;
 }
 
 
 /*!
-	Return an MD5MESH pointer for the action specified by name.
-	
-	\param[in] md5 A valid MD5 structure pointer.
-	\param[in] name The name of the mesh that you wish to obtain the MD5MESH pointer.
-	\param[in] exact_name Determine if the name is the exact string that should be used to find the
-	action in the MD5 structure MD5MESH database, or if only part of the name string can find the mesh.
-	
-	\return Return a valid MD5MESH pointer, else return NULL if the mesh name wasn't found.
+	Sample a compressed track at an arbitrary position in frames. The surrounding keys are found
+	using a binary search so only the two keys required are decoded.
+	
+	\param[in] md5track A valid MD5TRACK structure pointer.
+	\param[in] type Either 0 for a location track or 1 for a rotation track.
+	\param[in] position The position in frames to sample.
+	\param[in] joint_interpolation_method The method to use to interpolate rotations.
+	\param[out] dst A vec3 (location) or a vec4 (rotation) to store the result.
 */
-MD5MESH *MD5_get_mesh( MD5 *md5, char *name, unsigned char exact_name )
+void MD5_sample_track( MD5TRACK *md5track, unsigned char type, float position, unsigned char joint_interpolation_method, void *dst )
 {
-	unsigned int i = 0;
+	int l = 0,
+		h = md5track->n_key - 1,
+		m;
 	
-	while( i != md5->n_mesh )
+	if( md5track->n_key == 1 || position <= md5track->frame[ 0 ] )
 	{
-		if( exact_name )
-		{ if( !strcmp( md5->md5mesh[ i ].shader, name ) ) return &md5->md5mesh[ i ]; }
-		
-		else
-		{ if( strstr( md5->md5mesh[ i ].shader, name ) ) return &md5->md5mesh[ i ]; }
+		MD5_decode_track_key( md5track, type, 0, dst );
+		return;
+	}
 	
-		++i;
+	if( position >= md5track->frame[ h ] )
+	{
+		MD5_decode_track_key( md5track, type, h, dst );
+		return;
 	}
 	
-	return NULL;
+	while( h - l > 1 )
+	{
+		m = ( l + h ) >> 1;
+		
+		if( md5track->frame[ m ] <= position ) l = m;
+		else h = m;
+	}
+	
+	float t = ( position - md5track->frame[ l ] ) / ( float )( md5track->frame[ h ] - md5track->frame[ l ] );
+	
+	if( type )
+	{
+		vec4 r0, r1;
+		
+		MD5_decode_track_key( md5track, type, l, &r0 );
+		MD5_decode_track_key( md5track, type, h, &r1 );
+		
+		if( joint_interpolation_method == MD5_METHOD_SLERP ) vec4_slerp( ( vec4 * )dst, &r0, &r1, t );
+		
+		else vec4_lerp( ( vec4 * )dst, &r0, &r1, t );
+	}
+	else
+	{
+		vec3 l0, l1;
+		
+		MD5_decode_track_key( md5track, type, l, &l0 );
+		MD5_decode_track_key( md5track, type, h, &l1 );
+		
+		vec3_lerp( ( vec3 * )dst, &l0, &l1, t );
+	}
 }
 
 
 /*!
-	Start playing an action.
-	
-	\param[in,out] md5action A valid MD5ACTION structure pointer.
-	\param[in] frame_interpolation_method The type of interpolation that should be used between that animation frame.
-	\param[in] loop Determine wheter or not if the action should loop when the end frame is reached.
+	Sample a single joint of an action between its current and next frame.
 	
-	\sa MD5_METHOD_FRAME
-	\sa MD5_METHOD_LERP
-	\sa MD5_METHOD_SLERP
+	\param[in] md5action A valid MD5ACTION structure pointer.
+	\param[in] joint The index of the joint to sample.
+	\param[in,out] md5joint The MD5JOINT to store the result into.
+	\param[in] joint_interpolation_method The method to use to interpolate the rotation. \sa MD5_blend_pose
+	\param[in] blend The blending factor between the current and the next frame (a value between 0 and 1).
 */
-void MD5_action_play( MD5ACTION *md5action, unsigned char frame_interpolation_method, unsigned char loop )
+void MD5_sample_joint( MD5ACTION *md5action, unsigned int joint, MD5JOINT *md5joint, unsigned char joint_interpolation_method, float blend )
 {
-	md5action->method = frame_interpolation_method;
-	md5action->loop	  = loop;
-	md5action->state  = PLAY;
+	vec3 l0, l1;
 	
-	if( !md5action->frame_time && frame_interpolation_method == MD5_METHOD_FRAME )
+	vec4 r0, r1;
+	
+	if( !md5action->md5track )
 	{
-		md5action->frame_time =
-		md5action->fps;
+		MD5JOINT *joint0 = &md5action->frame[ md5action->curr_frame ][ joint ],
+				 *joint1 = &md5action->frame[ md5action->next_frame ][ joint ];
+		
+		memcpy( &l0, &joint0->location, sizeof( vec3 ) );
+		memcpy( &l1, &joint1->location, sizeof( vec3 ) );
+		
+		memcpy( &r0, &joint0->rotation, sizeof( vec4 ) );
+		memcpy( &r1, &joint1->rotation, sizeof( vec4 ) );
 	}
-}
-
+	else
+	{
+		MD5TRACK *location = &md5action->md5track[ joint << 1 ],
+				 *rotation = &md5action->md5track[ ( joint << 1 ) + 1 ];
+		
+		// Consecutive frames can be sampled at once, else sample both frames and blend.
+		if( md5action->next_frame == md5action->curr_frame + 1 || !blend )
+		{
+			float position = md5action->curr_frame + blend;
 
-/*!
-	Pause an action.
+			MD5_sample_track( location, 0, position, joint_interpolation_method, &md5joint->location );
+			
+			MD5_sample_track( rotation, 1, position, joint_interpolation_method, &md5joint->rotation );
+			
+			return;
+		}
+		
+		MD5_sample_track( location, 0, ( float )md5action->curr_frame, joint_interpolation_method, &l0 );
+		MD5_sample_track( location, 0, ( float )md5action->next_frame, joint_interpolation_method, &l1 );
+		
+		MD5_sample_track( rotation, 1, ( float )md5action->curr_frame, joint_interpolation_method, &r0 );
+		MD5_sample_track( rotation, 1, ( float )md5action->next_frame, joint_interpolation_method, &r1 );
+	}
 	
-	\param[in,out] md5action A valid MD5ACTION structure pointer.
-*/
-void MD5_action_pause( MD5ACTION *md5action )
-{ md5action->state = PAUSE; }
-
-
-/*!
-	Stop an reset an action.
+	vec3_lerp( &md5joint->location, &l0, &l1, blend );
 	
-	\param[in,out] md5action A valid MD5ACTION structure pointer.
-*/
-void MD5_action_stop( MD5ACTION *md5action )
-{
-	md5action->curr_frame = 0;
-	md5action->next_frame = 1;
-	md5action->state = STOP;
-	md5action->frame_time = 0.0f;
-}
-
-
-/*!
-	Set the frame rate of an action.
+	if( joint_interpolation_method == MD5_METHOD_SLERP ) vec4_slerp( &md5joint->rotation, &r0, &r1, blend );
 	
-	\param[in,out] md5action A valid MD5ACTION pointer.
-	\param[in] fps Determine the number of frame per second should be play back. (Default 24fps)
-*/
-void MD5_set_action_fps( MD5ACTION *md5action, float fps )
-{ md5action->fps = 1.0f / fps; }
+	else vec4_lerp( &md5joint->rotation, &r0, &r1, blend );
+}
 
 
 /*!
-	Set the vertex attribute of an MD5MESH. This function is used internally when
-	drawing an MD5MESH on screen or to build a VAO that will be associated to the
-	MD5MESH specified in parameter.
+	Sample the pose of an action between its current and next frame. For cooked actions the pose
+	is sampled directly from the compressed tracks, else the frames are blended like MD5_blend_pose.
 	
-	\param[in,out] md5mesh A valid MD5MESH structure pointer.
+	\param[in] md5 A valid MD5 structure pointer.
+	\param[in] md5action A valid MD5ACTION structure pointer.
+	\param[in,out] pose The MD5JOINT array to store the result into.
+	\param[in] joint_interpolation_method The method to use to interpolate the rotations. \sa MD5_blend_pose
+	\param[in] blend The blending factor between the current and the next frame (a value between 0 and 1).
 */
-void MD5_set_mesh_attributes( MD5MESH *md5mesh )
+void MD5_sample_action( MD5 *md5, MD5ACTION *md5action, MD5JOINT *pose, unsigned char joint_interpolation_method, float blend )
 {
-	glBindBuffer( GL_ARRAY_BUFFER, md5mesh->vbo );
-	
-	glEnableVertexAttribArray( 0 );
-	
-	glVertexAttribPointer( 0,
-						   3,
-						   GL_FLOAT,
-						   GL_FALSE,
-						   0,
-						   ( void * )NULL );	
-
-
-	glEnableVertexAttribArray( 1 );
-	
-	glVertexAttribPointer( 1,
-						   3,
-						   GL_FLOAT,
-						   GL_FALSE,
-						   0,
-						   BUFFER_OFFSET( md5mesh->offset[ 1 ] ) );
-
-
-	glEnableVertexAttribArray( 2 );
+	unsigned int i = 0;
 	
-	glVertexAttribPointer( 2,
-						   2,
-						   GL_FLOAT,
-						   GL_FALSE,
-						   0,
-						   BUFFER_OFFSET( md5mesh->offset[ 2 ] ) );	
-
-
-	glEnableVertexAttribArray( 3 );
+	if( !md5action->md5track )
+	{
+		MD5_blend_pose( md5,
+						pose,
+						md5action->frame[ md5action->curr_frame ],
+						md5action->frame[ md5action->next_frame ],
+						joint_interpolation_method,
+						blend );
+		return;
+	}
 	
-	glVertexAttribPointer( 3,
-						   3,
-						   GL_FLOAT,
-						   GL_FALSE,
-						   0,
-						   BUFFER_OFFSET( md5mesh->offset[ 3 ] ) );
-
-	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, md5mesh->vbo_indice );
+	while( i != md5->n_joint )
+	{
+		MD5_sample_joint( md5action, i, &pose[ i ], joint_interpolation_method, blend );
+		
+		++i;
+	}
 }
 
 
 /*!
-	Set a specific MD5MESH to be visible (1) or invisible (0) for drawing.
-	
-	\param[in] md5mesh A valid MD5MESH pointer.
-	\param[in] visible Set the visibility of the MD5MESH to be visible (1) or invisible (0). This function
-	is ideal to toggle on or off part of MD5. By default all MD5MESH starts with the visibility set to ON.
-*/
-void MD5_set_mesh_visibility( MD5MESH *md5mesh, unsigned char visible )
-{ md5mesh->visible = visible; }
-
-
-/*!
-	Assign an OBJMATERIAL structure pointer to an MD5MESH pointer. This OBJMATERIAL will be use
-	when drawing the MD5MESH.
+	Determine if the keys of a track can be removed between two frames without exceeding the
+	tolerance, using the same interpolation as MD5_sample_track.
 	
-	\param[in,out] md5mesh A valid MD5MESH pointer.
-	\param[in] objmaterial A valid OBJMATERIAL pointer.
-*/
-void MD5_set_mesh_material( MD5MESH *md5mesh, OBJMATERIAL *objmaterial )
-{ md5mesh->objmaterial = objmaterial; }
-
-
-/*!
-	Optimize all MD5MESH contains in the MD5 structure pointer received in parameter by this
-	function by converting triangles to triangle strips.
+	\param[in] value Array of n_frame vec3 (location) or vec4 (rotation) values.
+	\param[in] type Either 0 for a location track or 1 for a rotation track.
+	\param[in] start The first key frame.
+	\param[in] end The last key frame.
+	\param[in] tolerance The maximum distance (location) or angle in radians (rotation) allowed.
 	
-	\param[in,out] md5 A valid MD5 structure pointer.
-	\param[in] vertex_cache_size The higher the value the more optimize all MD5MESH will be, up
-	until the point that NvTriStrip library cannot optimize the geometry.
+	\return Return 1 if all the frames between start and end can be interpolated, else 0.
 */
-void MD5_optimize( MD5 *md5, unsigned int vertex_cache_size )
+unsigned char MD5_can_reduce_track( void *value, unsigned char type, unsigned int start, unsigned int end, float tolerance )
 {
-	unsigned int i = 0,
-	             s;
+	unsigned int i = start + 1;
 	
-	unsigned short n_group = 0;
-
-	if( vertex_cache_size ) SetCacheSize( vertex_cache_size );
-
-	while( i != md5->n_mesh )
+	while( i != end )
 	{
-		MD5MESH *md5mesh = &md5->md5mesh[ i ];
-
-		PrimitiveGroup *primitivegroup;
-	
-		if( GenerateStrips( ( unsigned short * )md5mesh->md5triangle,
-							md5mesh->n_indice,
-							&primitivegroup,
-							&n_group,
-							true ) )
+		float t = ( float )( i - start ) / ( float )( end - start );
+		
+		if( type )
 		{
-			if( primitivegroup[ 0 ].numIndices < md5mesh->n_indice )
-			{
-				md5mesh->mode = GL_TRIANGLE_STRIP;
-				md5mesh->n_indice = primitivegroup[ 0 ].numIndices;
+			vec4 *rotation = ( vec4 * )value,
+				 r;
 			
-				s = primitivegroup[ 0 ].numIndices * sizeof( unsigned short );
-
-				md5mesh->indice = ( unsigned short * ) realloc( md5mesh->indice, s );
-				
-				memcpy( &md5mesh->indice[ 0 ],
-						&primitivegroup[ 0 ].indices[ 0 ],
-						s );
-			}
-
-			delete[] primitivegroup;
+			vec4_lerp( &r, &rotation[ start ], &rotation[ end ], t );
+			
+			vec4_normalize( &r, &r );
+			
+			float d = fabsf( vec4_dot_vec4( &r, &rotation[ i ] ) );
+			
+			if( 2.0f * acosf( d > 1.0f ? 1.0f : d ) > tolerance ) return 0;
 		}
-	
+		else
+		{
+			vec3 *location = ( vec3 * )value,
+				 l;
+			
+			vec3_lerp( &l, &location[ start ], &location[ end ], t );
+			
+			if( vec3_dist( &l, &location[ i ] ) > tolerance ) return 0;
+		}
+		
 		++i;
 	}
+	
+	return 1;
 }
 
 
 /*!
-	Build the VBO for a specific MD5MESH index.
+	Determine if a track is constant: every frame is within the tolerance of the first one.
+	This function is used internally.
 	
-	\param[in,out] md5 A valid MD5 structure pointer.
-	\param[in] mesh_index The MD5MESH index inside the mesh database of the MD5 to build the VBO for.
+	\param[in] value Array of n_frame vec3 (location) or vec4 (rotation) values.
+	\param[in] type Either 0 for a location track or 1 for a rotation track.
+	\param[in] n_frame The number of frames.
+	\param[in] tolerance The maximum distance (location) or angle in radians (rotation) allowed.
+	
+	\return Return 1 if the track can be reduced to its first key, else 0.
 */
-void MD5_build_vbo( MD5 *md5, unsigned int mesh_index )
+unsigned char MD5_is_constant_track( void *value, unsigned char type, unsigned int n_frame, float tolerance )
 {
-	MD5MESH *md5mesh = &md5->md5mesh[ mesh_index ];
-
-	md5mesh->size = md5mesh->n_vertex * ( sizeof( vec3 ) +  // Vertex
-										  sizeof( vec3 ) +  // Normals
-										  sizeof( vec2 ) +  // Texcoord0
-										  sizeof( vec3 ) ); // Tangent0
-
-	md5mesh->vertex_data = ( unsigned char * ) calloc( 1, md5mesh->size );
-
-	md5mesh->offset[ 0 ] = 0;
-			
-	md5mesh->offset[ 1 ] = md5mesh->n_vertex * sizeof( vec3 );
+	unsigned int i = 1;
 	
-	md5mesh->offset[ 2 ] =   md5mesh->offset[ 1 ] +
-						   ( md5mesh->n_vertex * sizeof( vec3 ) );
-		
-	md5mesh->offset[ 3 ] =   md5mesh->offset[ 2 ] +
-						   ( md5mesh->n_vertex * sizeof( vec2 ) );
-						   
+	while( i < n_frame )
+	{
+		if( type )
+		{
+			vec4 *rotation = ( vec4 * )value;
+			
+			float d = fabsf( vec4_dot_vec4( &rotation[ 0 ], &rotation[ i ] ) );
+			
+			if( 2.0f * acosf( d > 1.0f ? 1.0f : d ) > tolerance ) return 0;
+		}
+		else
+		{
+			vec3 *location = ( vec3 * )value;
+			
+			if( vec3_dist( &location[ 0 ], &location[ i ] ) > tolerance ) return 0;
+		}
 		
-	glGenBuffers( 1, &md5mesh->vbo );
-	
-	glBindBuffer( GL_ARRAY_BUFFER, md5mesh->vbo );
-	
-	glBufferData( GL_ARRAY_BUFFER,
-				  md5mesh->size,
-				  md5mesh->vertex_data,
-				  GL_DYNAMIC_DRAW );
+		++i;
+	}
 	
-
-	glGenBuffers( 1, &md5mesh->vbo_indice );
-
-	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, md5mesh->vbo_indice );
-
-	glBufferData( GL_ELEMENT_ARRAY_BUFFER,
-				  md5mesh->n_indice * sizeof( unsigned short ),
-				  md5mesh->indice,
-				  GL_STATIC_DRAW );
+	return 1;
 }
 
 
 /*!
-	Pre-calculate the weighted normals and tangent in bind pose for the MD5 received in parameter. This
-	operation should only be done once at initialization time.
+	Cook an action into the compressed binary animation format. Constant tracks are reduced to
+	a single key, keys that can be interpolated within the tolerances are removed, locations are
+	quantized on 16 bits per axis relative to the track range and rotations are quantized using the
+	smallest three 48 bits encoding. Joint names and parents are not stored since they are taken from
+	the MD5 bind pose at load time. The resulting file can be loaded using MD5_load_action.
 	
-	\param[in,out] md5 A valid MD5 structure pointer.
+	\param[in] md5 A valid MD5 structure pointer.
+	\param[in] md5action A valid MD5ACTION loaded from an .md5anim file.
+	\param[in] filename The absolute path of the file to write.
+	\param[in] location_tolerance The maximum error allowed on the location of a joint (in units).
+	\param[in] rotation_tolerance The maximum error allowed on the rotation of a joint (in radians).
+	
+	\return Return 1 if the file have been written, else 0 (the keys being stored on 16 bits, an
+	action cannot have more than 65535 frames).
 */
-void MD5_build_bind_pose_weighted_normals_tangents( MD5 *md5 )
+unsigned char MD5_cook_action( MD5 *md5, MD5ACTION *md5action, char *filename, float location_tolerance, float rotation_tolerance )
 {
+	// The keys are stored on 16 bits.
+	if( !md5action->frame || !md5action->n_frame || md5action->n_frame > 65535 ) return 0;
+	
+	FILE *f = fopen( filename, "wb" );
+	
+	if( !f ) return 0;
+	
 	unsigned int i = 0,
 				 j,
-				 k;
-				 
-				 
-	while( i != md5->n_mesh )
+				 k,
+				 n_key,
+				 size,
+				 pad = 0;
+	
+	MD5COOKEDHEADER md5cookedheader;
+	
+	memcpy( md5cookedheader.tag, "MD5C", 4 );
+	
+	md5cookedheader.version = 1;
+	md5cookedheader.n_joint = md5->n_joint;
+	md5cookedheader.n_frame = md5action->n_frame;
+	md5cookedheader.fps		= md5action->fps;
+	
+	fwrite( &md5cookedheader, sizeof( MD5COOKEDHEADER ), 1, f );
+	
+	vec4 *value = ( vec4 * ) malloc( md5action->n_frame * sizeof( vec4 ) );
+	
+	unsigned short *key	  = ( unsigned short * ) malloc( md5action->n_frame * sizeof( unsigned short ) ),
+				   *quant = ( unsigned short * ) malloc( md5action->n_frame * 3 * sizeof( unsigned short ) );
+
+	while( i != ( md5->n_joint << 1 ) )
 	{
-		MD5MESH *md5mesh = &md5->md5mesh[ i ];
+		unsigned char type = i & 1;
 		
-		vec3 *vertex_array = ( vec3 * )md5mesh->vertex_data;
+		float tolerance = type ? rotation_tolerance : location_tolerance;
+		
+		MD5COOKEDTRACK md5cookedtrack;
+		
+		memset( &md5cookedtrack, 0, sizeof( MD5COOKEDTRACK ) );
+		
+		md5cookedtrack.type = type;
 		
 		j = 0;
-		while( j != md5mesh->n_vertex )
+		while( j != md5action->n_frame )
 		{
-			memset( &md5mesh->md5vertex[ j ].normal,
-					0,
-					sizeof( vec3 ) );
-
-			memset( &md5mesh->md5vertex[ j ].tangent,
-					0,
-					sizeof( vec3 ) );
+			MD5JOINT *md5joint = &md5action->frame[ j ][ i >> 1 ];
+			
+			if( type )
+			{
+				vec4_normalize( &value[ j ], &md5joint->rotation );
+				
+				// Keep the hemisphere continuous for the interpolation.
+				if( j && vec4_dot_vec4( &value[ j ], &value[ j - 1 ] ) < 0.0f )
+				{
+					value[ j ].x = -value[ j ].x;
+					value[ j ].y = -value[ j ].y;
+					value[ j ].z = -value[ j ].z;
+					value[ j ].w = -value[ j ].w;
+				}
+			}
+			else memcpy( &( ( vec3 * )value )[ j ], &md5joint->location, sizeof( vec3 ) );
+			
 			++j;
 		}
 		
-		j = 0;
-		while( j != md5mesh->n_triangle )
+		
+		// Keyframe reduction, a constant track end up with a single key.
+		n_key = 1;
+		key[ 0 ] = 0;
+		
+		if( md5action->n_frame > 1 )
 		{
-			MD5TRIANGLE *md5triangle = &md5mesh->md5triangle[ j ];
-
-			vec3 v1,
-				 v2,
-				 normal;
+			if( !MD5_is_constant_track( value, type, md5action->n_frame, tolerance ) )
+			{
+				j = 0;
+				while( j != md5action->n_frame - 1 )
+				{
+					k = j + 1;
+					
+					while( k + 1 != md5action->n_frame && MD5_can_reduce_track( value, type, j, k + 1, tolerance ) ) ++k;
+					
+					key[ n_key ] = k;
+					++n_key;
+					
+					j = k;
+				}
+			}
+		}
+		
+		
+		// Quantization.
+		if( !type )
+		{
+			vec3 *location = ( vec3 * )value,
+				 max;
 			
-			vec3_diff( &v1,
-					   &vertex_array[ md5triangle->indice[ 0 ] ],
-					   &vertex_array[ md5triangle->indice[ 1 ] ] );
-
-			vec3_diff( &v2,
-					   &vertex_array[ md5triangle->indice[ 0 ] ],
-					   &vertex_array[ md5triangle->indice[ 2 ] ] );
+			memcpy( &md5cookedtrack.min, &location[ key[ 0 ] ], sizeof( vec3 ) );
+			memcpy( &max, &location[ key[ 0 ] ], sizeof( vec3 ) );
 			
-
-			vec3_cross( &normal, &v1, &v2 );
+			j = 1;
+			while( j != n_key )
+			{
+				vec3 *l = &location[ key[ j ] ];
+				
+				if( l->x < md5cookedtrack.min.x ) md5cookedtrack.min.x = l->x;
+				if( l->y < md5cookedtrack.min.y ) md5cookedtrack.min.y = l->y;
+				if( l->z < md5cookedtrack.min.z ) md5cookedtrack.min.z = l->z;
+				
+				if( l->x > max.x ) max.x = l->x;
+				if( l->y > max.y ) max.y = l->y;
+				if( l->z > max.z ) max.z = l->z;
+				
+				++j;
+			}
 			
-			vec3_normalize( &normal, &normal );
-
-			// Flat normals
-			/*
-			memcpy( &md5mesh->md5vertex[ md5triangle->indice[ 0 ] ].normal, 
-					&normal,
-					sizeof( vec3 ) );
-
-			memcpy( &md5mesh->md5vertex[ md5triangle->indice[ 1 ] ].normal, 
-					&normal,
-					sizeof( vec3 ) );
+			md5cookedtrack.scale.x = ( max.x - md5cookedtrack.min.x ) / 65535.0f;
+			md5cookedtrack.scale.y = ( max.y - md5cookedtrack.min.y ) / 65535.0f;
+			md5cookedtrack.scale.z = ( max.z - md5cookedtrack.min.z ) / 65535.0f;
 
-			memcpy( &md5mesh->md5vertex[ md5triangle->indice[ 2 ] ].normal, 
-					&normal,
-					sizeof( vec3 ) );
-			*/
+			j = 0;
+			while( j != n_key )
+			{
+				vec3 *l = &location[ key[ j ] ];
+				
+				quant[ j * 3     ] = md5cookedtrack.scale.x ? ( unsigned short )( ( l->x - md5cookedtrack.min.x ) / md5cookedtrack.scale.x + 0.5f ) : 0;
+				quant[ j * 3 + 1 ] = md5cookedtrack.scale.y ? ( unsigned short )( ( l->y - md5cookedtrack.min.y ) / md5cookedtrack.scale.y + 0.5f ) : 0;
+				quant[ j * 3 + 2 ] = md5cookedtrack.scale.z ? ( unsigned short )( ( l->z - md5cookedtrack.min.z ) / md5cookedtrack.scale.z + 0.5f ) : 0;
+				
+				++j;
+			}
+		}
+		else
+		{
+			j = 0;
+			while( j != n_key )
+			{
+				MD5_encode_rotation( &quant[ j * 3 ], &value[ key[ j ] ] );
+				++j;
+			}
+		}
+		
+		
+		md5cookedtrack.n_key = n_key;
+		
+		fwrite( &md5cookedtrack, sizeof( MD5COOKEDTRACK ), 1, f );
+		
+		size = 0;
+		
+		if( n_key > 1 )
+		{
+			fwrite( key, sizeof( unsigned short ), n_key, f );
 			
-			// Smooth normals
-			vec3_add( &md5mesh->md5vertex[ md5triangle->indice[ 0 ] ].normal, 
-					  &md5mesh->md5vertex[ md5triangle->indice[ 0 ] ].normal,
-					  &normal );
+			size += n_key * sizeof( unsigned short );
+		}
+		
+		fwrite( quant, sizeof( unsigned short ), n_key * 3, f );
+		
+		size += n_key * 3 * sizeof( unsigned short );
+		
+		if( size & 3 ) fwrite( &pad, 1, 4 - ( size & 3 ), f );
+		
+		++i;
+	}
+	
+	free( quant );
+	free( key );
+	free( value );
+	
+	fclose( f );
+	
+	return 1;
+}
 
-			vec3_add( &md5mesh->md5vertex[ md5triangle->indice[ 1 ] ].normal, 
-					  &md5mesh->md5vertex[ md5triangle->indice[ 1 ] ].normal,
-					  &normal );
 
-			vec3_add( &md5mesh->md5vertex[ md5triangle->indice[ 2 ] ].normal, 
-					  &md5mesh->md5vertex[ md5triangle->indice[ 2 ] ].normal,
-					  &normal );
+/*!
+	Create a lightweight instance of an MD5 resource. The instance share the bind pose, weights,
+	triangles, action frames and index VBOs of the resource, and only own its playback state, the
+	current pose of each action and the skinned vertex data (with its VBO and VAO). If the resource
+	have already been built the instance is ready to be drawn, else you will have to build the
+	resource first and create your instances afterward.
+	
+	\param[in] md5 A valid MD5 structure pointer with all its actions loaded. If the MD5 is already
+	an instance the new instance will share the data of the original resource.
+	\param[in] name The internal name to use for the new instance.
+	
+	\return Return a new MD5 structure pointer that have to be freed using MD5_free.
+*/
+MD5 *MD5_create_instance( MD5 *md5, char *name )
+{
+	unsigned int i = 0;
 
-			vec3 tangent;
-									
-			vec2 uv1, uv2;
+	if( md5->resource ) md5 = ( MD5 * )md5->resource;
 
-			float c;
+	MD5 *instance = ( MD5 * ) malloc( sizeof( MD5 ) );
 
-			vec2_diff( &uv1,
-					   &md5mesh->md5vertex[ md5triangle->indice[ 1 ] ].uv,
-					   &md5mesh->md5vertex[ md5triangle->indice[ 0 ] ].uv );
+	memcpy( instance, md5, sizeof( MD5 ) );
 
-			vec2_diff( &uv2,
-					   &md5mesh->md5vertex[ md5triangle->indice[ 2 ] ].uv,
-					   &md5mesh->md5vertex[ md5triangle->indice[ 0 ] ].uv );
+	strcpy( instance->name, name );
 
+	instance->resource		= md5;
+	instance->n_instance	= 0;
+	instance->free_pending	= 0;
+	instance->btrigidbody	= NULL;
+	instance->pose			= NULL;
+	instance->dirty			= 0;
+	instance->md5node		= NULL;
+	
+	instance->md5lod.tick	   =
+	instance->md5lod.offscreen =
+	instance->md5lod.n_skin	   =
+	instance->md5lod.n_skip	   = 0;
 
-			c = 1.0f / ( uv1.x * uv2.y - uv2.x * uv1.y );
+	++md5->n_instance;
 
-			tangent.x = ( v1.x * uv2.y + v2.x * uv1.y ) * c;
-			tangent.y = ( v1.y * uv2.y + v2.y * uv1.y ) * c;
-			tangent.z = ( v1.z * uv2.y + v2.z * uv1.y ) * c;
 
+	instance->md5mesh = ( MD5MESH * ) malloc( md5->n_mesh * sizeof( MD5MESH ) );
 
-			vec3_add( &md5mesh->md5vertex[ md5triangle->indice[ 0 ] ].tangent, 
-					  &md5mesh->md5vertex[ md5triangle->indice[ 0 ] ].tangent,
-					  &tangent );
+	memcpy( instance->md5mesh, md5->md5mesh, md5->n_mesh * sizeof( MD5MESH ) );
 
-			vec3_add( &md5mesh->md5vertex[ md5triangle->indice[ 1 ] ].tangent, 
-					  &md5mesh->md5vertex[ md5triangle->indice[ 1 ] ].tangent,
-					  &tangent );
+	while( i != md5->n_mesh )
+	{
+		MD5MESH *md5mesh = &instance->md5mesh[ i ];
 
-			vec3_add( &md5mesh->md5vertex[ md5triangle->indice[ 2 ] ].tangent, 
-					  &md5mesh->md5vertex[ md5triangle->indice[ 2 ] ].tangent,
-					  &tangent );
-			
-			++j;
-		}
-	
+		md5mesh->vertex_data = NULL;
+		md5mesh->vbo		 =
+		md5mesh->vao		 =
+		md5mesh->stream_vbo	 = 0;
 
-		j = 0;
-		while( j != md5mesh->n_vertex )
+		if( md5->md5mesh[ i ].vertex_data )
 		{
-			// Average normals & tangents
-			vec3_normalize( &md5mesh->md5vertex[ j ].normal, 
-							&md5mesh->md5vertex[ j ].normal );
+			md5mesh->vertex_data = ( unsigned char * ) malloc( md5mesh->size );
 
-			vec3_normalize( &md5mesh->md5vertex[ j ].tangent, 
-							&md5mesh->md5vertex[ j ].tangent );
+			memcpy( md5mesh->vertex_data,
+					md5->md5mesh[ i ].vertex_data,
+					md5mesh->size );
 
-			++j;
-		}
-		
-		
-		j = 0;
-		while( j != md5mesh->n_weight )
-		{
-			memset( &md5mesh->md5weight[ j ].normal,
-					0,
-					sizeof( vec3 ) );
+			glGenBuffers( 1, &md5mesh->vbo );
 
-			memset( &md5mesh->md5weight[ j ].tangent,
-					0,
-					sizeof( vec3 ) );			
-			++j;
-		}
-		
-		
-		j = 0;
-		while( j != md5mesh->n_vertex )
-		{
-			MD5VERTEX *md5vertex = &md5mesh->md5vertex[ j ];
-			
-			k = 0;
-			while( k != md5vertex->count )
+			glBindBuffer( GL_ARRAY_BUFFER, md5mesh->vbo );
+
+			glBufferData( GL_ARRAY_BUFFER,
+						  md5mesh->size,
+						  md5mesh->vertex_data,
+						  GL_DYNAMIC_DRAW );
+
+			if( md5->md5mesh[ i ].vao )
 			{
-				MD5WEIGHT *md5weight = &md5mesh->md5weight[ md5vertex->start + k ];
-				
-				MD5JOINT *md5joint = &md5->bind_pose[ md5weight->joint ];	
-				
-				vec3 normal = { md5vertex->normal.x,
-								md5vertex->normal.y,
-								md5vertex->normal.z },
-					
-					 tangent = { md5vertex->tangent.x,
-								 md5vertex->tangent.y,
-								 md5vertex->tangent.z };
-				
-				vec4 rotation = { md5joint->rotation.x,
-								  md5joint->rotation.y,
-								  md5joint->rotation.z,
-								  md5joint->rotation.w };
+				glGenVertexArraysOES( 1, &md5mesh->vao );
 
-				
-				vec4_conjugate( &rotation, &rotation );
-				
-				
-				vec3_rotate_vec4( &normal,
-								  &normal,
-								  &rotation );
+				glBindVertexArrayOES( md5mesh->vao );
 
-				vec3_rotate_vec4( &tangent,
-								  &tangent,
-								  &rotation );
+				MD5_set_mesh_attributes( md5mesh );
 
-			
-				vec3_add( &md5weight->normal,
-						  &md5weight->normal,
-						  &normal );
-						  
-				vec3_add( &md5weight->tangent,
-						  &md5weight->tangent,
-						  &tangent );
-				++k;
+				glBindVertexArrayOES( 0 );
 			}
-		
-			++j;
 		}
 
+		++i;
+	}
 
-		j = 0;
-		while( j != md5mesh->n_weight )
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+
+	instance->md5action = NULL;
+
+	if( md5->n_action )
+	{
+		instance->md5action = ( MD5ACTION * ) malloc( md5->n_action * sizeof( MD5ACTION ) );
+
+		memcpy( instance->md5action, md5->md5action, md5->n_action * sizeof( MD5ACTION ) );
+
+		i = 0;
+		while( i != md5->n_action )
 		{
-			vec3_normalize( &md5mesh->md5weight[ j ].normal,
-							&md5mesh->md5weight[ j ].normal );
+			MD5ACTION *md5action = &instance->md5action[ i ];
 
-			vec3_normalize( &md5mesh->md5weight[ j ].tangent,
-							&md5mesh->md5weight[ j ].tangent );
-			++j;
-		}
+			md5action->pose = ( MD5JOINT * ) malloc( md5->n_joint * sizeof( MD5JOINT ) );
 
+			memcpy( md5action->pose,
+					md5->md5action[ i ].pose,
+					md5->n_joint * sizeof( MD5JOINT ) );
 
-		++i;
+			MD5_action_stop( md5action );
+
+			++i;
+		}
 	}
+
+	return instance;
 }
 
 
 /*!
-	Set all the MD5MESH inside an MD5 to a specific pose specified by an array of joints.
+	Free a valid MD5 structure pointer previously initialized with MD5_load_mesh or MD5_create_instance.
+	When the MD5 is an instance only its own data is released, the shared data is left untouched.
+	When the MD5 is a resource that still have instances, its release is deferred until its
+	last instance is freed.
 	
 	\param[in,out] md5 A valid MD5 structure pointer.
-	\param[in] pose An array of MD5JOINT where the number of individual joints are the
-	same as the one contained in the MD5 structure.
+	
+	\return Return a NULL MD5 structure pointer.
 */
-void MD5_set_pose( MD5 *md5, MD5JOINT *pose )
+MD5 *MD5_free( MD5 *md5 )
 {
 	unsigned int i = 0,
-				 j,
-				 k;
-				 
-	while( i != md5->n_mesh )
+			     j;
+
+	if( md5->resource )
 	{
-		MD5MESH *md5mesh = &md5->md5mesh[ i ];
+		while( i != md5->n_mesh )
+		{
+			MD5MESH *md5mesh = &md5->md5mesh[ i ];
 
-		vec3 *vertex_array  = ( vec3 * )md5mesh->vertex_data,
-			 *normal_array  = ( vec3 * )&md5mesh->vertex_data[ md5mesh->offset[ 1 ] ],
-			 *tangent_array = ( vec3 * )&md5mesh->vertex_data[ md5mesh->offset[ 3 ] ];
-			 
-		vec2 *uv_array = ( vec2 * )&md5mesh->vertex_data[ md5mesh->offset[ 2 ] ];
-		
-		memset( vertex_array , 0, md5mesh->offset[ 1 ] );
-		memset( normal_array , 0, md5mesh->offset[ 1 ] );
-		memset( tangent_array, 0, md5mesh->offset[ 1 ] );
-		
+			if( md5mesh->vertex_data ) free( md5mesh->vertex_data );
 
-		j = 0;
-		while( j != md5mesh->n_vertex )
-		{
-			MD5VERTEX *md5vertex = &md5mesh->md5vertex[ j ];
-		
-			k = 0;
-			while( k != md5vertex->count )
-			{
-				vec3 location = { 0.0f, 0.0f, 0.0f },
-					 normal   = { 0.0f, 0.0f, 0.0f },
-					 tangent  = { 0.0f, 0.0f, 0.0f };
-					 
+			if( md5mesh->vbo ) glDeleteBuffers( 1, &md5mesh->vbo );
 
-				MD5WEIGHT *md5weight = &md5mesh->md5weight[ md5vertex->start + k ];
-				
-				MD5JOINT *md5joint = &pose[ md5weight->joint ];
+			if( md5mesh->vao ) glDeleteVertexArraysOES( 1, &md5mesh->vao );
+
+			++i;
+		}
+
+		if( md5->md5mesh ) free( md5->md5mesh );
+
+
+		i = 0;
+		while( i != md5->n_action )
+		{
+			free( md5->md5action[ i ].pose );
+			++i;
+		}
+
+		if( md5->md5action ) free( md5->md5action );
+
+		if( md5->pose ) free( md5->pose );
+
+
+		MD5 *resource = ( MD5 * )md5->resource;
+
+		free( md5 );
+
+		if( !--resource->n_instance && resource->free_pending ) MD5_free( resource );
+
+		return NULL;
+	}
+
+
+	// Instances are still pointing to the shared data, release it with the last one.
+	if( md5->n_instance )
+	{
+		md5->free_pending = 1;
+		return NULL;
+	}
+
+
+	MD5_free_mesh_data( md5 );
+
+	while( i != md5->n_mesh )
+	{
+		MD5MESH *md5mesh = &md5->md5mesh[ i ];
+		
+		if( md5mesh->md5vertex ) free( md5mesh->md5vertex );
+		
+		if( md5mesh->vertex_data ) free( md5mesh->vertex_data );
+		
+		if( md5mesh->md5triangle ) free( md5mesh->md5triangle );
+		
+		if( md5mesh->md5weight ) free( md5mesh->md5weight );
+
+		if( md5mesh->vbo ) glDeleteBuffers( 1, &md5mesh->vbo );
+
+		if( md5mesh->vbo_indice ) glDeleteBuffers( 1, &md5mesh->vbo_indice );
+		
+		if( md5mesh->vao ) glDeleteVertexArraysOES( 1, &md5mesh->vao );
+		
+		++i;
+	}
+
+	if( md5->md5mesh ) free( md5->md5mesh );
+	
+
+	i = 0;
+	while( i != md5->n_action )
+	{
+		MD5ACTION *md5action = &md5->md5action[ i ];
+		
+		if( md5action->frame )
+		{
+			j = 0;
+			while( j != md5action->n_frame )
+			{
+				free( md5action->frame[ j ] );
+				++j;
+			}
+			
+			free( md5action->frame );
+		}
+		
+		if( md5action->pose ) free( md5action->pose );
+		
+		if( md5action->md5track ) free( md5action->md5track );
+		
+		if( md5action->memory ) mclose( md5action->memory );
+
+		++i;
+	}
+	
+	if( md5->md5action ) free( md5->md5action );
+
+	
+	if( md5->bind_pose )
+	{
+		free( md5->bind_pose );
+		md5->bind_pose = NULL;
+	}
+	
+	if( md5->md5bound ) free( md5->md5bound );
+	
+	if( md5->pose ) free( md5->pose );
+	
+
+	free( md5 );
+	return NULL;
+}
+
+
+/*!
+	Free all the indices and triangle data used by the different MD5MESH contains
+	in the MD5 structure pointer pass in parameter. This function should only be
+	called after you call MD5_build as theses data are not necessary anymore for
+	drawing and can help you to save memory. Calling this function on an instance
+	have no effect, since the indices are owned by the resource.
+	
+	\param[in,out] md5 A valid MD5 structure pointer.
+*/
+void MD5_free_mesh_data( MD5 *md5 )
+{
+	unsigned int i = 0;	
+
+	if( md5->resource ) return;
+
+	while( i != md5->n_mesh )
+	{
+		MD5MESH *md5mesh = &md5->md5mesh[ i ];
+		
+		if( md5mesh->indice )
+		{
+			free( md5mesh->indice );
+			md5mesh->indice = NULL;
+		}
+	
+		if( md5mesh->md5triangle )
+		{
+			free( md5mesh->md5triangle );
+			md5mesh->md5triangle = NULL;
+		}
+		
+		++i;
+	}	
+}
+
+
+/*!
+	Return an MD5ACTION pointer for the action specified by name.
+	
+	\param[in] md5 A valid MD5 structure pointer that have some MD5ACTION loaded. \sa MD5_load_action
+	\param[in] name The name of the action that you wish to obtain the MD5ACTION pointer.
+	\param[in] exact_name Determine if the name is the exact string that should be used to find the
+	action in the MD5 structure action database, or if only part of the name string can find the action.
+	
+	\return Return a valid MD5ACTION pointer, else return NULL if the action name wasn't found.
+*/
+MD5ACTION *MD5_get_action( MD5 *md5, char *name, unsigned char exact_name )
+{
+	unsigned int i = 0;
+	
+	while( i != md5->n_action )
+	{
+		if( exact_name )
+		{ if( !strcmp( md5->md5action[ i ].name, name ) ) return &md5->md5action[ i ]; }
+		
+		else
+		{ if( strstr( md5->md5action[ i ].name, name ) ) return &md5->md5action[ i ]; }
+	
+		++i;
+	}
+	
+	return NULL;
+}
+
+
+/*!
+	Return an MD5MESH pointer for the action specified by name.
+	
+	\param[in] md5 A valid MD5 structure pointer.
+	\param[in] name The name of the mesh that you wish to obtain the MD5MESH pointer.
+	\param[in] exact_name Determine if the name is the exact string that should be used to find the
+	action in the MD5 structure MD5MESH database, or if only part of the name string can find the mesh.
+	
+	\return Return a valid MD5MESH pointer, else return NULL if the mesh name wasn't found.
+*/
+MD5MESH *MD5_get_mesh( MD5 *md5, char *name, unsigned char exact_name )
+{
+	unsigned int i = 0;
+	
+	while( i != md5->n_mesh )
+	{
+		if( exact_name )
+		{ if( !strcmp( md5->md5mesh[ i ].shader, name ) ) return &md5->md5mesh[ i ]; }
+		
+		else
+		{ if( strstr( md5->md5mesh[ i ].shader, name ) ) return &md5->md5mesh[ i ]; }
+	
+		++i;
+	}
+	
+	return NULL;
+}
+
+
+/*!
+	Start playing an action.
+	
+	\param[in,out] md5action A valid MD5ACTION structure pointer.
+	\param[in] frame_interpolation_method The type of interpolation that should be used between that animation frame.
+	\param[in] loop Determine wheter or not if the action should loop when the end frame is reached.
+	
+	\sa MD5_METHOD_FRAME
+	\sa MD5_METHOD_LERP
+	\sa MD5_METHOD_SLERP
+*/
+void MD5_action_play( MD5ACTION *md5action, unsigned char frame_interpolation_method, unsigned char loop )
+{
+	md5action->method = frame_interpolation_method;
+	md5action->loop	  = loop;
+	md5action->state  = PLAY;
+	
+	if( !md5action->frame_time && frame_interpolation_method == MD5_METHOD_FRAME )
+	{
+		md5action->frame_time =
+		md5action->fps;
+	}
+}
+
+
+/*!
+	Pause an action.
+	
+	\param[in,out] md5action A valid MD5ACTION structure pointer.
+*/
+void MD5_action_pause( MD5ACTION *md5action )
+{ md5action->state = PAUSE; }
+
+
+/*!
+	Stop an reset an action.
+	
+	\param[in,out] md5action A valid MD5ACTION structure pointer.
+*/
+void MD5_action_stop( MD5ACTION *md5action )
+{
+	md5action->curr_frame = 0;
+	md5action->next_frame = 1;
+	md5action->state = STOP;
+	md5action->frame_time = 0.0f;
+}
+
+
+/*!
+	Set the frame rate of an action.
+	
+	\param[in,out] md5action A valid MD5ACTION pointer.
+	\param[in] fps Determine the number of frame per second should be play back. (Default 24fps)
+*/
+void MD5_set_action_fps( MD5ACTION *md5action, float fps )
+{ md5action->fps = 1.0f / fps; }
+
+
+/*!
+	Set the vertex attribute of an MD5MESH. This function is used internally when
+	drawing an MD5MESH on screen or to build a VAO that will be associated to the
+	MD5MESH specified in parameter.
+	
+	\param[in,out] md5mesh A valid MD5MESH structure pointer.
+*/
+void MD5_set_mesh_attributes( MD5MESH *md5mesh )
+{
+	unsigned int base = 0;
+	
+	if( md5mesh->stream_vbo )
+	{
+		glBindBuffer( GL_ARRAY_BUFFER, md5mesh->stream_vbo );
+		
+		base = md5mesh->stream_offset;
+	}
+	else glBindBuffer( GL_ARRAY_BUFFER, md5mesh->vbo );
+	
+	glEnableVertexAttribArray( 0 );
+	
+	glVertexAttribPointer( 0,
+						   3,
+						   GL_FLOAT,
+						   GL_FALSE,
+						   0,
+						   BUFFER_OFFSET( base ) );	
+
+
+	glEnableVertexAttribArray( 1 );
+	
+	glVertexAttribPointer( 1,
+						   3,
+						   GL_FLOAT,
+						   GL_FALSE,
+						   0,
+						   BUFFER_OFFSET( base + md5mesh->offset[ 1 ] ) );
+
+
+	glEnableVertexAttribArray( 2 );
+	
+	glVertexAttribPointer( 2,
+						   2,
+						   GL_FLOAT,
+						   GL_FALSE,
+						   0,
+						   BUFFER_OFFSET( base + md5mesh->offset[ 2 ] ) );	
+
+
+	glEnableVertexAttribArray( 3 );
+	
+	glVertexAttribPointer( 3,
+						   3,
+						   GL_FLOAT,
+						   GL_FALSE,
+						   0,
+						   BUFFER_OFFSET( base + md5mesh->offset[ 3 ] ) );
+
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, md5mesh->vbo_indice );
+}
+
+
+/*!
+	Set a specific MD5MESH to be visible (1) or invisible (0) for drawing.
+	
+	\param[in] md5mesh A valid MD5MESH pointer.
+	\param[in] visible Set the visibility of the MD5MESH to be visible (1) or invisible (0). This function
+	is ideal to toggle on or off part of MD5. By default all MD5MESH starts with the visibility set to ON.
+*/
+void MD5_set_mesh_visibility( MD5MESH *md5mesh, unsigned char visible )
+{ md5mesh->visible = visible; }
+
+
+/*!
+	Assign an OBJMATERIAL structure pointer to an MD5MESH pointer. This OBJMATERIAL will be use
+	when drawing the MD5MESH.
+	
+	\param[in,out] md5mesh A valid MD5MESH pointer.
+	\param[in] objmaterial A valid OBJMATERIAL pointer.
+*/
+void MD5_set_mesh_material( MD5MESH *md5mesh, OBJMATERIAL *objmaterial )
+{ md5mesh->objmaterial = objmaterial; }
+
+
+/*!
+	Optimize all MD5MESH contains in the MD5 structure pointer received in parameter by this
+	function by converting triangles to triangle strips.
+	
+	\param[in,out] md5 A valid MD5 structure pointer.
+	\param[in] vertex_cache_size The higher the value the more optimize all MD5MESH will be, up
+	until the point that NvTriStrip library cannot optimize the geometry.
+*/
+void MD5_optimize( MD5 *md5, unsigned int vertex_cache_size )
+{
+	unsigned int i = 0,
+	             s;
+	
+	unsigned short n_group = 0;
+
+	if( md5->resource ) return;
+
+	if( vertex_cache_size ) SetCacheSize( vertex_cache_size );
+
+	while( i != md5->n_mesh )
+	{
+		MD5MESH *md5mesh = &md5->md5mesh[ i ];
+
+		PrimitiveGroup *primitivegroup;
+	
+		if( GenerateStrips( ( unsigned short * )md5mesh->md5triangle,
+							md5mesh->n_indice,
+							&primitivegroup,
+							&n_group,
+							true ) )
+		{
+			if( primitivegroup[ 0 ].numIndices < md5mesh->n_indice )
+			{
+				md5mesh->mode = GL_TRIANGLE_STRIP;
+				md5mesh->n_indice = primitivegroup[ 0 ].numIndices;
+			
+				s = primitivegroup[ 0 ].numIndices * sizeof( unsigned short );
+
+				md5mesh->indice = ( unsigned short * ) realloc( md5mesh->indice, s );
+				
+				memcpy( &md5mesh->indice[ 0 ],
+						&primitivegroup[ 0 ].indices[ 0 ],
+						s );
+			}
+
+			delete[] primitivegroup;
+		}
+	
+		++i;
+	}
+}
+
+
+/*!
+	Build the VBO for a specific MD5MESH index.
+	
+	\param[in,out] md5 A valid MD5 structure pointer.
+	\param[in] mesh_index The MD5MESH index inside the mesh database of the MD5 to build the VBO for.
+*/
+void MD5_build_vbo( MD5 *md5, unsigned int mesh_index )
+{
+	MD5MESH *md5mesh = &md5->md5mesh[ mesh_index ];
+
+	md5mesh->size = md5mesh->n_vertex * ( sizeof( vec3 ) +  // Vertex
+										  sizeof( vec3 ) +  // Normals
+										  sizeof( vec2 ) +  // Texcoord0
+										  sizeof( vec3 ) ); // Tangent0
+
+	md5mesh->vertex_data = ( unsigned char * ) calloc( 1, md5mesh->size );
+
+	md5mesh->offset[ 0 ] = 0;
+			
+	md5mesh->offset[ 1 ] = md5mesh->n_vertex * sizeof( vec3 );
+	
+	md5mesh->offset[ 2 ] =   md5mesh->offset[ 1 ] +
+						   ( md5mesh->n_vertex * sizeof( vec3 ) );
+		
+	md5mesh->offset[ 3 ] =   md5mesh->offset[ 2 ] +
+						   ( md5mesh->n_vertex * sizeof( vec2 ) );
+						   
+		
+	glGenBuffers( 1, &md5mesh->vbo );
+	
+	glBindBuffer( GL_ARRAY_BUFFER, md5mesh->vbo );
+	
+	glBufferData( GL_ARRAY_BUFFER,
+				  md5mesh->size,
+				  md5mesh->vertex_data,
+				  GL_DYNAMIC_DRAW );
+	
+
+	// The index VBO of an instance is owned by its resource.
+	if( md5->resource ) return;
+
+	glGenBuffers( 1, &md5mesh->vbo_indice );
+
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, md5mesh->vbo_indice );
+
+	glBufferData( GL_ELEMENT_ARRAY_BUFFER,
+				  md5mesh->n_indice * sizeof( unsigned short ),
+				  md5mesh->indice,
+				  GL_STATIC_DRAW );
+}
+
+
+/*!
+	Pre-calculate the weighted normals and tangent in bind pose for the MD5 received in parameter. This
+	operation should only be done once at initialization time.
+	
+	\param[in,out] md5 A valid MD5 structure pointer.
+*/
+void MD5_build_bind_pose_weighted_normals_tangents( MD5 *md5 )
+{
+	unsigned int i = 0,
+				 j,
+				 k;
+				 
+				 
+	while( i != md5->n_mesh )
+	{
+		MD5MESH *md5mesh = &md5->md5mesh[ i ];
+		
+		vec3 *vertex_array = ( vec3 * )md5mesh->vertex_data;
+		
+		j = 0;
+		while( j != md5mesh->n_vertex )
+		{
+			memset( &md5mesh->md5vertex[ j ].normal,
+					0,
+					sizeof( vec3 ) );
+
+			memset( &md5mesh->md5vertex[ j ].tangent,
+					0,
+					sizeof( vec3 ) );
+			++j;
+		}
+		
+		j = 0;
+		while( j != md5mesh->n_triangle )
+		{
+			MD5TRIANGLE *md5triangle = &md5mesh->md5triangle[ j ];
+
+			vec3 v1,
+				 v2,
+				 normal;
+			
+			vec3_diff( &v1,
+					   &vertex_array[ md5triangle->indice[ 0 ] ],
+					   &vertex_array[ md5triangle->indice[ 1 ] ] );
+
+			vec3_diff( &v2,
+					   &vertex_array[ md5triangle->indice[ 0 ] ],
+					   &vertex_array[ md5triangle->indice[ 2 ] ] );
+			
+
+			vec3_cross( &normal, &v1, &v2 );
+			
+			vec3_normalize( &normal, &normal );
+
+			// Flat normals
+			/*
+			memcpy( &md5mesh->md5vertex[ md5triangle->indice[ 0 ] ].normal, 
+					&normal,
+					sizeof( vec3 ) );
+
+			memcpy( &md5mesh->md5vertex[ md5triangle->indice[ 1 ] ].normal, 
+					&normal,
+					sizeof( vec3 ) );
+
+			memcpy( &md5mesh->md5vertex[ md5triangle->indice[ 2 ] ].normal, 
+					&normal,
+					sizeof( vec3 ) );
+			*/
+			
+			// Smooth normals
+			vec3_add( &md5mesh->md5vertex[ md5triangle->indice[ 0 ] ].normal, 
+					  &md5mesh->md5vertex[ md5triangle->indice[ 0 ] ].normal,
+					  &normal );
+
+			vec3_add( &md5mesh->md5vertex[ md5triangle->indice[ 1 ] ].normal, 
+					  &md5mesh->md5vertex[ md5triangle->indice[ 1 ] ].normal,
+					  &normal );
+
+			vec3_add( &md5mesh->md5vertex[ md5triangle->indice[ 2 ] ].normal, 
+					  &md5mesh->md5vertex[ md5triangle->indice[ 2 ] ].normal,
+					  &normal );
+
+			vec3 tangent;
+									
+			vec2 uv1, uv2;
+
+			float c;
+
+			vec2_diff( &uv1,
+					   &md5mesh->md5vertex[ md5triangle->indice[ 1 ] ].uv,
+					   &md5mesh->md5vertex[ md5triangle->indice[ 0 ] ].uv );
+
+			vec2_diff( &uv2,
+					   &md5mesh->md5vertex[ md5triangle->indice[ 2 ] ].uv,
+					   &md5mesh->md5vertex[ md5triangle->indice[ 0 ] ].uv );
+
+
+			c = 1.0f / ( uv1.x * uv2.y - uv2.x * uv1.y );
+
+			tangent.x = ( v1.x * uv2.y + v2.x * uv1.y ) * c;
+			tangent.y = ( v1.y * uv2.y + v2.y * uv1.y ) * c;
+			tangent.z = ( v1.z * uv2.y + v2.z * uv1.y ) * c;
+
+
+			vec3_add( &md5mesh->md5vertex[ md5triangle->indice[ 0 ] ].tangent, 
+					  &md5mesh->md5vertex[ md5triangle->indice[ 0 ] ].tangent,
+					  &tangent );
+
+			vec3_add( &md5mesh->md5vertex[ md5triangle->indice[ 1 ] ].tangent, 
+					  &md5mesh->md5vertex[ md5triangle->indice[ 1 ] ].tangent,
+					  &tangent );
+
+			vec3_add( &md5mesh->md5vertex[ md5triangle->indice[ 2 ] ].tangent, 
+					  &md5mesh->md5vertex[ md5triangle->indice[ 2 ] ].tangent,
+					  &tangent );
+			
+			++j;
+		}
+	
+
+		j = 0;
+		while( j != md5mesh->n_vertex )
+		{
+			// Average normals & tangents
+			vec3_normalize( &md5mesh->md5vertex[ j ].normal, 
+							&md5mesh->md5vertex[ j ].normal );
+
+			vec3_normalize( &md5mesh->md5vertex[ j ].tangent, 
+							&md5mesh->md5vertex[ j ].tangent );
+
+			++j;
+		}
+		
+		
+		j = 0;
+		while( j != md5mesh->n_weight )
+		{
+			memset( &md5mesh->md5weight[ j ].normal,
+					0,
+					sizeof( vec3 ) );
+
+			memset( &md5mesh->md5weight[ j ].tangent,
+					0,
+					sizeof( vec3 ) );			
+			++j;
+		}
+		
+		
+		j = 0;
+		while( j != md5mesh->n_vertex )
+		{
+			MD5VERTEX *md5vertex = &md5mesh->md5vertex[ j ];
+			
+			k = 0;
+			while( k != md5vertex->count )
+			{
+				MD5WEIGHT *md5weight = &md5mesh->md5weight[ md5vertex->start + k ];
+				
+				MD5JOINT *md5joint = &md5->bind_pose[ md5weight->joint ];	
+				
+				vec3 normal = { md5vertex->normal.x,
+								md5vertex->normal.y,
+								md5vertex->normal.z },
+					
+					 tangent = { md5vertex->tangent.x,
+								 md5vertex->tangent.y,
+								 md5vertex->tangent.z };
+				
+				vec4 rotation = { md5joint->rotation.x,
+								  md5joint->rotation.y,
+								  md5joint->rotation.z,
+								  md5joint->rotation.w };
+
+				
+				vec4_conjugate( &rotation, &rotation );
+				
+				
+				vec3_rotate_vec4( &normal,
+								  &normal,
+								  &rotation );
+
+				vec3_rotate_vec4( &tangent,
+								  &tangent,
+								  &rotation );
+
+			
+				vec3_add( &md5weight->normal,
+						  &md5weight->normal,
+						  &normal );
+						  
+				vec3_add( &md5weight->tangent,
+						  &md5weight->tangent,
+						  &tangent );
+				++k;
+			}
+		
+			++j;
+		}
+
+
+		j = 0;
+		while( j != md5mesh->n_weight )
+		{
+			vec3_normalize( &md5mesh->md5weight[ j ].normal,
+							&md5mesh->md5weight[ j ].normal );
+
+			vec3_normalize( &md5mesh->md5weight[ j ].tangent,
+							&md5mesh->md5weight[ j ].tangent );
+			++j;
+		}
+
+
+		++i;
+	}
+}
+
+
+/*!
+	Skin the vertex data of all the MD5MESH inside an MD5 to a specific pose specified by an
+	array of joints. This function only work on the CPU side and doesn't issue any OpenGLES
+	call, so it can be called from any thread. \sa MD5_upload_pose
+	
+	\param[in,out] md5 A valid MD5 structure pointer.
+	\param[in] pose An array of MD5JOINT where the number of individual joints are the
+	same as the one contained in the MD5 structure.
+*/
+void MD5_skin_pose( MD5 *md5, MD5JOINT *pose )
+{
+	unsigned int i = 0,
+				 j,
+				 k;
+				 
+	while( i != md5->n_mesh )
+	{
+		MD5MESH *md5mesh = &md5->md5mesh[ i ];
+
+		vec3 *vertex_array  = ( vec3 * )md5mesh->vertex_data,
+			 *normal_array  = ( vec3 * )&md5mesh->vertex_data[ md5mesh->offset[ 1 ] ],
+			 *tangent_array = ( vec3 * )&md5mesh->vertex_data[ md5mesh->offset[ 3 ] ];
+			 
+		vec2 *uv_array = ( vec2 * )&md5mesh->vertex_data[ md5mesh->offset[ 2 ] ];
+		
+		memset( vertex_array , 0, md5mesh->offset[ 1 ] );
+		memset( normal_array , 0, md5mesh->offset[ 1 ] );
+		memset( tangent_array, 0, md5mesh->offset[ 1 ] );
+		
+
+		j = 0;
+		while( j != md5mesh->n_vertex )
+		{
+			MD5VERTEX *md5vertex = &md5mesh->md5vertex[ j ];
+		
+			k = 0;
+			while( k != md5vertex->count )
+			{
+				vec3 location = { 0.0f, 0.0f, 0.0f },
+					 normal   = { 0.0f, 0.0f, 0.0f },
+					 tangent  = { 0.0f, 0.0f, 0.0f };
+					 
+
+				MD5WEIGHT *md5weight = &md5mesh->md5weight[ md5vertex->start + k ];
+				
+				MD5JOINT *md5joint = &pose[ md5weight->joint ];
 
 				vec3_rotate_vec4( &location,
 								  &md5weight->location,
 								  &md5joint->rotation );
 								  
-				vec3_rotate_vec4( &normal,
-								  &md5weight->normal,
-								  &md5joint->rotation );
+				vec3_rotate_vec4( &normal,
+								  &md5weight->normal,
+								  &md5joint->rotation );
+
+				vec3_rotate_vec4( &tangent,
+								  &md5weight->tangent,
+								  &md5joint->rotation );
+								  
+				vertex_array[ j ].x += ( md5joint->location.x + location.x ) * md5weight->bias;
+				vertex_array[ j ].y += ( md5joint->location.y + location.y ) * md5weight->bias;
+				vertex_array[ j ].z += ( md5joint->location.z + location.z ) * md5weight->bias;
+
+				normal_array[ j ].x += normal.x * md5weight->bias;
+				normal_array[ j ].y += normal.y * md5weight->bias;
+				normal_array[ j ].z += normal.z * md5weight->bias;
+
+				tangent_array[ j ].x += tangent.x * md5weight->bias;
+				tangent_array[ j ].y += tangent.y * md5weight->bias;
+				tangent_array[ j ].z += tangent.z * md5weight->bias;
+								
+				++k;
+			}
+
+			uv_array[ j ].x = md5vertex->uv.x;
+			uv_array[ j ].y = md5vertex->uv.y;
+			
+			++j;
+		}
+
+		++i;
+	}
+	
+	MD5_update_bound_pose( md5, pose );
+	
+	md5->dirty = 1;
+}
+
+
+/*!
+	Update the bounding box and bounding sphere of an MD5 for a specific pose. Instead of
+	walking the skinned vertices, the joint space bounding box of each joint is transformed
+	by the pose, so the cost only depend on the number of joints. The resulting bounds are
+	conservative and contain the skinned mesh.
+	
+	\param[in,out] md5 A valid MD5 structure pointer.
+	\param[in] pose An array of MD5JOINT where the number of individual joints are the
+	same as the one contained in the MD5 structure.
+*/
+void MD5_update_bound_pose( MD5 *md5, MD5JOINT *pose )
+{
+	unsigned int i = 0;
+	
+	if( !md5->md5bound ) return;
+	
+	md5->min.x =
+	md5->min.y =
+	md5->min.z = 99999.999f;
+
+	md5->max.x =
+	md5->max.y =
+	md5->max.z = -99999.999f;
+	
+	while( i != md5->n_joint )
+	{
+		MD5BOUND *md5bound = &md5->md5bound[ i ];
+		
+		if( md5bound->used )
+		{
+			vec4 *q = &pose[ i ].rotation;
+			
+			vec3 center = { ( md5bound->min.x + md5bound->max.x ) * 0.5f,
+							( md5bound->min.y + md5bound->max.y ) * 0.5f,
+							( md5bound->min.z + md5bound->max.z ) * 0.5f },
+				 extent = { ( md5bound->max.x - md5bound->min.x ) * 0.5f,
+							( md5bound->max.y - md5bound->min.y ) * 0.5f,
+							( md5bound->max.z - md5bound->min.z ) * 0.5f },
+				 c,
+				 e;
+			
+			// Rotation matrix of the joint, its absolute value give the extent of the rotated box.
+			float m[ 9 ] = { 1.0f - 2.0f * ( q->y * q->y + q->z * q->z ), 2.0f * ( q->x * q->y - q->w * q->z ), 2.0f * ( q->x * q->z + q->w * q->y ),
+							 2.0f * ( q->x * q->y + q->w * q->z ), 1.0f - 2.0f * ( q->x * q->x + q->z * q->z ), 2.0f * ( q->y * q->z - q->w * q->x ),
+							 2.0f * ( q->x * q->z - q->w * q->y ), 2.0f * ( q->y * q->z + q->w * q->x ), 1.0f - 2.0f * ( q->x * q->x + q->y * q->y ) };
+			
+			vec3_rotate_vec4( &c, &center, q );
+			
+			c.x += pose[ i ].location.x;
+			c.y += pose[ i ].location.y;
+			c.z += pose[ i ].location.z;
+			
+			e.x = fabsf( m[ 0 ] ) * extent.x + fabsf( m[ 1 ] ) * extent.y + fabsf( m[ 2 ] ) * extent.z;
+			e.y = fabsf( m[ 3 ] ) * extent.x + fabsf( m[ 4 ] ) * extent.y + fabsf( m[ 5 ] ) * extent.z;
+			e.z = fabsf( m[ 6 ] ) * extent.x + fabsf( m[ 7 ] ) * extent.y + fabsf( m[ 8 ] ) * extent.z;
+			
+			if( c.x - e.x < md5->min.x ) md5->min.x = c.x - e.x;
+			if( c.y - e.y < md5->min.y ) md5->min.y = c.y - e.y;
+			if( c.z - e.z < md5->min.z ) md5->min.z = c.z - e.z;
+
+			if( c.x + e.x > md5->max.x ) md5->max.x = c.x + e.x;
+			if( c.y + e.y > md5->max.y ) md5->max.y = c.y + e.y;
+			if( c.z + e.z > md5->max.z ) md5->max.z = c.z + e.z;
+		}
+		
+		++i;
+	}
+
+	vec3_diff( &md5->dimension,
+			   &md5->max,
+			   &md5->min );
+
+	md5->radius = vec3_dist( &md5->min,
+							 &md5->max ) * 0.5f;
+}
+
+
+/*!
+	Get the distance of an MD5 inside the frustum using the bounding sphere of its current pose. The
+	sphere is centered on the bounding box and stay valid whatever the rotation of the MD5 is. Store the
+	result inside md5->distance before calling MD5_update or MD5_draw.
+	
+	\param[in] md5 A valid MD5 structure pointer.
+	\param[in] frustum The frustum planes. \sa build_frustum
+	
+	\return Return the distance of the MD5 from the viewer, or 0 if the MD5 is outside the frustum.
+*/
+float MD5_sphere_distance_in_frustum( MD5 *md5, vec4 *frustum )
+{
+	float scale = md5->scale.x > md5->scale.y ? md5->scale.x : md5->scale.y;
+	
+	vec3 center = { ( md5->min.x + md5->max.x ) * 0.5f * md5->scale.x,
+					( md5->min.y + md5->max.y ) * 0.5f * md5->scale.y,
+					( md5->min.z + md5->max.z ) * 0.5f * md5->scale.z };
+	
+	scale = scale > md5->scale.z ? scale : md5->scale.z;
+	
+	// The MD5 rotation is unknown to the sphere, so grow the radius by the center offset.
+	return sphere_distance_in_frustum( frustum,
+									   &md5->location,
+									   vec3_length( &center ) + md5->radius * scale );
+}
+
+
+/*!
+	Write the skinned vertex data of an MD5MESH inside a STREAMBUFFER, or inside the VBO of the mesh
+	if no STREAMBUFFER is used or if the current frame region of the STREAMBUFFER is full.
+	
+	\param[in,out] md5mesh A valid MD5MESH structure pointer.
+	\param[in,out] streambuffer A valid STREAMBUFFER structure pointer or NULL.
+*/
+void MD5_upload_mesh( MD5MESH *md5mesh, STREAMBUFFER *streambuffer )
+{
+	int offset = -1;
+	
+	if( streambuffer ) offset = STREAMBUFFER_write( streambuffer, md5mesh->vertex_data, md5mesh->size );
+	
+	if( offset != -1 )
+	{
+		md5mesh->stream_vbo	   = streambuffer->vbo;
+		md5mesh->stream_offset = offset;
+		md5mesh->stream_tick   = streambuffer->tick;
+	}
+	else
+	{
+		md5mesh->stream_vbo = 0;
+		
+		glBindBuffer( GL_ARRAY_BUFFER, md5mesh->vbo );
+
+		glBufferSubData( GL_ARRAY_BUFFER,
+						 0,
+						 md5mesh->size,
+						 md5mesh->vertex_data );
+	}
+}
+
+
+/*!
+	Upload the skinned vertex data of all the MD5MESH inside an MD5 to their VBOs, or to the
+	STREAMBUFFER of the MD5 if any. This function have to be called from the thread that own the
+	OpenGLES context.
+	
+	\param[in,out] md5 A valid MD5 structure pointer.
+*/
+void MD5_upload_pose( MD5 *md5 )
+{
+	unsigned int i = 0;
+	
+	while( i != md5->n_mesh )
+	{
+		MD5_upload_mesh( &md5->md5mesh[ i ], md5->streambuffer );
+
+		++i;
+	}
+
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	
+	md5->dirty = 0;
+}
+
+
+/*!
+	Set all the MD5MESH inside an MD5 to a specific pose specified by an array of joints.
+	
+	\param[in,out] md5 A valid MD5 structure pointer.
+	\param[in] pose An array of MD5JOINT where the number of individual joints are the
+	same as the one contained in the MD5 structure.
+*/
+void MD5_set_pose( MD5 *md5, MD5JOINT *pose )
+{
+	MD5_skin_pose( md5, pose );
+	
+	MD5_upload_pose( md5 );
+}
+
+
+/*!
+	Set the callback used by MD5_update to build the final pose of an MD5 from its actions.
+	The callback receive the MD5 structure pointer and should store the result of its blending
+	operations (using MD5_blend_pose, MD5_add_pose etc.) inside the md5->pose array. The callback
+	can be called from a worker thread so it should not issue any OpenGLES call.
+	
+	\param[in,out] md5 A valid MD5 structure pointer.
+	\param[in] md5posecallback The pose callback function to use.
+*/
+void MD5_set_pose_callback( MD5 *md5, MD5POSECALLBACK *md5posecallback )
+{ md5->md5posecallback = md5posecallback; }
+
+
+/*!
+	Set the STREAMBUFFER used to stream the skinned vertex data of an MD5. Instead of updating
+	the VBO of each mesh while the GPU may still be drawing the previous frame, the vertex data
+	are written in the current frame region of the STREAMBUFFER and the meshes are drawn from
+	there. Meshes that are not skinned during a frame (see MD5LOD) are written again from their
+	last skinned vertex data when drawn. Pass NULL to go back to the VBO of each mesh.
+	
+	\param[in,out] md5 A valid MD5 structure pointer.
+	\param[in] streambuffer A valid STREAMBUFFER structure pointer or NULL.
+*/
+void MD5_set_streambuffer( MD5 *md5, STREAMBUFFER *streambuffer )
+{
+	unsigned int i = 0;
+	
+	md5->streambuffer = streambuffer;
+	
+	while( i != md5->n_mesh )
+	{
+		md5->md5mesh[ i ].stream_vbo = 0;
+		++i;
+	}
+	
+	md5->dirty = 1;
+}
+
+
+/*!
+	Blender two skeleton pose togheter and assign it to the final pose parameter.
+	
+	\param[in] md5 A valid MD5 structure pointer to have access to the number of joints the MD5 contains.
+	\param[in,out] final_pose The final pose MD5JOINT array that will store the result of the blending operation between pose0 and pose1.
+	\param[in] pose0 The first pose to use for the blending operation.
+	\param[in] pose1 The second pose to use for the blending operation.
+	\param[in] joint_interpolation_method The method to use to interpolate the rotation, for location lerp will always be used.
+	\param[in] blend The blending factor (a value between 0 and 1).
+*/
+void MD5_blend_pose( MD5 *md5, MD5JOINT *final_pose, MD5JOINT *pose0, MD5JOINT *pose1, unsigned char joint_interpolation_method, float blend )
+{
+	unsigned int i = 0;
+
+	while( i != md5->n_joint )
+	{
+		vec3_lerp( &final_pose[ i ].location,
+				   &pose0[ i ].location,
+				   &pose1[ i ].location,
+				   blend );
+	
+		switch( joint_interpolation_method )
+		{
+			case MD5_METHOD_FRAME:
+			case MD5_METHOD_LERP:
+			{
+				vec4_lerp( &final_pose[ i ].rotation, 
+						   &pose0[ i ].rotation,
+						   &pose1[ i ].rotation,
+						   blend );
+				break;
+			}
+		
+		
+			case MD5_METHOD_SLERP:
+			{
+				vec4_slerp( &final_pose[ i ].rotation, 
+							&pose0[ i ].rotation,
+							&pose1[ i ].rotation,
+							blend );
+
+				break;
+			}
+		}
+
+
+		++i;
+	}
+}
+
+
+/*!
+	Add two action together. Please take note that the additive blending of each bone is evaluated on if the
+	current action1 frame is different than the next frame (or for a cooked action, if the bone tracks are not
+	constant). If yes it means that the action1 is taking over the control of the bone and will be blended by
+	the action weight factor.
+	
+	\param[in] md5 A valid MD5 structure pointer to gain access to the maximum number of MD5JOINTS each actions contains.
+	\param[in,out] final_pose Array of MD5JOINTs to use as the destination. The resulting skeleton of the operation executed in this function will use this array as destination.
+	\param[in] action0 A valid MD5ACTION pointer that will be use as the base action to use.
+	\param[in] action1 A valid MD5ACTION pointer that will be use as the second action that will additively be blended to action0.
+	\param[in] joint_interpolation_method The method to use to interpolate the action weight between action0 and action1.
+	\param[in] action_weight The weight factor of the action1 if the bone is animated. This value will have impact on the blending between action0 and action1.
+*/
+void MD5_add_pose( MD5 *md5, MD5JOINT *final_pose, MD5ACTION *action0, MD5ACTION *action1, unsigned char joint_interpolation_method, float action_weight )
+{
+	unsigned int i = 0;
+	
+	while( i != md5->n_joint )
+	{
+		unsigned char animated;
+		
+		if( action1->md5track )
+		{
+			animated = action1->md5track[ i << 1 ].n_key > 1 ||
+					   action1->md5track[ ( i << 1 ) + 1 ].n_key > 1;
+		}
+		else
+		{
+			animated = memcmp( &action1->frame[ action1->curr_frame ][ i ].location, &action1->frame[ action1->next_frame ][ i ].location, sizeof( vec3 ) ) ||
+					   memcmp( &action1->frame[ action1->curr_frame ][ i ].rotation, &action1->frame[ action1->next_frame ][ i ].rotation, sizeof( vec4 ) );
+		}
+		
+		if( animated )
+		{
+			vec3_lerp( &final_pose[ i ].location,
+					   &action0->pose[ i ].location,
+					   &action1->pose[ i ].location,
+					   action_weight );
+			
+			switch( joint_interpolation_method )
+			{
+				case MD5_METHOD_FRAME:
+				case MD5_METHOD_LERP:
+				{
+					vec4_lerp( &final_pose[ i ].rotation, 
+							   &action0->pose[ i ].rotation,
+							   &action1->pose[ i ].rotation,
+							   action_weight );
+					break;
+				}
+			
+			
+				case MD5_METHOD_SLERP:
+				{
+					vec4_slerp( &final_pose[ i ].rotation, 
+								&action0->pose[ i ].rotation,
+								&action1->pose[ i ].rotation,
+								action_weight );
+					break;
+				}
+			}
+		}
+		else
+		{
+			memcpy( &final_pose[ i ].location, &action0->pose[ i ].location, sizeof( vec3 ) );
+			memcpy( &final_pose[ i ].rotation, &action0->pose[ i ].rotation, sizeof( vec4 ) );
+		}
+
+		++i;
+	}
+}
+
+
+/*!
+	Build the VBO and VAO for a specific MD5.
+	
+	\param[in,out] md5 A valid MD5 structure pointer.
+*/
+void MD5_build( MD5 *md5 )
+{
+	unsigned int i = 0;
+	
+	while( i != md5->n_mesh )
+	{
+		MD5MESH *md5mesh = &md5->md5mesh[ i ];
+	
+		MD5_build_vbo( md5, i );
+		
+		glGenVertexArraysOES( 1, &md5mesh->vao );
+		
+		glBindVertexArrayOES( md5mesh->vao );	
+		
+		MD5_set_mesh_attributes( md5mesh );
+
+		glBindVertexArrayOES( 0 );
+
+		++i;
+	}
+
+	if( !md5->resource )
+	{
+		MD5_set_pose( md5, md5->bind_pose );
+
+		MD5_build_bind_pose_weighted_normals_tangents( md5 );
+	}
+
+	MD5_set_pose( md5, md5->bind_pose );
+}
+
+
+/*!
+	Only build the VBO for a specific MD5 pointer.
+	
+	\param[in,out] md5 A valid MD5 structure pointer.	
+*/
+void MD5_build2( MD5 *md5 )
+{
+	unsigned int i = 0;
+	
+	while( i != md5->n_mesh )
+	{
+		MD5_build_vbo( md5, i );
+
+		++i;
+	}
+
+	if( !md5->resource )
+	{
+		MD5_set_pose( md5, md5->bind_pose );
+
+		MD5_build_bind_pose_weighted_normals_tangents( md5 );
+	}
+
+	MD5_set_pose( md5, md5->bind_pose );
+}
+
+
+/*!
+	Update all actions time. This function will cause to refresh and update all the
+	current MD5ACTIONS that are set to PLAY by the time_step received in parameter.
+	
+	\param[in,out] md5 A valid MD5 structure pointer.
+	\param[in] time_step The delta time of the application. In other words a value from 0 to 1 (which is 1 second)
+	that represent how much time have elapsed since the last sync. 
+*/
+unsigned char MD5_draw_action( MD5 *md5, float time_step )
+{
+	unsigned int i = 0;
+	
+	unsigned char update = 0;
+	
+	while( i != md5->n_action )
+	{
+		MD5ACTION *md5action = &md5->md5action[ i ];
+	
+		if( md5action->state == PLAY )
+		{
+			md5action->frame_time += time_step;
+			
+			switch( md5action->method )
+			{
+				case MD5_METHOD_FRAME:
+				{
+					if( md5action->frame_time >= md5action->fps )
+					{
+						MD5_evaluate_action( md5, md5action, MD5_METHOD_FRAME );
+						
+						++md5action->curr_frame;
+
+						if( md5action->curr_frame == md5action->n_frame )
+						{
+							if( md5action->loop ) md5action->curr_frame = 0;
+							else
+							{
+								MD5_action_stop( md5action );
+								break;
+							}
+						}
+						
+						md5action->next_frame = md5action->curr_frame + 1;
+						
+						if( md5action->next_frame == md5action->n_frame )
+						{ md5action->next_frame = 0; }
+						
+						md5action->frame_time -= md5action->fps;
+						
+						update = 1;
+					}
+					
+					break;
+				}
+			
+				case MD5_METHOD_LERP:
+				case MD5_METHOD_SLERP:					
+				{
+					float t = CLAMP( md5action->frame_time / md5action->fps, 0.0f, 1.0f );
+
+					MD5_sample_action( md5,
+									   md5action,
+									   md5action->pose,
+									   md5action->method,
+									   t );
+
+					if( t >= 1.0f )
+					{
+						++md5action->curr_frame;
+
+						md5action->next_frame = ( md5action->curr_frame + 1 );
+						
+						if( md5action->loop )
+						{
+							if( md5action->curr_frame == md5action->n_frame )
+							{
+								md5action->curr_frame = 0;
+								md5action->next_frame = 1;
+							}								
+
+							if( md5action->next_frame == md5action->n_frame )
+							{ md5action->next_frame = 0; }				
+						}
+						else
+						{
+							if( md5action->next_frame == md5action->n_frame )
+							{
+								MD5_action_stop( md5action );
+								break;
+							}
+						}
+						
+						md5action->frame_time -= md5action->fps;
+					}
+					
+					update = 1;
+
+					break;
+				}
+			}
+		}
+	
+		++i;
+	}
+	
+	return update;
+}
+
+
+/*!
+	Advance the time of all the actions that are set to PLAY without evaluating their pose.
+	Contrarily to MD5_draw_action, the frame indices of an action can move by more than one
+	frame per call so large time steps are handled properly.
+	
+	\param[in,out] md5 A valid MD5 structure pointer.
+	\param[in] time_step The delta time of the application. \sa MD5_draw_action
+	
+	\return Return 1 if at least one action is playing, else 0.
+*/
+unsigned char MD5_advance_action( MD5 *md5, float time_step )
+{
+	unsigned int i = 0;
+	
+	unsigned char update = 0;
+	
+	while( i != md5->n_action )
+	{
+		MD5ACTION *md5action = &md5->md5action[ i ];
+	
+		if( md5action->state == PLAY && md5action->fps > 0.0f )
+		{
+			update = 1;
+		
+			md5action->frame_time += time_step;
+			
+			while( md5action->frame_time >= md5action->fps )
+			{
+				md5action->frame_time -= md5action->fps;
+				
+				++md5action->curr_frame;
+				
+				if( md5action->curr_frame == ( int )md5action->n_frame )
+				{
+					if( md5action->loop ) md5action->curr_frame = 0;
+					else
+					{
+						MD5_action_stop( md5action );
+						break;
+					}
+				}
+				
+				md5action->next_frame = md5action->curr_frame + 1;
+				
+				if( md5action->next_frame == ( int )md5action->n_frame )
+				{
+					if( md5action->loop || md5action->method == MD5_METHOD_FRAME ) md5action->next_frame = 0;
+					else
+					{
+						MD5_action_stop( md5action );
+						break;
+					}
+				}
+			}
+		}
+		
+		++i;
+	}
+	
+	return update;
+}
+
+
+/*!
+	Evaluate the pose of an action at its current frame time.
+	
+	\param[in] md5 A valid MD5 structure pointer.
+	\param[in,out] md5action A valid MD5ACTION structure pointer of the MD5.
+	\param[in] joint_interpolation_method The method to use, MD5_METHOD_FRAME copy the current frame
+	while MD5_METHOD_LERP and MD5_METHOD_SLERP interpolate between the current and the next frame.
+*/
+void MD5_evaluate_action( MD5 *md5, MD5ACTION *md5action, unsigned char joint_interpolation_method )
+{
+	if( joint_interpolation_method == MD5_METHOD_FRAME )
+	{
+		if( md5action->md5track ) MD5_sample_action( md5, md5action, md5action->pose, MD5_METHOD_FRAME, 0.0f );
+
+		else memcpy( md5action->pose,
+					 md5action->frame[ md5action->curr_frame ],
+					 md5->n_joint * sizeof( MD5JOINT ) );
+	}
+	else
+	{
+		MD5_sample_action( md5,
+						   md5action,
+						   md5action->pose,
+						   joint_interpolation_method,
+						   CLAMP( md5action->frame_time / md5action->fps, 0.0f, 1.0f ) );
+	}
+}
+
+
+/*!
+	Set the animation level of detail policy of an MD5. Based on md5->distance the pose of the MD5
+	will be evaluated and skinned at full rate, or only every 2, 4 or 8 calls to MD5_update. When the
+	MD5 is invisible or off-screen (a distance of 0) the time of its actions keep advancing but no
+	pose is evaluated or skinned.
+	
+	\param[in,out] md5 A valid MD5 structure pointer.
+	\param[in] distance_2 The distance starting from which the pose is updated at 1/2 rate (0 to disable).
+	\param[in] distance_4 The distance starting from which the pose is updated at 1/4 rate (0 to disable).
+	\param[in] distance_8 The distance starting from which the pose is updated at 1/8 rate (0 to disable).
+	\param[in] method Either MD5_LOD_INTERPOLATE or MD5_LOD_HOLD to determine how the actions pose are
+	evaluated on reduced rates.
+*/
+void MD5_set_lod( MD5 *md5, float distance_2, float distance_4, float distance_8, unsigned char method )
+{
+	md5->md5lod.distance[ 0 ] = distance_2;
+	md5->md5lod.distance[ 1 ] = distance_4;
+	md5->md5lod.distance[ 2 ] = distance_8;
+	md5->md5lod.method		  = method;
+}
+
+
+/*!
+	Create a new node of a blend graph. This function is used internally by the MD5_node_* functions.
+	
+	\param[in] md5 A valid MD5 structure pointer.
+	\param[in] name The internal name of the node.
+	\param[in] type The type of node.
+	
+	\return Return a new MD5NODE structure pointer that require all the joints of the MD5.
+*/
+MD5NODE *MD5_node_init( MD5 *md5, char *name, unsigned char type )
+{
+	unsigned int i = 0;
+	
+	MD5NODE *md5node = ( MD5NODE * ) calloc( 1, sizeof( MD5NODE ) );
+	
+	strcpy( md5node->name, name );
+	
+	md5node->type	   = type;
+	md5node->reference = md5->bind_pose;
+	md5node->n_joint   = md5->n_joint;
+	
+	md5node->pose = ( MD5JOINT * ) malloc( md5->n_joint * sizeof( MD5JOINT ) );
+	
+	memcpy( md5node->pose, md5->bind_pose, md5->n_joint * sizeof( MD5JOINT ) );
+	
+	md5node->required = ( unsigned char * ) malloc( md5->n_joint );
+	
+	memset( md5node->required, 1, md5->n_joint );
+	
+	md5node->joint = ( unsigned int * ) malloc( md5->n_joint * sizeof( unsigned int ) );
+	
+	while( i != md5->n_joint )
+	{
+		md5node->joint[ i ] = i;
+		++i;
+	}
+	
+	return md5node;
+}
 
-				vec3_rotate_vec4( &tangent,
-								  &md5weight->tangent,
-								  &md5joint->rotation );
-								  
-				vertex_array[ j ].x += ( md5joint->location.x + location.x ) * md5weight->bias;
-				vertex_array[ j ].y += ( md5joint->location.y + location.y ) * md5weight->bias;
-				vertex_array[ j ].z += ( md5joint->location.z + location.z ) * md5weight->bias;
 
-				normal_array[ j ].x += normal.x * md5weight->bias;
-				normal_array[ j ].y += normal.y * md5weight->bias;
-				normal_array[ j ].z += normal.z * md5weight->bias;
+/*!
+	Create a clip node, the leaf of a blend graph that sample the pose of an action. The
+	action time is still driven by MD5_draw_action or MD5_update, but the pose is only
+	sampled when the frames of the action changed since the last evaluation.
+	
+	\param[in] md5 A valid MD5 structure pointer.
+	\param[in] name The internal name of the node.
+	\param[in] md5action A valid MD5ACTION of the MD5.
+	\param[in] joint_interpolation_method The method to use to interpolate between the frames of the action.
+	
+	\return Return a new MD5NODE structure pointer.
+*/
+MD5NODE *MD5_node_clip( MD5 *md5, char *name, MD5ACTION *md5action, unsigned char joint_interpolation_method )
+{
+	MD5NODE *md5node = MD5_node_init( md5, name, MD5_NODE_CLIP );
+	
+	md5node->md5action = md5action;
+	md5node->method	   = joint_interpolation_method;
+	
+	return md5node;
+}
 
-				tangent_array[ j ].x += tangent.x * md5weight->bias;
-				tangent_array[ j ].y += tangent.y * md5weight->bias;
-				tangent_array[ j ].z += tangent.z * md5weight->bias;
-								
-				++k;
-			}
 
-			uv_array[ j ].x = md5vertex->uv.x;
-			uv_array[ j ].y = md5vertex->uv.y;
-			
-			++j;
+/*!
+	Create a node that blend two nodes together like MD5_blend_pose. When the weight is 0 or 1
+	only one of the input nodes is evaluated.
+	
+	\param[in] md5 A valid MD5 structure pointer.
+	\param[in] name The internal name of the node.
+	\param[in] node0 The first input node.
+	\param[in] node1 The second input node.
+	\param[in] joint_interpolation_method The method to use to interpolate the rotations.
+	\param[in] weight The blend weight of node1 (a value between 0 and 1).
+	
+	\return Return a new MD5NODE structure pointer.
+*/
+MD5NODE *MD5_node_lerp( MD5 *md5, char *name, MD5NODE *node0, MD5NODE *node1, unsigned char joint_interpolation_method, float weight )
+{
+	MD5NODE *md5node = MD5_node_init( md5, name, MD5_NODE_LERP );
+	
+	md5node->input[ 0 ] = node0;
+	md5node->input[ 1 ] = node1;
+	md5node->method		= joint_interpolation_method;
+	md5node->weight		= weight;
+	
+	return md5node;
+}
+
+
+/*!
+	Create an additive node. The difference between node1 and the reference pose is scaled by
+	the weight and added on top of node0. Since the MD5 joints are stored in model space, the
+	additive poses should be authored from the same reference pose (by default the bind pose).
+	
+	\param[in] md5 A valid MD5 structure pointer.
+	\param[in] name The internal name of the node.
+	\param[in] node0 The base node.
+	\param[in] node1 The additive node.
+	\param[in] reference The reference pose of node1, if NULL the bind pose is used.
+	\param[in] weight The weight of the additive node (a value between 0 and 1).
+	
+	\return Return a new MD5NODE structure pointer.
+*/
+MD5NODE *MD5_node_add( MD5 *md5, char *name, MD5NODE *node0, MD5NODE *node1, MD5JOINT *reference, float weight )
+{
+	MD5NODE *md5node = MD5_node_init( md5, name, MD5_NODE_ADD );
+	
+	md5node->input[ 0 ] = node0;
+	md5node->input[ 1 ] = node1;
+	md5node->method		= MD5_METHOD_SLERP;
+	md5node->weight		= weight;
+	
+	if( reference ) md5node->reference = reference;
+	
+	return md5node;
+}
+
+
+/*!
+	Create a layer node. The joints flagged in the node mask are blended from node0 to node1 using
+	the weight, the others are taken from node0. Only the masked joints of node1 are evaluated, so
+	for example an upper body layer doesn't sample the legs of its action. Use MD5_node_set_mask_branch
+	to build the mask.
+	
+	\param[in] md5 A valid MD5 structure pointer.
+	\param[in] name The internal name of the node.
+	\param[in] node0 The base node.
+	\param[in] node1 The layer node.
+	\param[in] joint_interpolation_method The method to use to interpolate the rotations.
+	\param[in] weight The weight of the layer (a value between 0 and 1).
+	
+	\return Return a new MD5NODE structure pointer.
+*/
+MD5NODE *MD5_node_layer( MD5 *md5, char *name, MD5NODE *node0, MD5NODE *node1, unsigned char joint_interpolation_method, float weight )
+{
+	MD5NODE *md5node = MD5_node_init( md5, name, MD5_NODE_LAYER );
+	
+	md5node->input[ 0 ] = node0;
+	md5node->input[ 1 ] = node1;
+	md5node->method		= joint_interpolation_method;
+	md5node->weight		= weight;
+	
+	md5node->mask = ( unsigned char * ) calloc( 1, md5->n_joint );
+	
+	return md5node;
+}
+
+
+/*!
+	Free a node of a blend graph. The input nodes are not freed.
+	
+	\param[in,out] md5node A valid MD5NODE structure pointer.
+	
+	\return Return a NULL MD5NODE structure pointer.
+*/
+MD5NODE *MD5_node_free( MD5NODE *md5node )
+{
+	if( md5node->mask ) free( md5node->mask );
+	
+	free( md5node->required );
+	
+	free( md5node->joint );
+	
+	free( md5node->pose );
+	
+	free( md5node );
+	return NULL;
+}
+
+
+/*!
+	Set the mask value of a joint and all its children for a layer node. Call MD5_node_prepare
+	(or MD5_set_node) on the root of the graph after changing the mask.
+	
+	\param[in] md5 A valid MD5 structure pointer.
+	\param[in,out] md5node A valid layer MD5NODE structure pointer.
+	\param[in] joint_name The name of the first joint of the branch (for example the spine for an upper body layer).
+	\param[in] value The mask value, 1 to blend the joints or 0 to take them from the base node.
+	
+	\return Return 1 if the joint exists, else 0.
+*/
+unsigned char MD5_node_set_mask_branch( MD5 *md5, MD5NODE *md5node, char *joint_name, unsigned char value )
+{
+	unsigned int i = 0;
+	
+	int joint = -1;
+	
+	if( !md5node->mask ) return 0;
+	
+	while( i != md5->n_joint )
+	{
+		if( !strcmp( md5->bind_pose[ i ].name, joint_name ) )
+		{
+			joint = i;
+			break;
 		}
 		
+		++i;
+	}
+	
+	if( joint == -1 ) return 0;
+	
+	i = 0;
+	while( i != md5->n_joint )
+	{
+		int parent = i;
+		
+		while( parent != -1 && parent != joint ) parent = md5->bind_pose[ parent ].parent;
+		
+		if( parent == joint ) md5node->mask[ i ] = value;
 		
-		glBindBuffer( GL_ARRAY_BUFFER, md5mesh->vbo );
-
-		glBufferSubData( GL_ARRAY_BUFFER,
-						 0,
-						 md5mesh->size,
-						 md5mesh->vertex_data );
-
 		++i;
 	}
+	
+	md5node->valid = 0;
+	
+	return 1;
+}
 
-	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+/*!
+	Reset the required joints of a node and its inputs. This function is used internally by MD5_node_prepare.
+	
+	\param[in] md5 A valid MD5 structure pointer.
+	\param[in,out] md5node A valid MD5NODE structure pointer.
+*/
+void MD5_node_reset( MD5 *md5, MD5NODE *md5node )
+{
+	memset( md5node->required, 0, md5->n_joint );
+	
+	md5node->valid = 0;
+	
+	if( md5node->input[ 0 ] ) MD5_node_reset( md5, md5node->input[ 0 ] );
+	
+	if( md5node->input[ 1 ] ) MD5_node_reset( md5, md5node->input[ 1 ] );
 }
 
 
 /*!
-	Blender two skeleton pose togheter and assign it to the final pose parameter.
+	Flag the joints required from a node and propagate them to its inputs. This function is used
+	internally by MD5_node_prepare.
 	
-	\param[in] md5 A valid MD5 structure pointer to have access to the number of joints the MD5 contains.
-	\param[in,out] final_pose The final pose MD5JOINT array that will store the result of the blending operation between pose0 and pose1.
-	\param[in] pose0 The first pose to use for the blending operation.
-	\param[in] pose1 The second pose to use for the blending operation.
-	\param[in] joint_interpolation_method The method to use to interpolate the rotation, for location lerp will always be used.
-	\param[in] blend The blending factor (a value between 0 and 1).
+	\param[in] md5 A valid MD5 structure pointer.
+	\param[in,out] md5node A valid MD5NODE structure pointer.
+	\param[in] required Array of n_joint flags of the joints required from the node.
 */
-void MD5_blend_pose( MD5 *md5, MD5JOINT *final_pose, MD5JOINT *pose0, MD5JOINT *pose1, unsigned char joint_interpolation_method, float blend )
+void MD5_node_require( MD5 *md5, MD5NODE *md5node, unsigned char *required )
 {
 	unsigned int i = 0;
-
+	
 	while( i != md5->n_joint )
 	{
-		vec3_lerp( &final_pose[ i ].location,
-				   &pose0[ i ].location,
-				   &pose1[ i ].location,
-				   blend );
+		md5node->required[ i ] |= required[ i ];
+		++i;
+	}
 	
-		switch( joint_interpolation_method )
+	if( md5node->input[ 0 ] ) MD5_node_require( md5, md5node->input[ 0 ], required );
+	
+	if( md5node->input[ 1 ] )
+	{
+		if( md5node->type == MD5_NODE_LAYER )
 		{
-			case MD5_METHOD_FRAME:
-			case MD5_METHOD_LERP:
-			{
-				vec4_lerp( &final_pose[ i ].rotation, 
-						   &pose0[ i ].rotation,
-						   &pose1[ i ].rotation,
-						   blend );
-				break;
-			}
-		
-		
-			case MD5_METHOD_SLERP:
+			unsigned char *mask = ( unsigned char * ) malloc( md5->n_joint );
+			
+			i = 0;
+			while( i != md5->n_joint )
 			{
-				vec4_slerp( &final_pose[ i ].rotation, 
-							&pose0[ i ].rotation,
-							&pose1[ i ].rotation,
-							blend );
-
-				break;
+				mask[ i ] = required[ i ] && md5node->mask[ i ];
+				++i;
 			}
+			
+			MD5_node_require( md5, md5node->input[ 1 ], mask );
+			
+			free( mask );
 		}
+		else MD5_node_require( md5, md5node->input[ 1 ], required );
+	}
+}
 
 
+/*!
+	Build the list of joints to evaluate for a node and its inputs. This function is used
+	internally by MD5_node_prepare.
+	
+	\param[in] md5 A valid MD5 structure pointer.
+	\param[in,out] md5node A valid MD5NODE structure pointer.
+*/
+void MD5_node_build_joint( MD5 *md5, MD5NODE *md5node )
+{
+	unsigned int i = 0;
+	
+	md5node->n_joint = 0;
+	
+	while( i != md5->n_joint )
+	{
+		if( md5node->required[ i ] )
+		{
+			md5node->joint[ md5node->n_joint ] = i;
+			++md5node->n_joint;
+		}
+		
 		++i;
 	}
+	
+	if( md5node->input[ 0 ] ) MD5_node_build_joint( md5, md5node->input[ 0 ] );
+	
+	if( md5node->input[ 1 ] ) MD5_node_build_joint( md5, md5node->input[ 1 ] );
 }
 
 
 /*!
-	Add two action together. Please take note that the additive blending of each bone is evaluated on if the
-	current action1 frame is different than the next frame. If yes it means that the action1 is taking over
-	the control of the bone and will be blended by the action weight factor.
+	Determine which joints each node of a blend graph have to evaluate, starting from its root node
+	which require all the joints. Call this function every time the graph or a layer mask change.
 	
-	\param[in] md5 A valid MD5 structure pointer to gain access to the maximum number of MD5JOINTS each actions contains.
-	\param[in,out] final_pose Array of MD5JOINTs to use as the destination. The resulting skeleton of the operation executed in this function will use this array as destination.
-	\param[in] action0 A valid MD5ACTION pointer that will be use as the base action to use.
-	\param[in] action1 A valid MD5ACTION pointer that will be use as the second action that will additively be blended to action0.
-	\param[in] joint_interpolation_method The method to use to interpolate the action weight between action0 and action1.
-	\param[in] action_weight The weight factor of the action1 if the bone is animated. This value will have impact on the blending between action0 and action1.
+	\param[in] md5 A valid MD5 structure pointer.
+	\param[in,out] md5node The root MD5NODE of the graph.
 */
-void MD5_add_pose( MD5 *md5, MD5JOINT *final_pose, MD5ACTION *action0, MD5ACTION *action1, unsigned char joint_interpolation_method, float action_weight )
+void MD5_node_prepare( MD5 *md5, MD5NODE *md5node )
 {
-	unsigned int i = 0;
+	unsigned char *required = ( unsigned char * ) malloc( md5->n_joint );
 	
-	while( i != md5->n_joint )
+	memset( required, 1, md5->n_joint );
+	
+	MD5_node_reset( md5, md5node );
+	
+	MD5_node_require( md5, md5node, required );
+	
+	MD5_node_build_joint( md5, md5node );
+	
+	free( required );
+}
+
+
+/*!
+	Evaluate a node of a blend graph and return its output pose. The output of each node is
+	cached and only evaluated again if its inputs (versions of the input nodes, weight, action
+	and sampled time of a clip) changed, so a graph which output doesn't change cost almost
+	nothing. The time of a clip is quantized to MD5_NODE_BLEND_STEP steps per frame, so a clip
+	is only sampled again once its time moved by a step. Only
+	the joints required by the graph are evaluated. \sa MD5_node_prepare
+	
+	\param[in] md5 A valid MD5 structure pointer.
+	\param[in,out] md5node A valid MD5NODE structure pointer.
+	
+	\return Return the output pose of the node. Only the joints required by the graph are valid.
+*/
+MD5JOINT *MD5_node_evaluate( MD5 *md5, MD5NODE *md5node )
+{
+	unsigned int i = 0,
+				 j;
+	
+	if( md5node->type == MD5_NODE_CLIP )
 	{
-		if( memcmp( &action1->frame[ action1->curr_frame ][ i ].location, &action1->frame[ action1->next_frame ][ i ].location, sizeof( vec3 ) ) ||
-			memcmp( &action1->frame[ action1->curr_frame ][ i ].rotation, &action1->frame[ action1->next_frame ][ i ].rotation, sizeof( vec4 ) ) )
+		MD5ACTION *md5action = md5node->md5action;
+
+		unsigned char method = md5->md5lod.rate > 1 && md5->md5lod.method == MD5_LOD_HOLD ?
+							   ( unsigned char )MD5_METHOD_FRAME :
+							   md5node->method;
+
+		// The time is quantized, so the clip is only sampled again once it moved by a step.
+		unsigned int step = method == MD5_METHOD_FRAME ?
+							0 :
+							( unsigned int )( CLAMP( md5action->frame_time / md5action->fps, 0.0f, 1.0f ) * MD5_NODE_BLEND_STEP + 0.5f );
+		
+		float blend = ( float )step / ( float )MD5_NODE_BLEND_STEP;
+		
+		if( md5node->valid &&
+			md5node->cached_action	   == md5action &&
+			md5node->cached_method	   == method &&
+			md5node->cached_frame[ 0 ] == md5action->curr_frame &&
+			md5node->cached_frame[ 1 ] == md5action->next_frame &&
+			md5node->cached_step	   == step ) return md5node->pose;
+		
+		while( i != md5node->n_joint )
 		{
-			vec3_lerp( &final_pose[ i ].location,
-					   &action0->pose[ i ].location,
-					   &action1->pose[ i ].location,
-					   action_weight );
+			j = md5node->joint[ i ];
 			
-			switch( joint_interpolation_method )
-			{
-				case MD5_METHOD_FRAME:
-				case MD5_METHOD_LERP:
-				{
-					vec4_lerp( &final_pose[ i ].rotation, 
-							   &action0->pose[ i ].rotation,
-							   &action1->pose[ i ].rotation,
-							   action_weight );
-					break;
-				}
+			if( !blend && !md5action->md5track )
+			{ memcpy( &md5node->pose[ j ], &md5action->frame[ md5action->curr_frame ][ j ], sizeof( MD5JOINT ) ); }
 			
+			else MD5_sample_joint( md5action, j, &md5node->pose[ j ], method, blend );
 			
-				case MD5_METHOD_SLERP:
-				{
-					vec4_slerp( &final_pose[ i ].rotation, 
-								&action0->pose[ i ].rotation,
-								&action1->pose[ i ].rotation,
-								action_weight );
-					break;
-				}
+			++i;
+		}
+		
+		md5node->cached_action	   = md5action;
+		md5node->cached_method	   = method;
+		md5node->cached_frame[ 0 ] = md5action->curr_frame;
+		md5node->cached_frame[ 1 ] = md5action->next_frame;
+		md5node->cached_step	   = step;
+	}
+	else
+	{
+		float weight = md5node->weight;
+		
+		unsigned char need0 = md5node->type != MD5_NODE_LERP || weight != 1.0f,
+					  need1 = weight != 0.0f;
+		
+		MD5JOINT *pose0 = need0 ? MD5_node_evaluate( md5, md5node->input[ 0 ] ) : NULL,
+				 *pose1 = need1 ? MD5_node_evaluate( md5, md5node->input[ 1 ] ) : NULL;
+		
+		if( md5node->valid &&
+			md5node->cached_weight == weight &&
+			( !need0 || md5node->input_version[ 0 ] == md5node->input[ 0 ]->version ) &&
+			( !need1 || md5node->input_version[ 1 ] == md5node->input[ 1 ]->version ) ) return md5node->pose;
+		
+		while( i != md5node->n_joint )
+		{
+			MD5JOINT *md5joint;
+			
+			j = md5node->joint[ i ];
+			
+			md5joint = &md5node->pose[ j ];
+			
+			if( !need1 || ( md5node->type == MD5_NODE_LAYER && !md5node->mask[ j ] ) )
+			{
+				memcpy( &md5joint->location, &pose0[ j ].location, sizeof( vec3 ) );
+				memcpy( &md5joint->rotation, &pose0[ j ].rotation, sizeof( vec4 ) );
 			}
+			else if( !need0 )
+			{
+				memcpy( &md5joint->location, &pose1[ j ].location, sizeof( vec3 ) );
+				memcpy( &md5joint->rotation, &pose1[ j ].rotation, sizeof( vec4 ) );
+			}
+			else if( md5node->type == MD5_NODE_ADD )
+			{
+				MD5JOINT *reference = &md5node->reference[ j ];
+				
+				vec4 identity = { 0.0f, 0.0f, 0.0f, 1.0f },
+					 conjugate,
+					 delta,
+					 rotation;
+				
+				vec4_conjugate( &conjugate, &reference->rotation );
+				
+				vec4_multiply_vec4( &delta, &pose1[ j ].rotation, &conjugate );
+				
+				vec4_slerp( &rotation, &identity, &delta, weight );
+				
+				vec4_multiply_vec4( &md5joint->rotation, &rotation, &pose0[ j ].rotation );
+				
+				md5joint->location.x = pose0[ j ].location.x + ( pose1[ j ].location.x - reference->location.x ) * weight;
+				md5joint->location.y = pose0[ j ].location.y + ( pose1[ j ].location.y - reference->location.y ) * weight;
+				md5joint->location.z = pose0[ j ].location.z + ( pose1[ j ].location.z - reference->location.z ) * weight;
+			}
+			else
+			{
+				vec3_lerp( &md5joint->location,
+						   &pose0[ j ].location,
+						   &pose1[ j ].location,
+						   weight );
+				
+				if( md5node->method == MD5_METHOD_SLERP ) vec4_slerp( &md5joint->rotation, &pose0[ j ].rotation, &pose1[ j ].rotation, weight );
+				
+				else vec4_lerp( &md5joint->rotation, &pose0[ j ].rotation, &pose1[ j ].rotation, weight );
+			}
+			
+			++i;
 		}
-		else
-		{
-			memcpy( &final_pose[ i ].location, &action0->pose[ i ].location, sizeof( vec3 ) );
-			memcpy( &final_pose[ i ].rotation, &action0->pose[ i ].rotation, sizeof( vec4 ) );
-		}
-
-		++i;
+		
+		if( need0 ) md5node->input_version[ 0 ] = md5node->input[ 0 ]->version;
+		
+		if( need1 ) md5node->input_version[ 1 ] = md5node->input[ 1 ]->version;
+		
+		md5node->cached_weight = weight;
 	}
+	
+	md5node->valid = 1;
+	
+	++md5node->version;
+	
+	return md5node->pose;
 }
 
 
 /*!
-	Calculate the min and max position of the MD5 mesh in bind position, as well as the bounding
-	box and bounding sphere.
+	Set the blend graph used by MD5_update to build the final pose of an MD5. The graph is
+	prepared (see MD5_node_prepare) and the MD5 will only be skinned when the output of the
+	graph changes. Pass NULL to go back to the default behavior.
 	
-	\param[in] md5 A valid MD5 structure pointer that the vertex data is available.
+	\param[in,out] md5 A valid MD5 structure pointer.
+	\param[in] md5node The root MD5NODE of the graph or NULL.
 */
-void MD5_update_bound_mesh( MD5 *md5 )
+void MD5_set_node( MD5 *md5, MD5NODE *md5node )
 {
-	unsigned int i = 0,
-				 j;
-
-
-	// Get the mesh min and max.
-	md5->min.x =
-	md5->min.y =
-	md5->min.z = 99999.999f;
-
-	md5->max.x =
-	md5->max.y =
-	md5->max.z = -99999.999f;
+	md5->md5node	  = md5node;
+	md5->node_version = 0;
+	
+	if( md5node ) MD5_node_prepare( md5, md5node );
+}
 
 
-	while( i != md5->n_mesh )
+/*!
+	Build the final pose of an MD5 from its pose callback, else from its blend graph, else
+	from its first playing action. This function is used internally.
+	
+	\param[in,out] md5 A valid MD5 structure pointer.
+	\param[in] hold Determine if the playing actions should be sampled on the closest frame
+	(MD5_METHOD_FRAME) instead of using their own interpolation method.
+	
+	\return Return 0 if the output of the blend graph didn't change since the MD5 was last
+	skinned (the pose is then left untouched), else 1.
+*/
+unsigned char MD5_build_pose( MD5 *md5, unsigned char hold )
+{
+	unsigned int i = 0;
+	
+	// The clip nodes of a blend graph sample their actions themselves, only when needed.
+	if( md5->md5node && !md5->md5posecallback )
 	{
-		MD5MESH *md5mesh = &md5->md5mesh[ i ];
+		MD5_node_evaluate( md5, md5->md5node );
 		
-		vec3 *vertex_array = ( vec3 * )md5mesh->vertex_data;
+		if( md5->pose && md5->node_version == md5->md5node->version ) return 0;
 		
-		j = 0;
-		while( j != md5mesh->n_vertex )
-		{
-			if( vertex_array[ j ].x < md5->min.x ) md5->min.x = vertex_array[ j ].x;
-			if( vertex_array[ j ].y < md5->min.y ) md5->min.y = vertex_array[ j ].y;
-			if( vertex_array[ j ].z < md5->min.z ) md5->min.z = vertex_array[ j ].z;
-
-			if( vertex_array[ j ].x > md5->max.x ) md5->max.x = vertex_array[ j ].x;
-			if( vertex_array[ j ].y > md5->max.y ) md5->max.y = vertex_array[ j ].y;
-			if( vertex_array[ j ].z > md5->max.z ) md5->max.z = vertex_array[ j ].z;
+		if( !md5->pose ) md5->pose = ( MD5JOINT * ) malloc( md5->n_joint * sizeof( MD5JOINT ) );
+		
+		memcpy( md5->pose, md5->md5node->pose, md5->n_joint * sizeof( MD5JOINT ) );
+		
+		return 1;
+	}
 	
-			++j;
+	
+	while( i != md5->n_action )
+	{
+		MD5ACTION *md5action = &md5->md5action[ i ];
+		
+		if( md5action->state == PLAY )
+		{
+			MD5_evaluate_action( md5,
+								 md5action,
+								 hold ? ( unsigned char )MD5_METHOD_FRAME : md5action->method );
 		}
 		
 		++i;
 	}
-
-
-	// Mesh dimension
-	vec3_diff( &md5->dimension,
-			   &md5->max,
-			   &md5->min );
-
-
-	// Bounding sphere radius
-	md5->radius = md5->dimension.x > md5->dimension.y ?
-				  md5->dimension.x:
-				  md5->dimension.y;
 	
-	md5->radius = md5->radius > md5->dimension.z ?
-				  md5->radius * 0.5f:
-				  md5->dimension.z * 0.5f;
+	if( !md5->pose ) md5->pose = ( MD5JOINT * ) malloc( md5->n_joint * sizeof( MD5JOINT ) );
 	
-	/*
-	md5->radius = vec3_dist( &md5->min,
-							 &md5->max ) * 0.5f;
-	*/
+	if( md5->md5posecallback ) md5->md5posecallback( md5 );
+	
+	else
+	{
+		i = 0;
+		while( i != md5->n_action )
+		{
+			if( md5->md5action[ i ].state == PLAY )
+			{
+				memcpy( md5->pose,
+						md5->md5action[ i ].pose,
+						md5->n_joint * sizeof( MD5JOINT ) );
+				break;
+			}
+			
+			++i;
+		}
+	}
+	
+	return 1;
 }
 
 
 /*!
-	Build the VBO and VAO for a specific MD5.
+	Update the actions of an MD5, build its final pose and skin its vertex data according to the
+	animation level of detail policy of the MD5. The final pose come from the pose callback if any,
+	else from the blend graph if any (in which case the skinning is skipped if the output of the graph
+	didn't change), else from the first playing action. This function doesn't issue any OpenGLES call so
+	it can safely run on a worker thread; the skinned vertex data is flagged as dirty and should
+	then be uploaded using MD5_upload_pose.
+	
+	While the MD5 is off-screen the skinning is skipped, but the pose is still sampled (on the
+	closest frame, every MD5_LOD_OFFSCREEN_RATE updates) to keep the bounds of the MD5 following
+	the animation, so culling against md5->bound can detect when the animation brings the MD5
+	back into view.
 	
 	\param[in,out] md5 A valid MD5 structure pointer.
+	\param[in] time_step The delta time of the application. \sa MD5_draw_action
+	
+	\return Return 1 if the vertex data have been skinned, else 0.
 */
-void MD5_build( MD5 *md5 )
+unsigned char MD5_update( MD5 *md5, float time_step )
 {
 	unsigned int i = 0;
 	
-	while( i != md5->n_mesh )
-	{
-		MD5MESH *md5mesh = &md5->md5mesh[ i ];
+	MD5LOD *md5lod = &md5->md5lod;
 	
-		MD5_build_vbo( md5, i );
+	if( !MD5_advance_action( md5, time_step ) ) return 0;
+	
+	// Off-screen, only update the bounds at the lowest rate and make sure to skin as soon as it come back.
+	if( !md5->visible || !md5->distance )
+	{
+		++md5lod->n_skip;
 		
-		glGenVertexArraysOES( 1, &md5mesh->vao );
+		if( !md5lod->offscreen )
+		{
+			md5lod->offscreen = 1;
+			md5lod->tick	  = 0;
+		}
 		
-		glBindVertexArrayOES( md5mesh->vao );	
+		if( md5lod->tick )
+		{
+			--md5lod->tick;
+			
+			return 0;
+		}
+		
+		md5lod->tick = MD5_LOD_OFFSCREEN_RATE - 1;
+		
+		if( MD5_build_pose( md5, 1 ) ) MD5_update_bound_pose( md5, md5->pose );
+		
+		return 0;
+	}
+	
+	if( md5lod->offscreen )
+	{
+		md5lod->offscreen = 0;
+		md5lod->tick	  = 0;
+	}
+	
+	md5lod->rate = 1;
+	
+	while( i != 3 )
+	{
+		if( md5lod->distance[ i ] && md5->distance >= md5lod->distance[ i ] ) md5lod->rate = 2 << i;
 		
-		MD5_set_mesh_attributes( md5mesh );
-
-		glBindVertexArrayOES( 0 );
-
 		++i;
 	}
-
-	MD5_set_pose( md5, md5->bind_pose );
 	
-	MD5_build_bind_pose_weighted_normals_tangents( md5 );
-
-	MD5_set_pose( md5, md5->bind_pose );
+	if( md5lod->tick )
+	{
+		--md5lod->tick;
+		
+		++md5lod->n_skip;
+		
+		return 0;
+	}
 	
-	MD5_update_bound_mesh( md5 );
+	md5lod->tick = md5lod->rate - 1;
+	
+	if( !MD5_build_pose( md5, md5lod->rate > 1 && md5lod->method == MD5_LOD_HOLD ) )
+	{
+		++md5lod->n_skip;
+		
+		return 0;
+	}
+	
+	if( md5->md5node && !md5->md5posecallback ) md5->node_version = md5->md5node->version;
+	
+	MD5_skin_pose( md5, md5->pose );
+	
+	++md5lod->n_skin;
+	
+	return 1;
 }
 
 
 /*!
-	Only build the VBO for a specific MD5 pointer.
+	Callback used internally by MD5_update_batch to update a range of MD5 on a thread of the
+	job scheduler.
 	
-	\param[in,out] md5 A valid MD5 structure pointer.	
+	\param[in,out] ptr The array of MD5 structure pointers.
+	\param[in] start The index of the first MD5 to update.
+	\param[in] end The index after the last MD5 to update.
 */
-void MD5_build2( MD5 *md5 )
+void MD5_update_range( void *ptr, unsigned int start, unsigned int end )
 {
-	unsigned int i = 0;
+	MD5 **md5 = ( MD5 ** )ptr;
 	
-	while( i != md5->n_mesh )
+	while( start != end )
 	{
-		MD5_build_vbo( md5, i );
-
-		++i;
+		MD5_update( md5[ start ], md5[ start ]->time_step );
+		++start;
 	}
-
-	MD5_set_pose( md5, md5->bind_pose );
-	
-	MD5_build_bind_pose_weighted_normals_tangents( md5 );	
-
-	MD5_set_pose( md5, md5->bind_pose );
-	
-	MD5_update_bound_mesh( md5 );	
 }
 
 
 /*!
-	Update all actions time. This function will cause to refresh and update all the
-	current MD5ACTIONS that are set to PLAY by the time_step received in parameter.
-	
-	\param[in,out] md5 A valid MD5 structure pointer.
-	\param[in] time_step The delta time of the application. In other words a value from 0 to 1 (which is 1 second)
-	that represent how much time have elapsed since the last sync. 
+	Update many MD5 in parallel. The actions update, pose evaluation and skinning of every
+	MD5 are split between the threads of the job scheduler, and once they are all done the
+	skinned vertex data get uploaded to the VBOs by the calling thread, which have to be the
+	thread that own the OpenGLES context and that started the job scheduler. \sa JOBSCHEDULER_init
+	
+	\param[in,out] md5 An array of valid MD5 structure pointers (usually the visible instances).
+	\param[in] n_md5 The number of MD5 in the array.
+	\param[in] time_step The delta time of the application. \sa MD5_draw_action
+	
+	\return Return the number of MD5 that have been skinned, the others were either not playing
+	any action, off-screen or skipped by their animation level of detail policy. If the job
+	scheduler is not started the MD5 are updated on the calling thread.
 */
-unsigned char MD5_draw_action( MD5 *md5, float time_step )
+unsigned int MD5_update_batch( MD5 **md5, unsigned int n_md5, float time_step )
 {
-	unsigned int i = 0;
-	
-	unsigned char update = 0;
+	unsigned int i = 0,
+				 n = 0;
 	
-	while( i != md5->n_action )
+	while( i != n_md5 )
 	{
-		MD5ACTION *md5action = &md5->md5action[ i ];
+		md5[ i ]->time_step = time_step;
+		++i;
+	}
 	
-		if( md5action->state == PLAY )
+	{
+		JOB *job = JOB_parallel_for( MD5_update_range, md5, n_md5, 0 );
+		
+		if( job )
 		{
-			md5action->frame_time += time_step;
-			
-			switch( md5action->method )
-			{
-				case MD5_METHOD_FRAME:
-				{
-					if( md5action->frame_time >= md5action->fps )
-					{
-						memcpy( md5action->pose,
-								md5action->frame[ md5action->curr_frame ],
-								md5->n_joint * sizeof( MD5JOINT ) );
-						
-						++md5action->curr_frame;
-
-						if( md5action->curr_frame == md5action->n_frame )
-						{
-							if( md5action->loop ) md5action->curr_frame = 0;
-							else
-							{
-								MD5_action_stop( md5action );
-								break;
-							}
-						}
-						
-						md5action->next_frame = md5action->curr_frame + 1;
-						
-						if( md5action->next_frame == md5action->n_frame )
-						{ md5action->next_frame = 0; }
-						
-						md5action->frame_time -= md5action->fps;
-						
-						update = 1;
-					}
-					
-					break;
-				}
+			JOB_run( job );
 			
-				case MD5_METHOD_LERP:
-				case MD5_METHOD_SLERP:					
-				{
-					float t = CLAMP( md5action->frame_time / md5action->fps, 0.0f, 1.0f );
-
-					MD5_blend_pose( md5,
-							 	    md5action->pose,
-									md5action->frame[ md5action->curr_frame ],
-									md5action->frame[ md5action->next_frame ],
-									md5action->method,
-									t );
-
-					if( t >= 1.0f )
-					{
-						++md5action->curr_frame;
-
-						md5action->next_frame = ( md5action->curr_frame + 1 );
-						
-						if( md5action->loop )
-						{
-							if( md5action->curr_frame == md5action->n_frame )
-							{
-								md5action->curr_frame = 0;
-								md5action->next_frame = 1;
-							}								
-
-							if( md5action->next_frame == md5action->n_frame )
-							{ md5action->next_frame = 0; }				
-						}
-						else
-						{
-							if( md5action->next_frame == md5action->n_frame )
-							{
-								MD5_action_stop( md5action );
-								break;
-							}
-						}
-						
-						md5action->frame_time -= md5action->fps;
-					}
-					
-					update = 1;
-
-					break;
-				}
-			}
+			JOB_wait( job );
 		}
+		else MD5_update_range( md5, 0, n_md5 );
+	}
 	
+	i = 0;
+	while( i != n_md5 )
+	{
+		if( md5[ i ]->dirty )
+		{
+			MD5_upload_pose( md5[ i ] );
+			
+			++n;
+		}
+		
 		++i;
 	}
 	
-	return update;
+	return n;
 }
 
 
@@ -1478,9 +3417,21 @@ unsigned int MD5_draw( MD5 *md5 )
 			{
 				if( md5mesh->objmaterial ) OBJ_draw_material( md5mesh->objmaterial );
 			
-				if( md5mesh->vao ) glBindVertexArrayOES( md5mesh->vao );
+				if( md5->streambuffer )
+				{
+					// The previous frame regions of the ring can be overwritten at any time.
+					if( !md5mesh->stream_vbo || md5mesh->stream_tick != md5->streambuffer->tick )
+					{ MD5_upload_mesh( md5mesh, md5->streambuffer ); }
+				}
+				
+				if( md5mesh->vao && !md5mesh->stream_vbo ) glBindVertexArrayOES( md5mesh->vao );
 			
-				else MD5_set_mesh_attributes( md5mesh );
+				else
+				{
+					if( md5mesh->vao ) glBindVertexArrayOES( 0 );
+					
+					MD5_set_mesh_attributes( md5mesh );
+				}
 				
 				glDrawElements( md5mesh->mode,
 								md5mesh->n_indice,
@@ -31,6 +31,13 @@ as being the original software.
 	\brief Function prototypes and definitions to use with the MD5 structure.
 */
 
+
+//! The update rate divider of the pose and bounds of an off-screen MD5, the lowest rate of the animation level of detail. \sa MD5_update
+#define MD5_LOD_OFFSCREEN_RATE	8
+
+//! The number of steps a frame is divided in when a clip node is sampled, the cached pose of a clip is reused until its time move by one step.
+#define MD5_NODE_BLEND_STEP		256
+
 enum
 {
 	//! Interpolate frame by frame.
@@ -44,6 +51,36 @@ enum
 };
 
 
+enum
+{
+	//! Reduced update rates evaluate the pose using the interpolation method of each action.
+	MD5_LOD_INTERPOLATE = 0,
+	
+	//! Reduced update rates hold the current frame of each action instead of interpolating.
+	MD5_LOD_HOLD		= 1
+};
+
+
+enum
+{
+	//! Sample the pose of an MD5ACTION.
+	MD5_NODE_CLIP  = 0,
+	
+	//! Blend the poses of two nodes using the node weight.
+	MD5_NODE_LERP  = 1,
+	
+	//! Add the difference between the second node and a reference pose on top of the first node.
+	MD5_NODE_ADD   = 2,
+	
+	//! Blend the second node over the first one only for the joints of the node mask.
+	MD5_NODE_LAYER = 3
+};
+
+
+//! The MD5 pose callback prototype. \sa MD5_update
+typedef void( MD5POSECALLBACK( void * ) );
+
+
 //! Structure definition of a single joint.
 typedef struct
 {
@@ -111,6 +148,21 @@ typedef struct
 } MD5WEIGHT;
 
 
+//! Structure definition of the bounding box of all the weights attached to a joint, in joint space.
+typedef struct
+{
+	//! The bottom left corner of the box.
+	vec3			min;
+	
+	//! The up right corner of the box.
+	vec3			max;
+	
+	//! Determine if at least one weight is attached to the joint (1) or not (0).
+	unsigned char	used;
+
+} MD5BOUND;
+
+
 //! Structure that allow you to draw a mesh from an MD5.
 typedef struct
 {
@@ -164,6 +216,15 @@ typedef struct
 	
 	//! The VAO id maintained by OpenGLES.
 	unsigned int	vao;
+
+	//! The STREAMBUFFER VBO id holding the skinned vertex data of the current frame, or 0 if the mesh VBO is used. \sa MD5_set_streambuffer
+	unsigned int	stream_vbo;
+
+	//! The offset in bytes of the skinned vertex data inside the STREAMBUFFER.
+	unsigned int	stream_offset;
+
+	//! The STREAMBUFFER tick at which the skinned vertex data have been written.
+	unsigned int	stream_tick;
 	
 	//! Determine if the mesh if visible (1) or invisile (0). Default value 1.
 	unsigned char	visible;
@@ -174,6 +235,66 @@ typedef struct
 } MD5MESH;
 
 
+//! Header of a cooked MD5 animation file. \sa MD5_cook_action
+typedef struct
+{
+	//! The file identifier, "MD5C".
+	char			tag[ 4 ];
+	
+	//! The version of the cooked format.
+	unsigned int	version;
+	
+	//! The number of joints animated by the action.
+	unsigned int	n_joint;
+	
+	//! The number of frames of the action.
+	unsigned int	n_frame;
+	
+	//! The duration of a frame in seconds.
+	float			fps;
+
+} MD5COOKEDHEADER;
+
+
+//! Header of a single track in a cooked MD5 animation file.
+typedef struct
+{
+	//! The number of keys of the track (1 for a constant track).
+	unsigned short	n_key;
+	
+	//! Either 0 for a location track or 1 for a rotation track.
+	unsigned short	type;
+	
+	//! The minimum value of a location track.
+	vec3			min;
+	
+	//! The quantization step of a location track.
+	vec3			scale;
+
+} MD5COOKEDTRACK;
+
+
+//! Structure definition of a compressed animation track (location or rotation of a joint).
+typedef struct
+{
+	//! The number of keys (1 for a constant track).
+	unsigned short	n_key;
+	
+	//! Array of frame index for each key (NULL for a constant track).
+	unsigned short	*frame;
+	
+	//! Array of quantized values, 3 per key. Locations use 16 bits per axis and rotations use the smallest three 48 bits encoding.
+	unsigned short	*value;
+	
+	//! The minimum value of a location track.
+	vec3			min;
+	
+	//! The quantization step of a location track.
+	vec3			scale;
+
+} MD5TRACK;
+
+
 //! Structure that allows you to load and manipulate an MD5 action.
 typedef struct
 {
@@ -209,10 +330,109 @@ typedef struct
 	
 	//! The action frame per second.
 	float			fps;
+	
+	//! Array of compressed tracks of a cooked action (two per joint, location then rotation), NULL if the action use frames.
+	MD5TRACK		*md5track;
+	
+	//! The MEMORY stream of a cooked action that the tracks point to, kept open since it may be a file mapping.
+	MEMORY			*memory;
 
 } MD5ACTION;
 
 
+//! Structure definition of the animation level of detail policy of an MD5. \sa MD5_set_lod
+typedef struct
+{
+	//! The distances from the viewer starting from which the pose is updated at 1/2, 1/4 and 1/8 rate (0 disable the level).
+	float			distance[ 3 ];
+	
+	//! The method to use on reduced update rates, either MD5_LOD_INTERPOLATE or MD5_LOD_HOLD.
+	unsigned char	method;
+	
+	//! The current update rate divider (1, 2, 4 or 8).
+	unsigned char	rate;
+	
+	//! The number of updates left to skip before the next pose evaluation.
+	unsigned char	tick;
+	
+	//! Determine if the MD5 was off-screen at the last update, so it is skinned as soon as it come back.
+	unsigned char	offscreen;
+	
+	//! The number of skins done by MD5_update.
+	unsigned int	n_skin;
+	
+	//! The number of skins skipped by MD5_update because the MD5 was off-screen or updated at a reduced rate.
+	unsigned int	n_skip;
+	
+} MD5LOD;
+
+
+//! Structure definition of a node of an MD5 blend graph. \sa MD5_node_evaluate
+typedef struct MD5NODE
+{
+	//! The internal name of the node.
+	char			name[ MAX_CHAR ];
+	
+	//! The type of node, either MD5_NODE_CLIP, MD5_NODE_LERP, MD5_NODE_ADD or MD5_NODE_LAYER.
+	unsigned char	type;
+	
+	//! The MD5ACTION sampled by a clip node.
+	MD5ACTION		*md5action;
+	
+	//! The input nodes of a blend node.
+	struct MD5NODE	*input[ 2 ];
+	
+	//! The reference pose substracted from the second input of an additive node (the bind pose by default).
+	MD5JOINT		*reference;
+	
+	//! The method to use to interpolate the rotations. \sa MD5_blend_pose
+	unsigned char	method;
+	
+	//! The blend weight of the second input (a value between 0 and 1), can be changed at any time.
+	float			weight;
+	
+	//! Array of n_joint flags of a layer node, determine which joints are blended. \sa MD5_node_set_mask_branch
+	unsigned char	*mask;
+	
+	//! Array of n_joint flags, determine which joints are required by the nodes using this node as input.
+	unsigned char	*required;
+	
+	//! The number of joints required.
+	unsigned int	n_joint;
+	
+	//! Array of the indices of the joints required.
+	unsigned int	*joint;
+	
+	//! The cached output pose of the node.
+	MD5JOINT		*pose;
+	
+	//! The version of the output pose, incremented every time the pose change.
+	unsigned int	version;
+	
+	//! Determine if the cached output pose is valid (1) or not (0).
+	unsigned char	valid;
+	
+	//! The input versions used to compute the cached output pose.
+	unsigned int	input_version[ 2 ];
+	
+	//! The weight used to compute the cached output pose.
+	float			cached_weight;
+	
+	//! The MD5ACTION used to compute the cached output pose of a clip node.
+	MD5ACTION		*cached_action;
+	
+	//! The interpolation method used to compute the cached output pose of a clip node.
+	unsigned char	cached_method;
+	
+	//! The frames used to compute the cached output pose of a clip node.
+	int				cached_frame[ 2 ];
+	
+	//! The time between the cached frames, in MD5_NODE_BLEND_STEP steps.
+	unsigned int	cached_step;
+
+} MD5NODE;
+
+
 //! The main MD5 structure that allow you to load and manipulate .md5mesh and .md5anim files.
 typedef struct
 {
@@ -249,24 +469,60 @@ typedef struct
 	//! The XYZ scale vector of the MD5.
 	vec3			scale;
 	
-	//! The bottom left corner of the bounding box. (in bind pose)
+	//! The bottom left corner of the bounding box. (of the current pose)
 	vec3			min;
 	
-	//! The up right corner of the bounding box. (in bind pose)
+	//! The up right corner of the bounding box. (of the current pose)
 	vec3			max;
 	
-	//! The dimension of the bounding box. (in bind pose)
+	//! The dimension of the bounding box. (of the current pose)
 	vec3			dimension;
 	
-	//! The bounding sphere.
+	//! The bounding sphere radius, centered on the middle of the bounding box.
 	float			radius;	
 	
+	//! Array of n_joint MD5BOUND used to compute the bounds of a pose without walking the vertices. \sa MD5_update_bound_pose
+	MD5BOUND		*md5bound;
+	
 	//! The current distance of the MD5 from the viewer.
 	float			distance;
 	
 	//! btRigidBody pointer of the current MD5 (if used in physics simulation).
 	btRigidBody		*btrigidbody;
 	
+	//! The MD5 resource that own the bind pose, weights, triangles, action frames and index VBOs shared by this instance (NULL if the MD5 is a resource). \sa MD5_create_instance
+	void			*resource;
+	
+	//! The number of instances currently sharing the data of this MD5 resource.
+	unsigned int	n_instance;
+	
+	//! Determine if MD5_free have been called on this resource while instances were still sharing its data, the resource is then released with its last instance.
+	unsigned char	free_pending;
+
+	//! The final pose of the MD5, filled by MD5_update from the actions or from the pose callback.
+	MD5JOINT		*pose;
+
+	//! Callback to use to build the final pose from the actions (if NULL the pose of the first playing action is used).
+	MD5POSECALLBACK	*md5posecallback;
+
+	//! The time step to use on the next MD5_update_batch.
+	float			time_step;
+
+	//! Determine if the skinned vertex data have been updated and need to be uploaded to the VBOs.
+	unsigned char	dirty;
+	
+	//! The animation level of detail policy used by MD5_update.
+	MD5LOD			md5lod;
+
+	//! The STREAMBUFFER to write the skinned vertex data into (if NULL the vertex data are uploaded to the VBO of each mesh).
+	STREAMBUFFER	*streambuffer;
+
+	//! The root node of the blend graph used by MD5_update to build the final pose (if any). \sa MD5_set_node
+	MD5NODE			*md5node;
+	
+	//! The version of the root node output the MD5 have been skinned with.
+	unsigned int	node_version;
+
 } MD5;
 
 
@@ -274,6 +530,12 @@ MD5 *MD5_load_mesh( char *filename, unsigned char relative_path );
 
 int MD5_load_action( MD5 *md5, char *name, char *filename, unsigned char relative_path );
 
+unsigned char MD5_cook_action( MD5 *md5, MD5ACTION *md5action, char *filename, float location_tolerance, float rotation_tolerance );
+
+void MD5_sample_action( MD5 *md5, MD5ACTION *md5action, MD5JOINT *pose, unsigned char joint_interpolation_method, float blend );
+
+MD5 *MD5_create_instance( MD5 *md5, char *name );
+
 MD5 *MD5_free( MD5 *md5 );
 
 void MD5_free_mesh_data( MD5 *md5 );
@@ -302,8 +564,20 @@ void MD5_build_vbo( MD5 *md5, unsigned int mesh_index );
 
 void MD5_build_bind_pose_weighted_normals_tangents( MD5 *md5 );
 
+void MD5_skin_pose( MD5 *md5, MD5JOINT *pose );
+
+void MD5_update_bound_pose( MD5 *md5, MD5JOINT *pose );
+
+float MD5_sphere_distance_in_frustum( MD5 *md5, vec4 *frustum );
+
+void MD5_upload_pose( MD5 *md5 );
+
 void MD5_set_pose( MD5 *md5, MD5JOINT *pose );
 
+void MD5_set_pose_callback( MD5 *md5, MD5POSECALLBACK *md5posecallback );
+
+void MD5_set_streambuffer( MD5 *md5, STREAMBUFFER *streambuffer );
+
 void MD5_blend_pose( MD5 *md5, MD5JOINT *final_pose, MD5JOINT *pose0, MD5JOINT *pose1, unsigned char joint_interpolation_method, float blend );
 
 void MD5_add_pose( MD5 *md5, MD5JOINT *final_pose, MD5ACTION *action0, MD5ACTION *action1, unsigned char joint_interpolation_method, float action_weight );
@@ -314,6 +588,36 @@ void MD5_build2( MD5 *md5 );
 
 unsigned char MD5_draw_action( MD5 *md5, float time_step );
 
+unsigned char MD5_advance_action( MD5 *md5, float time_step );
+
+void MD5_evaluate_action( MD5 *md5, MD5ACTION *md5action, unsigned char joint_interpolation_method );
+
+unsigned char MD5_build_pose( MD5 *md5, unsigned char hold );
+
+void MD5_set_lod( MD5 *md5, float distance_2, float distance_4, float distance_8, unsigned char method );
+
+MD5NODE *MD5_node_clip( MD5 *md5, char *name, MD5ACTION *md5action, unsigned char joint_interpolation_method );
+
+MD5NODE *MD5_node_lerp( MD5 *md5, char *name, MD5NODE *node0, MD5NODE *node1, unsigned char joint_interpolation_method, float weight );
+
+MD5NODE *MD5_node_add( MD5 *md5, char *name, MD5NODE *node0, MD5NODE *node1, MD5JOINT *reference, float weight );
+
+MD5NODE *MD5_node_layer( MD5 *md5, char *name, MD5NODE *node0, MD5NODE *node1, unsigned char joint_interpolation_method, float weight );
+
+MD5NODE *MD5_node_free( MD5NODE *md5node );
+
+unsigned char MD5_node_set_mask_branch( MD5 *md5, MD5NODE *md5node, char *joint_name, unsigned char value );
+
+void MD5_node_prepare( MD5 *md5, MD5NODE *md5node );
+
+MD5JOINT *MD5_node_evaluate( MD5 *md5, MD5NODE *md5node );
+
+void MD5_set_node( MD5 *md5, MD5NODE *md5node );
+
+unsigned char MD5_update( MD5 *md5, float time_step );
+
+unsigned int MD5_update_batch( MD5 **md5, unsigned int n_md5, float time_step );
+
 unsigned int MD5_draw( MD5 *md5 );
 
 #endif
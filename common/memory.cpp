@@ -21,8 +21,14 @@ as being the original software.
 
 */
 
+#define ALLOCATOR_TAG ALLOCATOR_TAG_MEMORY
+
 #include "gfx.h"
 
+APK apk = { "", 0, 0, NULL, NULL, 0, NULL, PTHREAD_MUTEX_INITIALIZER };
+
+MEMORYQUEUE memoryqueue;
+
 /*!
 	\file memory.cpp
 	
@@ -32,184 +38,1408 @@ as being the original software.
 	implementation is ideal for the loading game assets. In addition, the MEMORY structure offers
 	you built-in functionalities to read and extract files from and Android APK file, directly in
 	C so you won't have to use the Java API.
+	
+	On iOS and Windows the files bigger than MMAP_MIN_SIZE are not copied: the buffer is a
+	private copy-on-write mapping of the file, so the pages are read lazily, shared with the
+	system file cache, and only duplicated if a parser write in them (strtok for example).
+	
+	On Android the APK is opened once and its central directory indexed in a hash table. The
+	entries stored without compression are mapped in place the same way, the deflated entries
+	are inflated straight from the mapped archive into their buffer.
+	
+	Large text assets can be opened with mopen_stream instead: the buffer is then a window of
+	two chunks refilled from the file (or the APK entry, inflated on the fly) as the cursor
+	moves, so parsing them with mread, mpeek and mgets only keep a bounded amount of memory.
+	
+	Files can also be opened asynchronously with mopen_async: the requests are served by a
+	dedicated I/O thread in priority order (the PAK entries being decompressed on the PAK
+	WORKER pool), and the completion callbacks are called by mpump on the main thread.
 */
 
 
 /*!
-	Open/Extract a file from disk and load it in memory.
+	Resolve the path that mopen use to locate a file, the same file always resolve to the same
+	path whether it is referenced with a relative or an absolute path.
 	
-	\param[in] filename The file to load in memory.
+	\param[in] filename The file to locate.
 	\param[in] relative_path Determine if the filename is an absolute or relative path.
-	
-	\return Return a MEMORY structure pointer if the file is found and loaded, instead will return
-	NULL.
+	\param[out] path The resolved path (MAX_PATH bytes).
 */
-MEMORY *mopen( char *filename, unsigned char relative_path )
+void mresolve( char *filename, unsigned char relative_path, char *path )
 {
 	#if __IPHONE_4_0 || _WIN32
 
-		FILE *f;
-		
-		char fname[ MAX_PATH ] = {""};
+		path[ 0 ] = 0;
 		
 		if( relative_path )
 		{
 #if _WIN32
-			get_file_path("../../Resources/", fname);
+			get_file_path("../../Resources/", path);
 #else
-			get_file_path(getenv("FILESYSTEM"), fname);
+			get_file_path(getenv("FILESYSTEM"), path);
 #endif
-			strcat( fname, filename );
+			strcat( path, filename );
 		}
-		else strcpy( fname, filename );
+		else strcpy( path, filename );
 
-		f = fopen( fname, "rb" );
+	#else
+
+		if( relative_path ) sprintf( path, "assets/%s", filename );
+		else strcpy( path, filename );
+
+	#endif
+}
+
+
+/*!
+	Map a file in memory as a private copy-on-write buffer followed by a NULL byte. This
+	function is used internally by mopen.
+	
+	\param[in] path The resolved path of the file.
+	
+	\return Return a MEMORY structure pointer, or NULL if the file cannot (or should not) be mapped.
+*/
+MEMORY *mmap_open( char *path )
+{
+	#ifdef _WIN32
+	
+		SYSTEM_INFO system_info;
 		
-		if( !f ) return NULL;
+		HANDLE file,
+			   mapping;
 		
+		unsigned int size;
 		
-		MEMORY *memory = ( MEMORY * ) calloc( 1, sizeof( MEMORY ) );
+		void *buffer;
 		
-		strcpy( memory->filename, fname );
+		MEMORY *memory;
 		
+		file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
 		
-		fseek( f, 0, SEEK_END );
-		memory->size = ftell( f );
-		fseek( f, 0, SEEK_SET );
+		if( file == INVALID_HANDLE_VALUE ) return NULL;
 		
+		size = GetFileSize( file, NULL );
 		
-		memory->buffer = ( unsigned char * ) calloc( 1, memory->size + 1 );
-		fread( memory->buffer, memory->size, 1, f );
-		memory->buffer[ memory->size ] = 0;
+		GetSystemInfo( &system_info );
 		
+		// The end of the last page is filled with zeros, a file filling its last page has no NULL byte.
+		if( size < MMAP_MIN_SIZE || !( size % system_info.dwPageSize ) )
+		{
+			CloseHandle( file );
+			return NULL;
+		}
 		
-		fclose( f );
+		mapping = CreateFileMappingA( file, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+		
+		CloseHandle( file );
+		
+		if( !mapping ) return NULL;
+		
+		buffer = MapViewOfFile( mapping, FILE_MAP_COPY, 0, 0, 0 );
+		
+		// The view keep the mapping alive.
+		CloseHandle( mapping );
+		
+		if( !buffer ) return NULL;
+		
+		memory = ( MEMORY * ) calloc( 1, sizeof( MEMORY ) );
+		
+		memory->size		= size;
+		memory->mapped_size = size + 1;
+		memory->buffer		= ( unsigned char * )buffer;
 		
 		return memory;
 	
-	
 	#else
 	
-		char fpath[ MAX_PATH ] = {""},
-			 fname[ MAX_PATH ] = {""};
-
-		unzFile		    uf;
-		unz_file_info   fi;
-		unz_file_pos    fp;
-
-		strcpy( fpath, getenv( "FILESYSTEM" ) );
-
-		uf = unzOpen( fpath );
+		struct stat st;
 		
-		if( !uf ) return NULL;
-
-		if( relative_path ) sprintf( fname, "assets/%s", filename );
-		else strcpy( fname, filename );
+		unsigned int page,
+					 mapped_size;
 		
-		unzGoToFirstFile( uf );
-
-		MEMORY *memory = ( MEMORY * ) calloc( 1, sizeof( MEMORY ) );
-
-		unzGetFilePos( uf, &fp );
+		void *buffer;
+		
+		MEMORY *memory;
+		
+		int fd = open( path, O_RDONLY );
+		
+		if( fd == -1 ) return NULL;
 		
-		if( unzLocateFile( uf, fname, 1 ) == UNZ_OK )
+		if( fstat( fd, &st ) || st.st_size < MMAP_MIN_SIZE )
 		{
-			unzGetCurrentFileInfo(  uf,
-								   &fi,
-									memory->filename,
-									MAX_PATH,
-									NULL, 0,
-									NULL, 0 );
+			close( fd );
+			return NULL;
+		}
 		
-			if( unzOpenCurrentFilePassword( uf, NULL ) == UNZ_OK )
-			{
-				memory->position = 0;
-				memory->size	 = fi.uncompressed_size;
-				memory->buffer   = ( unsigned char * ) realloc( memory->buffer, fi.uncompressed_size + 1 );
-				memory->buffer[ fi.uncompressed_size ] = 0;
-
-				while( unzReadCurrentFile( uf, memory->buffer, fi.uncompressed_size ) > 0 ){}
-
-				unzCloseCurrentFile( uf );
-
-				unzClose( uf );
-					
-				return memory;
-			}
+		// Reserve one more zeroed page than needed so the buffer is always NULL terminated.
+		page		= ( unsigned int )sysconf( _SC_PAGESIZE );
+		mapped_size = ( ( unsigned int )st.st_size + page ) & ~( page - 1 );
+		
+		buffer = mmap( NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0 );
+		
+		if( buffer == MAP_FAILED )
+		{
+			close( fd );
+			return NULL;
 		}
 		
-		unzClose( uf );
-
-		return NULL;
+		if( mmap( buffer, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0 ) == MAP_FAILED )
+		{
+			munmap( buffer, mapped_size );
+			
+			close( fd );
+			return NULL;
+		}
+		
+		close( fd );
+		
+		madvise( buffer, st.st_size, MADV_SEQUENTIAL );
+		madvise( buffer, st.st_size, MADV_WILLNEED );
+		
+		memory = ( MEMORY * ) calloc( 1, sizeof( MEMORY ) );
+		
+		memory->size		= ( unsigned int )st.st_size;
+		memory->mapped_size = mapped_size;
+		memory->buffer		= ( unsigned char * )buffer;
 		
+		return memory;
+	
 	#endif
 }
 
 
 /*!
-	Close and free a previously initialized MEMORY stream.
+	Release the buffer of a MEMORY stream, either allocated or mapped. This function is used internally.
 	
 	\param[in,out] memory A valid MEMORY structure pointer.
+*/
+void mrelease( MEMORY *memory )
+{
+	if( !memory->buffer ) return;
 	
-	\return Return a NULL MEMORY structure pointer.
+	if( memory->mapped_size )
+	{
+		#ifdef _WIN32
+			UnmapViewOfFile( memory->buffer );
+		#else
+			munmap( memory->buffer - memory->mapped_offset, memory->mapped_size );
+		#endif
+		
+		memory->mapped_size = 0;
+	}
+	else free( memory->buffer );
+	
+	memory->buffer = NULL;
+}
+
+
+/*!
+	Hash an archive entry name.
+	
+	\param[in] name The entry name.
+	\param[in] length The length of the name in bytes.
+	
+	\return Return the FNV-1a hash of the name.
 */
-MEMORY *mclose( MEMORY *memory )
+unsigned int mhash( char *name, unsigned int length )
 {
-	if( memory->buffer ) free( memory->buffer );
+	unsigned int i	  = 0,
+				 hash = 2166136261u;
 	
-	free( memory );
-	return NULL;
+	while( i != length )
+	{
+		hash = ( hash ^ ( unsigned char )name[ i ] ) * 16777619u;
+		++i;
+	}
+	
+	return hash;
 }
 
 
+#if !( __IPHONE_4_0 || _WIN32 )
+
 /*!
-	Similar as the read method, this function read a chunk of bytes
-	at starting from the current location of the cursor in the memory stream
-	to a specific size. The result will be stored in the dst pointer.
+	Read a little endian 16 bits value. This function is used internally.
+*/
+unsigned short mget16( unsigned char *p )
+{ return p[ 0 ] | ( p[ 1 ] << 8 ); }
+
+
+/*!
+	Read a little endian 32 bits value. This function is used internally.
+*/
+unsigned int mget32( unsigned char *p )
+{ return p[ 0 ] | ( p[ 1 ] << 8 ) | ( p[ 2 ] << 16 ) | ( ( unsigned int )p[ 3 ] << 24 ); }
+
+
+/*!
+	Open an APK (or any zip archive) once and index its central directory in a hash table,
+	so mopen can locate an asset without parsing the archive again. Called automatically by
+	mopen with the FILESYSTEM environment variable on Android, call it again to switch to
+	another archive.
 	
-	\param[in,out] memory A valid MEMORY structure pointer.
-	\param[in,out] dst A void pointer to store the bytes that was read from this function.
-	\param[in] size The number of bytes to read from the memory stream.
+	\param[in] filename The absolute path of the archive.
 	
-	\return Return the number of bytes that the function store in the dst pointer.
+	\return Return 1 if the archive is open, else 0.
 */
-unsigned int mread( MEMORY *memory, void *dst, unsigned int size )
+unsigned char mopen_apk( char *filename )
+{
+	unsigned char tail[ 65557 ],
+				  *p;
+	
+	unsigned int i,
+				 size,
+				 tail_size,
+				 directory_size,
+				 directory_offset;
+	
+	struct stat st;
+	
+	int fd;
+	
+	if( !filename ) return 0;
+	
+	pthread_mutex_lock( &apk.mutex );
+	
+	if( apk.fd > 0 && !strcmp( apk.filename, filename ) )
+	{
+		pthread_mutex_unlock( &apk.mutex );
+		return 1;
+	}
+	
+	mclose_apk();
+	
+	fd = open( filename, O_RDONLY );
+	
+	if( fd == -1 || fstat( fd, &st ) )
+	{
+		if( fd != -1 ) close( fd );
+		
+		pthread_mutex_unlock( &apk.mutex );
+		return 0;
+	}
+	
+	size	  = ( unsigned int )st.st_size;
+	tail_size = size < sizeof( tail ) ? size : sizeof( tail );
+	
+	pread( fd, tail, tail_size, size - tail_size );
+	
+	// Look for the end of central directory record, followed by a comment of up to 64KB.
+	i = tail_size >= 22 ? tail_size - 22 : 0;
+	
+	while( i && mget32( &tail[ i ] ) != 0x06054B50 ) --i;
+	
+	if( mget32( &tail[ i ] ) != 0x06054B50 )
+	{
+		close( fd );
+		
+		pthread_mutex_unlock( &apk.mutex );
+		return 0;
+	}
+	
+	apk.n_apkentry	 = mget16( &tail[ i + 10 ] );
+	directory_size	 = mget32( &tail[ i + 12 ] );
+	directory_offset = mget32( &tail[ i + 16 ] );
+	
+	apk.directory = ( unsigned char * ) malloc( directory_size );
+	
+	pread( fd, apk.directory, directory_size, directory_offset );
+	
+	apk.apkentry = ( APKENTRY * ) calloc( apk.n_apkentry, sizeof( APKENTRY ) );
+	
+	apk.n_bucket = 1;
+	while( apk.n_bucket < ( apk.n_apkentry << 1 ) ) apk.n_bucket <<= 1;
+	
+	apk.bucket = ( int * ) malloc( apk.n_bucket * sizeof( int ) );
+	
+	memset( apk.bucket, -1, apk.n_bucket * sizeof( int ) );
+	
+	i = 0;
+	p = apk.directory;
+	
+	while( i != apk.n_apkentry && p + 46 <= apk.directory + directory_size && mget32( p ) == 0x02014B50 )
+	{
+		APKENTRY *apkentry = &apk.apkentry[ i ];
+		
+		unsigned int bucket;
+		
+		apkentry->compression	  = mget16( &p[ 10 ] );
+		apkentry->compressed_size = mget32( &p[ 20 ] );
+		apkentry->size			  = mget32( &p[ 24 ] );
+		apkentry->name_length	  = mget16( &p[ 28 ] );
+		apkentry->header_offset	  = mget32( &p[ 42 ] );
+		apkentry->name			  = ( char * )&p[ 46 ];
+		apkentry->hash			  = mhash( apkentry->name, apkentry->name_length );
+		
+		// Open addressing with linear probing, the table is at most half full.
+		bucket = apkentry->hash & ( apk.n_bucket - 1 );
+		
+		while( apk.bucket[ bucket ] != -1 ) bucket = ( bucket + 1 ) & ( apk.n_bucket - 1 );
+		
+		apk.bucket[ bucket ] = i;
+		
+		p += 46 + apkentry->name_length + mget16( &p[ 30 ] ) + mget16( &p[ 32 ] );
+		
+		++i;
+	}
+	
+	apk.n_apkentry = i;
+	apk.fd		   = fd;
+	
+	strcpy( apk.filename, filename );
+	
+	pthread_mutex_unlock( &apk.mutex );
+	
+	return 1;
+}
+
+
+/*!
+	Close the archive opened by mopen_apk and free its index. The MEMORY streams already opened
+	stay valid.
+*/
+void mclose_apk( void )
 {
-	if( ( memory->position + size ) > memory->size )
-	{ size = memory->size - memory->position; }
+	if( apk.fd > 0 ) close( apk.fd );
+	
+	if( apk.directory ) free( apk.directory );
+	
+	if( apk.apkentry ) free( apk.apkentry );
+	
+	if( apk.bucket ) free( apk.bucket );
+	
+	apk.fd		   = 0;
+	apk.directory  = NULL;
+	apk.apkentry   = NULL;
+	apk.bucket	   = NULL;
+	apk.n_apkentry =
+	apk.n_bucket   = 0;
+	apk.filename[ 0 ] = 0;
+}
 
-	memcpy( dst, &memory->buffer[ memory->position ], size );
+
+/*!
+	Look for an entry of the archive opened by mopen_apk.
+	
+	\param[in] name The full name of the entry inside the archive.
+	
+	\return Return the APKENTRY structure pointer, or NULL if the entry does not exist.
+*/
+APKENTRY *mfind_apk( char *name )
+{
+	unsigned int length = strlen( name ),
+				 hash	= mhash( name, length ),
+				 bucket;
 	
-	memory->position += size;
+	if( !apk.n_bucket ) return NULL;
+	
+	bucket = hash & ( apk.n_bucket - 1 );
+	
+	while( apk.bucket[ bucket ] != -1 )
+	{
+		APKENTRY *apkentry = &apk.apkentry[ apk.bucket[ bucket ] ];
+		
+		if( apkentry->hash == hash &&
+			apkentry->name_length == length &&
+			!memcmp( apkentry->name, name, length ) ) return apkentry;
+		
+		bucket = ( bucket + 1 ) & ( apk.n_bucket - 1 );
+	}
+	
+	return NULL;
+}
+
 
-	return size;
+/*!
+	Get the offset of the data of an entry, right after its local header. This function is used internally.
+	
+	\param[in] apkentry A valid APKENTRY structure pointer.
+	
+	\return Return the offset in bytes from the start of the archive, or 0 if the local header is invalid.
+*/
+unsigned int mget_apk_data_offset( APKENTRY *apkentry )
+{
+	unsigned char header[ 30 ];
+	
+	if( pread( apk.fd, header, 30, apkentry->header_offset ) != 30 || mget32( header ) != 0x04034B50 ) return 0;
+	
+	return apkentry->header_offset + 30 + mget16( &header[ 26 ] ) + mget16( &header[ 28 ] );
 }
 
 
 /*!
-	Insert text at a specific position in a memory stream.
+	Map a range of the archive opened by mopen_apk as a private copy-on-write buffer. This
+	function is used internally.
 	
-	\param[in,out] memory A valid MEMORY structure pointer with a loaded buffer.
-	\param[in] str The string of text to insert.
-	\param[in] position The position (in bytes) to inser the text.
+	\param[in] offset The offset of the range in bytes.
+	\param[in] size The size of the range in bytes.
+	\param[out] mapped_offset The distance between the start of the mapping (aligned on a page) and the range.
+	\param[out] mapped_size The size of the mapping.
+	
+	\return Return a pointer to the first byte of the range, or NULL if the range cannot be mapped.
 */
-void minsert( MEMORY *memory, char *str, unsigned int position )
+unsigned char *mmap_range( unsigned int offset, unsigned int size, unsigned int *mapped_offset, unsigned int *mapped_size )
 {
-	unsigned int s1 = strlen( str ),
-				 s2 = memory->size + s1 + 1;
+	unsigned int page = ( unsigned int )sysconf( _SC_PAGESIZE );
+	
+	void *buffer;
+	
+	*mapped_offset = offset & ( page - 1 );
+	*mapped_size   = size + *mapped_offset;
+	
+	buffer = mmap( NULL, *mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, apk.fd, offset - *mapped_offset );
+	
+	if( buffer == MAP_FAILED ) return NULL;
+	
+	madvise( buffer, *mapped_size, MADV_SEQUENTIAL );
+	
+	return ( unsigned char * )buffer + *mapped_offset;
+}
 
-	char *buffer = ( char * )memory->buffer,
-		 *tmp	 = ( char * )calloc( 1, s2 );
+#endif
+
+
+/*!
+	Open/Extract a file from disk and load it in memory. Relative paths are first looked up
+	in the mounted PAK files. \sa PAK_mount
 	
-	if( position )
-	{ strncpy( &tmp[ 0 ], &buffer[ 0 ], position ); }
+	\param[in] filename The file to load in memory.
+	\param[in] relative_path Determine if the filename is an absolute or relative path.
+	
+	\return Return a MEMORY structure pointer if the file is found and loaded, instead will return
+	NULL.
+*/
+MEMORY *mopen( char *filename, unsigned char relative_path )
+{
+	if( relative_path && pakregistry.n_pak )
+	{
+		MEMORY *memory = PAK_mopen( filename );
+		
+		if( memory ) return memory;
+	}
+	
+	return mopen_file( filename, relative_path );
+}
 
-	strcat( &tmp[ position ], str );
+
+/*!
+	Open/Extract a file from disk (or from the APK on Android) and load it in memory, without
+	looking in the mounted PAK files. This function is used by mopen.
 	
-	strcat( &tmp[ position + s1 ], &buffer[ position ] );
+	\param[in] filename The file to load in memory.
+	\param[in] relative_path Determine if the filename is an absolute or relative path.
+	
+	\return Return a MEMORY structure pointer if the file is found and loaded, instead will return
+	NULL.
+*/
+MEMORY *mopen_file( char *filename, unsigned char relative_path )
+{
+	#if __IPHONE_4_0 || _WIN32
 
-	memory->size = s2;
+		FILE *f;
+		
+		char fname[ MAX_PATH ] = {""};
+		
+		mresolve( filename, relative_path, fname );
+		
+		MEMORY *memory = mmap_open( fname );
+		
+		if( memory )
+		{
+			strcpy( memory->filename, fname );
+			
+			return memory;
+		}
+
+		f = fopen( fname, "rb" );
+		
+		if( !f ) return NULL;
+		
+		
+		memory = ( MEMORY * ) calloc( 1, sizeof( MEMORY ) );
+		
+		strcpy( memory->filename, fname );
+		
+		
+		fseek( f, 0, SEEK_END );
+		memory->size = ftell( f );
+		fseek( f, 0, SEEK_SET );
+		
+		
+		memory->buffer = ( unsigned char * ) malloc( memory->size + 1 );
+		fread( memory->buffer, memory->size, 1, f );
+		memory->buffer[ memory->size ] = 0;
+		
+		
+		fclose( f );
+		
+		return memory;
 	
-	free( memory->buffer );
-	memory->buffer = ( unsigned char * )tmp;	
+	
+	#else
+	
+		char fname[ MAX_PATH ] = {""};
+		
+		unsigned char *data;
+		
+		unsigned int data_offset;
+		
+		APKENTRY *apkentry;
+		
+		MEMORY *memory;
+		
+		if( !mopen_apk( getenv( "FILESYSTEM" ) ) ) return NULL;
+		
+		mresolve( filename, relative_path, fname );
+		
+		apkentry = mfind_apk( fname );
+		
+		if( !apkentry ) return NULL;
+		
+		data_offset = mget_apk_data_offset( apkentry );
+		
+		if( !data_offset ) return NULL;
+		
+		memory = ( MEMORY * ) calloc( 1, sizeof( MEMORY ) );
+		
+		strcpy( memory->filename, fname );
+		
+		memory->size = apkentry->size;
+		
+		if( !apkentry->compression )
+		{
+			// Stored entry, map it in place. Only the page of the NULL byte is copied on write.
+			data = mmap_range( data_offset, apkentry->size + 1, &memory->mapped_offset, &memory->mapped_size );
+			
+			if( !data )
+			{
+				free( memory );
+				return NULL;
+			}
+			
+			memory->buffer = data;
+			memory->buffer[ memory->size ] = 0;
+			
+			return memory;
+		}
+		
+		
+		// Deflated entry, inflate straight from the mapped APK into the final buffer.
+		unsigned int mapped_offset,
+					 mapped_size;
+		
+		z_stream stream;
+		
+		int status;
+		
+		data = mmap_range( data_offset, apkentry->compressed_size, &mapped_offset, &mapped_size );
+		
+		if( !data )
+		{
+			free( memory );
+			return NULL;
+		}
+		
+		memory->buffer = ( unsigned char * ) malloc( memory->size + 1 );
+		memory->buffer[ memory->size ] = 0;
+		
+		memset( &stream, 0, sizeof( z_stream ) );
+		
+		stream.next_in	 = data;
+		stream.avail_in	 = apkentry->compressed_size;
+		stream.next_out	 = memory->buffer;
+		stream.avail_out = memory->size;
+		
+		inflateInit2( &stream, -MAX_WBITS );
+		
+		status = inflate( &stream, Z_FINISH );
+		
+		inflateEnd( &stream );
+		
+		munmap( data - mapped_offset, mapped_size );
+		
+		if( status != Z_STREAM_END ) return mclose( memory );
+		
+		return memory;
+		
+	#endif
+}
+
+
+/*!
+	Open a file as a stream: instead of loading the whole file, the buffer of the MEMORY is a
+	window of up to two MSTREAM_CHUNK_SIZE chunks that mread, mpeek and mgets refill as the
+	cursor moves. The files served by a mounted PAK are returned whole (mread, mpeek and mgets
+	work the same on both kind of MEMORY). A streamed MEMORY cannot be used with minsert, or
+	by code that access the buffer directly.
+	
+	\param[in] filename The file to stream.
+	\param[in] relative_path Determine if the filename is an absolute or relative path.
+	
+	\return Return a MEMORY structure pointer if the file is found, instead will return NULL.
+*/
+MEMORY *mopen_stream( char *filename, unsigned char relative_path )
+{
+	char fname[ MAX_PATH ] = {""};
+	
+	MEMORYSOURCE *source;
+	
+	MEMORY *memory;
+	
+	FILE *f;
+	
+	if( relative_path && pakregistry.n_pak )
+	{
+		memory = PAK_mopen( filename );
+		
+		if( memory ) return memory;
+	}
+	
+	mresolve( filename, relative_path, fname );
+	
+	#if __IPHONE_4_0 || _WIN32
+	
+		f = fopen( fname, "rb" );
+		
+		if( !f ) return NULL;
+		
+		source = ( MEMORYSOURCE * ) calloc( 1, sizeof( MEMORYSOURCE ) );
+		
+		memory = ( MEMORY * ) calloc( 1, sizeof( MEMORY ) );
+		
+		fseek( f, 0, SEEK_END );
+		memory->size = ftell( f );
+		fseek( f, 0, SEEK_SET );
+	
+	#else
+	
+		unsigned int data_offset;
+		
+		APKENTRY *apkentry;
+		
+		if( !mopen_apk( getenv( "FILESYSTEM" ) ) ) return NULL;
+		
+		apkentry = mfind_apk( fname );
+		
+		if( !apkentry ) return NULL;
+		
+		data_offset = mget_apk_data_offset( apkentry );
+		
+		if( !data_offset ) return NULL;
+		
+		f = fopen( apk.filename, "rb" );
+		
+		if( !f ) return NULL;
+		
+		source = ( MEMORYSOURCE * ) calloc( 1, sizeof( MEMORYSOURCE ) );
+		
+		memory = ( MEMORY * ) calloc( 1, sizeof( MEMORY ) );
+		
+		memory->size = apkentry->size;
+		
+		source->offset = data_offset;
+		
+		if( apkentry->compression )
+		{
+			source->compressed_size = apkentry->compressed_size;
+			
+			source->zstream = ( z_stream * ) calloc( 1, sizeof( z_stream ) );
+			
+			source->input = ( unsigned char * ) malloc( MSTREAM_CHUNK_SIZE );
+			
+			inflateInit2( source->zstream, -MAX_WBITS );
+		}
+		
+		fseek( f, data_offset, SEEK_SET );
+	
+	#endif
+	
+	strcpy( memory->filename, fname );
+	
+	source->f = f;
+	
+	memory->source = source;
+	
+	memory->buffer = ( unsigned char * ) malloc( ( MSTREAM_CHUNK_SIZE << 1 ) + 1 );
+	memory->buffer[ 0 ] = 0;
+	
+	return memory;
+}
+
+
+/*!
+	Read the next bytes of the data of a streamed MEMORY. This function is used internally.
+	
+	\param[in,out] memory A valid streamed MEMORY structure pointer.
+	\param[in,out] dst The destination buffer.
+	\param[in] size The number of bytes to read.
+	
+	\return Return the number of bytes read, 0 at the end of the file.
+*/
+unsigned int mread_source( MEMORY *memory, unsigned char *dst, unsigned int size )
+{
+	MEMORYSOURCE *source = memory->source;
+	
+	unsigned int left = memory->size - ( source->window + source->window_size );
+	
+	if( size > left ) size = left;
+	
+	if( !source->zstream ) return ( unsigned int )fread( dst, 1, size, source->f );
+	
+	source->zstream->next_out  = dst;
+	source->zstream->avail_out = size;
+	
+	while( source->zstream->avail_out )
+	{
+		if( !source->zstream->avail_in )
+		{
+			unsigned int n = source->compressed_size - source->compressed_position;
+			
+			if( n > MSTREAM_CHUNK_SIZE ) n = MSTREAM_CHUNK_SIZE;
+			
+			n = ( unsigned int )fread( source->input, 1, n, source->f );
+			
+			if( !n ) break;
+			
+			source->compressed_position += n;
+			
+			source->zstream->next_in  = source->input;
+			source->zstream->avail_in = n;
+		}
+		
+		if( inflate( source->zstream, Z_NO_FLUSH ) != Z_OK ) break;
+	}
+	
+	return size - source->zstream->avail_out;
+}
+
+
+/*!
+	Make sure the bytes following the cursor are in the buffer. For a streamed MEMORY, the bytes
+	before the cursor are dropped from the window and the chunks following it are read (a
+	backward seek restart the source from the beginning). This function is used internally.
+	
+	\param[in,out] memory A valid MEMORY structure pointer.
+	\param[in] size The number of bytes needed after the cursor, up to two MSTREAM_CHUNK_SIZE for a streamed MEMORY.
+	
+	\return Return the number of bytes available in the buffer after the cursor (may be less than size at the end of the file).
+*/
+unsigned int mfill( MEMORY *memory, unsigned int size )
+{
+	MEMORYSOURCE *source = memory->source;
+	
+	if( memory->position >= memory->size ) return 0;
+	
+	if( !source ) return memory->size - memory->position;
+	
+	if( size > ( MSTREAM_CHUNK_SIZE << 1 ) ) size = MSTREAM_CHUNK_SIZE << 1;
+	
+	if( memory->position < source->window )
+	{
+		source->window		= 0;
+		source->window_size = 0;
+		
+		fseek( source->f, source->offset, SEEK_SET );
+		
+		if( source->zstream )
+		{
+			inflateReset( source->zstream );
+			
+			source->zstream->avail_in	= 0;
+			source->compressed_position = 0;
+		}
+	}
+	
+	if( memory->position >= source->window + source->window_size && !source->zstream )
+	{
+		// Stored data, jump straight to the cursor.
+		source->window		= memory->position;
+		source->window_size = 0;
+		
+		fseek( source->f, source->offset + memory->position, SEEK_SET );
+	}
+	
+	while( memory->position + size > source->window + source->window_size &&
+		   source->window + source->window_size < memory->size )
+	{
+		unsigned int drop = memory->position - source->window,
+					 n;
+		
+		if( drop > source->window_size ) drop = source->window_size;
+		
+		if( drop )
+		{
+			source->window_size -= drop;
+			source->window		+= drop;
+			
+			memmove( memory->buffer, &memory->buffer[ drop ], source->window_size );
+		}
+		
+		n = ( MSTREAM_CHUNK_SIZE << 1 ) - source->window_size;
+		
+		if( n > MSTREAM_CHUNK_SIZE ) n = MSTREAM_CHUNK_SIZE;
+		
+		n = mread_source( memory, &memory->buffer[ source->window_size ], n );
+		
+		if( !n ) break;
+		
+		source->window_size += n;
+	}
+	
+	memory->buffer[ source->window_size ] = 0;
+	
+	if( memory->position >= source->window + source->window_size ) return 0;
+	
+	return source->window + source->window_size - memory->position;
+}
+
+
+/*!
+	Return a pointer to the byte of the buffer at the cursor. This function is used internally.
+	
+	\param[in] memory A valid MEMORY structure pointer.
+*/
+unsigned char *mcursor( MEMORY *memory )
+{
+	if( memory->source ) return &memory->buffer[ memory->position - memory->source->window ];
+	
+	return &memory->buffer[ memory->position ];
+}
+
+
+/*!
+	Close and free a previously initialized MEMORY stream.
+	
+	\param[in,out] memory A valid MEMORY structure pointer.
+	
+	\return Return a NULL MEMORY structure pointer.
+*/
+MEMORY *mclose( MEMORY *memory )
+{
+	if( memory->source )
+	{
+		fclose( memory->source->f );
+		
+		if( memory->source->zstream )
+		{
+			inflateEnd( memory->source->zstream );
+			
+			free( memory->source->zstream );
+			
+			free( memory->source->input );
+		}
+		
+		free( memory->source );
+	}
+	
+	mrelease( memory );
+	
+	free( memory );
+	return NULL;
+}
+
+
+/*!
+	Similar as the read method, this function read a chunk of bytes
+	at starting from the current location of the cursor in the memory stream
+	to a specific size. The result will be stored in the dst pointer.
+	
+	\param[in,out] memory A valid MEMORY structure pointer.
+	\param[in,out] dst A void pointer to store the bytes that was read from this function.
+	\param[in] size The number of bytes to read from the memory stream.
+	
+	\return Return the number of bytes that the function store in the dst pointer.
+*/
+unsigned int mread( MEMORY *memory, void *dst, unsigned int size )
+{
+	unsigned int total = 0,
+				 n;
+	
+	while( size )
+	{
+		n = mfill( memory, size );
+		
+		if( !n ) break;
+		
+		if( n > size ) n = size;
+		
+		memcpy( ( unsigned char * )dst + total, mcursor( memory ), n );
+		
+		memory->position += n;
+		
+		total += n;
+		size  -= n;
+	}
+
+	return total;
+}
+
+
+/*!
+	Same as mread but without moving the cursor.
+	
+	\param[in,out] memory A valid MEMORY structure pointer.
+	\param[in,out] dst A void pointer to store the bytes.
+	\param[in] size The number of bytes to peek, up to two MSTREAM_CHUNK_SIZE for a streamed MEMORY.
+	
+	\return Return the number of bytes that the function store in the dst pointer.
+*/
+unsigned int mpeek( MEMORY *memory, void *dst, unsigned int size )
+{
+	unsigned int n = mfill( memory, size );
+	
+	if( n > size ) n = size;
+	
+	memcpy( dst, mcursor( memory ), n );
+	
+	return n;
+}
+
+
+/*!
+	Read the next line of text from the cursor, the empty lines being skipped (the same way as
+	strtok( ..., "\n" ) over the whole buffer). The line is terminated in place in the buffer and
+	stay valid until the next read on the stream. A line longer than two MSTREAM_CHUNK_SIZE is
+	split on a streamed MEMORY.
+	
+	\param[in,out] memory A valid MEMORY structure pointer.
+	
+	\return Return a pointer to the line, or NULL at the end of the file.
+*/
+char *mgets( MEMORY *memory )
+{
+	while( 1 )
+	{
+		unsigned int n = mfill( memory, 1 );
+		
+		char *line,
+			 *end;
+		
+		if( !n ) return NULL;
+		
+		line = ( char * )mcursor( memory );
+		end	 = ( char * )memchr( line, '\n', n );
+		
+		if( !end && memory->source )
+		{
+			n	 = mfill( memory, MSTREAM_CHUNK_SIZE << 1 );
+			line = ( char * )mcursor( memory );
+			end	 = ( char * )memchr( line, '\n', n );
+		}
+		
+		if( end ) memory->position += ( unsigned int )( end - line ) + 1;
+		
+		else
+		{
+			end = line + n;
+			
+			memory->position += n;
+		}
+		
+		if( end != line )
+		{
+			*end = 0;
+			
+			return line;
+		}
+	}
+}
+
+
+/*!
+	Move the cursor of a MEMORY stream, the same way as fseek.
+	
+	\param[in,out] memory A valid MEMORY structure pointer.
+	\param[in] offset The offset in bytes.
+	\param[in] whence SEEK_SET, SEEK_CUR or SEEK_END.
+	
+	\return Return 0.
+*/
+int mseek( MEMORY *memory, int offset, int whence )
+{
+	int position = offset;
+	
+	if( whence == SEEK_CUR ) position += ( int )memory->position;
+	
+	else if( whence == SEEK_END ) position += ( int )memory->size;
+	
+	if( position < 0 ) position = 0;
+	
+	else if( ( unsigned int )position > memory->size ) position = memory->size;
+	
+	memory->position = position;
+	
+	return 0;
+}
+
+
+/*!
+	Insert text at a specific position in a memory stream.
+	
+	\param[in,out] memory A valid MEMORY structure pointer with a loaded buffer.
+	\param[in] str The string of text to insert.
+	\param[in] position The position (in bytes) to inser the text.
+*/
+void minsert( MEMORY *memory, char *str, unsigned int position )
+{
+	unsigned int s1 = strlen( str ),
+				 s2 = memory->size + s1 + 1;
+
+	char *buffer = ( char * )memory->buffer,
+		 *tmp	 = ( char * )calloc( 1, s2 );
+	
+	if( position )
+	{ strncpy( &tmp[ 0 ], &buffer[ 0 ], position ); }
+
+	strcat( &tmp[ position ], str );
+	
+	strcat( &tmp[ position + s1 ], &buffer[ position ] );
+
+	memory->size = s2;
+	
+	mrelease( memory );
+	memory->buffer = ( unsigned char * )tmp;	
+}
+
+
+/*!
+	The internal function of the I/O thread, load the pending request with the highest priority
+	(the oldest first for equal priorities) until mfree_async is called.
+
+	\param[in] ptr Unused.
+*/
+void *mrun_async( void *ptr )
+{
+	pthread_mutex_lock( &memoryqueue.mutex );
+	
+	while( 1 )
+	{
+		unsigned int i	   = 1,
+					 index = 0;
+		
+		MEMORYREQUEST *memoryrequest;
+		
+		MEMORY *memory;
+		
+		while( !memoryqueue.n_pending && memoryqueue.state == PLAY )
+		{ pthread_cond_wait( &memoryqueue.cond, &memoryqueue.mutex ); }
+		
+		if( memoryqueue.state != PLAY ) break;
+		
+		while( i != memoryqueue.n_pending )
+		{
+			if( memoryqueue.pending[ i ]->priority > memoryqueue.pending[ index ]->priority ) index = i;
+			++i;
+		}
+		
+		memoryrequest = memoryqueue.pending[ index ];
+		
+		--memoryqueue.n_pending;
+		
+		memmove( &memoryqueue.pending[ index ],
+				 &memoryqueue.pending[ index + 1 ],
+				 ( memoryqueue.n_pending - index ) * sizeof( MEMORYREQUEST * ) );
+		
+		memoryqueue.loading = memoryrequest;
+		
+		pthread_mutex_unlock( &memoryqueue.mutex );
+		
+		memory = mopen( memoryrequest->filename, memoryrequest->relative_path );
+		
+		pthread_mutex_lock( &memoryqueue.mutex );
+		
+		memoryqueue.loading = NULL;
+		
+		if( memoryrequest->state == MEMORY_REQUEST_CANCELLED )
+		{
+			if( memory ) mclose( memory );
+			
+			free( memoryrequest );
+		}
+		else
+		{
+			memoryrequest->memory = memory;
+			
+			++memoryqueue.n_done;
+			
+			memoryqueue.done = ( MEMORYREQUEST ** ) realloc( memoryqueue.done,
+															  memoryqueue.n_done * sizeof( MEMORYREQUEST * ) );
+			
+			memoryqueue.done[ memoryqueue.n_done - 1 ] = memoryrequest;
+		}
+	}
+	
+	pthread_mutex_unlock( &memoryqueue.mutex );
+	
+	return NULL;
+}
+
+
+/*!
+	Start the I/O thread used by mopen_async. Called automatically by the first mopen_async.
+*/
+void minit_async( void )
+{
+	if( memoryqueue.state == PLAY ) return;
+	
+	memset( &memoryqueue, 0, sizeof( MEMORYQUEUE ) );
+	
+	memoryqueue.state	= PLAY;
+	memoryqueue.next_id = 1;
+	
+	pthread_mutex_init( &memoryqueue.mutex, NULL );
+	
+	pthread_cond_init( &memoryqueue.cond, NULL );
+	
+	pthread_create( &memoryqueue.thread, NULL, mrun_async, NULL );
+}
+
+
+/*!
+	Stop the I/O thread and discard all the requests, their callbacks are not called. The
+	request being loaded (if any) is completed first.
+*/
+void mfree_async( void )
+{
+	unsigned int i = 0;
+	
+	if( memoryqueue.state != PLAY ) return;
+	
+	pthread_mutex_lock( &memoryqueue.mutex );
+	
+	memoryqueue.state = STOP;
+	
+	pthread_cond_broadcast( &memoryqueue.cond );
+	
+	pthread_mutex_unlock( &memoryqueue.mutex );
+	
+	pthread_join( memoryqueue.thread, NULL );
+	
+	while( i != memoryqueue.n_pending )
+	{
+		free( memoryqueue.pending[ i ] );
+		++i;
+	}
+	
+	i = 0;
+	while( i != memoryqueue.n_done )
+	{
+		if( memoryqueue.done[ i ]->memory ) mclose( memoryqueue.done[ i ]->memory );
+		
+		free( memoryqueue.done[ i ] );
+		++i;
+	}
+	
+	if( memoryqueue.pending ) free( memoryqueue.pending );
+	
+	if( memoryqueue.done ) free( memoryqueue.done );
+	
+	pthread_cond_destroy( &memoryqueue.cond );
+	
+	pthread_mutex_destroy( &memoryqueue.mutex );
+	
+	memset( &memoryqueue, 0, sizeof( MEMORYQUEUE ) );
+}
+
+
+/*!
+	Queue a file to be opened on the I/O thread. Once loaded, the completion callback is called
+	from mpump with the MEMORY stream, that the callback have to close.
+	
+	\param[in] filename The file to load.
+	\param[in] relative_path Determine if the filename is an absolute or relative path.
+	\param[in] priority The priority of the request, the highest is loaded first.
+	\param[in] memorycallback The completion callback.
+	\param[in] userdata Userdata pointer sent to the completion callback.
+	
+	\return Return the id of the request. \sa mcancel, mprioritize
+*/
+unsigned int mopen_async( char *filename, unsigned char relative_path, int priority, MEMORYCALLBACK *memorycallback, void *userdata )
+{
+	unsigned int id;
+	
+	MEMORYREQUEST *memoryrequest = ( MEMORYREQUEST * ) calloc( 1, sizeof( MEMORYREQUEST ) );
+	
+	minit_async();
+	
+	strcpy( memoryrequest->filename, filename );
+	
+	memoryrequest->relative_path  = relative_path;
+	memoryrequest->priority		  = priority;
+	memoryrequest->memorycallback = memorycallback;
+	memoryrequest->userdata		  = userdata;
+	memoryrequest->state		  = MEMORY_REQUEST_PENDING;
+	
+	pthread_mutex_lock( &memoryqueue.mutex );
+	
+	id = memoryrequest->id = memoryqueue.next_id;
+	
+	++memoryqueue.next_id;
+	
+	++memoryqueue.n_pending;
+	
+	memoryqueue.pending = ( MEMORYREQUEST ** ) realloc( memoryqueue.pending,
+														memoryqueue.n_pending * sizeof( MEMORYREQUEST * ) );
+	
+	memoryqueue.pending[ memoryqueue.n_pending - 1 ] = memoryrequest;
+	
+	pthread_cond_signal( &memoryqueue.cond );
+	
+	pthread_mutex_unlock( &memoryqueue.mutex );
+	
+	return id;
+}
+
+
+/*!
+	Cancel an asynchronous request, its completion callback will not be called.
+	
+	\param[in] id The id of the request. \sa mopen_async
+	
+	\return Return 1 if the request have been cancelled, 0 if it is unknown or already delivered.
+*/
+unsigned char mcancel( unsigned int id )
+{
+	unsigned int i = 0;
+	
+	if( memoryqueue.state != PLAY ) return 0;
+	
+	pthread_mutex_lock( &memoryqueue.mutex );
+	
+	if( memoryqueue.loading && memoryqueue.loading->id == id )
+	{
+		// The I/O thread free the request once loaded.
+		memoryqueue.loading->state = MEMORY_REQUEST_CANCELLED;
+		
+		pthread_mutex_unlock( &memoryqueue.mutex );
+		return 1;
+	}
+	
+	while( i != memoryqueue.n_pending )
+	{
+		if( memoryqueue.pending[ i ]->id == id )
+		{
+			free( memoryqueue.pending[ i ] );
+			
+			--memoryqueue.n_pending;
+			
+			memmove( &memoryqueue.pending[ i ],
+					 &memoryqueue.pending[ i + 1 ],
+					 ( memoryqueue.n_pending - i ) * sizeof( MEMORYREQUEST * ) );
+			
+			pthread_mutex_unlock( &memoryqueue.mutex );
+			return 1;
+		}
+		
+		++i;
+	}
+	
+	i = 0;
+	while( i != memoryqueue.n_done )
+	{
+		if( memoryqueue.done[ i ]->id == id )
+		{
+			if( memoryqueue.done[ i ]->memory ) mclose( memoryqueue.done[ i ]->memory );
+			
+			free( memoryqueue.done[ i ] );
+			
+			--memoryqueue.n_done;
+			
+			memmove( &memoryqueue.done[ i ],
+					 &memoryqueue.done[ i + 1 ],
+					 ( memoryqueue.n_done - i ) * sizeof( MEMORYREQUEST * ) );
+			
+			pthread_mutex_unlock( &memoryqueue.mutex );
+			return 1;
+		}
+		
+		++i;
+	}
+	
+	pthread_mutex_unlock( &memoryqueue.mutex );
+	
+	return 0;
+}
+
+
+/*!
+	Change the priority of a request that is still waiting to be loaded, for example when the
+	camera moves toward the content it belongs to.
+	
+	\param[in] id The id of the request. \sa mopen_async
+	\param[in] priority The new priority, the highest is loaded first.
+	
+	\return Return 1 if the priority have been changed, 0 if the request is not waiting anymore.
+*/
+unsigned char mprioritize( unsigned int id, int priority )
+{
+	unsigned int i = 0;
+	
+	if( memoryqueue.state != PLAY ) return 0;
+	
+	pthread_mutex_lock( &memoryqueue.mutex );
+	
+	while( i != memoryqueue.n_pending )
+	{
+		if( memoryqueue.pending[ i ]->id == id )
+		{
+			memoryqueue.pending[ i ]->priority = priority;
+			
+			pthread_mutex_unlock( &memoryqueue.mutex );
+			return 1;
+		}
+		
+		++i;
+	}
+	
+	pthread_mutex_unlock( &memoryqueue.mutex );
+	
+	return 0;
+}
+
+
+/*!
+	Call the completion callbacks of the requests loaded since the last call, in completion
+	order. Have to be called regularly (usually once per frame) from the main thread, the
+	callbacks can queue new requests.
+	
+	\return Return the number of requests still waiting or being loaded.
+*/
+unsigned int mpump( void )
+{
+	unsigned int i = 0,
+				 n_done,
+				 n_left;
+	
+	MEMORYREQUEST **done;
+	
+	if( memoryqueue.state != PLAY ) return 0;
+	
+	pthread_mutex_lock( &memoryqueue.mutex );
+	
+	n_done = memoryqueue.n_done;
+	done   = memoryqueue.done;
+	
+	memoryqueue.n_done = 0;
+	memoryqueue.done   = NULL;
+	
+	pthread_mutex_unlock( &memoryqueue.mutex );
+	
+	while( i != n_done )
+	{
+		done[ i ]->memorycallback( done[ i ]->memory, done[ i ]->userdata );
+		
+		free( done[ i ] );
+		++i;
+	}
+	
+	if( done ) free( done );
+	
+	pthread_mutex_lock( &memoryqueue.mutex );
+	
+	n_left = memoryqueue.n_pending + ( memoryqueue.loading != NULL ) + memoryqueue.n_done;
+	
+	pthread_mutex_unlock( &memoryqueue.mutex );
+	
+	return n_left;
 }
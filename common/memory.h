@@ -32,6 +32,43 @@ as being the original software.
 */
 
 
+//! Files smaller than this size in bytes are read in an allocated buffer instead of being mapped.
+#define MMAP_MIN_SIZE	16384
+
+//! The size in bytes of the chunks read by a streamed MEMORY, its window holds up to two chunks. \sa mopen_stream
+#define MSTREAM_CHUNK_SIZE	65536
+
+
+//! Structure definition of the source a streamed MEMORY refill its window from. \sa mopen_stream
+typedef struct
+{
+	//! The file the data is read from (the APK on Android).
+	FILE			*f;
+	
+	//! The offset of the data in the file.
+	unsigned int	offset;
+	
+	//! The size of the compressed data, 0 if the data is stored.
+	unsigned int	compressed_size;
+	
+	//! The number of compressed bytes already read.
+	unsigned int	compressed_position;
+	
+	//! The inflate stream of a compressed source, NULL if the data is stored.
+	z_stream		*zstream;
+	
+	//! The buffer of compressed data (MSTREAM_CHUNK_SIZE bytes).
+	unsigned char	*input;
+	
+	//! The position in the file of the first byte of the window.
+	unsigned int	window;
+	
+	//! The number of bytes in the window.
+	unsigned int	window_size;
+	
+} MEMORYSOURCE;
+
+
 //! Structure that allows you to manipulate memory stream.
 typedef struct
 {
@@ -44,18 +81,202 @@ typedef struct
 	//! The position of the cursor within the memory buffer.
 	unsigned int	position;
 
-	//! The memory buffer.
+	//! The memory buffer, always followed by a NULL byte.
 	unsigned char	*buffer;
+	
+	//! The size in bytes of the file mapping backing the buffer, 0 if the buffer have been allocated.
+	unsigned int	mapped_size;
+	
+	//! The distance in bytes between the start of the file mapping and the buffer.
+	unsigned int	mapped_offset;
+	
+	//! The source of a streamed MEMORY, the buffer is then a window over the file. NULL if the whole file is in the buffer.
+	MEMORYSOURCE	*source;
 
 } MEMORY;
 
 
+//! Structure definition of an entry of the central directory of an APK.
+typedef struct
+{
+	//! The hash of the name of the entry. \sa mfind_apk
+	unsigned int	hash;
+	
+	//! The name of the entry inside the central directory (not NULL terminated).
+	char			*name;
+	
+	//! The length of the name in bytes.
+	unsigned short	name_length;
+	
+	//! The compression method, 0 for STORE or 8 for DEFLATE.
+	unsigned short	compression;
+	
+	//! The offset of the local header of the entry in the archive.
+	unsigned int	header_offset;
+	
+	//! The size of the data in the archive.
+	unsigned int	compressed_size;
+	
+	//! The size of the file once extracted.
+	unsigned int	size;
+	
+} APKENTRY;
+
+
+//! Structure definition of the APK opened by mopen on Android, with its central directory indexed in a hash table.
+typedef struct
+{
+	//! The absolute path of the archive.
+	char			filename[ MAX_PATH ];
+	
+	//! The file descriptor of the archive, 0 if not open.
+	int				fd;
+	
+	//! The number of entries.
+	unsigned int	n_apkentry;
+	
+	//! Array of entries, in the order of the central directory.
+	APKENTRY		*apkentry;
+	
+	//! The raw central directory the entry names point to.
+	unsigned char	*directory;
+	
+	//! The number of buckets of the hash table (a power of two).
+	unsigned int	n_bucket;
+	
+	//! The hash table, index of the entry or -1 for an empty bucket.
+	int				*bucket;
+	
+	//! The mutex protecting the opening of the archive.
+	pthread_mutex_t	mutex;
+	
+} APK;
+
+//! Global APK archive. Declared as extern in memory.h and implemented in memory.cpp
+extern APK apk;
+
+
+//! The asynchronous open completion callback prototype, the callback own the MEMORY stream (NULL if the file cannot be opened).
+typedef void( MEMORYCALLBACK( MEMORY *, void * ) );
+
+
+enum
+{
+	//! The request is queued or being loaded.
+	MEMORY_REQUEST_PENDING	 = 0,
+	
+	//! The request have been cancelled while being loaded.
+	MEMORY_REQUEST_CANCELLED = 1
+};
+
+
+//! Structure definition of an asynchronous open request. \sa mopen_async
+typedef struct
+{
+	//! The unique id of the request.
+	unsigned int	id;
+	
+	//! The file to load.
+	char			filename[ MAX_PATH ];
+	
+	//! Determine if the filename is relative (1) or absolute (0).
+	unsigned char	relative_path;
+	
+	//! The priority of the request, the highest is loaded first.
+	int				priority;
+	
+	//! The completion callback.
+	MEMORYCALLBACK	*memorycallback;
+	
+	//! Userdata pointer sent to the completion callback.
+	void			*userdata;
+	
+	//! The MEMORY stream once loaded.
+	MEMORY			*memory;
+	
+	//! The state of the request, either MEMORY_REQUEST_PENDING or MEMORY_REQUEST_CANCELLED.
+	unsigned char	state;
+	
+} MEMORYREQUEST;
+
+
+//! Structure definition of the asynchronous I/O queue, served by a dedicated thread in priority order.
+typedef struct
+{
+	//! The state of the I/O thread, either PLAY or STOP.
+	unsigned char	state;
+	
+	//! The I/O thread.
+	pthread_t		thread;
+	
+	//! The mutex protecting the queue.
+	pthread_mutex_t	mutex;
+	
+	//! Condition signaled when a new request is queued.
+	pthread_cond_t	cond;
+	
+	//! The id of the next request.
+	unsigned int	next_id;
+	
+	//! The number of requests waiting to be loaded.
+	unsigned int	n_pending;
+	
+	//! Array of requests waiting to be loaded.
+	MEMORYREQUEST	**pending;
+	
+	//! The request being loaded by the I/O thread (if any).
+	MEMORYREQUEST	*loading;
+	
+	//! The number of requests loaded and waiting to be delivered by mpump.
+	unsigned int	n_done;
+	
+	//! Array of requests waiting to be delivered, in completion order.
+	MEMORYREQUEST	**done;
+	
+} MEMORYQUEUE;
+
+//! Global asynchronous I/O queue. Declared as extern in memory.h and implemented in memory.cpp
+extern MEMORYQUEUE memoryqueue;
+
+
+void mresolve( char *filename, unsigned char relative_path, char *path );
+
+unsigned int mhash( char *name, unsigned int length );
+
+unsigned char mopen_apk( char *filename );
+
+void mclose_apk( void );
+
+APKENTRY *mfind_apk( char *name );
+
 MEMORY *mopen( char *filename, unsigned char relative_path );
 
+MEMORY *mopen_file( char *filename, unsigned char relative_path );
+
+MEMORY *mopen_stream( char *filename, unsigned char relative_path );
+
 MEMORY *mclose( MEMORY *memory );
 
 unsigned int mread( MEMORY *memory, void *dst, unsigned int size );
 
+unsigned int mpeek( MEMORY *memory, void *dst, unsigned int size );
+
+char *mgets( MEMORY *memory );
+
+int mseek( MEMORY *memory, int offset, int whence );
+
 void minsert( MEMORY *memory, char *str, unsigned int position );
 
+void minit_async( void );
+
+void mfree_async( void );
+
+unsigned int mopen_async( char *filename, unsigned char relative_path, int priority, MEMORYCALLBACK *memorycallback, void *userdata );
+
+unsigned char mcancel( unsigned int id );
+
+unsigned char mprioritize( unsigned int id, int priority );
+
+unsigned int mpump( void );
+
 #endif
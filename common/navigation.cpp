@@ -21,6 +21,8 @@ as being the original software.
 
 */
 
+#define ALLOCATOR_TAG ALLOCATOR_TAG_NAVIGATION
+
 #include "gfx.h"
 
 
@@ -50,7 +52,7 @@ as being the original software.
 */
 NAVIGATION *NAVIGATION_init( char *name )
 {
-	NAVIGATION *navigation = ( NAVIGATION * ) calloc( 1, sizeof( NAVIGATION ) );
+	NAVIGATION *navigation = ( NAVIGATION * ) POOL_alloc( &allocator.pool[ POOL_NAVIGATION ] );
 
 	strcpy( navigation->name, name );
 
@@ -84,7 +86,7 @@ NAVIGATION *NAVIGATION_free( NAVIGATION *navigation )
 		PROGRAM_free( navigation->program );
 	}
 	
-	free( navigation );
+	POOL_release( &allocator.pool[ POOL_NAVIGATION ], navigation );
 	
 	return NULL;
 }
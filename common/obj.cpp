@@ -21,6 +21,8 @@ as being the original software.
 
 */
 
+#define ALLOCATOR_TAG ALLOCATOR_TAG_MESH
+
 #include "gfx.h"
 
 /*!
@@ -176,7 +178,10 @@ void OBJ_add_program( OBJ  *obj,
 
 
 /*!
-	Build a specific texture index inside the OBJ TEXTURE database.
+	Build a specific texture index inside the OBJ TEXTURE database. If the same file have already been
+	created with the same parameters (by this OBJ, another one or TEXTURE_create), the registered TEXTURE
+	is shared and replace the entry of the database. If the OBJ have a TEXTURESTREAM, the TEXTURE use a
+	placeholder texture id until it get decoded and uploaded by TEXTURESTREAM_pump.
 
 	\param[in] obj A valid OBJ structure pointer.
 	\param[in] texture_index The index of the TEXTURE to build inside the OBJ TEXTURE database.
@@ -192,18 +197,56 @@ void OBJ_build_texture( OBJ			  *obj,
 						unsigned char filter,
 						float		  anisotropic_filter )
 {
-	TEXTURE *texture = obj->texture[ texture_index ];
+	TEXTURE *texture = obj->texture[ texture_index ],
+			*shared;
 
 	MEMORY *m = NULL;
 	
-	char filename[ MAX_PATH ] = {""};
+	char filename[ MAX_PATH ] = {""},
+		 path	 [ MAX_PATH ] = {""};
 	
 	sprintf( filename, "%s%s", texture_path, texture->name  );
 	
+	mresolve( filename, 0, path );
+	
+	shared = TEXTURE_registry_get( path, flags, filter, anisotropic_filter );
+	
+	if( shared )
+	{
+		if( shared != texture )
+		{
+			TEXTURE_free( texture );
+			
+			obj->texture[ texture_index ] = shared;
+		}
+		
+		// Building the same entry twice does not take a new reference.
+		else --shared->n_ref;
+		
+		return;
+	}
+	
+	if( obj->texturestream )
+	{
+		// Unregistered by TEXTURESTREAM_pump if the file cannot be loaded.
+		if( !texture->n_ref ) TEXTURE_registry_add( texture, path, flags, filter, anisotropic_filter );
+		
+		TEXTURESTREAM_request( obj->texturestream,
+							   texture,
+							   filename,
+							   0,
+							   flags,
+							   filter,
+							   anisotropic_filter );
+		return;
+	}
+	
 	m = mopen( filename, 0 );
 	
 	if( m )
 	{
+		if( !texture->n_ref ) TEXTURE_registry_add( texture, path, flags, filter, anisotropic_filter );
+		
 		TEXTURE_load( texture, m );
 		
 		TEXTURE_generate_id( texture,
@@ -398,6 +441,35 @@ void OBJ_set_draw_callback_material( OBJ *obj, unsigned int material_index, MATE
 { obj->objmaterial[ material_index ].materialdrawcallback = materialdrawcallback; }
 
 
+/*!
+	Use the page of an ATLAS as diffuse texture for a specific material index. The atlas entry
+	is looked up using the map_diffuse name of the material, and its UV scale and offset are
+	stored in the OBJMATERIAL for the shader to remap the UVs (uv * uv_scale + uv_offset).
+	
+	\param[in] obj A valid OBJ structure pointer.
+	\param[in] material_index The material index in the OBJ OBJMATERIAL database.
+	\param[in] atlas A valid packed ATLAS structure pointer.
+	
+	\return Return 1 if the diffuse texture have been found in the atlas, else 0.
+*/
+unsigned char OBJ_set_atlas_material( OBJ *obj, unsigned int material_index, ATLAS *atlas )
+{
+	OBJMATERIAL *objmaterial = &obj->objmaterial[ material_index ];
+	
+	ATLASENTRY *atlasentry = ATLAS_get_entry( atlas, objmaterial->map_diffuse, 1 );
+	
+	if( !atlasentry || atlasentry->page == ATLAS_NO_PAGE ) return 0;
+	
+	objmaterial->texture_diffuse = ATLAS_get_texture( atlas, atlasentry );
+	
+	memcpy( &objmaterial->uv_scale, &atlasentry->scale, sizeof( vec2 ) );
+	
+	memcpy( &objmaterial->uv_offset, &atlasentry->offset, sizeof( vec2 ) );
+	
+	return 1;
+}
+
+
 /*!
 	Calculate the bound of a mesh. This function will update the min and max bounding box value, update the
 	mesh dimension as well as the OBJMESH sphere radius.
@@ -1141,7 +1213,7 @@ void OBJ_free_mesh_vertex_data( OBJ *obj, unsigned int mesh_index )
 */
 unsigned char OBJ_load_mtl( OBJ *obj, char *filename, unsigned char relative_path )
 {
-	MEMORY *m = mopen( filename, relative_path );
+	MEMORY *m = mopen_stream( filename, relative_path );
 
 	OBJMATERIAL *objmaterial = NULL;
 
@@ -1151,7 +1223,7 @@ unsigned char OBJ_load_mtl( OBJ *obj, char *filename, unsigned char relative_pat
 
 	get_file_path( m->filename, obj->program_path );
 
-	char *line = strtok( ( char * )m->buffer, "\n" ),
+	char *line = mgets( m ),
 		 str[ MAX_PATH ] = {""};
 		 
 	vec3 v;
@@ -1173,6 +1245,9 @@ unsigned char OBJ_load_mtl( OBJ *obj, char *filename, unsigned char relative_pat
 			memset( objmaterial, 0, sizeof( OBJMATERIAL ) );
 					
 			strcpy( objmaterial->name, str );
+			
+			objmaterial->uv_scale.x =
+			objmaterial->uv_scale.y = 1.0f;
 		}
 
 		else if( sscanf( line, "Ka %f %f %f", &v.x, &v.y, &v.z ) == 3 )
@@ -1278,7 +1353,7 @@ unsigned char OBJ_load_mtl( OBJ *obj, char *filename, unsigned char relative_pat
 
 		next_mat_line:
 		
-			line = strtok( NULL, "\n" );
+			line = mgets( m );
 	}
 
 	mclose( m );
@@ -1288,7 +1363,8 @@ unsigned char OBJ_load_mtl( OBJ *obj, char *filename, unsigned char relative_pat
 
 
 /*!
-	Helper function to load an OBJ file.
+	Helper function to load an OBJ file. The file is streamed, so only the parsed data have to
+	fit in memory.
 
 	\param[in] filename The .OBJ filename to load.
 	\param[in] relative_path Determine if the filename is relative to the application or an absolute path.
@@ -1299,7 +1375,7 @@ OBJ *OBJ_load( char *filename, unsigned char relative_path )
 {
 	OBJ *obj = NULL;
 	
-	MEMORY *o = mopen( filename, relative_path );
+	MEMORY *o = mopen_stream( filename, relative_path );
 	
 	if( !o ) return obj;
 
@@ -1310,7 +1386,7 @@ OBJ *OBJ_load( char *filename, unsigned char relative_path )
 			 usemtl[ MAX_CHAR ] = {""},
 			 str   [ MAX_PATH ] = {""},
 			 last  = 0,
-			 *line = strtok( ( char * )o->buffer, "\n" );
+			 *line = mgets( o );
 		
 		unsigned char use_smooth_normals;
 		
@@ -1539,18 +1615,16 @@ OBJ *OBJ_load( char *filename, unsigned char relative_path )
 			
 			else if( sscanf( line, "mtllib %s", str ) == 1 )
 			{
-				o->position = ( unsigned char * )line - o->buffer + strlen( line ) + 1;
-				
 				OBJ_load_mtl( obj, str, relative_path );
 				
-				line = strtok( ( char * )&o->buffer[ o->position ], "\n" );
+				line = mgets( o );
 				continue;
 			}
 
 			next_obj_line:
 			
 				last = line[ 0 ];
-				line = strtok( NULL, "\n" );
+				line = mgets( o );
 		}
 		
 		mclose( o );
@@ -1796,6 +1870,9 @@ OBJ *OBJ_free( OBJ *obj )
 	i = 0;
 	while( i != obj->n_texture )
 	{
+		// Only cancel the streaming of the textures that are not shared with another owner.
+		if( obj->texturestream && obj->texture[ i ]->n_ref < 2 ) TEXTURESTREAM_cancel( obj->texturestream, obj->texture[ i ] );
+		
 		obj->texture[ i ] = TEXTURE_free( obj->texture[ i ] );
 		++i;
 	}
@@ -102,6 +102,12 @@ typedef struct
 	//! The bumpmap TEXTURE pointer. 
 	TEXTURE					*texture_bump;
 
+	//! The UV scale to apply to the UVs of the material when its diffuse texture is in an ATLAS (1,1 by default).
+	vec2					uv_scale;
+
+	//! The UV offset to add to the scaled UVs of the material when its diffuse texture is in an ATLAS (0,0 by default).
+	vec2					uv_offset;
+
 	//! The shader PROGRAM to use when drawing the material.
 	PROGRAM					*program;
 	
@@ -291,6 +297,9 @@ typedef struct
 	//! Array of indexed UVs.
 	vec2			*indexed_uv;		// vt
 
+	//! The TEXTURESTREAM used by OBJ_build_texture to load the textures asynchronously (if NULL the textures are loaded right away).
+	TEXTURESTREAM	*texturestream;
+
 } OBJ;
 
 
@@ -302,6 +311,8 @@ void OBJ_build_material( OBJ *obj, unsigned int material_index, PROGRAM	*program
 
 void OBJ_set_draw_callback_material( OBJ *obj, unsigned int material_index, MATERIALDRAWCALLBACK *materialdrawcallback );
 
+unsigned char OBJ_set_atlas_material( OBJ *obj, unsigned int material_index, ATLAS *atlas );
+
 void OBJ_update_bound_mesh( OBJ *obj, unsigned int mesh_index );
 
 void OBJ_build_vbo_mesh( OBJ *obj, unsigned int mesh_index );
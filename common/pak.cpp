@@ -0,0 +1,687 @@
+/*
+
+GFX Lightweight OpenGLES 2.0 Game and Graphics Engine
+
+Copyright (C) 2011 Romain Marucchi-Foino http://gfx.sio2interactive.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of
+this software. Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that
+you wrote the original software. If you use this software in a product, an acknowledgment
+in the product would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented
+as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#define ALLOCATOR_TAG ALLOCATOR_TAG_MEMORY
+
+#include "gfx.h"
+
+/*!
+	\file pak.cpp
+
+    \brief Engine pack files (.gfxpak).
+
+	\details Instead of hundreds of loose files (or APK entries), the assets can be packed
+	in a single .gfxpak file built with PAK_build. The file start with an index sorted by
+	name hash, so a lookup is a binary search, followed by the entries aligned on 16 bytes.
+	Each entry is either stored or compressed as independent zlib chunks that are
+	decompressed in parallel on a WORKER pool. Entries of the same group are stored next
+	to each other so they can be prefetched together with PAK_preload_group. Once mounted
+	with PAK_mount, mopen serve the relative paths from the PAK before the file system.
+*/
+
+
+PAKREGISTRY pakregistry = { 0, NULL, PTHREAD_MUTEX_INITIALIZER };
+
+
+/*!
+	Open a .gfxpak file. The file is kept open as a single MEMORY stream, which is a file
+	mapping on iOS, Windows and for APK entries stored without compression.
+
+	\param[in] name The internal name of the PAK.
+	\param[in] filename The .gfxpak file to open.
+	\param[in] relative_path Determine if the filename is a relative (1) or absolute (0) path.
+	\param[in] worker The WORKER pool to use to decompress large entries (can be NULL).
+
+	\return Return a new PAK structure pointer, or NULL if the file cannot be opened.
+*/
+PAK *PAK_open( char *name, char *filename, unsigned char relative_path, WORKER *worker )
+{
+	PAK *pak;
+
+	MEMORY *m = mopen( filename, relative_path );
+
+	if( !m ) return NULL;
+
+	if( m->size < sizeof( PAKHEADER ) || memcmp( m->buffer, "GFXPAK01", 8 ) )
+	{
+		console_print( "PAK: %s is not a .gfxpak file.\n", filename );
+
+		mclose( m );
+		return NULL;
+	}
+
+	pak = ( PAK * ) calloc( 1, sizeof( PAK ) );
+
+	strcpy( pak->name, name );
+
+	pak->memory	   = m;
+	pak->worker	   = worker;
+	pak->pakheader = ( PAKHEADER * )m->buffer;
+	pak->pakentry  = ( PAKENTRY * )&m->buffer[ sizeof( PAKHEADER ) ];
+	pak->names	   = ( char * )&m->buffer[ pak->pakheader->name_offset ];
+
+	return pak;
+}
+
+
+/*!
+	Close a PAK, it is unmounted if needed. The MEMORY streams read from the PAK stay valid.
+
+	\param[in,out] pak A valid PAK structure pointer.
+
+	\return Return a NULL PAK structure pointer.
+*/
+PAK *PAK_close( PAK *pak )
+{
+	PAK_unmount( pak );
+
+	mclose( pak->memory );
+
+	free( pak );
+	return NULL;
+}
+
+
+/*!
+	Look for an entry using a binary search on the hash of its name.
+
+	\param[in] pak A valid PAK structure pointer.
+	\param[in] name The name of the entry. \sa PAKFILE
+
+	\return Return the PAKENTRY structure pointer, or NULL if the entry does not exist.
+*/
+PAKENTRY *PAK_find( PAK *pak, char *name )
+{
+	unsigned int length = strlen( name ),
+				 hash	= mhash( name, length ),
+				 first	= 0,
+				 last	= pak->pakheader->n_pakentry;
+
+	while( first != last )
+	{
+		unsigned int middle = ( first + last ) >> 1;
+
+		if( pak->pakentry[ middle ].hash < hash ) first = middle + 1;
+
+		else last = middle;
+	}
+
+	// Check the names of all the entries sharing the hash.
+	while( first != pak->pakheader->n_pakentry && pak->pakentry[ first ].hash == hash )
+	{
+		PAKENTRY *pakentry = &pak->pakentry[ first ];
+
+		if( pakentry->name_length == length &&
+			!memcmp( &pak->names[ pakentry->name_offset ], name, length ) ) return pakentry;
+
+		++first;
+	}
+
+	return NULL;
+}
+
+
+/*!
+	Decompress a chunk. This function is used internally as WORKER task callback.
+
+	\param[in,out] ptr The PAKCHUNK structure pointer to decompress.
+*/
+void PAK_inflate_chunk( void *ptr )
+{
+	PAKCHUNK *pakchunk = ( PAKCHUNK * )ptr;
+
+	uLongf size = pakchunk->dst_size;
+
+	pakchunk->status = uncompress( pakchunk->dst,
+								   &size,
+								   pakchunk->src,
+								   pakchunk->src_size ) == Z_OK && size == pakchunk->dst_size;
+}
+
+
+/*!
+	Extract an entry in a new MEMORY stream followed by a NULL byte. The chunks of a
+	compressed entry are decompressed in parallel when the PAK have a WORKER pool.
+
+	\param[in] pak A valid PAK structure pointer.
+	\param[in] pakentry A valid PAKENTRY structure pointer of the PAK.
+
+	\return Return a new MEMORY structure pointer, or NULL if the entry is corrupted.
+*/
+MEMORY *PAK_read( PAK *pak, PAKENTRY *pakentry )
+{
+	unsigned char *data = &pak->memory->buffer[ pakentry->offset ];
+
+	MEMORY *memory = ( MEMORY * ) calloc( 1, sizeof( MEMORY ) );
+
+	unsigned int i		 = 0,
+				 offset	 = pakentry->n_chunk * sizeof( unsigned int ),
+				 counter = 0,
+				 status	 = 1;
+
+	PAKCHUNK *pakchunk;
+
+	// The names are not NULL terminated and come from the file, keep the room for the NULL byte.
+	memcpy( memory->filename,
+			&pak->names[ pakentry->name_offset ],
+			pakentry->name_length < sizeof( memory->filename ) ? pakentry->name_length : sizeof( memory->filename ) - 1 );
+
+	memory->size   = pakentry->size;
+	memory->buffer = ( unsigned char * ) malloc( memory->size + 1 );
+	memory->buffer[ memory->size ] = 0;
+
+	if( !pakentry->n_chunk )
+	{
+		memcpy( memory->buffer, data, memory->size );
+
+		return memory;
+	}
+
+	pakchunk = ( PAKCHUNK * ) malloc( pakentry->n_chunk * sizeof( PAKCHUNK ) );
+
+	while( i != pakentry->n_chunk )
+	{
+		unsigned int chunk_offset = i * pak->pakheader->chunk_size;
+
+		pakchunk[ i ].src	   = &data[ offset ];
+		pakchunk[ i ].src_size = ( ( unsigned int * )data )[ i ];
+		pakchunk[ i ].dst	   = &memory->buffer[ chunk_offset ];
+		pakchunk[ i ].dst_size = memory->size - chunk_offset < pak->pakheader->chunk_size ?
+								 memory->size - chunk_offset :
+								 pak->pakheader->chunk_size;
+
+		offset += pakchunk[ i ].src_size;
+
+		// Keep the last chunk for the calling thread.
+		if( pak->worker && i + 1 != pakentry->n_chunk ) WORKER_push( pak->worker, PAK_inflate_chunk, &pakchunk[ i ], &counter );
+
+		else PAK_inflate_chunk( &pakchunk[ i ] );
+
+		++i;
+	}
+
+	if( pak->worker ) WORKER_wait( pak->worker, &counter );
+
+	i = 0;
+	while( i != pakentry->n_chunk )
+	{
+		status &= pakchunk[ i ].status;
+		++i;
+	}
+
+	free( pakchunk );
+
+	if( !status )
+	{
+		console_print( "PAK: %s is corrupted.\n", memory->filename );
+
+		return mclose( memory );
+	}
+
+	return memory;
+}
+
+
+/*!
+	Ask the system to prefetch the data of a group of entries, for example at the start of
+	a loading screen. Only useful when the PAK is mapped.
+
+	\param[in] pak A valid PAK structure pointer.
+	\param[in] group The group to prefetch.
+*/
+void PAK_preload_group( PAK *pak, unsigned int group )
+{
+	unsigned int i	   = 0,
+				 start = 0xFFFFFFFF,
+				 end   = 0;
+
+	while( i != pak->pakheader->n_pakentry )
+	{
+		PAKENTRY *pakentry = &pak->pakentry[ i ];
+
+		if( pakentry->group == group )
+		{
+			if( pakentry->offset < start ) start = pakentry->offset;
+
+			if( pakentry->offset + pakentry->compressed_size > end ) end = pakentry->offset + pakentry->compressed_size;
+		}
+
+		++i;
+	}
+
+	if( !pak->memory->mapped_size || start >= end ) return;
+
+	#ifndef _WIN32
+	{
+		unsigned int page	= ( unsigned int )sysconf( _SC_PAGESIZE );
+
+		unsigned char *addr = &pak->memory->buffer[ start ],
+					  *base = ( unsigned char * )( ( size_t )addr & ~( size_t )( page - 1 ) );
+
+		madvise( base, end - start + ( addr - base ), MADV_WILLNEED );
+	}
+	#endif
+}
+
+
+/*!
+	Mount a PAK, mopen will look for the relative paths in the PAK before the file system.
+
+	\param[in] pak A valid PAK structure pointer.
+*/
+void PAK_mount( PAK *pak )
+{
+	pthread_mutex_lock( &pakregistry.mutex );
+
+	pakregistry.pak = ( PAK ** ) realloc( pakregistry.pak,
+										  ( pakregistry.n_pak + 1 ) * sizeof( PAK * ) );
+
+	pakregistry.pak[ pakregistry.n_pak ] = pak;
+
+	++pakregistry.n_pak;
+
+	pthread_mutex_unlock( &pakregistry.mutex );
+}
+
+
+/*!
+	Unmount a PAK previously mounted with PAK_mount.
+
+	\param[in] pak A valid PAK structure pointer.
+*/
+void PAK_unmount( PAK *pak )
+{
+	unsigned int i = 0;
+
+	pthread_mutex_lock( &pakregistry.mutex );
+
+	while( i != pakregistry.n_pak )
+	{
+		if( pakregistry.pak[ i ] == pak )
+		{
+			--pakregistry.n_pak;
+
+			memmove( &pakregistry.pak[ i ],
+					 &pakregistry.pak[ i + 1 ],
+					 ( pakregistry.n_pak - i ) * sizeof( PAK * ) );
+
+			if( !pakregistry.n_pak )
+			{
+				free( pakregistry.pak );
+				pakregistry.pak = NULL;
+			}
+
+			break;
+		}
+
+		++i;
+	}
+
+	pthread_mutex_unlock( &pakregistry.mutex );
+}
+
+
+/*!
+	Look for a file in the mounted PAK. This function is used internally by mopen. The
+	registry stay locked while the entry is read, so its PAK cannot be unmounted meanwhile.
+
+	\param[in] filename The relative path of the file.
+
+	\return Return a new MEMORY structure pointer, or NULL if the file is not in a mounted PAK.
+*/
+MEMORY *PAK_mopen( char *filename )
+{
+	MEMORY *memory = NULL;
+
+	unsigned int i;
+
+	pthread_mutex_lock( &pakregistry.mutex );
+
+	i = pakregistry.n_pak;
+
+	while( i )
+	{
+		--i;
+
+		PAKENTRY *pakentry = PAK_find( pakregistry.pak[ i ], filename );
+
+		if( pakentry )
+		{
+			memory = PAK_read( pakregistry.pak[ i ], pakentry );
+			break;
+		}
+	}
+
+	pthread_mutex_unlock( &pakregistry.mutex );
+
+	return memory;
+}
+
+
+/*!
+	Sort the entries by hash. This function is used internally as qsort callback.
+*/
+int PAK_compare_hash( const void *a, const void *b )
+{
+	PAKENTRY *pakentry_a = ( PAKENTRY * )a,
+			 *pakentry_b = ( PAKENTRY * )b;
+
+	if( pakentry_a->hash != pakentry_b->hash ) return pakentry_a->hash < pakentry_b->hash ? -1 : 1;
+
+	return 0;
+}
+
+
+/*!
+	Build a .gfxpak file, this is the offline builder used to cook the assets. The files are
+	written group by group, in the order they are given within a group. A file flagged to be
+	compressed is split in independent zlib chunks, and stored anyway if it does not shrink
+	by at least 10%.
+
+	\param[in] filename The absolute path of the .gfxpak file to create.
+	\param[in] n_pakfile The number of files to pack.
+	\param[in] pakfile Array of files to pack.
+	\param[in] chunk_size The amount of uncompressed bytes per chunk (0 for PAK_CHUNK_SIZE).
+
+	\return Return 1 if the file have been built, else 0.
+*/
+unsigned char PAK_build( char *filename, unsigned int n_pakfile, PAKFILE *pakfile, unsigned int chunk_size )
+{
+	const unsigned char padding[ 16 ] = { 0 };
+
+	unsigned int i = 0,
+				 j,
+				 offset,
+				 name_size = 0,
+				 *order	   = ( unsigned int * ) malloc( n_pakfile * sizeof( unsigned int ) );
+
+	PAKHEADER pakheader;
+
+	PAKENTRY *pakentry = ( PAKENTRY * ) calloc( n_pakfile, sizeof( PAKENTRY ) );
+
+	FILE *f = fopen( filename, "wb" );
+
+	if( !f )
+	{
+		free( pakentry );
+		free( order );
+
+		return 0;
+	}
+
+	if( !chunk_size ) chunk_size = PAK_CHUNK_SIZE;
+
+	memset( &pakheader, 0, sizeof( PAKHEADER ) );
+
+	memcpy( pakheader.identifier, "GFXPAK01", 8 );
+
+	pakheader.n_pakentry  = n_pakfile;
+	pakheader.chunk_size  = chunk_size;
+	pakheader.name_offset = sizeof( PAKHEADER ) + n_pakfile * sizeof( PAKENTRY );
+
+	while( i != n_pakfile )
+	{
+		pakentry[ i ].name_offset = name_size;
+		pakentry[ i ].name_length = strlen( pakfile[ i ].name );
+		pakentry[ i ].hash		  = mhash( pakfile[ i ].name, pakentry[ i ].name_length );
+		pakentry[ i ].group		  = pakfile[ i ].group;
+
+		name_size += pakentry[ i ].name_length;
+
+		order[ i ] = i;
+
+		++i;
+	}
+
+	pakheader.name_size = name_size;
+
+	// Insertion sort by group keep the order of the files within a group.
+	i = 1;
+	while( i < n_pakfile )
+	{
+		unsigned int k = order[ i ];
+
+		j = i;
+		while( j && pakfile[ order[ j - 1 ] ].group > pakfile[ k ].group )
+		{
+			order[ j ] = order[ j - 1 ];
+			--j;
+		}
+
+		order[ j ] = k;
+
+		++i;
+	}
+
+	// Reserve the header, the index and the names, they are written once the data offsets are known.
+	offset = ( pakheader.name_offset + name_size + 15 ) & ~15;
+
+	fseek( f, offset, SEEK_SET );
+
+	i = 0;
+	while( i != n_pakfile )
+	{
+		PAKFILE *file = &pakfile[ order[ i ] ];
+
+		PAKENTRY *entry = &pakentry[ order[ i ] ];
+
+		MEMORY *m = mopen( file->filename, file->relative_path );
+
+		if( !m )
+		{
+			console_print( "PAK: Unable to open %s\n", file->filename );
+
+			fclose( f );
+
+			free( pakentry );
+			free( order );
+
+			return 0;
+		}
+
+		entry->offset		   = offset;
+		entry->size			   = m->size;
+		entry->compressed_size = m->size;
+
+		if( file->compress && m->size )
+		{
+			unsigned int n_chunk = ( m->size + chunk_size - 1 ) / chunk_size,
+						 *size	 = ( unsigned int * ) malloc( n_chunk * sizeof( unsigned int ) ),
+						 compressed_size = n_chunk * sizeof( unsigned int );
+
+			unsigned char *buffer = ( unsigned char * ) malloc( n_chunk * compressBound( chunk_size ) ),
+						  *dst	  = buffer;
+
+			j = 0;
+			while( j != n_chunk )
+			{
+				uLongf dst_size = compressBound( chunk_size );
+
+				unsigned int src_size = m->size - j * chunk_size < chunk_size ? m->size - j * chunk_size : chunk_size;
+
+				compress2( dst, &dst_size, &m->buffer[ j * chunk_size ], src_size, 9 );
+
+				size[ j ] = ( unsigned int )dst_size;
+
+				compressed_size += size[ j ];
+
+				dst += dst_size;
+
+				++j;
+			}
+
+			if( compressed_size < m->size - m->size / 10 )
+			{
+				entry->n_chunk		   = n_chunk;
+				entry->compressed_size = compressed_size;
+
+				fwrite( size, sizeof( unsigned int ), n_chunk, f );
+
+				fwrite( buffer, compressed_size - n_chunk * sizeof( unsigned int ), 1, f );
+			}
+
+			free( buffer );
+			free( size );
+		}
+
+		if( !entry->n_chunk ) fwrite( m->buffer, m->size, 1, f );
+
+		mclose( m );
+
+		offset += entry->compressed_size;
+
+		fwrite( padding, ( 16 - ( offset & 15 ) ) & 15, 1, f );
+
+		offset = ( offset + 15 ) & ~15;
+
+		++i;
+	}
+
+	fseek( f, 0, SEEK_SET );
+
+	fwrite( &pakheader, sizeof( PAKHEADER ), 1, f );
+
+	fseek( f, pakheader.name_offset, SEEK_SET );
+
+	i = 0;
+	while( i != n_pakfile )
+	{
+		fwrite( pakfile[ i ].name, pakentry[ i ].name_length, 1, f );
+		++i;
+	}
+
+	// The names are written in the original order, the index is sorted for the binary search.
+	qsort( pakentry, n_pakfile, sizeof( PAKENTRY ), PAK_compare_hash );
+
+	fseek( f, sizeof( PAKHEADER ), SEEK_SET );
+
+	fwrite( pakentry, sizeof( PAKENTRY ), n_pakfile, f );
+
+	fclose( f );
+
+	free( pakentry );
+	free( order );
+
+	return 1;
+}
+
+
+/*!
+	Read one byte per page of a MEMORY stream, so the lazy file mappings are really loaded
+	during the benchmark. This function is used internally.
+
+	\param[in] memory A valid MEMORY structure pointer.
+
+	\return Return the sum of the bytes read.
+*/
+unsigned int PAK_touch( MEMORY *memory )
+{
+	unsigned int i	 = 0,
+				 sum = 0;
+
+	while( i < memory->size )
+	{
+		sum += memory->buffer[ i ];
+
+		i += 4096;
+	}
+
+	return sum;
+}
+
+
+/*!
+	Compare the time needed to load every entry of a PAK from the PAK and from the matching
+	loose files (opened with mopen_file as relative paths, bypassing the mounted PAK), and
+	print the result in the console.
+
+	\param[in] pak A valid PAK structure pointer.
+*/
+void PAK_benchmark( PAK *pak )
+{
+	unsigned int i		 = 0,
+				 n_byte	 = 0,
+				 n_loose = 0,
+				 checksum = 0,
+				 start,
+				 pak_time,
+				 loose_time;
+
+	start = get_micro_time();
+
+	while( i != pak->pakheader->n_pakentry )
+	{
+		MEMORY *m = PAK_read( pak, &pak->pakentry[ i ] );
+
+		if( m )
+		{
+			n_byte += m->size;
+
+			checksum += PAK_touch( m );
+
+			mclose( m );
+		}
+
+		++i;
+	}
+
+	pak_time = get_micro_time() - start;
+
+	start = get_micro_time();
+
+	i = 0;
+	while( i != pak->pakheader->n_pakentry )
+	{
+		char name[ MAX_PATH ] = {""};
+
+		MEMORY *m;
+
+		memcpy( name,
+				&pak->names[ pak->pakentry[ i ].name_offset ],
+				pak->pakentry[ i ].name_length < MAX_PATH ? pak->pakentry[ i ].name_length : MAX_PATH - 1 );
+
+		m = mopen_file( name, 1 );
+
+		if( m )
+		{
+			++n_loose;
+
+			checksum += PAK_touch( m );
+
+			mclose( m );
+		}
+
+		++i;
+	}
+
+	loose_time = get_micro_time() - start;
+
+	console_print( "PAK: %s %d entries %dKB pak:%dms loose(%d):%dms (%08X)\n",
+				   pak->name,
+				   pak->pakheader->n_pakentry,
+				   n_byte >> 10,
+				   pak_time / 1000,
+				   n_loose,
+				   loose_time / 1000,
+				   checksum );
+}
@@ -0,0 +1,193 @@
+/*
+
+GFX Lightweight OpenGLES 2.0 Game and Graphics Engine
+
+Copyright (C) 2011 Romain Marucchi-Foino http://gfx.sio2interactive.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of
+this software. Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that
+you wrote the original software. If you use this software in a product, an acknowledgment
+in the product would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented
+as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef PAK_H
+#define PAK_H
+
+/*!
+	\file pak.h
+
+    \brief Contains structure definition and functions to use with a PAK file.
+*/
+
+
+//! The default amount of uncompressed bytes per compressed chunk. \sa PAK_build
+#define PAK_CHUNK_SIZE	262144
+
+
+//! Header of a .gfxpak file.
+typedef struct
+{
+	//! The file identifier "GFXPAK01".
+	char			identifier[ 8 ];
+
+	//! The number of entries.
+	unsigned int	n_pakentry;
+
+	//! The amount of uncompressed bytes per compressed chunk.
+	unsigned int	chunk_size;
+
+	//! The offset of the entry names.
+	unsigned int	name_offset;
+
+	//! The size of the entry names in bytes.
+	unsigned int	name_size;
+
+} PAKHEADER;
+
+
+//! Structure definition of an entry of the index of a .gfxpak file, the index is sorted by hash.
+typedef struct
+{
+	//! The hash of the name of the entry. \sa mhash
+	unsigned int	hash;
+
+	//! The offset of the name of the entry in the names (not NULL terminated).
+	unsigned int	name_offset;
+
+	//! The length of the name in bytes.
+	unsigned int	name_length;
+
+	//! The group the entry belongs to, the entries of a group are stored contiguously.
+	unsigned int	group;
+
+	//! The offset of the data of the entry in the file (16 bytes aligned).
+	unsigned int	offset;
+
+	//! The size of the entry once extracted.
+	unsigned int	size;
+
+	//! The size of the data of the entry in the file.
+	unsigned int	compressed_size;
+
+	//! The number of zlib chunks of the entry, 0 if the entry is stored. The data start with the compressed size of each chunk.
+	unsigned int	n_chunk;
+
+} PAKENTRY;
+
+
+//! Structure definition of a file to add to a .gfxpak file. \sa PAK_build
+typedef struct
+{
+	//! The name used to open the file with mopen once the PAK is mounted.
+	char			name[ MAX_PATH ];
+
+	//! The file to read.
+	char			filename[ MAX_PATH ];
+
+	//! Determine if the filename is relative (1) or absolute (0).
+	unsigned char	relative_path;
+
+	//! The group of the file, use the same group for the files that load together.
+	unsigned int	group;
+
+	//! Determine if the file should be compressed (1) or stored (0). Files that do not compress well are always stored.
+	unsigned char	compress;
+
+} PAKFILE;
+
+
+//! Structure definition of an opened .gfxpak file.
+typedef struct
+{
+	//! The internal name of the PAK.
+	char			name[ MAX_CHAR ];
+
+	//! The MEMORY stream of the whole file (usually a file mapping).
+	MEMORY			*memory;
+
+	//! The header of the file.
+	PAKHEADER		*pakheader;
+
+	//! The index of the file, sorted by hash.
+	PAKENTRY		*pakentry;
+
+	//! The names of the entries.
+	char			*names;
+
+	//! The WORKER pool used to decompress the chunks of large entries in parallel (can be NULL).
+	WORKER			*worker;
+
+} PAK;
+
+
+//! Structure definition of a chunk decompressed by a WORKER pool.
+typedef struct
+{
+	//! The compressed data.
+	unsigned char	*src;
+
+	//! The size of the compressed data.
+	unsigned int	src_size;
+
+	//! The destination buffer.
+	unsigned char	*dst;
+
+	//! The size of the chunk once decompressed.
+	unsigned int	dst_size;
+
+	//! Determine if the chunk have been decompressed successfully.
+	unsigned char	status;
+
+} PAKCHUNK;
+
+
+//! Structure definition of the list of PAK mounted in mopen.
+typedef struct
+{
+	//! The number of PAK mounted.
+	unsigned int	n_pak;
+
+	//! Array of PAK mounted, the last one mounted is searched first.
+	PAK				**pak;
+
+	//! The mutex protecting the registry, mopen can be called from any thread (mopen_async, WORKER pools).
+	pthread_mutex_t	mutex;
+
+} PAKREGISTRY;
+
+//! Global list of mounted PAK. Declared as extern in pak.h and implemented in pak.cpp
+extern PAKREGISTRY pakregistry;
+
+
+PAK *PAK_open( char *name, char *filename, unsigned char relative_path, WORKER *worker );
+
+PAK *PAK_close( PAK *pak );
+
+PAKENTRY *PAK_find( PAK *pak, char *name );
+
+MEMORY *PAK_read( PAK *pak, PAKENTRY *pakentry );
+
+void PAK_preload_group( PAK *pak, unsigned int group );
+
+void PAK_mount( PAK *pak );
+
+void PAK_unmount( PAK *pak );
+
+MEMORY *PAK_mopen( char *filename );
+
+unsigned char PAK_build( char *filename, unsigned int n_pakfile, PAKFILE *pakfile, unsigned int chunk_size );
+
+void PAK_benchmark( PAK *pak );
+
+#endif
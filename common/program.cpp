@@ -21,6 +21,8 @@ as being the original software.
 
 */
 
+#define ALLOCATOR_TAG ALLOCATOR_TAG_SHADER
+
 #include "gfx.h"
 
 
@@ -45,7 +47,7 @@ as being the original software.
 */
 PROGRAM *PROGRAM_init( const char *name )
 {
-	PROGRAM *program = ( PROGRAM * ) calloc( 1, sizeof( PROGRAM ) );
+	PROGRAM *program = ( PROGRAM * ) POOL_alloc( &allocator.pool[ POOL_PROGRAM ] );
 
 	strcpy( program->name, name );
 	
@@ -68,7 +70,7 @@ PROGRAM *PROGRAM_free( PROGRAM *program )
 	
 	if( program->pid ) PROGRAM_delete_id( program );
 
-	free( program );
+	POOL_release( &allocator.pool[ POOL_PROGRAM ], program );
 	return NULL;
 }
 
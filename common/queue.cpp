@@ -0,0 +1,623 @@
+/*
+
+GFX Lightweight OpenGLES 2.0 Game and Graphics Engine
+
+Copyright (C) 2011 Romain Marucchi-Foino http://gfx.sio2interactive.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of
+this software. Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that
+you wrote the original software. If you use this software in a product, an acknowledgment
+in the product would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented
+as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#define ALLOCATOR_TAG ALLOCATOR_TAG_THREAD
+
+#include "gfx.h"
+
+/*!
+	\file queue.cpp
+
+    \brief Bounded lock-free queues of pointers to pass messages between threads.
+
+	\details SPSCQUEUE connects exactly one producer thread to one consumer thread (for example
+	the main thread feeding a streaming THREAD), each side only writing its own index.
+	MPMCQUEUE can be used by any number of producers and consumers, each cell carrying a
+	sequence number telling if it is ready for the push or the pop of a given index (Dmitry
+	Vyukov's bounded queue). Neither queue ever blocks or allocates: a push on a full queue
+	and a pop on an empty queue fail right away. The batch functions move as many pointers
+	as possible in a single update of the shared index. NULL cannot be pushed, since pop
+	return NULL when the queue is empty. SPSCQUEUE_benchmark and MPMCQUEUE_benchmark stress
+	both queues under contention, check the messages received and print their throughput.
+*/
+
+
+/*!
+	Round a capacity to the next power of two. This function is used internally.
+	
+	\param[in] capacity The requested capacity.
+	
+	\return Return the capacity to use.
+*/
+unsigned int QUEUE_get_capacity( unsigned int capacity )
+{
+	unsigned int size = 2;
+	
+	while( size < capacity ) size <<= 1;
+	
+	return size;
+}
+
+
+/*!
+	Create a new single producer, single consumer queue.
+	
+	\param[in] capacity The maximum number of pointers in the queue, rounded up to a power of two.
+	
+	\return Return a new SPSCQUEUE structure pointer.
+*/
+SPSCQUEUE *SPSCQUEUE_init( unsigned int capacity )
+{
+	SPSCQUEUE *spscqueue = ( SPSCQUEUE * ) calloc( 1, sizeof( SPSCQUEUE ) );
+	
+	capacity = QUEUE_get_capacity( capacity );
+	
+	spscqueue->mask = capacity - 1;
+	spscqueue->data = ( void ** ) calloc( capacity, sizeof( void * ) );
+	
+	return spscqueue;
+}
+
+
+/*!
+	Free a queue, the pointers still in the queue are not freed.
+	
+	\param[in,out] spscqueue A valid SPSCQUEUE structure pointer.
+	
+	\return Return a NULL SPSCQUEUE structure pointer.
+*/
+SPSCQUEUE *SPSCQUEUE_free( SPSCQUEUE *spscqueue )
+{
+	free( spscqueue->data );
+	
+	free( spscqueue );
+	return NULL;
+}
+
+
+/*!
+	Push pointers at the end of the queue, only from the producer thread.
+	
+	\param[in,out] spscqueue A valid SPSCQUEUE structure pointer.
+	\param[in] ptr Array of pointers to push (not NULL).
+	\param[in] n The number of pointers.
+	
+	\return Return the number of pointers pushed, less than n if the queue is full.
+*/
+unsigned int SPSCQUEUE_push_batch( SPSCQUEUE *spscqueue, void **ptr, unsigned int n )
+{
+	unsigned int i	  = 0,
+				 tail = ( unsigned int )spscqueue->tail,
+				 size = spscqueue->mask + 1;
+	
+	// Only read the index of the consumer when the queue looks full.
+	if( size - ( tail - spscqueue->cached_head ) < n )
+	{ spscqueue->cached_head = ( unsigned int )ATOMIC_load( &spscqueue->head ); }
+	
+	if( size - ( tail - spscqueue->cached_head ) < n ) n = size - ( tail - spscqueue->cached_head );
+	
+	while( i != n )
+	{
+		spscqueue->data[ ( tail + i ) & spscqueue->mask ] = ptr[ i ];
+		++i;
+	}
+	
+	if( n ) ATOMIC_store( &spscqueue->tail, ( int )( tail + n ) );
+	
+	return n;
+}
+
+
+/*!
+	Push a pointer at the end of the queue, only from the producer thread.
+	
+	\param[in,out] spscqueue A valid SPSCQUEUE structure pointer.
+	\param[in] ptr The pointer to push (not NULL).
+	
+	\return Return 1 if the pointer have been pushed, 0 if the queue is full.
+*/
+unsigned char SPSCQUEUE_push( SPSCQUEUE *spscqueue, void *ptr )
+{ return ( unsigned char )SPSCQUEUE_push_batch( spscqueue, &ptr, 1 ); }
+
+
+/*!
+	Pop pointers from the front of the queue, only from the consumer thread.
+	
+	\param[in,out] spscqueue A valid SPSCQUEUE structure pointer.
+	\param[out] ptr Array receiving the pointers.
+	\param[in] n The maximum number of pointers to pop.
+	
+	\return Return the number of pointers popped, less than n if the queue had less.
+*/
+unsigned int SPSCQUEUE_pop_batch( SPSCQUEUE *spscqueue, void **ptr, unsigned int n )
+{
+	unsigned int i	  = 0,
+				 head = ( unsigned int )spscqueue->head;
+	
+	// Only read the index of the producer when the queue looks empty.
+	if( spscqueue->cached_tail - head < n )
+	{ spscqueue->cached_tail = ( unsigned int )ATOMIC_load( &spscqueue->tail ); }
+	
+	if( spscqueue->cached_tail - head < n ) n = spscqueue->cached_tail - head;
+	
+	while( i != n )
+	{
+		ptr[ i ] = spscqueue->data[ ( head + i ) & spscqueue->mask ];
+		++i;
+	}
+	
+	if( n ) ATOMIC_store( &spscqueue->head, ( int )( head + n ) );
+	
+	return n;
+}
+
+
+/*!
+	Pop a pointer from the front of the queue, only from the consumer thread.
+	
+	\param[in,out] spscqueue A valid SPSCQUEUE structure pointer.
+	
+	\return Return the pointer, or NULL if the queue is empty.
+*/
+void *SPSCQUEUE_pop( SPSCQUEUE *spscqueue )
+{
+	void *ptr = NULL;
+	
+	SPSCQUEUE_pop_batch( spscqueue, &ptr, 1 );
+	
+	return ptr;
+}
+
+
+/*!
+	Create a new multiple producers, multiple consumers queue.
+	
+	\param[in] capacity The maximum number of pointers in the queue, rounded up to a power of two.
+	
+	\return Return a new MPMCQUEUE structure pointer.
+*/
+MPMCQUEUE *MPMCQUEUE_init( unsigned int capacity )
+{
+	unsigned int i = 0;
+	
+	MPMCQUEUE *mpmcqueue = ( MPMCQUEUE * ) calloc( 1, sizeof( MPMCQUEUE ) );
+	
+	capacity = QUEUE_get_capacity( capacity );
+	
+	mpmcqueue->mask		= capacity - 1;
+	mpmcqueue->mpmccell = ( MPMCCELL * ) calloc( capacity, sizeof( MPMCCELL ) );
+	
+	while( i != capacity )
+	{
+		mpmcqueue->mpmccell[ i ].sequence = i;
+		++i;
+	}
+	
+	return mpmcqueue;
+}
+
+
+/*!
+	Free a queue, the pointers still in the queue are not freed.
+	
+	\param[in,out] mpmcqueue A valid MPMCQUEUE structure pointer.
+	
+	\return Return a NULL MPMCQUEUE structure pointer.
+*/
+MPMCQUEUE *MPMCQUEUE_free( MPMCQUEUE *mpmcqueue )
+{
+	free( mpmcqueue->mpmccell );
+	
+	free( mpmcqueue );
+	return NULL;
+}
+
+
+/*!
+	Push pointers at the end of the queue. The pointers are claimed with a single update of
+	the push index, as many as there are consecutive free cells (up to n).
+	
+	\param[in,out] mpmcqueue A valid MPMCQUEUE structure pointer.
+	\param[in] ptr Array of pointers to push (not NULL).
+	\param[in] n The number of pointers.
+	
+	\return Return the number of pointers pushed, less than n if the queue is full.
+*/
+unsigned int MPMCQUEUE_push_batch( MPMCQUEUE *mpmcqueue, void **ptr, unsigned int n )
+{
+	unsigned int i,
+				 tail;
+	
+	if( !n ) return 0;
+	
+	while( 1 )
+	{
+		tail = ( unsigned int )ATOMIC_load( &mpmcqueue->tail );
+		
+		i = 0;
+		while( i != n && ( unsigned int )ATOMIC_load( &mpmcqueue->mpmccell[ ( tail + i ) & mpmcqueue->mask ].sequence ) == tail + i ) ++i;
+		
+		if( i )
+		{
+			if( ATOMIC_cas( &mpmcqueue->tail, ( int )tail, ( int )( tail + i ) ) ) break;
+		}
+		
+		// The cell still holds the pointer pushed one lap before, the queue is full.
+		else if( ( int )( ATOMIC_load( &mpmcqueue->mpmccell[ tail & mpmcqueue->mask ].sequence ) - tail ) < 0 ) return 0;
+	}
+	
+	n = i;
+	i = 0;
+	while( i != n )
+	{
+		MPMCCELL *mpmccell = &mpmcqueue->mpmccell[ ( tail + i ) & mpmcqueue->mask ];
+		
+		mpmccell->data = ptr[ i ];
+		
+		ATOMIC_store( &mpmccell->sequence, ( int )( tail + i + 1 ) );
+		
+		++i;
+	}
+	
+	return n;
+}
+
+
+/*!
+	Push a pointer at the end of the queue.
+	
+	\param[in,out] mpmcqueue A valid MPMCQUEUE structure pointer.
+	\param[in] ptr The pointer to push (not NULL).
+	
+	\return Return 1 if the pointer have been pushed, 0 if the queue is full.
+*/
+unsigned char MPMCQUEUE_push( MPMCQUEUE *mpmcqueue, void *ptr )
+{ return ( unsigned char )MPMCQUEUE_push_batch( mpmcqueue, &ptr, 1 ); }
+
+
+/*!
+	Pop pointers from the front of the queue. The pointers are claimed with a single update
+	of the pop index, as many as there are consecutive pushed cells (up to n).
+	
+	\param[in,out] mpmcqueue A valid MPMCQUEUE structure pointer.
+	\param[out] ptr Array receiving the pointers.
+	\param[in] n The maximum number of pointers to pop.
+	
+	\return Return the number of pointers popped, less than n if the queue had less.
+*/
+unsigned int MPMCQUEUE_pop_batch( MPMCQUEUE *mpmcqueue, void **ptr, unsigned int n )
+{
+	unsigned int i,
+				 head;
+	
+	if( !n ) return 0;
+	
+	while( 1 )
+	{
+		head = ( unsigned int )ATOMIC_load( &mpmcqueue->head );
+		
+		i = 0;
+		while( i != n && ( unsigned int )ATOMIC_load( &mpmcqueue->mpmccell[ ( head + i ) & mpmcqueue->mask ].sequence ) == head + i + 1 ) ++i;
+		
+		if( i )
+		{
+			if( ATOMIC_cas( &mpmcqueue->head, ( int )head, ( int )( head + i ) ) ) break;
+		}
+		
+		// The cell have not been pushed yet, the queue is empty.
+		else if( ( int )( ATOMIC_load( &mpmcqueue->mpmccell[ head & mpmcqueue->mask ].sequence ) - ( head + 1 ) ) < 0 ) return 0;
+	}
+	
+	n = i;
+	i = 0;
+	while( i != n )
+	{
+		MPMCCELL *mpmccell = &mpmcqueue->mpmccell[ ( head + i ) & mpmcqueue->mask ];
+		
+		ptr[ i ] = mpmccell->data;
+		
+		// Ready for the push of the next lap.
+		ATOMIC_store( &mpmccell->sequence, ( int )( head + i + mpmcqueue->mask + 1 ) );
+		
+		++i;
+	}
+	
+	return n;
+}
+
+
+/*!
+	Pop a pointer from the front of the queue.
+	
+	\param[in,out] mpmcqueue A valid MPMCQUEUE structure pointer.
+	
+	\return Return the pointer, or NULL if the queue is empty.
+*/
+void *MPMCQUEUE_pop( MPMCQUEUE *mpmcqueue )
+{
+	void *ptr = NULL;
+	
+	MPMCQUEUE_pop_batch( mpmcqueue, &ptr, 1 );
+	
+	return ptr;
+}
+
+
+/*!
+	Push a batch of messages on the queue of a benchmark thread. This function is used internally.
+	
+	\param[in,out] queuebenchmark A valid QUEUEBENCHMARK structure pointer.
+	\param[in] ptr Array of pointers to push.
+	\param[in] n The number of pointers.
+	
+	\return Return the number of pointers pushed.
+*/
+unsigned int QUEUE_push_batch( QUEUEBENCHMARK *queuebenchmark, void **ptr, unsigned int n )
+{
+	return queuebenchmark->mpmc ?
+		   MPMCQUEUE_push_batch( ( MPMCQUEUE * )queuebenchmark->queue, ptr, n ) :
+		   SPSCQUEUE_push_batch( ( SPSCQUEUE * )queuebenchmark->queue, ptr, n );
+}
+
+
+/*!
+	Pop a batch of messages from the queue of a benchmark thread. This function is used internally.
+	
+	\param[in,out] queuebenchmark A valid QUEUEBENCHMARK structure pointer.
+	\param[out] ptr Array receiving the pointers.
+	\param[in] n The maximum number of pointers to pop.
+	
+	\return Return the number of pointers popped.
+*/
+unsigned int QUEUE_pop_batch( QUEUEBENCHMARK *queuebenchmark, void **ptr, unsigned int n )
+{
+	return queuebenchmark->mpmc ?
+		   MPMCQUEUE_pop_batch( ( MPMCQUEUE * )queuebenchmark->queue, ptr, n ) :
+		   SPSCQUEUE_pop_batch( ( SPSCQUEUE * )queuebenchmark->queue, ptr, n );
+}
+
+
+/*!
+	The thread function of a benchmark producer, push n_message consecutive messages starting
+	at first. This function is used internally.
+	
+	\param[in,out] ptr A valid QUEUEBENCHMARK structure pointer.
+*/
+void *QUEUE_produce( void *ptr )
+{
+	QUEUEBENCHMARK *queuebenchmark = ( QUEUEBENCHMARK * )ptr;
+	
+	void *message[ QUEUE_BENCHMARK_MAX_BATCH ];
+	
+	unsigned int i = 0;
+	
+	while( !ATOMIC_load( queuebenchmark->start ) ) sched_yield();
+	
+	while( i != queuebenchmark->n_message )
+	{
+		unsigned int j = 0,
+					 n = queuebenchmark->n_message - i;
+		
+		if( n > queuebenchmark->batch ) n = queuebenchmark->batch;
+		
+		while( j != n )
+		{
+			message[ j ] = ( void * )( size_t )( queuebenchmark->first + i + j );
+			++j;
+		}
+		
+		n = QUEUE_push_batch( queuebenchmark, message, n );
+		
+		// Full, let the consumers run.
+		if( !n ) sched_yield();
+		
+		i += n;
+	}
+	
+	return NULL;
+}
+
+
+/*!
+	The thread function of a benchmark consumer, pop messages until all the messages of the
+	benchmark have been popped. This function is used internally.
+	
+	\param[in,out] ptr A valid QUEUEBENCHMARK structure pointer.
+*/
+void *QUEUE_consume( void *ptr )
+{
+	QUEUEBENCHMARK *queuebenchmark = ( QUEUEBENCHMARK * )ptr;
+	
+	void *message[ QUEUE_BENCHMARK_MAX_BATCH ];
+	
+	while( !ATOMIC_load( queuebenchmark->start ) ) sched_yield();
+	
+	while( ATOMIC_load( queuebenchmark->n_pending ) > 0 )
+	{
+		unsigned int j = 0,
+					 n = QUEUE_pop_batch( queuebenchmark, message, queuebenchmark->batch );
+		
+		// Empty, let the producers run.
+		if( !n )
+		{
+			sched_yield();
+			continue;
+		}
+		
+		ATOMIC_add( queuebenchmark->n_pending, -( int )n );
+		
+		while( j != n )
+		{
+			unsigned int value = ( unsigned int )( size_t )message[ j ];
+			
+			if( !queuebenchmark->mpmc && value != queuebenchmark->last + 1 ) ++queuebenchmark->n_error;
+			
+			queuebenchmark->last = value;
+			queuebenchmark->sum += value;
+			
+			++queuebenchmark->n_pop;
+			++j;
+		}
+	}
+	
+	return NULL;
+}
+
+
+/*!
+	Run producer and consumer threads on a queue, check that every message have been popped
+	exactly once (and in order for a SPSCQUEUE), and print the throughput in the console.
+	This function is used internally by SPSCQUEUE_benchmark and MPMCQUEUE_benchmark.
+	
+	\param[in] mpmc Determine if a MPMCQUEUE (1) or a SPSCQUEUE (0) is tested.
+	\param[in] capacity The capacity of the queue.
+	\param[in] n_producer The number of producer threads.
+	\param[in] n_consumer The number of consumer threads.
+	\param[in] n_message The number of messages pushed by each producer.
+	\param[in] batch The number of messages pushed or popped at once (1 to QUEUE_BENCHMARK_MAX_BATCH).
+	
+	\return Return 1 if the messages have been received correctly, else 0.
+*/
+unsigned char QUEUE_benchmark( unsigned char mpmc, unsigned int capacity, unsigned int n_producer, unsigned int n_consumer, unsigned int n_message, unsigned int batch )
+{
+	unsigned int i		= 0,
+				 n		= n_producer + n_consumer,
+				 n_pop	= 0,
+				 sum	= 0,
+				 expect = 0,
+				 n_error = 0,
+				 start,
+				 time;
+	
+	volatile int go		   = 0,
+				 n_pending = ( int )( n_producer * n_message );
+	
+	pthread_t *thread = ( pthread_t * ) malloc( n * sizeof( pthread_t ) );
+	
+	QUEUEBENCHMARK *queuebenchmark = ( QUEUEBENCHMARK * ) calloc( n, sizeof( QUEUEBENCHMARK ) );
+	
+	void *queue = mpmc ? ( void * )MPMCQUEUE_init( capacity ) : ( void * )SPSCQUEUE_init( capacity );
+	
+	batch = CLAMP( batch, 1, QUEUE_BENCHMARK_MAX_BATCH );
+	
+	while( i != n )
+	{
+		queuebenchmark[ i ].queue	  = queue;
+		queuebenchmark[ i ].mpmc	  = mpmc;
+		queuebenchmark[ i ].batch	  = batch;
+		queuebenchmark[ i ].n_pending = &n_pending;
+		queuebenchmark[ i ].start	  = &go;
+		
+		// The messages are never NULL, since pop return NULL when the queue is empty.
+		if( i < n_producer )
+		{
+			queuebenchmark[ i ].first	  = i * n_message + 1;
+			queuebenchmark[ i ].n_message = n_message;
+		}
+		
+		pthread_create( &thread[ i ],
+						NULL,
+						i < n_producer ? QUEUE_produce : QUEUE_consume,
+						&queuebenchmark[ i ] );
+		++i;
+	}
+	
+	start = get_micro_time();
+	
+	ATOMIC_store( &go, 1 );
+	
+	i = 0;
+	while( i != n )
+	{
+		pthread_join( thread[ i ], NULL );
+		++i;
+	}
+	
+	time = get_micro_time() - start;
+	
+	i = 1;
+	while( i != n_producer * n_message + 1 )
+	{
+		expect += i;
+		++i;
+	}
+	
+	i = n_producer;
+	while( i != n )
+	{
+		n_pop	+= queuebenchmark[ i ].n_pop;
+		sum		+= queuebenchmark[ i ].sum;
+		n_error += queuebenchmark[ i ].n_error;
+		++i;
+	}
+	
+	console_print( "%s: %d/%d thread(s) %d messages batch:%d %dms %.1fM/s %s\n",
+				   mpmc ? "MPMCQUEUE" : "SPSCQUEUE",
+				   n_producer,
+				   n_consumer,
+				   n_producer * n_message,
+				   batch,
+				   time / 1000,
+				   time ? ( float )n_pop / ( float )time : 0.0f,
+				   n_pop == n_producer * n_message && sum == expect && !n_error ? "ok" : "FAILED" );
+	
+	if( mpmc ) MPMCQUEUE_free( ( MPMCQUEUE * )queue );
+	
+	else SPSCQUEUE_free( ( SPSCQUEUE * )queue );
+	
+	free( queuebenchmark );
+	
+	free( thread );
+	
+	return n_pop == n_producer * n_message && sum == expect && !n_error;
+}
+
+
+/*!
+	Stress a SPSCQUEUE with a producer and a consumer thread, check that every message is
+	received in order and print the throughput in the console.
+	
+	\param[in] capacity The capacity of the queue, a small one increase the contention.
+	\param[in] n_message The number of messages to send.
+	\param[in] batch The number of messages pushed or popped at once (1 to QUEUE_BENCHMARK_MAX_BATCH).
+	
+	\return Return 1 if the messages have been received correctly, else 0.
+*/
+unsigned char SPSCQUEUE_benchmark( unsigned int capacity, unsigned int n_message, unsigned int batch )
+{ return QUEUE_benchmark( 0, capacity, 1, 1, n_message, batch ); }
+
+
+/*!
+	Stress a MPMCQUEUE with multiple producer and consumer threads, check that every message
+	is received exactly once and print the throughput in the console.
+	
+	\param[in] capacity The capacity of the queue, a small one increase the contention.
+	\param[in] n_producer The number of producer threads.
+	\param[in] n_consumer The number of consumer threads.
+	\param[in] n_message The number of messages sent by each producer.
+	\param[in] batch The number of messages pushed or popped at once (1 to QUEUE_BENCHMARK_MAX_BATCH).
+	
+	\return Return 1 if the messages have been received correctly, else 0.
+*/
+unsigned char MPMCQUEUE_benchmark( unsigned int capacity, unsigned int n_producer, unsigned int n_consumer, unsigned int n_message, unsigned int batch )
+{ return QUEUE_benchmark( 1, capacity, n_producer, n_consumer, n_message, batch ); }
@@ -0,0 +1,180 @@
+/*
+
+GFX Lightweight OpenGLES 2.0 Game and Graphics Engine
+
+Copyright (C) 2011 Romain Marucchi-Foino http://gfx.sio2interactive.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of
+this software. Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that
+you wrote the original software. If you use this software in a product, an acknowledgment
+in the product would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented
+as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef QUEUE_H
+#define QUEUE_H
+
+/*!
+	\file queue.h
+
+    \brief Contains structure definitions and functions to use with the SPSCQUEUE and MPMCQUEUE lock-free queues.
+*/
+
+
+//! The size in bytes of a cache line, used to keep the indices of the producers and consumers on different lines.
+#define QUEUE_CACHE_LINE	64
+
+//! The maximum number of messages pushed or popped at once by the queue benchmarks.
+#define QUEUE_BENCHMARK_MAX_BATCH	64
+
+
+//! Structure definition of a bounded single producer, single consumer queue of pointers. \sa SPSCQUEUE_init
+typedef struct
+{
+	//! The capacity of the queue minus one (the capacity is a power of two).
+	unsigned int	mask;
+	
+	//! The ring of pointers.
+	void			**data;
+	
+	//! Padding to keep the consumer index on its own cache line.
+	char			pad0[ QUEUE_CACHE_LINE ];
+	
+	//! The index of the next pointer to pop, only written by the consumer.
+	volatile int	head;
+	
+	//! The last value of tail read by the consumer.
+	unsigned int	cached_tail;
+	
+	//! Padding to keep the producer index on its own cache line.
+	char			pad1[ QUEUE_CACHE_LINE ];
+	
+	//! The index of the next pointer to push, only written by the producer.
+	volatile int	tail;
+	
+	//! The last value of head read by the producer.
+	unsigned int	cached_head;
+	
+	//! Padding to keep the producer index on its own cache line.
+	char			pad2[ QUEUE_CACHE_LINE ];
+
+} SPSCQUEUE;
+
+
+//! Structure definition of a cell of a MPMCQUEUE.
+typedef struct
+{
+	//! The sequence number of the cell, tells if the cell is ready to be pushed or popped at a given index.
+	volatile int	sequence;
+	
+	//! The pointer stored in the cell.
+	void			*data;
+
+} MPMCCELL;
+
+
+//! Structure definition of a bounded multiple producers, multiple consumers queue of pointers. \sa MPMCQUEUE_init
+typedef struct
+{
+	//! The capacity of the queue minus one (the capacity is a power of two).
+	unsigned int	mask;
+	
+	//! The ring of cells.
+	MPMCCELL		*mpmccell;
+	
+	//! Padding to keep the push index on its own cache line.
+	char			pad0[ QUEUE_CACHE_LINE ];
+	
+	//! The index of the next cell to push, shared by the producers.
+	volatile int	tail;
+	
+	//! Padding to keep the pop index on its own cache line.
+	char			pad1[ QUEUE_CACHE_LINE ];
+	
+	//! The index of the next cell to pop, shared by the consumers.
+	volatile int	head;
+	
+	//! Padding to keep the pop index on its own cache line.
+	char			pad2[ QUEUE_CACHE_LINE ];
+
+} MPMCQUEUE;
+
+
+//! Structure definition of a producer or consumer thread of the queue benchmarks. \sa MPMCQUEUE_benchmark
+typedef struct
+{
+	//! The queue, either a SPSCQUEUE or a MPMCQUEUE structure pointer.
+	void			*queue;
+	
+	//! Determine if the queue is a MPMCQUEUE (1) or a SPSCQUEUE (0).
+	unsigned char	mpmc;
+	
+	//! The number of messages pushed or popped at once.
+	unsigned int	batch;
+	
+	//! The first message pushed by a producer, the following ones are consecutive.
+	unsigned int	first;
+	
+	//! The number of messages to push for a producer.
+	unsigned int	n_message;
+	
+	//! The number of messages left to pop, shared by the consumers.
+	volatile int	*n_pending;
+	
+	//! The start flag shared by all the threads.
+	volatile int	*start;
+	
+	//! The number of messages popped by a consumer.
+	unsigned int	n_pop;
+	
+	//! The sum of the messages popped by a consumer.
+	unsigned int	sum;
+	
+	//! The last message popped by a consumer.
+	unsigned int	last;
+	
+	//! The number of messages popped out of order by the consumer of a SPSCQUEUE.
+	unsigned int	n_error;
+	
+} QUEUEBENCHMARK;
+
+
+SPSCQUEUE *SPSCQUEUE_init( unsigned int capacity );
+
+SPSCQUEUE *SPSCQUEUE_free( SPSCQUEUE *spscqueue );
+
+unsigned char SPSCQUEUE_push( SPSCQUEUE *spscqueue, void *ptr );
+
+void *SPSCQUEUE_pop( SPSCQUEUE *spscqueue );
+
+unsigned int SPSCQUEUE_push_batch( SPSCQUEUE *spscqueue, void **ptr, unsigned int n );
+
+unsigned int SPSCQUEUE_pop_batch( SPSCQUEUE *spscqueue, void **ptr, unsigned int n );
+
+unsigned char SPSCQUEUE_benchmark( unsigned int capacity, unsigned int n_message, unsigned int batch );
+
+MPMCQUEUE *MPMCQUEUE_init( unsigned int capacity );
+
+MPMCQUEUE *MPMCQUEUE_free( MPMCQUEUE *mpmcqueue );
+
+unsigned char MPMCQUEUE_push( MPMCQUEUE *mpmcqueue, void *ptr );
+
+void *MPMCQUEUE_pop( MPMCQUEUE *mpmcqueue );
+
+unsigned int MPMCQUEUE_push_batch( MPMCQUEUE *mpmcqueue, void **ptr, unsigned int n );
+
+unsigned int MPMCQUEUE_pop_batch( MPMCQUEUE *mpmcqueue, void **ptr, unsigned int n );
+
+unsigned char MPMCQUEUE_benchmark( unsigned int capacity, unsigned int n_producer, unsigned int n_consumer, unsigned int n_message, unsigned int batch );
+
+#endif
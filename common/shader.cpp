@@ -21,6 +21,8 @@ as being the original software.
 
 */
 
+#define ALLOCATOR_TAG ALLOCATOR_TAG_SHADER
+
 #include "gfx.h"
 
 
@@ -45,7 +47,7 @@ as being the original software.
 */
 SHADER *SHADER_init(const char *name, unsigned int type )
 {
-	SHADER *shader = ( SHADER * ) calloc( 1, sizeof( SHADER ) );
+	SHADER *shader = ( SHADER * ) POOL_alloc( &allocator.pool[ POOL_SHADER ] );
 
 	strcpy( shader->name, name );
 
@@ -66,7 +68,7 @@ SHADER *SHADER_free( SHADER *shader )
 {
 	if( shader->sid ) SHADER_delete_id( shader );
 
-	free( shader );
+	POOL_release( &allocator.pool[ POOL_SHADER ], shader );
 	return NULL;
 }
 
@@ -21,6 +21,8 @@ as being the original software.
 
 */
 
+#define ALLOCATOR_TAG ALLOCATOR_TAG_AUDIO
+
 #include "gfx.h"
 
 /*!
@@ -252,7 +254,7 @@ SOUND *SOUND_add( char *name, SOUNDBUFFER *soundbuffer )
 {
 	vec3 tmp = { 0.0f, 0.0f, 0.0f };
 	
-	SOUND *sound = ( SOUND * ) calloc( 1, sizeof( SOUND ) );
+	SOUND *sound = ( SOUND * ) POOL_alloc( &allocator.pool[ POOL_SOUND ] );
 
 	strcpy( sound->name, name );
 	
@@ -294,7 +296,7 @@ SOUND *SOUND_free( SOUND *sound )
 		alDeleteSources( 1, &sound->sid );
 	}
 
-	free( sound );
+	POOL_release( &allocator.pool[ POOL_SOUND ], sound );
 	return NULL;
 }
 
@@ -0,0 +1,163 @@
+/*
+
+GFX Lightweight OpenGLES 2.0 Game and Graphics Engine
+
+Copyright (C) 2011 Romain Marucchi-Foino http://gfx.sio2interactive.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of
+this software. Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that
+you wrote the original software. If you use this software in a product, an acknowledgment
+in the product would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented
+as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#define ALLOCATOR_TAG ALLOCATOR_TAG_MESH
+
+#include "gfx.h"
+
+/*!
+	\file streambuffer.cpp
+
+    \brief Ring buffer to stream dynamic vertex data every frame.
+
+	\details Updating the same VBO every frame with glBufferSubData while the GPU may still
+	be reading it from the previous frame force the driver to synchronize, which is especially
+	costly on tiled mobile GPUs. A STREAMBUFFER split a single VBO in n_frame regions and each
+	frame write into the next region, so the data of the frames still in flight are never
+	touched. Writers receive an offset inside the VBO to bind instead of owning a VBO. When
+	orphaning is enabled the storage is also re-specified every time the ring wrap around,
+	letting the driver allocate a new block if the GPU is late by more than n_frame frames.
+*/
+
+
+/*!
+	Create a new STREAMBUFFER and its VBO.
+
+	\param[in] name The internal name of the stream buffer.
+	\param[in] target The buffer target, usually GL_ARRAY_BUFFER.
+	\param[in] size The amount of bytes that can be written during one frame.
+	\param[in] n_frame The number of frame regions in the ring. 3 is usually enough to never
+	write into a region used by a frame still in flight. Pass 1 to only rely on orphaning.
+	\param[in] orphan Orphan the buffer storage every time the ring wrap around (1) or not (0).
+
+	\return Return a new STREAMBUFFER structure pointer.
+*/
+STREAMBUFFER *STREAMBUFFER_init( char *name, unsigned int target, unsigned int size, unsigned int n_frame, unsigned char orphan )
+{
+	STREAMBUFFER *streambuffer = ( STREAMBUFFER * ) calloc( 1, sizeof( STREAMBUFFER ) );
+
+	strcpy( streambuffer->name, name );
+
+	streambuffer->target  = target;
+	streambuffer->size	  = ( size + 3 ) & ~3;
+	streambuffer->n_frame = n_frame ? n_frame : 1;
+	streambuffer->orphan  = n_frame > 1 ? orphan : 1;
+
+	glGenBuffers( 1, &streambuffer->vbo );
+
+	glBindBuffer( target, streambuffer->vbo );
+
+	glBufferData( target,
+				  streambuffer->size * streambuffer->n_frame,
+				  NULL,
+				  GL_STREAM_DRAW );
+
+	glBindBuffer( target, 0 );
+
+	return streambuffer;
+}
+
+
+/*!
+	Free a previously initialized STREAMBUFFER.
+
+	\param[in,out] streambuffer A valid STREAMBUFFER structure pointer.
+
+	\return Return a NULL STREAMBUFFER structure pointer.
+*/
+STREAMBUFFER *STREAMBUFFER_free( STREAMBUFFER *streambuffer )
+{
+	if( streambuffer->vbo ) glDeleteBuffers( 1, &streambuffer->vbo );
+
+	free( streambuffer );
+	return NULL;
+}
+
+
+/*!
+	Move to the next frame region of the ring. Call this function once per frame
+	before any write.
+
+	\param[in,out] streambuffer A valid STREAMBUFFER structure pointer.
+*/
+void STREAMBUFFER_begin_frame( STREAMBUFFER *streambuffer )
+{
+	streambuffer->frame  = ( streambuffer->frame + 1 ) % streambuffer->n_frame;
+	streambuffer->offset = 0;
+
+	++streambuffer->tick;
+
+	if( !streambuffer->frame && streambuffer->orphan )
+	{
+		glBindBuffer( streambuffer->target, streambuffer->vbo );
+
+		glBufferData( streambuffer->target,
+					  streambuffer->size * streambuffer->n_frame,
+					  NULL,
+					  GL_STREAM_DRAW );
+	}
+}
+
+
+/*!
+	Write a block of data inside the current frame region. The STREAMBUFFER VBO is left
+	bound to its target.
+
+	\param[in,out] streambuffer A valid STREAMBUFFER structure pointer.
+	\param[in] data The data to write.
+	\param[in] size The size of the data in bytes.
+
+	\return Return the offset in bytes of the data inside the VBO, or -1 if the current
+	frame region is full, in which case nothing is written and the caller should fall back
+	to its own buffer.
+*/
+int STREAMBUFFER_write( STREAMBUFFER *streambuffer, void *data, unsigned int size )
+{
+	unsigned int offset;
+
+	if( streambuffer->offset + size > streambuffer->size ) return -1;
+
+	offset = ( streambuffer->frame * streambuffer->size ) + streambuffer->offset;
+
+	glBindBuffer( streambuffer->target, streambuffer->vbo );
+
+	glBufferSubData( streambuffer->target,
+					 offset,
+					 size,
+					 data );
+
+	streambuffer->offset = ( streambuffer->offset + size + 3 ) & ~3;
+
+	if( streambuffer->offset > streambuffer->max_offset ) streambuffer->max_offset = streambuffer->offset;
+
+	return ( int )offset;
+}
+
+
+/*!
+	Bind the STREAMBUFFER VBO to its target.
+
+	\param[in] streambuffer A valid STREAMBUFFER structure pointer.
+*/
+void STREAMBUFFER_bind( STREAMBUFFER *streambuffer )
+{ glBindBuffer( streambuffer->target, streambuffer->vbo ); }
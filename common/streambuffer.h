@@ -0,0 +1,80 @@
+/*
+
+GFX Lightweight OpenGLES 2.0 Game and Graphics Engine
+
+Copyright (C) 2011 Romain Marucchi-Foino http://gfx.sio2interactive.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of
+this software. Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that
+you wrote the original software. If you use this software in a product, an acknowledgment
+in the product would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented
+as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+/*!
+	\file streambuffer.h
+
+    \brief Contains structure definition and functions to use with a STREAMBUFFER.
+*/
+
+
+//! Structure definition of a ring buffer used to stream per-frame vertex data to OpenGLES.
+typedef struct
+{
+	//! The internal name of the stream buffer.
+	char			name[ MAX_CHAR ];
+
+	//! The buffer target, usually GL_ARRAY_BUFFER.
+	unsigned int	target;
+
+	//! The VBO id maintained by OpenGLES.
+	unsigned int	vbo;
+
+	//! The size in bytes of each frame region of the ring.
+	unsigned int	size;
+
+	//! The number of frame regions in the ring.
+	unsigned int	n_frame;
+
+	//! The index of the frame region currently written.
+	unsigned int	frame;
+
+	//! The number of frames started since the creation of the stream buffer, writers can compare it to know if their data are from the current frame.
+	unsigned int	tick;
+
+	//! The write offset in bytes inside the current frame region.
+	unsigned int	offset;
+
+	//! Determine if the buffer storage is orphaned every time the ring wrap around (1) or not (0).
+	unsigned char	orphan;
+
+	//! The largest amount of bytes written in a single frame, use it to tune the size of the frame regions.
+	unsigned int	max_offset;
+
+} STREAMBUFFER;
+
+
+STREAMBUFFER *STREAMBUFFER_init( char *name, unsigned int target, unsigned int size, unsigned int n_frame, unsigned char orphan );
+
+STREAMBUFFER *STREAMBUFFER_free( STREAMBUFFER *streambuffer );
+
+void STREAMBUFFER_begin_frame( STREAMBUFFER *streambuffer );
+
+int STREAMBUFFER_write( STREAMBUFFER *streambuffer, void *data, unsigned int size );
+
+void STREAMBUFFER_bind( STREAMBUFFER *streambuffer );
+
+#endif
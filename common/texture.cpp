@@ -21,6 +21,8 @@ as being the original software.
 
 */
 
+#define ALLOCATOR_TAG ALLOCATOR_TAG_TEXTURE
+
 #include "gfx.h"
 
 /*!
@@ -29,11 +31,19 @@ as being the original software.
     \brief Create and manipulate textures through the TEXTURE interface.
 		
 	\details The TEXTURE structure provide an interface to handle OpenGLES texture.
-	The structure support in-memory load of PNG and PVRTC and allow you to 
-	convert 24 and 32 bits textures to 16 bits.
+	The structure support in-memory load of PNG, PVRTC and KTX (ETC1/ETC2) and allow you to 
+	convert 24 and 32 bits textures to 16 bits. Uncompressed textures can also be
+	compressed to ETC1 at load time, and cached on disk, using the TEXTURE_COMPRESS_ETC1 flag.
 */
 
 
+//! Global TEXTUREENCODER structure.
+TEXTUREENCODER textureencoder;
+
+//! Global TEXTUREREGISTRY structure.
+TEXTUREREGISTRY textureregistry;
+
+
 /*!
 	Create a new TEXTURE structure pointer.
 	
@@ -43,7 +53,7 @@ as being the original software.
 */
 TEXTURE *TEXTURE_init( char *name )
 {
-	TEXTURE *texture = ( TEXTURE * ) calloc( 1, sizeof( TEXTURE ) );
+	TEXTURE *texture = ( TEXTURE * ) POOL_alloc( &allocator.pool[ POOL_TEXTURE ] );
 
 	texture->target = GL_TEXTURE_2D;
 
@@ -54,7 +64,8 @@ TEXTURE *TEXTURE_init( char *name )
 
 
 /*!
-	Free a previously initialized TEXTURE structure.
+	Free a previously initialized TEXTURE structure. For a shared texture only the reference
+	is released, the texture is freed once its last owner release it.
 
 	\param[in,out] texture A valid TEXTURE structure pointer.
 	
@@ -62,17 +73,31 @@ TEXTURE *TEXTURE_init( char *name )
 */
 TEXTURE *TEXTURE_free( TEXTURE *texture )
 {
+	if( texture->n_ref > 1 )
+	{
+		--texture->n_ref;
+		return NULL;
+	}
+	
+	if( texture->n_ref ) TEXTURE_registry_remove( texture );
+	
+	if( texture->pending && textureresidency.texturestream ) TEXTURESTREAM_cancel( textureresidency.texturestream, texture );
+	
 	TEXTURE_free_texel_array( texture );
 	
 	TEXTURE_delete_id( texture );
 	
-	free( texture );
+	if( texture->texture_alpha ) TEXTURE_free( texture->texture_alpha );
+	
+	POOL_release( &allocator.pool[ POOL_TEXTURE ], texture );
 	return NULL;
 }
 
 
 /*!
-	Helper function to automatically create, load and generate a new TEXTURE.
+	Helper function to automatically create, load and generate a new TEXTURE. If the same file
+	have already been created with the same parameters, the existing TEXTURE is shared and
+	have to be released with TEXTURE_free like a new one.
 
 	\param[in] name The internal name to use for the new TEXTURE.
 	\param[in] filename The file to load.
@@ -86,13 +111,27 @@ TEXTURE *TEXTURE_free( TEXTURE *texture )
 */
 TEXTURE *TEXTURE_create( char *name, char *filename, unsigned char relative_path, unsigned int flags, unsigned char filter, float anisotropic_filter )
 {
-	TEXTURE *texture = TEXTURE_init( name );
+	char path[ MAX_PATH ] = {""};
+	
+	TEXTURE *texture;
+	
+	MEMORY *m;
+	
+	mresolve( filename, relative_path, path );
+	
+	texture = TEXTURE_registry_get( path, flags, filter, anisotropic_filter );
+	
+	if( texture ) return texture;
+	
+	texture = TEXTURE_init( name );
 	
-	MEMORY *m = mopen( filename, relative_path );
+	m = mopen( filename, relative_path );
 	
 	if( m )
 	{
-		TEXTURE_load( texture, m );
+		TEXTURE_registry_add( texture, path, flags, filter, anisotropic_filter );
+		
+		if( !( flags & TEXTURE_COMPRESS_ETC1 ) || !TEXTURE_load_cache( texture, m, flags ) ) TEXTURE_load( texture, m );
 		
 		TEXTURE_generate_id( texture, flags, filter, anisotropic_filter );
 		
@@ -105,17 +144,180 @@ TEXTURE *TEXTURE_create( char *name, char *filename, unsigned char relative_path
 }
 
 
+/*!
+	Look for a TEXTURE already created from the same file with the same creation parameters.
+	If found, its reference count is incremented.
+	
+	\param[in] path The resolved path of the file. \sa mresolve
+	\param[in] flags The TEXTURE flags.
+	\param[in] filter The mipmap filtering.
+	\param[in] anisotropic_filter The anisotropic filtering.
+	
+	\return Return the shared TEXTURE structure pointer, or NULL if the texture is not registered.
+*/
+TEXTURE *TEXTURE_registry_get( char *path, unsigned int flags, unsigned char filter, float anisotropic_filter )
+{
+	unsigned int i = 0;
+	
+	while( i != textureregistry.n_texture )
+	{
+		TEXTURE *texture = textureregistry.texture[ i ];
+		
+		if( texture->flags				== flags  &&
+			texture->filter				== filter &&
+			texture->anisotropic_filter == anisotropic_filter &&
+			!strcmp( texture->filename, path ) )
+		{
+			++texture->n_ref;
+			
+			return texture;
+		}
+		
+		++i;
+	}
+	
+	return NULL;
+}
+
+
+/*!
+	Register a TEXTURE so it can be shared, its reference count is set to 1.
+	
+	\param[in,out] texture A valid TEXTURE structure pointer.
+	\param[in] path The resolved path of the file the texture is created from. \sa mresolve
+	\param[in] flags The TEXTURE flags.
+	\param[in] filter The mipmap filtering.
+	\param[in] anisotropic_filter The anisotropic filtering.
+*/
+void TEXTURE_registry_add( TEXTURE *texture, char *path, unsigned int flags, unsigned char filter, float anisotropic_filter )
+{
+	strcpy( texture->filename, path );
+	
+	texture->flags				= flags;
+	texture->filter				= filter;
+	texture->anisotropic_filter = anisotropic_filter;
+	texture->n_ref				= 1;
+	
+	++textureregistry.n_texture;
+	
+	textureregistry.texture = ( TEXTURE ** ) realloc( textureregistry.texture,
+													  textureregistry.n_texture * sizeof( TEXTURE * ) );
+	
+	textureregistry.texture[ textureregistry.n_texture - 1 ] = texture;
+}
+
+
+/*!
+	Remove a TEXTURE from the registry. This function is used internally by TEXTURE_free when
+	the last reference is released.
+	
+	\param[in,out] texture A valid registered TEXTURE structure pointer.
+*/
+void TEXTURE_registry_remove( TEXTURE *texture )
+{
+	unsigned int i = 0;
+	
+	while( i != textureregistry.n_texture )
+	{
+		if( textureregistry.texture[ i ] == texture )
+		{
+			--textureregistry.n_texture;
+			
+			memmove( &textureregistry.texture[ i ],
+					 &textureregistry.texture[ i + 1 ],
+					 ( textureregistry.n_texture - i ) * sizeof( TEXTURE * ) );
+			
+			if( !textureregistry.n_texture )
+			{
+				free( textureregistry.texture );
+				textureregistry.texture = NULL;
+			}
+			
+			break;
+		}
+		
+		++i;
+	}
+	
+	texture->n_ref = 0;
+}
+
+
+/*!
+	Estimate the amount of video memory used by a TEXTURE, including its alpha texture and the
+	mipmaps generated by the driver.
+	
+	\param[in] texture A valid TEXTURE structure pointer.
+	
+	\return Return the estimated size in bytes.
+*/
+unsigned int TEXTURE_get_memory( TEXTURE *texture )
+{
+	unsigned int size = texture->tid ? texture->size : 0;
+	
+	if( texture->lod == TEXTURE_LOD_PLACEHOLDER ) return 4;
+	
+	// glGenerateMipmap add about a third of the base level.
+	if( ( texture->flags & TEXTURE_MIPMAP ) && texture->n_mipmap < 2 ) size += size / 3;
+	
+	if( texture->texture_alpha ) size += TEXTURE_get_memory( texture->texture_alpha );
+	
+	return size;
+}
+
+
+/*!
+	Print the textures of the registry along with their reference count and estimated memory usage.
+*/
+void TEXTURE_registry_print( void )
+{
+	unsigned int i	   = 0,
+				 total = 0;
+	
+	while( i != textureregistry.n_texture )
+	{
+		TEXTURE *texture = textureregistry.texture[ i ];
+		
+		unsigned int size = TEXTURE_get_memory( texture );
+		
+		console_print( "%s: %dx%d ref:%d lod:%d %dKB (%s)\n",
+					   texture->name,
+					   texture->width,
+					   texture->height,
+					   texture->n_ref,
+					   texture->lod,
+					   size >> 10,
+					   texture->filename );
+		
+		total += size;
+		
+		++i;
+	}
+	
+	console_print( "%d texture(s) %dKB budget:%dKB evict:%d reload:%d\n",
+				   textureregistry.n_texture,
+				   total >> 10,
+				   textureresidency.budget >> 10,
+				   textureresidency.n_evict,
+				   textureresidency.n_reload );
+}
+
+
 /*!
 	Load and uncompress TEXTURE texels from a MEMORY stream.
 	
 	\param[in,out] texture A valid TEXTURE structure pointer.
-	\param[in] memory The compressed texture stream (either PNG or PVR).
+	\param[in] memory The compressed texture stream (either PNG, PVR or KTX).
 	
 */
 void TEXTURE_load( TEXTURE *texture, MEMORY *memory )
 {
 	char ext[ MAX_CHAR ] = {""};
 	
+	// The texture may be reloaded by the residency manager, reset what the loaders do not always set.
+	texture->n_mipmap	 = 0;
+	texture->compression = 0;
+	
 	get_file_name( memory->filename, texture->name );
 	
 	get_file_extension( memory->filename, ext, 1 );
@@ -123,6 +325,8 @@ void TEXTURE_load( TEXTURE *texture, MEMORY *memory )
 	if( !strcmp( ext, "PNG" ) ) TEXTURE_load_png( texture, memory );
 	
 	else if( !strcmp( ext, "PVR" ) ) TEXTURE_load_pvr( texture, memory );
+
+	else if( !strcmp( ext, "KTX" ) ) TEXTURE_load_ktx( texture, memory );
 }
 
 
@@ -161,10 +365,13 @@ void TEXTURE_load_png( TEXTURE *texture, MEMORY *memory )
 		png_bit_depth,
 		png_color_type;
 
-	structp = png_create_read_struct( PNG_LIBPNG_VER_STRING,
-									  NULL,
-									  NULL,
-									  NULL );
+	structp = png_create_read_struct_2( PNG_LIBPNG_VER_STRING,
+										NULL,
+										NULL,
+										NULL,
+										NULL,
+										ALLOCATOR_png_alloc,
+										ALLOCATOR_png_free );
 
 	infop = png_create_info_struct( structp );
 
@@ -311,6 +518,8 @@ void TEXTURE_load_pvr( TEXTURE *texture, MEMORY *memory )
 								   GL_COMPRESSED_RGB_PVRTC_2BPPV1_IMG;
 		}
 
+		texture->size = pvrheader->datasize;
+
 		texture->texel_array = ( unsigned char * ) malloc( pvrheader->datasize );
 
 		memcpy( texture->texel_array,
@@ -321,181 +530,2273 @@ void TEXTURE_load_pvr( TEXTURE *texture, MEMORY *memory )
 
 
 /*!
-	Helper function to convert an uncompressed 24bits or 32bits image to a 16 bits image.
+	Helper function to load a KTX 1.1 texture in-memory. Compressed textures (ETC1, ETC2/EAC,
+	PVRTC etc.) are loaded with their full mipmap chain, uncompressed textures only load their
+	first level.
 	
 	\param[in,out] texture A valid TEXTURE pointer.
-	\param[in] use_5551 Determine if a 32bits image should be converted using 5551 bits instead of the default 4444 bits.
+	\param[in] memory A valid MEMORY pointer that contains a KTX buffer.
 */
-void TEXTURE_convert_16_bits( TEXTURE *texture, unsigned char use_5551 )
+void TEXTURE_load_ktx( TEXTURE *texture, MEMORY *memory )
 {
-	unsigned int i = 0,
-				 s = texture->width * texture->height,
-				*t = NULL;
+	const unsigned char ktx_identifier[ 12 ] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
 
-	unsigned short *texel_array = NULL;
+	KTXHEADER *ktxheader = ( KTXHEADER * )memory->buffer;
+
+	unsigned int i		= 0,
+				 size	= 0,
+				 offset = sizeof( KTXHEADER );
+
+	if( memory->size < sizeof( KTXHEADER ) ||
+		memcmp( ktxheader->identifier, ktx_identifier, 12 ) ||
+		ktxheader->endianness != 0x04030201 ) return;
+
+	if( ktxheader->pixel_depth > 1 || ktxheader->n_face > 1 || ktxheader->n_array_element > 1 ) return;
 	
-	switch( texture->byte )
+	offset += ktxheader->n_key_value_byte;
+
+	texture->width  = ktxheader->pixel_width;
+	texture->height = ktxheader->pixel_height;
+
+	if( ktxheader->gl_type )
 	{
-		case 3:
+		texture->internal_format = ktxheader->gl_base_internal_format;
+		texture->format			 = ktxheader->gl_format;
+		texture->texel_type		 = ktxheader->gl_type;
+
+		switch( texture->format )
 		{
-			unsigned int j = 0;
-			
-			unsigned char *tmp_array = NULL;
-			
-			texture->byte		= 4;
-			texture->size		= s * texture->byte;
-			texture->texel_type = GL_UNSIGNED_SHORT_5_6_5;
+			case GL_RGBA: texture->byte = 4; break;
+			case GL_RGB : texture->byte = 3; break;
+			case GL_LUMINANCE_ALPHA: texture->byte = 2; break;
+			default: texture->byte = 1; break;
+		}
+		
+		if( texture->texel_type != GL_UNSIGNED_BYTE ) texture->byte = 2;
 
-			tmp_array = ( unsigned char * ) malloc( texture->size );
+		size = *( unsigned int * )&memory->buffer[ offset ];
+		
+		texture->size = size;
+		
+		texture->texel_array = ( unsigned char * ) malloc( size );
 
-			while( i != texture->size )
-			{
-				tmp_array[ i     ] = texture->texel_array[ j     ];
-				tmp_array[ i + 1 ] = texture->texel_array[ j + 1 ];
-				tmp_array[ i + 2 ] = texture->texel_array[ j + 2 ];
-				tmp_array[ i + 3 ] = 255;
-				
-				i += texture->byte;
-				j += 3;				
-			}
+		memcpy( texture->texel_array,
+				&memory->buffer[ offset + 4 ],
+				size );
 
-			free( texture->texel_array );
-			texture->texel_array = tmp_array;
+		return;
+	}
+	
+	texture->compression = ktxheader->gl_internal_format;
+	texture->n_mipmap	 = ktxheader->n_mipmap ? ktxheader->n_mipmap : 1;
+	
+	switch( texture->compression )
+	{
+		case GL_COMPRESSED_RGB_PVRTC_2BPPV1_IMG:
+		case GL_COMPRESSED_RGBA_PVRTC_2BPPV1_IMG: texture->byte = 2; break;
+		
+		case GL_COMPRESSED_RGBA8_ETC2_EAC:
+		case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC: texture->byte = 8; break;
+		
+		default: texture->byte = 4; break;
+	}
 
-			texel_array = ( unsigned short * )texture->texel_array;
 
-			t = ( unsigned int * )texture->texel_array;
-			
-			i = 0;
-			while( i != s )
-			{
-			   *texel_array++ = ( ( (   *t         & 0xff ) >> 3 ) << 11 ) | 
-								( ( ( ( *t >>  8 ) & 0xff ) >> 2 ) <<  5 ) |
-									( ( *t >> 16 ) & 0xff ) >> 3;
-				++t;
-				++i;					
-			}
-			
-			break;
-		}
+	// Gather the size of all the levels to store them contiguously.
+	while( i != texture->n_mipmap && offset + 4 <= memory->size )
+	{
+		unsigned int image_size = *( unsigned int * )&memory->buffer[ offset ];
 		
-		case 4:
-		{
-			texel_array = ( unsigned short * )texture->texel_array;
+		size   += image_size;
+		offset += 4 + ( ( image_size + 3 ) & ~3 );
+		
+		++i;
+	}
+	
+	texture->n_mipmap	 = i;
+	texture->size		 = size;
+	texture->texel_array = ( unsigned char * ) malloc( size );
 
-			t = ( unsigned int * )texture->texel_array;
-						
-			if( use_5551 )
-			{
-				texture->texel_type = GL_UNSIGNED_SHORT_5_5_5_1;
+	offset = sizeof( KTXHEADER ) + ktxheader->n_key_value_byte;
+	size   = 0;
 
-				while( i != s )
-				{
-					*texel_array++ = ( ( (   *t         & 0xff ) >> 3 ) << 11 ) |
-									 ( ( ( ( *t >>  8 ) & 0xff ) >> 3 ) <<  6 ) |
-									 ( ( ( ( *t >> 16 ) & 0xff ) >> 3 ) <<  1 ) |
-								         ( ( *t >> 24 ) & 0xff ) >> 7;
-					++t;
-					++i;
-				}
-			}
-			else
-			{
-				texture->texel_type = GL_UNSIGNED_SHORT_4_4_4_4;
+	i = 0;
+	while( i != texture->n_mipmap )
+	{
+		unsigned int image_size = *( unsigned int * )&memory->buffer[ offset ];
 		
-				while( i != s )
-				{
-					*texel_array++ = ( ( (   *t         & 0xff ) >> 4 ) << 12 ) |
-									 ( ( ( ( *t >>  8 ) & 0xff ) >> 4 ) <<  8 ) |
-									 ( ( ( ( *t >> 16 ) & 0xff ) >> 4 ) <<  4 ) |
-										 ( ( *t >> 24 ) & 0xff ) >> 4;
-					++t;
-					++i;
-				}			
-			}
+		memcpy( &texture->texel_array[ size ],
+				&memory->buffer[ offset + 4 ],
+				image_size );
 		
-			break;
-		}
+		size   += image_size;
+		offset += 4 + ( ( image_size + 3 ) & ~3 );
+
+		++i;
 	}
 }
 
 
 /*!
-	Helper function to automatically generate an OpenGLES texture.
+	Get the size in bytes of one level of a compressed texture.
 	
-	\param[in,out] texture A valid TEXTURE structure pointer.
-	\param[in] flags The bit flags to use to generate the GLES texture.
-	\param[in] filter The type of mipmap filtering to use.
-	\param[in] anisotropic_filter The amount of anisotropic filtering to apply on the texture.
+	\param[in] compression The compression type.
+	\param[in] width The width of the level.
+	\param[in] height The height of the level.
+	
+	\return Return the size in bytes of the level.
 */
-void TEXTURE_generate_id( TEXTURE *texture, unsigned int flags, unsigned char filter, float anisotropic_filter )
+unsigned int TEXTURE_get_compressed_size( unsigned int compression, unsigned int width, unsigned int height )
 {
-	if( texture->tid ) TEXTURE_delete_id( texture );
-
-	glGenTextures( 1, &texture->tid );
-
-	glBindTexture( texture->target, texture->tid );
-	
-	
-	if( !texture->compression )
+	switch( compression )
 	{
-		switch( texture->byte )
+		case GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG:
+		case GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG:
 		{
-			case 1: glPixelStorei( GL_PACK_ALIGNMENT, 1 ); break;
-			case 2: glPixelStorei( GL_PACK_ALIGNMENT, 2 ); break;
-			case 3:
-			case 4: glPixelStorei( GL_PACK_ALIGNMENT, 4 ); break;
+			unsigned int size = ( width >> 2 ) * ( height >> 2 ) * 8;
+			
+			return size < 32 ? 32 : size;
 		}
 
-		if( flags & TEXTURE_16_BITS ) TEXTURE_convert_16_bits( texture, flags & TEXTURE_16_BITS_5551 );
+		case GL_COMPRESSED_RGB_PVRTC_2BPPV1_IMG:
+		case GL_COMPRESSED_RGBA_PVRTC_2BPPV1_IMG:
+		{
+			unsigned int size = ( width >> 3 ) * ( height >> 2 ) * 8;
+			
+			return size < 32 ? 32 : size;
+		}
+		
+		case GL_COMPRESSED_RGBA8_ETC2_EAC:
+		case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+		{ return ( ( width + 3 ) >> 2 ) * ( ( height + 3 ) >> 2 ) * 16; }
 	}
 	
+	// ETC1 and the ETC2 RGB formats use 8 bytes per 4x4 block.
+	return ( ( width + 3 ) >> 2 ) * ( ( height + 3 ) >> 2 ) * 8;
+}
 
-	if( flags & TEXTURE_CLAMP )
+
+/*!
+	Check if the OpenGLES driver support a compressed texture format. The list of formats is
+	queried once, so this function have to be called first from the thread that own the OpenGLES
+	context.
+	
+	\param[in] compression The compression type.
+	
+	\return Return 1 if the compression type is supported, else 0.
+*/
+unsigned char TEXTURE_is_compression_supported( unsigned int compression )
+{
+	static int n_format = -1,
+			   format[ 64 ];
+
+	int i = 0;
+
+	if( n_format == -1 )
 	{
-		glTexParameteri( texture->target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-		glTexParameteri( texture->target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+		int n = 0;
+		
+		glGetIntegerv( GL_NUM_COMPRESSED_TEXTURE_FORMATS, &n );
+		
+		if( n > 0 && n <= 64 ) glGetIntegerv( GL_COMPRESSED_TEXTURE_FORMATS, format );
+		
+		else n = 0;
+		
+		n_format = n;
 	}
-	else
+
+	while( i != n_format )
 	{
-		glTexParameteri( texture->target, GL_TEXTURE_WRAP_S, GL_REPEAT );
-		glTexParameteri( texture->target, GL_TEXTURE_WRAP_T, GL_REPEAT );			
+		if( format[ i ] == ( int )compression ) return 1;
+		++i;
 	}
 	
+	return 0;
+}
 
-	if( anisotropic_filter )
+
+/*!
+	Decode a 4x4 ETC1, ETC2 or ETC2 punchthrough color block. This function is used internally
+	by TEXTURE_decompress.
+	
+	\param[in] block The 8 bytes of the block.
+	\param[in] compression The compression type of the block.
+	\param[out] rgba The 16 decoded RGBA texels, stored column by column like the block indices.
+*/
+void TEXTURE_decode_etc_block( unsigned char *block, unsigned int compression, unsigned char rgba[ 16 ][ 4 ] )
+{
+	static const int modifier[ 8 ][ 2 ] = { {  2,   8 }, {  5,  17 }, {  9,  29 }, { 13,  42 },
+											{ 18,  60 }, { 24,  80 }, { 33, 106 }, { 47, 183 } };
+	
+	static const int distance[ 8 ] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+	
+	unsigned int high = ( block[ 0 ] << 24 ) | ( block[ 1 ] << 16 ) | ( block[ 2 ] << 8 ) | block[ 3 ],
+				 low  = ( block[ 4 ] << 24 ) | ( block[ 5 ] << 16 ) | ( block[ 6 ] << 8 ) | block[ 7 ],
+				 i	  = 0;
+	
+	unsigned char etc2		  = compression != GL_ETC1_RGB8_OES,
+				  punchthrough = compression == GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2 ||
+								 compression == GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2,
+				  diff		  = ( high >> 1 ) & 1,
+				  opaque	  = 1;
+	
+	int c[ 2 ][ 3 ],
+		paint[ 4 ][ 3 ],
+		mode = 0;	// 0 ETC1, 1 T, 2 H, 3 planar.
+	
+	// The punchthrough formats use the diff bit as opaque bit and are always differential.
+	if( punchthrough )
 	{
-		static float texture_max_anisotropy = 0.0f;
+		opaque = diff;
+		diff   = 1;
+	}
+	
+	if( !diff )
+	{
+		c[ 0 ][ 0 ] = ( high >> 28 ) & 0xF; c[ 1 ][ 0 ] = ( high >> 24 ) & 0xF;
+		c[ 0 ][ 1 ] = ( high >> 20 ) & 0xF; c[ 1 ][ 1 ] = ( high >> 16 ) & 0xF;
+		c[ 0 ][ 2 ] = ( high >> 12 ) & 0xF; c[ 1 ][ 2 ] = ( high >>  8 ) & 0xF;
 		
-		if( !texture_max_anisotropy ) glGetFloatv( GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT,
-												   &texture_max_anisotropy );
-
-		anisotropic_filter = CLAMP( anisotropic_filter,
-									0.0f,
-									texture_max_anisotropy );
-
-		glTexParameterf( texture->target,
-						 GL_TEXTURE_MAX_ANISOTROPY_EXT,
-						 anisotropic_filter );
+		while( i != 6 )
+		{
+			c[ i / 3 ][ i % 3 ] |= c[ i / 3 ][ i % 3 ] << 4;
+			++i;
+		}
+	}
+	else
+	{
+		int base[ 3 ] = { ( int )( high >> 27 ) & 0x1F, ( int )( high >> 19 ) & 0x1F, ( int )( high >> 11 ) & 0x1F },
+			delta[ 3 ] = { ( int )( high >> 24 ) & 0x7, ( int )( high >> 16 ) & 0x7, ( int )( high >> 8 ) & 0x7 };
+		
+		while( i != 3 )
+		{
+			if( delta[ i ] > 3 ) delta[ i ] -= 8;
+			
+			if( etc2 && !mode && ( base[ i ] + delta[ i ] < 0 || base[ i ] + delta[ i ] > 31 ) ) mode = i + 1;
+			
+			c[ 0 ][ i ] = ( base[ i ] << 3 ) | ( base[ i ] >> 2 );
+			c[ 1 ][ i ] = ( ( base[ i ] + delta[ i ] ) << 3 ) | ( ( ( base[ i ] + delta[ i ] ) & 0x1F ) >> 2 );
+			
+			++i;
+		}
 	}
 	
 	
-	if( flags & TEXTURE_MIPMAP )
+	if( mode == 1 || mode == 2 )
 	{
-		switch( filter )
+		int d;
+		
+		if( mode == 1 )
 		{
-			case TEXTURE_FILTER_1X:
-			{
-				glTexParameteri( texture->target, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR );
-				glTexParameteri( texture->target, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
-								
-				break;
-			}
-							
-			case TEXTURE_FILTER_2X:
-			{
-				glTexParameteri( texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST );
-				glTexParameteri( texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR );				
+			c[ 0 ][ 0 ] = ( ( ( high >> 27 ) & 0x3 ) << 2 ) | ( ( high >> 24 ) & 0x3 );
+			c[ 0 ][ 1 ] = ( high >> 20 ) & 0xF;
+			c[ 0 ][ 2 ] = ( high >> 16 ) & 0xF;
+			c[ 1 ][ 0 ] = ( high >> 12 ) & 0xF;
+			c[ 1 ][ 1 ] = ( high >>  8 ) & 0xF;
+			c[ 1 ][ 2 ] = ( high >>  4 ) & 0xF;
+			
+			d = distance[ ( ( ( high >> 2 ) & 0x3 ) << 1 ) | ( high & 1 ) ];
+		}
+		else
+		{
+			c[ 0 ][ 0 ] = ( high >> 27 ) & 0xF;
+			c[ 0 ][ 1 ] = ( ( ( high >> 24 ) & 0x7 ) << 1 ) | ( ( high >> 20 ) & 0x1 );
+			c[ 0 ][ 2 ] = ( ( ( high >> 19 ) & 0x1 ) << 3 ) | ( ( high >> 15 ) & 0x7 );
+			c[ 1 ][ 0 ] = ( high >> 11 ) & 0xF;
+			c[ 1 ][ 1 ] = ( high >>  7 ) & 0xF;
+			c[ 1 ][ 2 ] = ( high >>  3 ) & 0xF;
+			
+			d = ( ( ( high >> 2 ) & 1 ) << 2 ) | ( ( high & 1 ) << 1 ) |
+				( ( ( c[ 0 ][ 0 ] << 8 ) | ( c[ 0 ][ 1 ] << 4 ) | c[ 0 ][ 2 ] ) >=
+				  ( ( c[ 1 ][ 0 ] << 8 ) | ( c[ 1 ][ 1 ] << 4 ) | c[ 1 ][ 2 ] ) );
+			
+			d = distance[ d ];
+		}
+		
+		i = 0;
+		while( i != 6 )
+		{
+			c[ i / 3 ][ i % 3 ] |= c[ i / 3 ][ i % 3 ] << 4;
+			++i;
+		}
+		
+		i = 0;
+		while( i != 3 )
+		{
+			if( mode == 1 )
+			{
+				paint[ 0 ][ i ] = c[ 0 ][ i ];
+				paint[ 1 ][ i ] = CLAMP( c[ 1 ][ i ] + d, 0, 255 );
+				paint[ 2 ][ i ] = c[ 1 ][ i ];
+				paint[ 3 ][ i ] = CLAMP( c[ 1 ][ i ] - d, 0, 255 );
+			}
+			else
+			{
+				paint[ 0 ][ i ] = CLAMP( c[ 0 ][ i ] + d, 0, 255 );
+				paint[ 1 ][ i ] = CLAMP( c[ 0 ][ i ] - d, 0, 255 );
+				paint[ 2 ][ i ] = CLAMP( c[ 1 ][ i ] + d, 0, 255 );
+				paint[ 3 ][ i ] = CLAMP( c[ 1 ][ i ] - d, 0, 255 );
+			}
+			
+			++i;
+		}
+	}
+	
+	
+	i = 0;
+	while( i != 16 )
+	{
+		unsigned int x	 = i >> 2,
+					 y	 = i & 3,
+					 idx = ( ( ( low >> ( 16 + i ) ) & 1 ) << 1 ) | ( ( low >> i ) & 1 ),
+					 j;
+		
+		rgba[ i ][ 3 ] = 255;
+		
+		if( mode == 3 )
+		{
+			int o[ 3 ] = { ( int )( ( high >> 25 ) & 0x3F ),
+						   ( int )( ( ( ( high >> 24 ) & 0x1 ) << 6 ) | ( ( high >> 17 ) & 0x3F ) ),
+						   ( int )( ( ( ( high >> 16 ) & 0x1 ) << 5 ) | ( ( ( high >> 11 ) & 0x3 ) << 3 ) | ( ( high >> 7 ) & 0x7 ) ) },
+				h[ 3 ] = { ( int )( ( ( ( high >> 2 ) & 0x1F ) << 1 ) | ( high & 1 ) ),
+						   ( int )( ( low >> 25 ) & 0x7F ),
+						   ( int )( ( low >> 19 ) & 0x3F ) },
+				v[ 3 ] = { ( int )( ( low >> 13 ) & 0x3F ),
+						   ( int )( ( low >>  6 ) & 0x7F ),
+						   ( int )( low & 0x3F ) };
+			
+			// Expand 6 and 7 bits (green) components to 8 bits.
+			o[ 0 ] = ( o[ 0 ] << 2 ) | ( o[ 0 ] >> 4 ); h[ 0 ] = ( h[ 0 ] << 2 ) | ( h[ 0 ] >> 4 ); v[ 0 ] = ( v[ 0 ] << 2 ) | ( v[ 0 ] >> 4 );
+			o[ 1 ] = ( o[ 1 ] << 1 ) | ( o[ 1 ] >> 6 ); h[ 1 ] = ( h[ 1 ] << 1 ) | ( h[ 1 ] >> 6 ); v[ 1 ] = ( v[ 1 ] << 1 ) | ( v[ 1 ] >> 6 );
+			o[ 2 ] = ( o[ 2 ] << 2 ) | ( o[ 2 ] >> 4 ); h[ 2 ] = ( h[ 2 ] << 2 ) | ( h[ 2 ] >> 4 ); v[ 2 ] = ( v[ 2 ] << 2 ) | ( v[ 2 ] >> 4 );
+			
+			j = 0;
+			while( j != 3 )
+			{
+				int value = ( ( int )x * ( h[ j ] - o[ j ] ) + ( int )y * ( v[ j ] - o[ j ] ) + 4 * o[ j ] + 2 ) >> 2;
+				
+				rgba[ i ][ j ] = CLAMP( value, 0, 255 );
+				++j;
+			}
+		}
+		else if( mode )
+		{
+			j = 0;
+			while( j != 3 )
+			{
+				rgba[ i ][ j ] = paint[ idx ][ j ];
+				++j;
+			}
+			
+			if( !opaque && idx == 2 )
+			{
+				rgba[ i ][ 0 ] =
+				rgba[ i ][ 1 ] =
+				rgba[ i ][ 2 ] =
+				rgba[ i ][ 3 ] = 0;
+			}
+		}
+		else
+		{
+			unsigned char flip	   = high & 1,
+						  subblock = flip ? y >= 2 : x >= 2;
+			
+			int table = ( high >> ( subblock ? 2 : 5 ) ) & 0x7,
+				m	  = modifier[ table ][ idx & 1 ];
+			
+			if( idx & 2 ) m = -m;
+			
+			if( !opaque && !( idx & 1 ) ) m = 0;
+			
+			j = 0;
+			while( j != 3 )
+			{
+				int value = c[ subblock ][ j ] + m;
+				
+				rgba[ i ][ j ] = CLAMP( value, 0, 255 );
+				++j;
+			}
+			
+			if( !opaque && idx == 2 )
+			{
+				rgba[ i ][ 0 ] =
+				rgba[ i ][ 1 ] =
+				rgba[ i ][ 2 ] =
+				rgba[ i ][ 3 ] = 0;
+			}
+		}
+		
+		++i;
+	}
+}
+
+
+/*!
+	Decode a 4x4 EAC alpha block. This function is used internally by TEXTURE_decompress.
+	
+	\param[in] block The 8 bytes of the block.
+	\param[in,out] rgba The 16 RGBA texels to store the alpha into, stored column by column.
+*/
+void TEXTURE_decode_eac_block( unsigned char *block, unsigned char rgba[ 16 ][ 4 ] )
+{
+	static const int modifier[ 16 ][ 8 ] = { { -3, -6,  -9, -15, 2, 5, 8, 14 },
+											 { -3, -7, -10, -13, 2, 6, 9, 12 },
+											 { -2, -5,  -8, -13, 1, 4, 7, 12 },
+											 { -2, -4,  -6, -13, 1, 3, 5, 12 },
+											 { -3, -6,  -8, -12, 2, 5, 7, 11 },
+											 { -3, -7,  -9, -11, 2, 6, 8, 10 },
+											 { -4, -7,  -8, -11, 3, 6, 7, 10 },
+											 { -3, -5,  -8, -11, 2, 4, 7, 10 },
+											 { -2, -6,  -8, -10, 1, 5, 7,  9 },
+											 { -2, -5,  -8, -10, 1, 4, 7,  9 },
+											 { -2, -4,  -8, -10, 1, 3, 7,  9 },
+											 { -2, -5,  -7, -10, 1, 4, 6,  9 },
+											 { -3, -4,  -7, -10, 2, 3, 6,  9 },
+											 { -1, -2,  -3, -10, 0, 1, 2,  9 },
+											 { -4, -6,  -8,  -9, 3, 5, 7,  8 },
+											 { -3, -5,  -7,  -9, 2, 4, 6,  8 } };
+	
+	int base	   = block[ 0 ],
+		multiplier = block[ 1 ] >> 4,
+		table	   = block[ 1 ] & 0xF;
+	
+	unsigned int i = 0;
+	
+	unsigned long long bits = 0;
+	
+	while( i != 6 )
+	{
+		bits = ( bits << 8 ) | block[ 2 + i ];
+		++i;
+	}
+	
+	i = 0;
+	while( i != 16 )
+	{
+		int value = base + modifier[ table ][ ( bits >> ( 45 - 3 * i ) ) & 0x7 ] * multiplier;
+		
+		rgba[ i ][ 3 ] = CLAMP( value, 0, 255 );
+		++i;
+	}
+}
+
+
+/*!
+	Decompress an ETC1 or ETC2 texture (with all its mipmap levels) on the CPU when the compression
+	type is not supported by the driver. Textures without alpha are converted to RGB565 and textures
+	with alpha to RGBA4444.
+	
+	\param[in,out] texture A valid TEXTURE structure pointer that contain an ETC compressed texel array.
+	
+	\return Return 1 if the texture have been decompressed, 0 if the compression type is not supported.
+*/
+unsigned char TEXTURE_decompress( TEXTURE *texture )
+{
+	unsigned int i		  = 0,
+				 width	  = texture->width,
+				 height	  = texture->height,
+				 src	  = 0,
+				 dst	  = 0,
+				 size	  = 0,
+				 bsize;
+	
+	unsigned char alpha;
+	
+	unsigned short *texel_array;
+	
+	switch( texture->compression )
+	{
+		case GL_ETC1_RGB8_OES:
+		case GL_COMPRESSED_RGB8_ETC2:
+		case GL_COMPRESSED_SRGB8_ETC2: alpha = 0; break;
+		
+		case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+		case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+		case GL_COMPRESSED_RGBA8_ETC2_EAC:
+		case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC: alpha = 1; break;
+		
+		default: return 0;
+	}
+	
+	bsize = texture->compression == GL_COMPRESSED_RGBA8_ETC2_EAC ||
+			texture->compression == GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC ? 16 : 8;
+	
+	while( i != texture->n_mipmap )
+	{
+		size += ( width ? width : 1 ) * ( height ? height : 1 );
+		
+		width  >>= 1;
+		height >>= 1;
+		
+		++i;
+	}
+	
+	texel_array = ( unsigned short * ) malloc( size * sizeof( unsigned short ) );
+
+	width  = texture->width;
+	height = texture->height;
+	
+	i = 0;
+	while( i != texture->n_mipmap )
+	{
+		unsigned int x,
+					 y = 0,
+					 k;
+		
+		if( width  < 1 ) width  = 1;
+		if( height < 1 ) height = 1;
+		
+		while( y < height )
+		{
+			x = 0;
+			while( x < width )
+			{
+				unsigned char rgba[ 16 ][ 4 ];
+				
+				unsigned char *block = &texture->texel_array[ src ];
+				
+				if( bsize == 16 )
+				{
+					TEXTURE_decode_etc_block( block + 8, texture->compression, rgba );
+					
+					TEXTURE_decode_eac_block( block, rgba );
+				}
+				else TEXTURE_decode_etc_block( block, texture->compression, rgba );
+				
+				k = 0;
+				while( k != 16 )
+				{
+					unsigned int px = x + ( k >> 2 ),
+								 py = y + ( k & 3 );
+					
+					if( px < width && py < height )
+					{
+						unsigned char *t = rgba[ k ];
+						
+						texel_array[ dst + py * width + px ] = alpha ?
+															   ( ( t[ 0 ] >> 4 ) << 12 ) | ( ( t[ 1 ] >> 4 ) << 8 ) | ( ( t[ 2 ] >> 4 ) << 4 ) | ( t[ 3 ] >> 4 ) :
+															   ( ( t[ 0 ] >> 3 ) << 11 ) | ( ( t[ 1 ] >> 2 ) << 5 ) | ( t[ 2 ] >> 3 );
+					}
+					
+					++k;
+				}
+				
+				src += bsize;
+				x	+= 4;
+			}
+			
+			y += 4;
+		}
+		
+		dst += width * height;
+		
+		width  >>= 1;
+		height >>= 1;
+		
+		++i;
+	}
+	
+	free( texture->texel_array );
+	
+	texture->texel_array	 = ( unsigned char * )texel_array;
+	texture->compression	 = 0;
+	texture->byte			 = 2;
+	texture->size			 = size * sizeof( unsigned short );
+	texture->internal_format =
+	texture->format			 = alpha ? GL_RGBA : GL_RGB;
+	texture->texel_type		 = alpha ? GL_UNSIGNED_SHORT_4_4_4_4 : GL_UNSIGNED_SHORT_5_6_5;
+	
+	return 1;
+}
+
+
+/*!
+	Return the dither mode matching a set of TEXTURE flags.
+	
+	\param[in] flags The TEXTURE flags.
+	
+	\return Return TEXTURE_DITHER_NONE, TEXTURE_DITHER_ORDERED or TEXTURE_DITHER_DIFFUSION.
+*/
+unsigned char TEXTURE_get_dither( unsigned int flags )
+{
+	if( flags & TEXTURE_16_BITS_DITHER_DIFFUSION ) return TEXTURE_DITHER_DIFFUSION;
+	
+	else if( flags & TEXTURE_16_BITS_DITHER ) return TEXTURE_DITHER_ORDERED;
+	
+	return TEXTURE_DITHER_NONE;
+}
+
+
+/*!
+	Pack one 24 or 32 bits texel to 16 bits. This function is used internally by
+	TEXTURE_convert_16_bits for the texels that are not handled by the SIMD kernels.
+	
+	\param[in] t The source texel.
+	\param[in] d The dither bias to add (with saturation) to each channel of the texel.
+	\param[in] texel_type The 16 bits texel type to pack to.
+	
+	\return Return the 16 bits texel.
+*/
+unsigned short TEXTURE_pack_16_bits( unsigned char *t, unsigned char *d, unsigned int texel_type )
+{
+	unsigned int r = t[ 0 ] + d[ 0 ],
+				 g = t[ 1 ] + d[ 1 ],
+				 b = t[ 2 ] + d[ 2 ];
+	
+	if( r > 255 ) r = 255;
+	if( g > 255 ) g = 255;
+	if( b > 255 ) b = 255;
+	
+	switch( texel_type )
+	{
+		case GL_UNSIGNED_SHORT_5_6_5:
+		{ return ( ( r >> 3 ) << 11 ) | ( ( g >> 2 ) << 5 ) | ( b >> 3 ); }
+		
+		case GL_UNSIGNED_SHORT_5_5_5_1:
+		{ return ( ( r >> 3 ) << 11 ) | ( ( g >> 3 ) << 6 ) | ( ( b >> 3 ) << 1 ) | ( t[ 3 ] >> 7 ); }
+	}
+	
+	unsigned int a = t[ 3 ] + d[ 3 ];
+	
+	if( a > 255 ) a = 255;
+	
+	return ( ( r >> 4 ) << 12 ) | ( ( g >> 4 ) << 8 ) | ( ( b >> 4 ) << 4 ) | ( a >> 4 );
+}
+
+
+/*!
+	Convert the texels using an optional 4x4 ordered dither. The conversion is done in place
+	from the start of the array since the 16 bits texels never overlap the source texels that
+	remain to be read. This function is used internally by TEXTURE_convert_16_bits.
+	
+	\param[in] src The source texels.
+	\param[out] dst The destination texels, either equal to src or located before it.
+	\param[in] width The width of the image.
+	\param[in] height The height of the image.
+	\param[in] byte The number of bytes per source texel (3 or 4).
+	\param[in] texel_type The 16 bits texel type to convert to.
+	\param[in] dither Determine if the ordered dither is applied.
+*/
+void TEXTURE_convert_16_bits_ordered( unsigned char *src, unsigned short *dst, unsigned int width, unsigned int height, unsigned char byte, unsigned int texel_type, unsigned char dither )
+{
+	static const unsigned char bayer[ 4 ][ 4 ] = { {  0,  8,  2, 10 },
+												   { 12,  4, 14,  6 },
+												   {  3, 11,  1,  9 },
+												   { 15,  7, 13,  5 } };
+	
+	unsigned int y = 0,
+				 s = width * height;
+	
+	while( y != height )
+	{
+		// The dither bias of 4 consecutive texels in RGBA order, matching the layout of 16 bytes of RGBA texels.
+		unsigned char pattern[ 16 ];
+		
+		unsigned int x = 0,
+					 row = y * width;
+		
+		while( x != 4 )
+		{
+			unsigned char d = dither ? bayer[ y & 3 ][ x ] : 0;
+			
+			switch( texel_type )
+			{
+				case GL_UNSIGNED_SHORT_5_6_5:
+				{
+					pattern[ ( x << 2 )     ] = d >> 1;
+					pattern[ ( x << 2 ) + 1 ] = d >> 2;
+					pattern[ ( x << 2 ) + 2 ] = d >> 1;
+					pattern[ ( x << 2 ) + 3 ] = 0;
+					
+					break;
+				}
+				
+				case GL_UNSIGNED_SHORT_5_5_5_1:
+				{
+					pattern[ ( x << 2 )     ] =
+					pattern[ ( x << 2 ) + 1 ] =
+					pattern[ ( x << 2 ) + 2 ] = d >> 1;
+					pattern[ ( x << 2 ) + 3 ] = 0;
+					
+					break;
+				}
+				
+				default:
+				{
+					pattern[ ( x << 2 )     ] =
+					pattern[ ( x << 2 ) + 1 ] =
+					pattern[ ( x << 2 ) + 2 ] =
+					pattern[ ( x << 2 ) + 3 ] = d;
+					
+					break;
+				}
+			}
+			
+			++x;
+		}
+		
+		x = 0;
+		
+		#ifdef GFX_SSE2
+		{
+			__m128i bias  = _mm_loadu_si128( ( __m128i * )pattern ),
+					mask5 = _mm_set1_epi32( 0x1F ),
+					mask6 = _mm_set1_epi32( 0x3F ),
+					mask4 = _mm_set1_epi32( 0x0F );
+			
+			// 8 texels per iteration, 24 bits texels are read 16 bytes at a time so stay clear of the end of the array.
+			while( x + 8 <= width &&
+				   ( byte == 4 || row + x + 10 <= s ) )
+			{
+				__m128i v[ 2 ];
+				
+				unsigned int k = 0;
+				
+				while( k != 2 )
+				{
+					unsigned char *t = &src[ ( row + x + ( k << 2 ) ) * byte ];
+					
+					__m128i p = _mm_loadu_si128( ( __m128i * )t );
+					
+					if( byte == 3 )
+					{
+						// Spread the 4 RGB texels to 32 bits lanes.
+						p = _mm_unpacklo_epi64( _mm_unpacklo_epi32( p, _mm_srli_si128( p, 3 ) ),
+												_mm_unpacklo_epi32( _mm_srli_si128( p, 6 ), _mm_srli_si128( p, 9 ) ) );
+					}
+					
+					p = _mm_adds_epu8( p, bias );
+					
+					switch( texel_type )
+					{
+						case GL_UNSIGNED_SHORT_5_6_5:
+						{
+							p = _mm_or_si128( _mm_or_si128( _mm_slli_epi32( _mm_and_si128( _mm_srli_epi32( p,  3 ), mask5 ), 11 ),
+															_mm_slli_epi32( _mm_and_si128( _mm_srli_epi32( p, 10 ), mask6 ),  5 ) ),
+															_mm_and_si128( _mm_srli_epi32( p, 19 ), mask5 ) );
+							break;
+						}
+						
+						case GL_UNSIGNED_SHORT_5_5_5_1:
+						{
+							p = _mm_or_si128( _mm_or_si128( _mm_slli_epi32( _mm_and_si128( _mm_srli_epi32( p,  3 ), mask5 ), 11 ),
+															_mm_slli_epi32( _mm_and_si128( _mm_srli_epi32( p, 11 ), mask5 ),  6 ) ),
+											  _mm_or_si128( _mm_slli_epi32( _mm_and_si128( _mm_srli_epi32( p, 19 ), mask5 ),  1 ),
+															_mm_srli_epi32( p, 31 ) ) );
+							break;
+						}
+						
+						default:
+						{
+							p = _mm_or_si128( _mm_or_si128( _mm_slli_epi32( _mm_and_si128( _mm_srli_epi32( p,  4 ), mask4 ), 12 ),
+															_mm_slli_epi32( _mm_and_si128( _mm_srli_epi32( p, 12 ), mask4 ),  8 ) ),
+											  _mm_or_si128( _mm_slli_epi32( _mm_and_si128( _mm_srli_epi32( p, 20 ), mask4 ),  4 ),
+															_mm_srli_epi32( p, 28 ) ) );
+							break;
+						}
+					}
+					
+					// Sign extend so the signed pack keep the 16 low bits untouched.
+					v[ k ] = _mm_srai_epi32( _mm_slli_epi32( p, 16 ), 16 );
+					
+					++k;
+				}
+				
+				_mm_storeu_si128( ( __m128i * )&dst[ row + x ], _mm_packs_epi32( v[ 0 ], v[ 1 ] ) );
+				
+				x += 8;
+			}
+		}
+		#elif defined( GFX_NEON )
+		{
+			uint8x8_t bias[ 4 ];
+			
+			unsigned int k = 0;
+			
+			while( k != 4 )
+			{
+				unsigned char lane[ 8 ];
+				
+				unsigned int j = 0;
+				
+				while( j != 8 )
+				{
+					lane[ j ] = pattern[ ( ( j & 3 ) << 2 ) + k ];
+					++j;
+				}
+				
+				bias[ k ] = vld1_u8( lane );
+				
+				++k;
+			}
+			
+			while( x + 8 <= width )
+			{
+				unsigned char *t = &src[ ( row + x ) * byte ];
+				
+				uint8x8_t r, g, b, a;
+				
+				uint16x8_t p;
+				
+				if( byte == 3 )
+				{
+					uint8x8x3_t rgb = vld3_u8( t );
+					
+					r = rgb.val[ 0 ];
+					g = rgb.val[ 1 ];
+					b = rgb.val[ 2 ];
+					a = vdup_n_u8( 255 );
+				}
+				else
+				{
+					uint8x8x4_t rgba = vld4_u8( t );
+					
+					r = rgba.val[ 0 ];
+					g = rgba.val[ 1 ];
+					b = rgba.val[ 2 ];
+					a = rgba.val[ 3 ];
+				}
+				
+				r = vqadd_u8( r, bias[ 0 ] );
+				g = vqadd_u8( g, bias[ 1 ] );
+				b = vqadd_u8( b, bias[ 2 ] );
+				a = vqadd_u8( a, bias[ 3 ] );
+				
+				switch( texel_type )
+				{
+					case GL_UNSIGNED_SHORT_5_6_5:
+					{
+						p = vorrq_u16( vorrq_u16( vshlq_n_u16( vmovl_u8( vshr_n_u8( r, 3 ) ), 11 ),
+												  vshlq_n_u16( vmovl_u8( vshr_n_u8( g, 2 ) ),  5 ) ),
+												  vmovl_u8( vshr_n_u8( b, 3 ) ) );
+						break;
+					}
+					
+					case GL_UNSIGNED_SHORT_5_5_5_1:
+					{
+						p = vorrq_u16( vorrq_u16( vshlq_n_u16( vmovl_u8( vshr_n_u8( r, 3 ) ), 11 ),
+												  vshlq_n_u16( vmovl_u8( vshr_n_u8( g, 3 ) ),  6 ) ),
+									   vorrq_u16( vshlq_n_u16( vmovl_u8( vshr_n_u8( b, 3 ) ),  1 ),
+												  vmovl_u8( vshr_n_u8( a, 7 ) ) ) );
+						break;
+					}
+					
+					default:
+					{
+						p = vorrq_u16( vorrq_u16( vshlq_n_u16( vmovl_u8( vshr_n_u8( r, 4 ) ), 12 ),
+												  vshlq_n_u16( vmovl_u8( vshr_n_u8( g, 4 ) ),  8 ) ),
+									   vorrq_u16( vshlq_n_u16( vmovl_u8( vshr_n_u8( b, 4 ) ),  4 ),
+												  vmovl_u8( vshr_n_u8( a, 4 ) ) ) );
+						break;
+					}
+				}
+				
+				vst1q_u16( &dst[ row + x ], p );
+				
+				x += 8;
+			}
+		}
+		#endif
+		
+		while( x != width )
+		{
+			dst[ row + x ] = TEXTURE_pack_16_bits( &src[ ( row + x ) * byte ],
+														   &pattern[ ( x & 3 ) << 2 ],
+														   texel_type );
+			++x;
+		}
+		
+		++y;
+	}
+}
+
+
+/*!
+	Convert the texels using a Floyd-Steinberg error diffusion. The error is spread directly
+	into the source texels that are not converted yet, so no extra buffer is needed. This
+	function is used internally by TEXTURE_convert_16_bits.
+	
+	\param[in,out] src The source texels.
+	\param[out] dst The destination texels, either equal to src or located before it.
+	\param[in] width The width of the image.
+	\param[in] height The height of the image.
+	\param[in] byte The number of bytes per source texel (3 or 4).
+	\param[in] texel_type The 16 bits texel type to convert to.
+*/
+void TEXTURE_convert_16_bits_diffusion( unsigned char *src, unsigned short *dst, unsigned int width, unsigned int height, unsigned char byte, unsigned int texel_type )
+{
+	unsigned int y = 0,
+				 bits[ 4 ];
+	
+	switch( texel_type )
+	{
+		case GL_UNSIGNED_SHORT_5_6_5  : bits[ 0 ] = 5; bits[ 1 ] = 6; bits[ 2 ] = 5; bits[ 3 ] = 8; break;
+		case GL_UNSIGNED_SHORT_5_5_5_1: bits[ 0 ] = 5; bits[ 1 ] = 5; bits[ 2 ] = 5; bits[ 3 ] = 8; break;
+		default						  : bits[ 0 ] = 4; bits[ 1 ] = 4; bits[ 2 ] = 4; bits[ 3 ] = 4; break;
+	}
+	
+	while( y != height )
+	{
+		unsigned int x = 0;
+		
+		while( x != width )
+		{
+			unsigned int i = y * width + x,
+						 c = 0;
+			
+			unsigned char *t = &src[ i * byte ],
+						  q[ 4 ],
+						  zero[ 4 ] = { 0, 0, 0, 0 };
+			
+			while( c != byte )
+			{
+				// Round to the nearest representable value, the 1 bit alpha of 5551 is not diffused.
+				int m = ( 1 << bits[ c ] ) - 1,
+					v = ( t[ c ] * m + 127 ) / 255,
+					e;
+				
+				q[ c ] = ( v * 255 + ( m >> 1 ) ) / m;
+				
+				e = t[ c ] - q[ c ];
+				
+				if( e && bits[ c ] != 8 )
+				{
+					// Divide instead of shifting so negative errors are not rounded down, the last share get the remainder.
+					int e7 = ( e * 7 ) / 16,
+						e3 = ( e * 3 ) / 16,
+						e5 = ( e * 5 ) / 16,
+						e1 = e - e7 - e3 - e5;
+					
+					if( x + 1 != width )
+					{
+						int n = t[ byte + c ] + e7;
+						
+						t[ byte + c ] = CLAMP( n, 0, 255 );
+					}
+					
+					if( y + 1 != height )
+					{
+						unsigned char *b = &src[ ( i + width ) * byte + c ];
+						
+						int n;
+						
+						if( x )
+						{
+							n = b[ -( int )byte ] + e3;
+							
+							b[ -( int )byte ] = CLAMP( n, 0, 255 );
+						}
+						
+						n = b[ 0 ] + e5;
+						
+						b[ 0 ] = CLAMP( n, 0, 255 );
+						
+						if( x + 1 != width )
+						{
+							n = b[ byte ] + e1;
+							
+							b[ byte ] = CLAMP( n, 0, 255 );
+						}
+					}
+				}
+				
+				++c;
+			}
+			
+			if( byte == 3 ) q[ 3 ] = 255;
+			
+			dst[ i ] = TEXTURE_pack_16_bits( q, zero, texel_type );
+			
+			++x;
+		}
+		
+		++y;
+	}
+}
+
+
+/*!
+	Helper function to convert an uncompressed 24bits or 32bits image to a 16 bits image. The
+	conversion is done in place without any temporary allocation, 24 bits images are converted
+	to 565 and 32 bits images to 4444 or 5551.
+	
+	\param[in,out] texture A valid TEXTURE pointer.
+	\param[in] use_5551 Determine if a 32bits image should be converted using 5551 bits instead of the default 4444 bits.
+	\param[in] dither The dither to apply, either TEXTURE_DITHER_NONE, TEXTURE_DITHER_ORDERED or TEXTURE_DITHER_DIFFUSION.
+*/
+void TEXTURE_convert_16_bits( TEXTURE *texture, unsigned char use_5551, unsigned char dither )
+{
+	unsigned int i		= 0,
+				 width	= texture->width,
+				 height = texture->height,
+				 src	= 0,
+				 dst	= 0;
+	
+	unsigned short *texel_array = ( unsigned short * )texture->texel_array;
+	
+	if( texture->texel_type != GL_UNSIGNED_BYTE ||
+		( texture->byte != 3 && texture->byte != 4 ) ) return;
+	
+	if( texture->byte == 3 ) texture->texel_type = GL_UNSIGNED_SHORT_5_6_5;
+	
+	else texture->texel_type = use_5551 ? GL_UNSIGNED_SHORT_5_5_5_1 : GL_UNSIGNED_SHORT_4_4_4_4;
+	
+	// Convert every mipmap level, the 16 bits levels are packed one after the other.
+	do
+	{
+		if( width  < 1 ) width  = 1;
+		if( height < 1 ) height = 1;
+		
+		if( dither == TEXTURE_DITHER_DIFFUSION )
+		{
+			TEXTURE_convert_16_bits_diffusion( &texture->texel_array[ src ],
+											   &texel_array[ dst ],
+											   width,
+											   height,
+											   texture->byte,
+											   texture->texel_type );
+		}
+		else
+		{
+			TEXTURE_convert_16_bits_ordered( &texture->texel_array[ src ],
+											 &texel_array[ dst ],
+											 width,
+											 height,
+											 texture->byte,
+											 texture->texel_type,
+											 dither == TEXTURE_DITHER_ORDERED );
+		}
+		
+		src += width * height * texture->byte;
+		dst += width * height;
+		
+		width  >>= 1;
+		height >>= 1;
+		
+		++i;
+	}
+	while( i < texture->n_mipmap );
+	
+	texture->byte = 2;
+	texture->size = dst * 2;
+}
+
+
+/*!
+	Evaluate the zero order modified Bessel function of the first kind used by the Kaiser window.
+	This function is used internally by TEXTURE_resample_kernel.
+	
+	\param[in] x The value to evaluate.
+	
+	\return Return I0( x ).
+*/
+float TEXTURE_bessel0( float x )
+{
+	float sum  = 1.0f,
+		  term = 1.0f,
+		  x2   = x * x * 0.25f;
+	
+	unsigned int i = 1;
+	
+	while( i != 20 )
+	{
+		term *= x2 / ( float )( i * i );
+		sum  += term;
+		
+		++i;
+	}
+	
+	return sum;
+}
+
+
+/*!
+	Evaluate a resampling filter. This function is used internally by TEXTURE_resample.
+	
+	\param[in] filter The filter to use, either TEXTURE_RESAMPLE_BOX, TEXTURE_RESAMPLE_KAISER or TEXTURE_RESAMPLE_LANCZOS.
+	\param[in] x The distance to the center of the filter, in destination texels.
+	
+	\return Return the unnormalized weight of the filter.
+*/
+float TEXTURE_resample_kernel( unsigned char filter, float x )
+{
+	float sinc;
+	
+	if( filter == TEXTURE_RESAMPLE_BOX ) return ( x > -0.5f && x <= 0.5f ) ? 1.0f : 0.0f;
+	
+	x = fabsf( x );
+	
+	if( x >= 3.0f ) return 0.0f;
+	
+	sinc = x < 0.0001f ? 1.0f : sinf( M_PI * x ) / ( M_PI * x );
+	
+	if( filter == TEXTURE_RESAMPLE_KAISER )
+	{
+		// Kaiser window of width 3 and alpha 4.
+		float t = x / 3.0f;
+		
+		return sinc * TEXTURE_bessel0( 4.0f * sqrtf( 1.0f - t * t ) ) / TEXTURE_bessel0( 4.0f );
+	}
+	
+	// Lanczos 3.
+	return sinc * ( x < 0.0001f ? 1.0f : sinf( M_PI * x / 3.0f ) / ( M_PI * x / 3.0f ) );
+}
+
+
+/*!
+	Build the table of source texels and weights contributing to each destination texel along
+	one axis. Texels outside the image are clamped to the edges and the weights are normalized.
+	Each destination texel use the same number of contributions, unused ones have a weight of 0.
+	This function is used internally by TEXTURE_resample.
+	
+	\param[in] src_size The number of source texels.
+	\param[in] dst_size The number of destination texels.
+	\param[in] filter The filter to use.
+	\param[out] index The array of source indices allocated by the function.
+	\param[out] weight The array of weights allocated by the function.
+	
+	\return Return the number of contributions per destination texel.
+*/
+unsigned int TEXTURE_resample_contributions( unsigned int src_size, unsigned int dst_size, unsigned char filter, unsigned int **index, float **weight )
+{
+	float scale	  = ( float )src_size / ( float )dst_size,
+		  stretch = scale > 1.0f ? scale : 1.0f,
+		  support = ( filter == TEXTURE_RESAMPLE_BOX ? 0.5f : 3.0f ) * stretch;
+	
+	unsigned int i = 0,
+				 n_contrib = ( unsigned int )ceilf( support * 2.0f ) + 1;
+	
+	*index  = ( unsigned int * ) calloc( dst_size * n_contrib, sizeof( unsigned int ) );
+	*weight = ( float * ) calloc( dst_size * n_contrib, sizeof( float ) );
+	
+	while( i != dst_size )
+	{
+		float center = ( ( float )i + 0.5f ) * scale,
+			  sum	 = 0.0f;
+		
+		int first = ( int )floorf( center - support ),
+			j	  = 0;
+		
+		while( j != ( int )n_contrib )
+		{
+			int s = first + j;
+			
+			float w = TEXTURE_resample_kernel( filter, ( ( float )s + 0.5f - center ) / stretch );
+			
+			( *index  )[ i * n_contrib + j ] = CLAMP( s, 0, ( int )src_size - 1 );
+			( *weight )[ i * n_contrib + j ] = w;
+			
+			sum += w;
+			++j;
+		}
+		
+		if( sum )
+		{
+			j = 0;
+			while( j != ( int )n_contrib )
+			{
+				( *weight )[ i * n_contrib + j ] /= sum;
+				++j;
+			}
+		}
+		
+		++i;
+	}
+	
+	return n_contrib;
+}
+
+
+/*!
+	Resample an 8 bits per channel image using a separable filter. Rows are filtered horizontally
+	as they are needed by the vertical pass and kept in a small ring, so the memory used does not
+	depend on the height of the image. The accumulation is done on 4 channels at a time using
+	SSE or NEON when available. The function does not use OpenGLES and can be called from a
+	WORKER thread.
+	
+	\param[in] src The source texels.
+	\param[in] src_width The width of the source image.
+	\param[in] src_height The height of the source image.
+	\param[out] dst The destination texels.
+	\param[in] dst_width The width of the destination image.
+	\param[in] dst_height The height of the destination image.
+	\param[in] byte The number of channels per texel (1 to 4).
+	\param[in] filter The filter to use, either TEXTURE_RESAMPLE_BOX, TEXTURE_RESAMPLE_KAISER or TEXTURE_RESAMPLE_LANCZOS.
+	\param[in] gamma Determine if the color channels are filtered in linear space (sRGB source), alpha is always filtered as is.
+*/
+void TEXTURE_resample( unsigned char *src, unsigned int src_width, unsigned int src_height, unsigned char *dst, unsigned int dst_width, unsigned int dst_height, unsigned char byte, unsigned char filter, unsigned char gamma )
+{
+	static float		 to_linear[ 256 ];
+	static unsigned char to_srgb[ 4096 ];
+	static unsigned char table = 0;
+	
+	unsigned int i = 0,
+				 x,
+				 y,
+				 c,
+				 n_color = ( byte == 2 || byte == 4 ) ? byte - 1 : byte,
+				 n_contrib_x,
+				 n_contrib_y,
+				 *index_x,
+				 *index_y,
+				 *ring_row;
+	
+	float *weight_x,
+		  *weight_y,
+		  *row,
+		  *ring,
+		  *acc;
+	
+	if( gamma && !table )
+	{
+		while( i != 256 )
+		{
+			float v = ( float )i / 255.0f;
+			
+			to_linear[ i ] = v <= 0.04045f ? v / 12.92f : powf( ( v + 0.055f ) / 1.055f, 2.4f );
+			++i;
+		}
+		
+		i = 0;
+		while( i != 4096 )
+		{
+			float v = ( float )i / 4095.0f;
+			
+			v = v <= 0.0031308f ? v * 12.92f : 1.055f * powf( v, 1.0f / 2.4f ) - 0.055f;
+			
+			to_srgb[ i ] = ( unsigned char )( v * 255.0f + 0.5f );
+			++i;
+		}
+		
+		table = 1;
+	}
+	
+	n_contrib_x = TEXTURE_resample_contributions( src_width , dst_width , filter, &index_x, &weight_x );
+	n_contrib_y = TEXTURE_resample_contributions( src_height, dst_height, filter, &index_y, &weight_y );
+	
+	row		 = ( float * ) malloc( src_width * 4 * sizeof( float ) );
+	ring	 = ( float * ) malloc( n_contrib_y * dst_width * 4 * sizeof( float ) );
+	acc		 = ( float * ) malloc( dst_width * 4 * sizeof( float ) );
+	ring_row = ( unsigned int * ) malloc( n_contrib_y * sizeof( unsigned int ) );
+	
+	i = 0;
+	while( i != n_contrib_y )
+	{
+		ring_row[ i ] = 0xFFFFFFFF;
+		++i;
+	}
+	
+	y = 0;
+	while( y != dst_height )
+	{
+		memset( acc, 0, dst_width * 4 * sizeof( float ) );
+		
+		i = 0;
+		while( i != n_contrib_y )
+		{
+			unsigned int sy	  = index_y[ y * n_contrib_y + i ],
+						 slot = sy % n_contrib_y;
+			
+			float w = weight_y[ y * n_contrib_y + i ],
+				  *r = &ring[ slot * dst_width * 4 ];
+			
+			if( !w ){ ++i; continue; }
+			
+			// Filter the source row horizontally if it is not in the ring yet.
+			if( ring_row[ slot ] != sy )
+			{
+				unsigned char *t = &src[ sy * src_width * byte ];
+				
+				x = 0;
+				while( x != src_width )
+				{
+					c = 0;
+					while( c != 4 )
+					{
+						row[ ( x << 2 ) + c ] = c < byte ?
+												( gamma && c < n_color ? to_linear[ t[ c ] ] : ( float )t[ c ] / 255.0f ) :
+												0.0f;
+						++c;
+					}
+					
+					t += byte;
+					++x;
+				}
+				
+				x = 0;
+				while( x != dst_width )
+				{
+					unsigned int *ix = &index_x[ x * n_contrib_x ],
+								  j	 = 0;
+					
+					float *wx = &weight_x[ x * n_contrib_x ];
+					
+					#ifdef GFX_SSE2
+					
+						__m128 sum = _mm_setzero_ps();
+						
+						while( j != n_contrib_x )
+						{
+							sum = _mm_add_ps( sum, _mm_mul_ps( _mm_set1_ps( wx[ j ] ), _mm_loadu_ps( &row[ ix[ j ] << 2 ] ) ) );
+							++j;
+						}
+						
+						_mm_storeu_ps( &r[ x << 2 ], sum );
+					
+					#elif defined( GFX_NEON )
+					
+						float32x4_t sum = vdupq_n_f32( 0.0f );
+						
+						while( j != n_contrib_x )
+						{
+							sum = vmlaq_n_f32( sum, vld1q_f32( &row[ ix[ j ] << 2 ] ), wx[ j ] );
+							++j;
+						}
+						
+						vst1q_f32( &r[ x << 2 ], sum );
+					
+					#else
+					
+						r[ ( x << 2 )     ] =
+						r[ ( x << 2 ) + 1 ] =
+						r[ ( x << 2 ) + 2 ] =
+						r[ ( x << 2 ) + 3 ] = 0.0f;
+					
+						while( j != n_contrib_x )
+						{
+							float *s = &row[ ix[ j ] << 2 ];
+							
+							r[ ( x << 2 )     ] += wx[ j ] * s[ 0 ];
+							r[ ( x << 2 ) + 1 ] += wx[ j ] * s[ 1 ];
+							r[ ( x << 2 ) + 2 ] += wx[ j ] * s[ 2 ];
+							r[ ( x << 2 ) + 3 ] += wx[ j ] * s[ 3 ];
+							++j;
+						}
+					#endif
+					
+					++x;
+				}
+				
+				ring_row[ slot ] = sy;
+			}
+			
+			// Accumulate the filtered row vertically.
+			x = 0;
+			
+			#ifdef GFX_SSE2
+			{
+				__m128 ws = _mm_set1_ps( w );
+				
+				while( x != dst_width )
+				{
+					_mm_storeu_ps( &acc[ x << 2 ], _mm_add_ps( _mm_loadu_ps( &acc[ x << 2 ] ), _mm_mul_ps( ws, _mm_loadu_ps( &r[ x << 2 ] ) ) ) );
+					++x;
+				}
+			}
+			#elif defined( GFX_NEON )
+			
+				while( x != dst_width )
+				{
+					vst1q_f32( &acc[ x << 2 ], vmlaq_n_f32( vld1q_f32( &acc[ x << 2 ] ), vld1q_f32( &r[ x << 2 ] ), w ) );
+					++x;
+				}
+			#else
+			
+				while( x != ( dst_width << 2 ) )
+				{
+					acc[ x ] += w * r[ x ];
+					++x;
+				}
+			#endif
+			
+			++i;
+		}
+		
+		// Store the destination row.
+		x = 0;
+		while( x != dst_width )
+		{
+			unsigned char *t = &dst[ ( y * dst_width + x ) * byte ];
+			
+			c = 0;
+			while( c != byte )
+			{
+				float v = CLAMP( acc[ ( x << 2 ) + c ], 0.0f, 1.0f );
+				
+				t[ c ] = gamma && c < n_color ?
+						 to_srgb[ ( unsigned int )( v * 4095.0f + 0.5f ) ] :
+						 ( unsigned char )( v * 255.0f + 0.5f );
+				++c;
+			}
+			
+			++x;
+		}
+		
+		++y;
+	}
+	
+	free( ring_row );
+	free( acc );
+	free( ring );
+	free( row );
+	free( weight_y );
+	free( index_y );
+	free( weight_x );
+	free( index_x );
+}
+
+
+/*!
+	Generate the full mipmap chain of an uncompressed texture on the CPU. Each level is
+	filtered from the previous one using TEXTURE_resample and stored after it in the texel
+	array. Since no OpenGLES call is involved, the chain can be built on a WORKER thread and
+	is then uploaded level by level by TEXTURE_generate_id instead of using glGenerateMipmap.
+	
+	\param[in,out] texture A valid TEXTURE structure pointer that contain an uncompressed 8 bits per channel texel array.
+	\param[in] filter The filter to use, either TEXTURE_RESAMPLE_BOX, TEXTURE_RESAMPLE_KAISER or TEXTURE_RESAMPLE_LANCZOS.
+	\param[in] gamma Determine if the color channels are filtered in linear space.
+	
+	\return Return 1 if the mipmap chain have been generated, else 0.
+*/
+unsigned char TEXTURE_generate_mipmap( TEXTURE *texture, unsigned char filter, unsigned char gamma )
+{
+	unsigned int i		= 1,
+				 width	= texture->width,
+				 height = texture->height,
+				 size	= width * height * texture->byte,
+				 offset = 0,
+				 n_level = 1;
+	
+	if( texture->compression ||
+		!texture->texel_array ||
+		texture->texel_type != GL_UNSIGNED_BYTE ||
+		texture->n_mipmap > 1 ) return 0;
+	
+	while( width > 1 || height > 1 )
+	{
+		width  = width  > 1 ? width  >> 1 : 1;
+		height = height > 1 ? height >> 1 : 1;
+		
+		size += width * height * texture->byte;
+		
+		++n_level;
+	}
+	
+	texture->texel_array = ( unsigned char * ) realloc( texture->texel_array, size );
+	
+	width  = texture->width;
+	height = texture->height;
+	
+	while( i != n_level )
+	{
+		unsigned int level_width  = width  > 1 ? width  >> 1 : 1,
+					 level_height = height > 1 ? height >> 1 : 1;
+		
+		TEXTURE_resample( &texture->texel_array[ offset ],
+						  width,
+						  height,
+						  &texture->texel_array[ offset + width * height * texture->byte ],
+						  level_width,
+						  level_height,
+						  texture->byte,
+						  filter,
+						  gamma );
+		
+		offset += width * height * texture->byte;
+		
+		width  = level_width;
+		height = level_height;
+		
+		++i;
+	}
+	
+	texture->n_mipmap = n_level;
+	texture->size	  = size;
+	
+	return 1;
+}
+
+
+/*!
+	Drop the top levels of a texture that have not been uploaded yet. When the texture
+	contain a mipmap chain the first levels are simply discarded, else the texture is
+	rescaled. Used by the residency manager to keep a texture at a lower resolution.
+	
+	\param[in,out] texture A valid TEXTURE structure pointer with a texel array.
+	\param[in] lod The number of levels to drop.
+*/
+void TEXTURE_drop_levels( TEXTURE *texture, unsigned int lod )
+{
+	if( !lod || !texture->texel_array ) return;
+	
+	if( texture->texture_alpha ) TEXTURE_drop_levels( texture->texture_alpha, lod );
+	
+	if( texture->n_mipmap > 1 )
+	{
+		unsigned int offset = 0;
+		
+		if( lod > texture->n_mipmap - 1 ) lod = texture->n_mipmap - 1;
+		
+		texture->n_mipmap -= lod;
+		
+		while( lod )
+		{
+			offset += texture->compression ?
+					  TEXTURE_get_compressed_size( texture->compression, texture->width, texture->height ) :
+					  texture->width * texture->height * texture->byte;
+			
+			texture->width  = texture->width  > 1 ? texture->width  >> 1 : 1;
+			texture->height = texture->height > 1 ? texture->height >> 1 : 1;
+			
+			--lod;
+		}
+		
+		texture->size -= offset;
+		
+		memmove( texture->texel_array, &texture->texel_array[ offset ], texture->size );
+	}
+	else if( !texture->compression )
+	{
+		unsigned int width	= texture->width  >> lod,
+					 height = texture->height >> lod;
+		
+		TEXTURE_scale( texture, width ? width : 1, height ? height : 1 );
+	}
+}
+
+
+/*!
+	Set the WORKER pool and the disk cache directory used by the load-time ETC1 encoder.
+	
+	\param[in] worker The WORKER pool to use to encode the blocks (can be NULL).
+	\param[in] cache_path The directory including the trailing slash where to cache the encoded
+	textures, NULL to disable the cache.
+*/
+void TEXTURE_set_encoder( WORKER *worker, char *cache_path )
+{
+	textureencoder.worker = worker;
+	
+	if( cache_path ) strcpy( textureencoder.cache_path, cache_path );
+	
+	else textureencoder.cache_path[ 0 ] = 0;
+}
+
+
+/*!
+	Encode one 4x4 block in ETC1. Both subblock orientations are tried, using the differential
+	mode when the two average colors are close enough, and for each subblock the modifier table
+	with the lowest error is kept. This function is used internally by TEXTURE_encode_etc1.
+	
+	\param[in] texel The 16 RGB texels of the block, stored column by column.
+	\param[out] block The 8 bytes of the encoded block.
+*/
+void TEXTURE_encode_etc1_block( unsigned char texel[ 16 ][ 3 ], unsigned char *block )
+{
+	static const int modifier[ 8 ][ 2 ] = { {  2,   8 }, {  5,  17 }, {  9,  29 }, { 13,  42 },
+											{ 18,  60 }, { 24,  80 }, { 33, 106 }, { 47, 183 } };
+
+	unsigned int flip		= 0,
+				 best_error = 0xFFFFFFFF,
+				 best_high  = 0,
+				 best_low	= 0;
+	
+	while( flip != 2 )
+	{
+		int avg[ 2 ][ 3 ] = { { 0, 0, 0 }, { 0, 0, 0 } },
+			q[ 2 ][ 3 ],
+			base[ 2 ][ 3 ];
+		
+		unsigned int i = 0,
+					 j,
+					 s,
+					 diff  = 1,
+					 error = 0,
+					 high  = 0,
+					 low   = 0;
+		
+		while( i != 16 )
+		{
+			s = flip ? ( i & 3 ) >= 2 : ( i >> 2 ) >= 2;
+			
+			avg[ s ][ 0 ] += texel[ i ][ 0 ];
+			avg[ s ][ 1 ] += texel[ i ][ 1 ];
+			avg[ s ][ 2 ] += texel[ i ][ 2 ];
+			
+			++i;
+		}
+		
+		i = 0;
+		while( i != 3 )
+		{
+			avg[ 0 ][ i ] = ( avg[ 0 ][ i ] + 4 ) >> 3;
+			avg[ 1 ][ i ] = ( avg[ 1 ][ i ] + 4 ) >> 3;
+			
+			q[ 0 ][ i ] = ( avg[ 0 ][ i ] * 31 + 127 ) / 255;
+			q[ 1 ][ i ] = ( avg[ 1 ][ i ] * 31 + 127 ) / 255;
+			
+			if( q[ 1 ][ i ] - q[ 0 ][ i ] < -4 || q[ 1 ][ i ] - q[ 0 ][ i ] > 3 ) diff = 0;
+			
+			++i;
+		}
+		
+		i = 0;
+		while( i != 3 )
+		{
+			if( diff )
+			{
+				base[ 0 ][ i ] = ( q[ 0 ][ i ] << 3 ) | ( q[ 0 ][ i ] >> 2 );
+				base[ 1 ][ i ] = ( q[ 1 ][ i ] << 3 ) | ( q[ 1 ][ i ] >> 2 );
+				
+				high |= q[ 0 ][ i ] << ( 27 - i * 8 );
+				high |= ( ( q[ 1 ][ i ] - q[ 0 ][ i ] ) & 0x7 ) << ( 24 - i * 8 );
+			}
+			else
+			{
+				q[ 0 ][ i ] = ( avg[ 0 ][ i ] * 15 + 127 ) / 255;
+				q[ 1 ][ i ] = ( avg[ 1 ][ i ] * 15 + 127 ) / 255;
+				
+				base[ 0 ][ i ] = q[ 0 ][ i ] | ( q[ 0 ][ i ] << 4 );
+				base[ 1 ][ i ] = q[ 1 ][ i ] | ( q[ 1 ][ i ] << 4 );
+				
+				high |= q[ 0 ][ i ] << ( 28 - i * 8 );
+				high |= q[ 1 ][ i ] << ( 24 - i * 8 );
+			}
+			
+			++i;
+		}
+		
+		high |= ( diff << 1 ) | flip;
+		
+		
+		s = 0;
+		while( s != 2 )
+		{
+			unsigned int table		 = 0,
+						 best_table	 = 0,
+						 table_error = 0xFFFFFFFF,
+						 table_low	 = 0;
+			
+			while( table != 8 )
+			{
+				unsigned int sub_error = 0,
+							 sub_low   = 0;
+				
+				i = 0;
+				while( i != 16 )
+				{
+					unsigned int best_idx	= 0,
+								 best_texel = 0xFFFFFFFF,
+								 idx		= 0;
+					
+					if( ( flip ? ( i & 3 ) >= 2 : ( i >> 2 ) >= 2 ) != s ){ ++i; continue; }
+					
+					while( idx != 4 )
+					{
+						int m = modifier[ table ][ idx & 1 ];
+						
+						unsigned int e = 0;
+						
+						if( idx & 2 ) m = -m;
+						
+						j = 0;
+						while( j != 3 )
+						{
+							int d = CLAMP( base[ s ][ j ] + m, 0, 255 ) - texel[ i ][ j ];
+							
+							e += d * d;
+							++j;
+						}
+						
+						if( e < best_texel )
+						{
+							best_texel = e;
+							best_idx   = idx;
+						}
+						
+						++idx;
+					}
+					
+					sub_error += best_texel;
+					sub_low	  |= ( ( ( best_idx >> 1 ) << 16 ) | ( best_idx & 1 ) ) << i;
+					
+					++i;
+				}
+				
+				if( sub_error < table_error )
+				{
+					table_error = sub_error;
+					table_low	= sub_low;
+					best_table	= table;
+				}
+				
+				++table;
+			}
+			
+			high  |= best_table << ( s ? 2 : 5 );
+			low	  |= table_low;
+			error += table_error;
+			
+			++s;
+		}
+		
+		if( error < best_error )
+		{
+			best_error = error;
+			best_high  = high;
+			best_low   = low;
+		}
+		
+		++flip;
+	}
+	
+	block[ 0 ] = best_high >> 24; block[ 1 ] = best_high >> 16; block[ 2 ] = best_high >> 8; block[ 3 ] = best_high;
+	block[ 4 ] = best_low  >> 24; block[ 5 ] = best_low  >> 16; block[ 6 ] = best_low  >> 8; block[ 7 ] = best_low;
+}
+
+
+/*!
+	Encode a range of block rows. This function is used internally by TEXTURE_encode_etc1 as
+	WORKER callback.
+	
+	\param[in] ptr A valid TEXTUREETC1TASK structure pointer.
+*/
+void TEXTURE_encode_etc1_task( void *ptr )
+{
+	TEXTUREETC1TASK *textureetc1task = ( TEXTUREETC1TASK * )ptr;
+	
+	unsigned int n_block_x = ( textureetc1task->width + 3 ) >> 2,
+				 row	   = textureetc1task->first_row;
+	
+	while( row != textureetc1task->last_row )
+	{
+		unsigned int bx = 0;
+		
+		while( bx != n_block_x )
+		{
+			unsigned char texel[ 16 ][ 3 ];
+			
+			unsigned int k = 0;
+			
+			while( k != 16 )
+			{
+				// Repeat the border texels for the blocks crossing the edges of the image.
+				unsigned int x = ( bx << 2 ) + ( k >> 2 ),
+							 y = ( row << 2 ) + ( k & 3 );
+				
+				unsigned char *t;
+				
+				if( x >= textureetc1task->width  ) x = textureetc1task->width  - 1;
+				if( y >= textureetc1task->height ) y = textureetc1task->height - 1;
+				
+				t = &textureetc1task->texel_array[ ( y * textureetc1task->width + x ) * textureetc1task->byte ];
+				
+				if( textureetc1task->alpha ) texel[ k ][ 0 ] = texel[ k ][ 1 ] = texel[ k ][ 2 ] = t[ 3 ];
+				else
+				{
+					texel[ k ][ 0 ] = t[ 0 ];
+					texel[ k ][ 1 ] = t[ 1 ];
+					texel[ k ][ 2 ] = t[ 2 ];
+				}
+				
+				++k;
+			}
+			
+			TEXTURE_encode_etc1_block( texel, &textureetc1task->block_array[ ( row * n_block_x + bx ) << 3 ] );
+			
+			++bx;
+		}
+		
+		++row;
+	}
+}
+
+
+/*!
+	Encode an RGB or RGBA image in ETC1. The block rows are split between the threads of the
+	encoder WORKER pool (if any). \sa TEXTURE_set_encoder
+	
+	\param[in] texel_array The source texels.
+	\param[in] width The width of the image.
+	\param[in] height The height of the image.
+	\param[in] byte The number of bytes per texel (3 or 4).
+	\param[in] alpha Determine if the alpha channel (1) or the color channels (0) are encoded.
+	\param[out] block_array The destination array, at least TEXTURE_get_compressed_size bytes long.
+*/
+void TEXTURE_encode_etc1( unsigned char *texel_array, unsigned int width, unsigned int height, unsigned char byte, unsigned char alpha, unsigned char *block_array )
+{
+	unsigned int i		 = 0,
+				 n_row	 = ( height + 3 ) >> 2,
+				 n_task	 = textureencoder.worker ? textureencoder.worker->n_thread << 2 : 1,
+				 counter = 0;
+	
+	TEXTUREETC1TASK *textureetc1task;
+	
+	if( n_task > n_row ) n_task = n_row;
+	
+	textureetc1task = ( TEXTUREETC1TASK * ) malloc( n_task * sizeof( TEXTUREETC1TASK ) );
+	
+	while( i != n_task )
+	{
+		textureetc1task[ i ].texel_array = texel_array;
+		textureetc1task[ i ].width		 = width;
+		textureetc1task[ i ].height		 = height;
+		textureetc1task[ i ].byte		 = byte;
+		textureetc1task[ i ].alpha		 = alpha;
+		textureetc1task[ i ].block_array = block_array;
+		textureetc1task[ i ].first_row	 = ( n_row *   i       ) / n_task;
+		textureetc1task[ i ].last_row	 = ( n_row * ( i + 1 ) ) / n_task;
+		
+		if( n_task > 1 ) WORKER_push( textureencoder.worker, TEXTURE_encode_etc1_task, &textureetc1task[ i ], &counter );
+		
+		else TEXTURE_encode_etc1_task( &textureetc1task[ i ] );
+		
+		++i;
+	}
+	
+	if( n_task > 1 ) WORKER_wait( textureencoder.worker, &counter );
+	
+	free( textureetc1task );
+}
+
+
+/*!
+	Compress an uncompressed 24 or 32 bits texture to ETC1. Since ETC1 cannot store alpha, the
+	alpha channel of 32 bits textures is encoded as a second grey ETC1 texture stored in
+	texture_alpha. When mipmaps are requested and the texture does not already contain a mipmap
+	chain, the levels are box filtered on the CPU since glGenerateMipmap cannot be used on
+	compressed textures.
+	
+	\param[in,out] texture A valid TEXTURE structure pointer that contain an uncompressed texel array.
+	\param[in] mipmap Determine if the full mipmap chain have to be encoded.
+	
+	\return Return 1 if the texture have been compressed, else 0.
+*/
+unsigned char TEXTURE_compress_etc1( TEXTURE *texture, unsigned char mipmap )
+{
+	unsigned int i		= 0,
+				 width	= texture->width,
+				 height = texture->height,
+				 size	= 0,
+				 offset = 0,
+				 src	= 0,
+				 n_level;
+	
+	unsigned char *block_array,
+				  *alpha_array = NULL;
+	
+	if( texture->compression ||
+		!texture->texel_array ||
+		texture->texel_type != GL_UNSIGNED_BYTE ||
+		( texture->byte != 3 && texture->byte != 4 ) ) return 0;
+	
+	if( mipmap ) TEXTURE_generate_mipmap( texture, TEXTURE_RESAMPLE_BOX, 0 );
+	
+	n_level = texture->n_mipmap > 1 ? texture->n_mipmap : 1;
+	
+	while( i != n_level )
+	{
+		size += TEXTURE_get_compressed_size( GL_ETC1_RGB8_OES, width, height );
+		
+		width  = width  > 1 ? width  >> 1 : 1;
+		height = height > 1 ? height >> 1 : 1;
+		
+		++i;
+	}
+	
+	block_array = ( unsigned char * ) malloc( size );
+	
+	if( texture->byte == 4 ) alpha_array = ( unsigned char * ) malloc( size );
+	
+	width  = texture->width;
+	height = texture->height;
+	
+	i = 0;
+	while( i != n_level )
+	{
+		TEXTURE_encode_etc1( &texture->texel_array[ src ], width, height, texture->byte, 0, &block_array[ offset ] );
+		
+		if( alpha_array ) TEXTURE_encode_etc1( &texture->texel_array[ src ], width, height, texture->byte, 1, &alpha_array[ offset ] );
+		
+		offset += TEXTURE_get_compressed_size( GL_ETC1_RGB8_OES, width, height );
+		src	   += width * height * texture->byte;
+		
+		width  = width  > 1 ? width  >> 1 : 1;
+		height = height > 1 ? height >> 1 : 1;
+		
+		++i;
+	}
+	
+	free( texture->texel_array );
+	
+	texture->texel_array = block_array;
+	texture->size		 = size;
+	texture->n_mipmap	 = n_level;
+	texture->compression = GL_ETC1_RGB8_OES;
+	texture->byte		 = 4;
+	
+	if( alpha_array )
+	{
+		// Reuse the alpha texture of a reloaded texture, it keep its texture id until the new one is uploaded.
+		if( !texture->texture_alpha ) texture->texture_alpha = TEXTURE_init( texture->name );
+		
+		else if( texture->texture_alpha->texel_array ) free( texture->texture_alpha->texel_array );
+		
+		texture->texture_alpha->width		= texture->width;
+		texture->texture_alpha->height		= texture->height;
+		texture->texture_alpha->byte		= 4;
+		texture->texture_alpha->size		= size;
+		texture->texture_alpha->texel_array	= alpha_array;
+		texture->texture_alpha->n_mipmap	= n_level;
+		texture->texture_alpha->compression	= GL_ETC1_RGB8_OES;
+	}
+	
+	return 1;
+}
+
+
+/*!
+	Save the compressed texel array of a TEXTURE as a KTX file. When the texture have a hash
+	(ETC1 disk cache entry), the hashes and size of its source are stored as the
+	TEXTURE_CACHE_KEY key/value, so TEXTURE_load_cache can check that an entry really match.
+	
+	\param[in] texture A valid TEXTURE structure pointer that contain a compressed texel array.
+	\param[in] filename The absolute path of the file to write.
+	
+	\return Return 1 if the file have been written, else 0.
+*/
+unsigned char TEXTURE_save_ktx( TEXTURE *texture, char *filename )
+{
+	const unsigned char ktx_identifier[ 12 ] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+	
+	unsigned int i		= 0,
+				 width	= texture->width,
+				 height = texture->height,
+				 offset = 0;
+	
+	KTXHEADER ktxheader;
+	
+	FILE *f;
+	
+	if( !texture->compression || !texture->texel_array ) return 0;
+	
+	f = fopen( filename, "wb" );
+	
+	if( !f ) return 0;
+	
+	memset( &ktxheader, 0, sizeof( KTXHEADER ) );
+	
+	memcpy( ktxheader.identifier, ktx_identifier, 12 );
+	
+	ktxheader.endianness			  = 0x04030201;
+	ktxheader.gl_type_size			  = 1;
+	ktxheader.gl_internal_format	  = texture->compression;
+	ktxheader.gl_base_internal_format = GL_RGB;
+	ktxheader.pixel_width			  = texture->width;
+	ktxheader.pixel_height			  = texture->height;
+	ktxheader.n_face				  = 1;
+	ktxheader.n_mipmap				  = texture->n_mipmap;
+	
+	// Size, key, NULL byte and the three values, padded to 4 bytes.
+	if( texture->hash ) ktxheader.n_key_value_byte = sizeof( unsigned int ) + ( ( sizeof( TEXTURE_CACHE_KEY ) + 12 + 3 ) & ~3 );
+	
+	fwrite( &ktxheader, sizeof( KTXHEADER ), 1, f );
+	
+	if( texture->hash )
+	{
+		unsigned int value[ 4 ] = { sizeof( TEXTURE_CACHE_KEY ) + 12, texture->hash, texture->hash_check, texture->hash_size };
+		
+		unsigned char pad[ 4 ] = { 0, 0, 0, 0 };
+		
+		fwrite( &value[ 0 ], sizeof( unsigned int ), 1, f );
+		
+		fwrite( TEXTURE_CACHE_KEY, sizeof( TEXTURE_CACHE_KEY ), 1, f );
+		
+		fwrite( &value[ 1 ], sizeof( unsigned int ), 3, f );
+		
+		fwrite( pad, ( 4 - ( value[ 0 ] & 3 ) ) & 3, 1, f );
+	}
+	
+	while( i != texture->n_mipmap )
+	{
+		unsigned int size = TEXTURE_get_compressed_size( texture->compression, width, height );
+		
+		fwrite( &size, sizeof( unsigned int ), 1, f );
+		
+		fwrite( &texture->texel_array[ offset ], size, 1, f );
+		
+		offset += size;
+		
+		width  = width  > 1 ? width  >> 1 : 1;
+		height = height > 1 ? height >> 1 : 1;
+		
+		++i;
+	}
+	
+	fclose( f );
+	
+	return 1;
+}
+
+
+/*!
+	Build the filename of an ETC1 disk cache entry. This function is used internally by
+	TEXTURE_load_cache and TEXTURE_save_cache.
+	
+	\param[in] texture A valid TEXTURE structure pointer with a valid hash.
+	\param[in] flags The TEXTURE flags used to generate the texture, only the TEXTURE_CACHE_FLAGS are part of the filename.
+	\param[in] alpha Determine if the filename of the alpha texture (1) or the color texture (0) is returned.
+	\param[out] filename The absolute path of the cache entry, a buffer of MAX_PATH bytes.
+*/
+void TEXTURE_get_cache_filename( TEXTURE *texture, unsigned int flags, unsigned char alpha, char *filename )
+{
+	snprintf( filename,
+			  MAX_PATH,
+			  "%s%08X_%X_%X%s.ktx",
+			  textureencoder.cache_path,
+			  texture->hash,
+			  texture->hash_size,
+			  flags & TEXTURE_CACHE_FLAGS,
+			  alpha ? "a" : "" );
+}
+
+
+/*!
+	Read a KTX file from the ETC1 disk cache, the entry is only loaded if its TEXTURE_CACHE_KEY
+	value match the hashes and size of the texture. This function is used internally by
+	TEXTURE_load_cache.
+	
+	\param[in,out] texture A valid TEXTURE structure pointer with the hashes and size of its source.
+	\param[in] filename The absolute path of the cache entry.
+	
+	\return Return 1 if the file have been loaded, else 0.
+*/
+unsigned char TEXTURE_read_cache( TEXTURE *texture, char *filename )
+{
+	// The cache is outside the APK on Android, so the file is read without mopen.
+	MEMORY memory;
+	
+	FILE *f = fopen( filename, "rb" );
+	
+	if( !f ) return 0;
+	
+	memset( &memory, 0, sizeof( MEMORY ) );
+	
+	strcpy( memory.filename, filename );
+	
+	fseek( f, 0, SEEK_END );
+	memory.size = ftell( f );
+	fseek( f, 0, SEEK_SET );
+	
+	memory.buffer = ( unsigned char * ) malloc( memory.size );
+	
+	if( fread( memory.buffer, memory.size, 1, f ) == 1 &&
+		memory.size >= sizeof( KTXHEADER ) + sizeof( unsigned int ) + sizeof( TEXTURE_CACHE_KEY ) + 12 )
+	{
+		unsigned int value[ 4 ];
+		
+		unsigned char *key = &memory.buffer[ sizeof( KTXHEADER ) ];
+		
+		memcpy( &value[ 0 ], key, sizeof( unsigned int ) );
+		
+		memcpy( &value[ 1 ], &key[ sizeof( unsigned int ) + sizeof( TEXTURE_CACHE_KEY ) ], sizeof( unsigned int ) * 3 );
+		
+		// A crc32 collision or an entry written for another source is a cache miss.
+		if( value[ 0 ] == sizeof( TEXTURE_CACHE_KEY ) + 12 &&
+			!memcmp( &key[ sizeof( unsigned int ) ], TEXTURE_CACHE_KEY, sizeof( TEXTURE_CACHE_KEY ) ) &&
+			value[ 1 ] == texture->hash &&
+			value[ 2 ] == texture->hash_check &&
+			value[ 3 ] == texture->hash_size ) TEXTURE_load_ktx( texture, &memory );
+	}
+	
+	fclose( f );
+	
+	free( memory.buffer );
+	
+	return texture->texel_array != NULL;
+}
+
+
+/*!
+	Hash a source texture file and try to load its ETC1 version from the disk cache instead of
+	decoding it. \sa TEXTURE_set_encoder
+	
+	\param[in,out] texture A valid TEXTURE structure pointer.
+	\param[in] memory The source texture stream.
+	\param[in] flags The TEXTURE flags that will be used to generate the texture.
+	
+	\return Return 1 if the texture have been loaded from the cache, else 0.
+*/
+unsigned char TEXTURE_load_cache( TEXTURE *texture, MEMORY *memory, unsigned int flags )
+{
+	char filename[ MAX_PATH ] = {""};
+	
+	if( !textureencoder.cache_path[ 0 ] ) return 0;
+	
+	texture->hash		= crc32( 0, memory->buffer, memory->size );
+	texture->hash_check = adler32( 1, memory->buffer, memory->size );
+	texture->hash_size	= memory->size;
+	
+	TEXTURE_get_cache_filename( texture, flags, 0, filename );
+	
+	if( !TEXTURE_read_cache( texture, filename ) ) return 0;
+	
+	get_file_name( memory->filename, texture->name );
+	
+	TEXTURE_get_cache_filename( texture, flags, 1, filename );
+	
+	// Reuse the alpha texture of a reloaded texture, it keep its texture id until the new one is uploaded.
+	if( !texture->texture_alpha ) texture->texture_alpha = TEXTURE_init( texture->name );
+	
+	// The alpha entry is checked against the same source.
+	texture->texture_alpha->hash	   = texture->hash;
+	texture->texture_alpha->hash_check = texture->hash_check;
+	texture->texture_alpha->hash_size  = texture->hash_size;
+	
+	if( !TEXTURE_read_cache( texture->texture_alpha, filename ) && !texture->texture_alpha->tid ) texture->texture_alpha = TEXTURE_free( texture->texture_alpha );
+	
+	return 1;
+}
+
+
+/*!
+	Write an ETC1 compressed texture (and its alpha texture if any) to the disk cache, unless
+	the cache entry already exist.
+	
+	\param[in] texture A valid TEXTURE structure pointer with a valid hash and a compressed texel array.
+	\param[in] flags The TEXTURE flags used to generate the texture.
+*/
+void TEXTURE_save_cache( TEXTURE *texture, unsigned int flags )
+{
+	char filename[ MAX_PATH ] = {""};
+	
+	FILE *f;
+	
+	if( !textureencoder.cache_path[ 0 ] || !texture->hash ) return;
+	
+	TEXTURE_get_cache_filename( texture, flags, 0, filename );
+	
+	// The entry is keyed by the content of the source, an existing one is already up to date.
+	f = fopen( filename, "rb" );
+	
+	if( f )
+	{
+		fclose( f );
+		return;
+	}
+	
+	TEXTURE_save_ktx( texture, filename );
+	
+	if( texture->texture_alpha )
+	{
+		TEXTURE_get_cache_filename( texture, flags, 1, filename );
+		
+		texture->texture_alpha->hash	   = texture->hash;
+		texture->texture_alpha->hash_check = texture->hash_check;
+		texture->texture_alpha->hash_size  = texture->hash_size;
+		
+		TEXTURE_save_ktx( texture->texture_alpha, filename );
+	}
+}
+
+
+/*!
+	Helper function to automatically generate an OpenGLES texture.
+	
+	\param[in,out] texture A valid TEXTURE structure pointer.
+	\param[in] flags The bit flags to use to generate the GLES texture.
+	\param[in] filter The type of mipmap filtering to use.
+	\param[in] anisotropic_filter The amount of anisotropic filtering to apply on the texture.
+*/
+void TEXTURE_generate_id( TEXTURE *texture, unsigned int flags, unsigned char filter, float anisotropic_filter )
+{
+	if( texture->tid ) TEXTURE_delete_id( texture );
+
+	glGenTextures( 1, &texture->tid );
+
+	glBindTexture( texture->target, texture->tid );
+	
+	
+	if( ( flags & TEXTURE_MIPMAP ) && ( flags & TEXTURE_MIPMAP_CPU ) )
+	{
+		TEXTURE_generate_mipmap( texture,
+								 TEXTURE_RESAMPLE_KAISER,
+								 ( flags & TEXTURE_MIPMAP_GAMMA ) != 0 );
+	}
+	
+	
+	// Fallback to a CPU decompression if the driver cannot handle the compression type.
+	if( texture->compression && !TEXTURE_is_compression_supported( texture->compression ) )
+	{
+		if( !TEXTURE_decompress( texture ) ) console_print( "%s: Compression type 0x%X not supported.\n", texture->name, texture->compression );
+	}
+	else if( ( flags & TEXTURE_COMPRESS_ETC1 ) &&
+			 TEXTURE_is_compression_supported( GL_ETC1_RGB8_OES ) &&
+			 TEXTURE_compress_etc1( texture, flags & TEXTURE_MIPMAP ) )
+	{
+		// Never cache a texture reduced by the residency manager.
+		if( !texture->lod ) TEXTURE_save_cache( texture, flags );
+	}
+	
+	
+	if( !texture->compression )
+	{
+		switch( texture->byte )
+		{
+			case 1: glPixelStorei( GL_PACK_ALIGNMENT, 1 ); break;
+			case 2: glPixelStorei( GL_PACK_ALIGNMENT, 2 ); break;
+			case 3:
+			case 4: glPixelStorei( GL_PACK_ALIGNMENT, 4 ); break;
+		}
+
+		if( flags & TEXTURE_16_BITS ) TEXTURE_convert_16_bits( texture, flags & TEXTURE_16_BITS_5551, TEXTURE_get_dither( flags ) );
+	}
+	
+
+	if( flags & TEXTURE_CLAMP )
+	{
+		glTexParameteri( texture->target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+		glTexParameteri( texture->target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	}
+	else
+	{
+		glTexParameteri( texture->target, GL_TEXTURE_WRAP_S, GL_REPEAT );
+		glTexParameteri( texture->target, GL_TEXTURE_WRAP_T, GL_REPEAT );			
+	}
+	
+
+	if( anisotropic_filter )
+	{
+		static float texture_max_anisotropy = 0.0f;
+		
+		if( !texture_max_anisotropy ) glGetFloatv( GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT,
+												   &texture_max_anisotropy );
+
+		anisotropic_filter = CLAMP( anisotropic_filter,
+									0.0f,
+									texture_max_anisotropy );
+
+		glTexParameterf( texture->target,
+						 GL_TEXTURE_MAX_ANISOTROPY_EXT,
+						 anisotropic_filter );
+	}
+	
+	
+	if( flags & TEXTURE_MIPMAP )
+	{
+		switch( filter )
+		{
+			case TEXTURE_FILTER_1X:
+			{
+				glTexParameteri( texture->target, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR );
+				glTexParameteri( texture->target, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+								
+				break;
+			}
+							
+			case TEXTURE_FILTER_2X:
+			{
+				glTexParameteri( texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST );
+				glTexParameteri( texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR );				
 				
 				break;
 			}
@@ -547,25 +2848,14 @@ void TEXTURE_generate_id( TEXTURE *texture, unsigned int flags, unsigned char fi
 					 width  = texture->width,
 					 height = texture->height,
 					 size	= 0,
-					 offset = 0,
-					 bsize  = texture->byte == 4 ? 16 : 32,
-					 bwidth,
-					 bheight;
+					 offset = 0;
 
 		while( i != texture->n_mipmap )
 		{
 			if( width  < 1 ){ width  = 1; }
 			if( height < 1 ){ height = 1; }
 				
-			bwidth = texture->byte == 4 ?
-					 width >> 2:
-					 width >> 3;
-
-			bheight = height >> 2;	
-			
-			size = bwidth * bheight * ( ( bsize * texture->byte ) >> 3 );				
-
-			if( size < 32 ){ size = 32; }
+			size = TEXTURE_get_compressed_size( texture->compression, width, height );
 			
 			glCompressedTexImage2D( texture->target,
 									i,											
@@ -585,19 +2875,53 @@ void TEXTURE_generate_id( TEXTURE *texture, unsigned int flags, unsigned char fi
 	}
 	else
 	{
-		glTexImage2D( texture->target,
-					  0,
-					  texture->internal_format,
-					  texture->width,
-					  texture->height,
-					  0,
-					  texture->format,
-					  texture->texel_type,
-					  texture->texel_array );
+		unsigned int i		= 0,
+					 width  = texture->width,
+					 height = texture->height,
+					 offset = 0;
+
+		do
+		{
+			if( width  < 1 ){ width  = 1; }
+			if( height < 1 ){ height = 1; }
+
+			glTexImage2D( texture->target,
+						  i,
+						  texture->internal_format,
+						  width,
+						  height,
+						  0,
+						  texture->format,
+						  texture->texel_type,
+						  &texture->texel_array[ offset ] );
+
+			offset += width * height * ( texture->texel_type == GL_UNSIGNED_BYTE ? texture->byte : 2 );
+
+			width  >>= 1;
+			height >>= 1;
+
+			++i;
+		}
+		while( i < texture->n_mipmap );
 	}
 
 
-	if( flags & TEXTURE_MIPMAP && !texture->n_mipmap ) glGenerateMipmap( texture->target );
+	if( flags & TEXTURE_MIPMAP && !texture->compression && texture->n_mipmap < 2 ) glGenerateMipmap( texture->target );
+	
+	
+	// Upload the alpha texture when it have been (re)loaded.
+	if( texture->texture_alpha && texture->texture_alpha->texel_array )
+	{
+		TEXTURE_generate_id( texture->texture_alpha,
+							 flags & ~TEXTURE_COMPRESS_ETC1,
+							 filter,
+							 anisotropic_filter );
+		
+		glBindTexture( texture->target, texture->tid );
+	}
+	
+	texture->memory  = TEXTURE_get_memory( texture );
+	texture->pending = 0;
 }
 
 
@@ -628,6 +2952,8 @@ void TEXTURE_free_texel_array( TEXTURE *texture )
 		free( texture->texel_array );
 		texture->texel_array = NULL;
 	}
+	
+	if( texture->texture_alpha ) TEXTURE_free_texel_array( texture->texture_alpha );
 }
 
 
@@ -638,6 +2964,12 @@ void TEXTURE_free_texel_array( TEXTURE *texture )
 */
 void TEXTURE_draw( TEXTURE *texture )
 {
+	texture->last_use = textureresidency.frame;
+	
+	// Bring back the full resolution of a texture reduced or evicted by the residency manager.
+	if( texture->lod && !texture->pending && textureresidency.texturestream )
+	{ TEXTURESTREAM_reload( textureresidency.texturestream, texture, 0 ); }
+	
 	glBindTexture( texture->target, 
 				   texture->tid );
 }
@@ -645,7 +2977,8 @@ void TEXTURE_draw( TEXTURE *texture )
 
 /*!
 	Rescale a texture, please take note that this function have to be called
-	before you call TEXTURE_generate_id.
+	before you call TEXTURE_generate_id. 8 bits per channel textures are filtered
+	using a Lanczos filter, 16 bits textures use the nearest texel.
 	
 	\param[in] texture A valid TEXTURE structure pointer.
 	\param[in] width The new width of the texture.
@@ -653,6 +2986,31 @@ void TEXTURE_draw( TEXTURE *texture )
 */
 void TEXTURE_scale( TEXTURE *texture, unsigned int width, unsigned int height )
 {
+	if( texture->texel_type == GL_UNSIGNED_BYTE && !texture->compression )
+	{
+		unsigned char *texel_array = ( unsigned char * ) malloc( width * height * texture->byte );
+		
+		TEXTURE_resample( texture->texel_array,
+						  texture->width,
+						  texture->height,
+						  texel_array,
+						  width,
+						  height,
+						  texture->byte,
+						  TEXTURE_RESAMPLE_LANCZOS,
+						  0 );
+		
+		texture->width	  = width;
+		texture->height	  = height;
+		texture->size	  = width * height * texture->byte;
+		texture->n_mipmap = 0;
+		
+		free( texture->texel_array );
+		texture->texel_array = texel_array;
+		
+		return;
+	}
+	
 	unsigned int i = 0,
 				 j,
 				 offset,
@@ -31,6 +31,20 @@ as being the original software.
 */
 
 
+#ifndef GL_ETC1_RGB8_OES
+	#define GL_ETC1_RGB8_OES							0x8D64
+#endif
+
+#ifndef GL_COMPRESSED_RGB8_ETC2
+	#define GL_COMPRESSED_RGB8_ETC2						0x9274
+	#define GL_COMPRESSED_SRGB8_ETC2					0x9275
+	#define GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2	0x9276
+	#define GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2	0x9277
+	#define GL_COMPRESSED_RGBA8_ETC2_EAC				0x9278
+	#define GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC			0x9279
+#endif
+
+
 enum
 {
 	//! Enable image clamping on the UV, 0 to 1 only no texture repeat.
@@ -43,7 +57,55 @@ enum
 	TEXTURE_16_BITS = ( 1 << 2 ),
 
 	//! Force the conversion of 32 bits textures to use use 5551 instead of 4444.
-	TEXTURE_16_BITS_5551 = ( 1 << 3 )
+	TEXTURE_16_BITS_5551 = ( 1 << 3 ),
+	
+	//! Compress uncompressed textures to ETC1 before uploading them, the alpha channel (if any) is stored in a second texture.
+	TEXTURE_COMPRESS_ETC1 = ( 1 << 4 ),
+	
+	//! Use an ordered dither when converting to 16 bits.
+	TEXTURE_16_BITS_DITHER = ( 1 << 5 ),
+	
+	//! Use a Floyd-Steinberg error diffusion dither when converting to 16 bits (slower, scalar only).
+	TEXTURE_16_BITS_DITHER_DIFFUSION = ( 1 << 6 ),
+	
+	//! Generate the mipmaps on the CPU with a Kaiser filter instead of using glGenerateMipmap (requires TEXTURE_MIPMAP).
+	TEXTURE_MIPMAP_CPU = ( 1 << 7 ),
+	
+	//! Filter the CPU generated mipmaps in linear space.
+	TEXTURE_MIPMAP_GAMMA = ( 1 << 8 )
+};
+
+
+//! The TEXTURE flags that change the content of an ETC1 disk cache entry, part of its filename. \sa TEXTURE_get_cache_filename
+#define TEXTURE_CACHE_FLAGS		( TEXTURE_MIPMAP | TEXTURE_MIPMAP_CPU | TEXTURE_MIPMAP_GAMMA )
+
+//! The KTX key of the value identifying the source file of an ETC1 disk cache entry. \sa TEXTURE_save_ktx
+#define TEXTURE_CACHE_KEY		"GFXsource"
+
+
+enum
+{
+	//! Plain truncation of the texels.
+	TEXTURE_DITHER_NONE = 0,
+	
+	//! 4x4 Bayer ordered dither.
+	TEXTURE_DITHER_ORDERED = 1,
+	
+	//! Floyd-Steinberg error diffusion.
+	TEXTURE_DITHER_DIFFUSION = 2
+};
+
+
+enum
+{
+	//! Box filter, fast and exact for power of two reductions.
+	TEXTURE_RESAMPLE_BOX = 0,
+	
+	//! Kaiser windowed sinc filter (width 3, alpha 4), sharp with little ringing.
+	TEXTURE_RESAMPLE_KAISER = 1,
+	
+	//! Lanczos 3 filter.
+	TEXTURE_RESAMPLE_LANCZOS = 2
 };
 
 
@@ -108,8 +170,56 @@ typedef struct
 } PVRHEADER;
 
 
-//! The TEXTURE structure used to control a texture behaviors and properties.
+//! KTX 1.1 file header data.
 typedef struct
+{
+	//! The KTX file identifier.
+	unsigned char	identifier[ 12 ];
+	
+	//! Endianness of the file, 0x04030201 if it match the endianness of the platform.
+	unsigned int	endianness;
+	
+	//! The texel type (0 for compressed textures).
+	unsigned int	gl_type;
+	
+	//! The size in bytes of the texel type (1 for compressed textures).
+	unsigned int	gl_type_size;
+	
+	//! The format (0 for compressed textures).
+	unsigned int	gl_format;
+	
+	//! The internal format, for compressed textures the compression type.
+	unsigned int	gl_internal_format;
+	
+	//! The base internal format.
+	unsigned int	gl_base_internal_format;
+	
+	//! The width of the texture.
+	unsigned int	pixel_width;
+	
+	//! The height of the texture.
+	unsigned int	pixel_height;
+	
+	//! The depth of the texture (0 for 2D textures).
+	unsigned int	pixel_depth;
+	
+	//! The number of array elements (0 if the texture is not an array).
+	unsigned int	n_array_element;
+	
+	//! The number of faces (6 for cube maps, else 1).
+	unsigned int	n_face;
+	
+	//! The number of mipmap levels contained in the file.
+	unsigned int	n_mipmap;
+	
+	//! The size of the key value data following the header.
+	unsigned int	n_key_value_byte;
+
+} KTXHEADER;
+
+
+//! The TEXTURE structure used to control a texture behaviors and properties.
+typedef struct TEXTURE
 {
 	//! Internal name to use for the TEXTURE.
 	char			name[ MAX_CHAR ];
@@ -144,28 +254,167 @@ typedef struct
 	//! The raw texel array.
 	unsigned char	*texel_array;
 
-	//! The number of mipmaps (PVRTC only).
+	//! The number of mipmap levels contained in the texel array (PVR and KTX only).
 	unsigned int	n_mipmap;
 	
 	//! The compression type.
 	unsigned int	compression;
+	
+	//! The content hash of the source file (crc32), used as key for the ETC1 disk cache (0 if unused).
+	unsigned int	hash;
+	
+	//! The size in bytes of the source file, part of the ETC1 disk cache key.
+	unsigned int	hash_size;
+	
+	//! A second content hash of the source file (adler32), stored in the ETC1 disk cache entries to reject the crc32 collisions.
+	unsigned int	hash_check;
+	
+	//! The ETC1 compressed alpha channel of the texture (if any). \sa TEXTURE_COMPRESS_ETC1
+	struct TEXTURE	*texture_alpha;
+	
+	//! The resolved path of the file the texture have been created from (registered textures only).
+	char			filename[ MAX_PATH ];
+	
+	//! The TEXTURE flags used to create the texture (registered textures only).
+	unsigned int	flags;
+	
+	//! The mipmap filtering used to create the texture (registered textures only).
+	unsigned char	filter;
+	
+	//! The anisotropic filtering used to create the texture (registered textures only).
+	float			anisotropic_filter;
+	
+	//! The number of owners of a registered texture, 0 if the texture is not registered.
+	unsigned int	n_ref;
+	
+	//! The estimated video memory used by the texture once uploaded. \sa TEXTURE_get_memory
+	unsigned int	memory;
+	
+	//! The residency frame the texture have been drawn for the last time. \sa TEXTURESTREAM_update_residency
+	unsigned int	last_use;
+	
+	//! The number of top mipmap levels dropped by the residency manager, TEXTURE_LOD_PLACEHOLDER if evicted.
+	unsigned char	lod;
+	
+	//! Determine if a (re)load of the texture is queued in a TEXTURESTREAM.
+	unsigned char	pending;
 		
 } TEXTURE;
 
 
+//! Structure definition of a range of 4x4 block rows to encode in ETC1 on a WORKER thread.
+typedef struct
+{
+	//! The source RGB or RGBA texels.
+	unsigned char	*texel_array;
+	
+	//! The width of the source image.
+	unsigned int	width;
+	
+	//! The height of the source image.
+	unsigned int	height;
+	
+	//! The number of bytes per texel of the source image (3 or 4).
+	unsigned char	byte;
+	
+	//! Encode the alpha channel as a grey image instead of the color channels.
+	unsigned char	alpha;
+	
+	//! The destination ETC1 blocks of the whole image.
+	unsigned char	*block_array;
+	
+	//! The first block row to encode.
+	unsigned int	first_row;
+	
+	//! The block row where to stop.
+	unsigned int	last_row;
+
+} TEXTUREETC1TASK;
+
+
+//! Global settings of the load-time ETC1 encoder. \sa TEXTURE_set_encoder
+typedef struct
+{
+	//! The WORKER pool used to encode the blocks in parallel (NULL to encode on the calling thread).
+	WORKER			*worker;
+	
+	//! The directory (including the trailing slash) where encoded textures are cached, empty to disable the cache.
+	char			cache_path[ MAX_PATH ];
+
+} TEXTUREENCODER;
+
+
+//! Global TEXTUREENCODER structure. Declared as extern in texture.h and implemented in texture.cpp
+extern TEXTUREENCODER textureencoder;
+
+
+//! Registry of the TEXTUREs shared by TEXTURE_create, TEXTURESTREAM_create and OBJ_build_texture.
+typedef struct
+{
+	//! The number of registered textures.
+	unsigned int	n_texture;
+	
+	//! Array of registered TEXTURE pointers.
+	TEXTURE			**texture;
+
+} TEXTUREREGISTRY;
+
+
+//! Global TEXTUREREGISTRY structure. Declared as extern in texture.h and implemented in texture.cpp
+extern TEXTUREREGISTRY textureregistry;
+
+
 TEXTURE *TEXTURE_init( char *name );
 
 TEXTURE *TEXTURE_free( TEXTURE *texture );
 
 TEXTURE *TEXTURE_create( char *name, char *filename, unsigned char relative_path, unsigned int flags, unsigned char filter, float anisotropic_filter );
 
+TEXTURE *TEXTURE_registry_get( char *path, unsigned int flags, unsigned char filter, float anisotropic_filter );
+
+void TEXTURE_registry_add( TEXTURE *texture, char *path, unsigned int flags, unsigned char filter, float anisotropic_filter );
+
+void TEXTURE_registry_remove( TEXTURE *texture );
+
+unsigned int TEXTURE_get_memory( TEXTURE *texture );
+
+void TEXTURE_registry_print( void );
+
 void TEXTURE_load( TEXTURE *texture, MEMORY *memory );
 
 void TEXTURE_load_png( TEXTURE *texture, MEMORY *memory );
 
 void TEXTURE_load_pvr( TEXTURE *texture, MEMORY *memory );
 
-void TEXTURE_convert_16_bits( TEXTURE *texture, unsigned char use_5551 );
+void TEXTURE_load_ktx( TEXTURE *texture, MEMORY *memory );
+
+unsigned int TEXTURE_get_compressed_size( unsigned int compression, unsigned int width, unsigned int height );
+
+unsigned char TEXTURE_is_compression_supported( unsigned int compression );
+
+unsigned char TEXTURE_decompress( TEXTURE *texture );
+
+unsigned char TEXTURE_get_dither( unsigned int flags );
+
+void TEXTURE_convert_16_bits( TEXTURE *texture, unsigned char use_5551, unsigned char dither );
+
+void TEXTURE_resample( unsigned char *src, unsigned int src_width, unsigned int src_height, unsigned char *dst, unsigned int dst_width, unsigned int dst_height, unsigned char byte, unsigned char filter, unsigned char gamma );
+
+unsigned char TEXTURE_generate_mipmap( TEXTURE *texture, unsigned char filter, unsigned char gamma );
+
+void TEXTURE_drop_levels( TEXTURE *texture, unsigned int lod );
+
+void TEXTURE_set_encoder( WORKER *worker, char *cache_path );
+
+void TEXTURE_encode_etc1( unsigned char *texel_array, unsigned int width, unsigned int height, unsigned char byte, unsigned char alpha, unsigned char *block_array );
+
+unsigned char TEXTURE_compress_etc1( TEXTURE *texture, unsigned char mipmap );
+
+unsigned char TEXTURE_save_ktx( TEXTURE *texture, char *filename );
+
+unsigned char TEXTURE_load_cache( TEXTURE *texture, MEMORY *memory, unsigned int flags );
+
+void TEXTURE_save_cache( TEXTURE *texture, unsigned int flags );
 
 void TEXTURE_generate_id( TEXTURE *texture, unsigned int flags, unsigned char filter, float anisotropic_filter );
 
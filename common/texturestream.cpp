@@ -0,0 +1,648 @@
+/*
+
+GFX Lightweight OpenGLES 2.0 Game and Graphics Engine
+
+Copyright (C) 2011 Romain Marucchi-Foino http://gfx.sio2interactive.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of
+this software. Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that
+you wrote the original software. If you use this software in a product, an acknowledgment
+in the product would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented
+as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#define ALLOCATOR_TAG ALLOCATOR_TAG_TEXTURE
+
+#include "gfx.h"
+
+/*!
+	\file texturestream.cpp
+
+    \brief Asynchronous texture loading.
+
+	\details TEXTURE_create open, decode and upload a texture in one go on the thread that
+	own the OpenGLES context, which freeze the application while a level is loading. A
+	TEXTURESTREAM split this work: each requested texture immediately receive a 1x1
+	placeholder texture id that can be used for drawing, the file is then opened and
+	decoded (read from the ETC1 disk cache or encoded, and converted to 16 bits if
+	requested) by a WORKER pool, and the decoded textures are finally uploaded by
+	TEXTURESTREAM_pump, called once per frame from the OpenGLES thread, within a byte and
+	time budget. All the TEXTURESTREAM functions have
+	to be called from the OpenGLES thread, only the decoding happen on the WORKER pool. The
+	WORKER pool decode into a staging TEXTURE, only swapped into the requested texture by
+	TEXTURESTREAM_pump, so a texture being reloaded can be drawn in the meantime.
+	
+	The same queue is used by the residency manager to keep the registered textures within
+	a video memory budget: TEXTURESTREAM_update_residency reduce the least recently drawn
+	textures to a lower resolution (or to a placeholder) and TEXTURE_draw bring them back
+	at full resolution the next time they are used.
+*/
+
+
+TEXTURERESIDENCY textureresidency;
+
+
+/*!
+	Create a new TEXTURESTREAM.
+
+	\param[in] name The internal name of the stream.
+	\param[in] worker The WORKER pool to use to decode the textures, if NULL the stream create its own pool of one thread.
+	\param[in] budget_byte The maximum amount of bytes to upload on each call to TEXTURESTREAM_pump (0 for no limit).
+	\param[in] budget_time The maximum amount of time in micro seconds to spend on each call to TEXTURESTREAM_pump (0 for no limit).
+
+	\return Return a new TEXTURESTREAM structure pointer.
+*/
+TEXTURESTREAM *TEXTURESTREAM_init( char *name, WORKER *worker, unsigned int budget_byte, unsigned int budget_time )
+{
+	TEXTURESTREAM *texturestream = ( TEXTURESTREAM * ) calloc( 1, sizeof( TEXTURESTREAM ) );
+
+	strcpy( texturestream->name, name );
+
+	if( worker ) texturestream->worker = worker;
+	
+	else
+	{
+		texturestream->worker	  = WORKER_init( name, 1 );
+		texturestream->own_worker = 1;
+	}
+	
+	texturestream->budget_byte = budget_byte;
+	texturestream->budget_time = budget_time;
+
+	return texturestream;
+}
+
+
+/*!
+	Free a TEXTURESTREAM. The requests still in the queue are cancelled, their textures keep
+	their placeholder texture id.
+
+	\param[in,out] texturestream A valid TEXTURESTREAM structure pointer.
+
+	\return Return a NULL TEXTURESTREAM structure pointer.
+*/
+TEXTURESTREAM *TEXTURESTREAM_free( TEXTURESTREAM *texturestream )
+{
+	if( textureresidency.texturestream == texturestream ) textureresidency.texturestream = NULL;
+	
+	while( texturestream->n_request ) TEXTURESTREAM_cancel( texturestream, texturestream->texturerequest[ 0 ]->texture );
+
+	if( texturestream->texturerequest ) free( texturestream->texturerequest );
+
+	if( texturestream->own_worker ) WORKER_free( texturestream->worker );
+
+	free( texturestream );
+	return NULL;
+}
+
+
+/*!
+	Decode a texture on a worker thread. This function is used internally as WORKER task callback.
+
+	\param[in,out] ptr The TEXTUREREQUEST structure pointer to decode.
+*/
+void TEXTURESTREAM_decode( void *ptr )
+{
+	TEXTUREREQUEST *texturerequest = ( TEXTUREREQUEST * )ptr;
+
+	TEXTURE *texture = texturerequest->staging;
+	
+	unsigned char state = TEXTURE_REQUEST_FAILED;
+
+	MEMORY *m = mopen( texturerequest->filename, texturerequest->relative_path );
+
+	if( m )
+	{
+		unsigned char encode = 0;
+		
+		// Use the ETC1 disk cache when possible, else decode the source and encode it here.
+		if( !( texturerequest->flags & TEXTURE_COMPRESS_ETC1 ) || !TEXTURE_load_cache( texture, m, texturerequest->flags ) )
+		{
+			TEXTURE_load( texture, m );
+			
+			encode = ( texturerequest->flags & TEXTURE_COMPRESS_ETC1 ) != 0;
+		}
+
+		mclose( m );
+		
+		if( texture->texel_array )
+		{
+			if( texturerequest->lod && !encode ) TEXTURE_drop_levels( texture, texturerequest->lod );
+			
+			// Build the mipmap chain here so the GL thread only have to upload it.
+			if( ( texturerequest->flags & TEXTURE_MIPMAP ) && ( texturerequest->flags & TEXTURE_MIPMAP_CPU ) )
+			{
+				TEXTURE_generate_mipmap( texture,
+										 TEXTURE_RESAMPLE_KAISER,
+										 ( texturerequest->flags & TEXTURE_MIPMAP_GAMMA ) != 0 );
+			}
+			
+			// The full resolution is encoded and cached, the levels are dropped afterward.
+			if( encode )
+			{
+				if( TEXTURE_compress_etc1( texture, texturerequest->flags & TEXTURE_MIPMAP ) ) TEXTURE_save_cache( texture, texturerequest->flags );
+				
+				if( texturerequest->lod ) TEXTURE_drop_levels( texture, texturerequest->lod );
+			}
+			
+			// Already compressed, the GL thread only have to upload it.
+			texturerequest->flags &= ~TEXTURE_COMPRESS_ETC1;
+			
+			if( !texture->compression && ( texturerequest->flags & TEXTURE_16_BITS ) )
+			{
+				TEXTURE_convert_16_bits( texture,
+										 texturerequest->flags & TEXTURE_16_BITS_5551,
+										 TEXTURE_get_dither( texturerequest->flags ) );
+				
+				texturerequest->flags &= ~TEXTURE_16_BITS;
+			}
+			
+			state = TEXTURE_REQUEST_DECODED;
+		}
+	}
+
+	texturerequest->state = state;
+}
+
+
+/*!
+	Create a 1x1 placeholder texture id for a texture being streamed.
+
+	\param[in,out] texture A valid TEXTURE structure pointer.
+*/
+void TEXTURESTREAM_placeholder( TEXTURE *texture )
+{
+	unsigned char texel[ 4 ] = { 128, 128, 128, 255 };
+
+	if( texture->tid ) TEXTURE_delete_id( texture );
+
+	glGenTextures( 1, &texture->tid );
+
+	glBindTexture( texture->target, texture->tid );
+
+	glTexParameteri( texture->target, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( texture->target, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+
+	glTexImage2D( texture->target,
+				  0,
+				  GL_RGBA,
+				  1,
+				  1,
+				  0,
+				  GL_RGBA,
+				  GL_UNSIGNED_BYTE,
+				  texel );
+}
+
+
+/*!
+	Queue a request. This function is used internally.
+
+	\param[in,out] texturestream A valid TEXTURESTREAM structure pointer.
+	\param[in,out] texture A valid TEXTURE structure pointer.
+	\param[in] filename The file to load.
+	\param[in] relative_path Determine if the filename is a relative (1) or absolute (0) path.
+	\param[in] flags The TEXTURE flags to use.
+	\param[in] filter The mipmap filtering to use.
+	\param[in] anisotropic_filter The anisotropic filtering to use for the texture.
+	\param[in] lod The number of top mipmap levels to drop once decoded.
+*/
+void TEXTURESTREAM_queue( TEXTURESTREAM *texturestream, TEXTURE *texture, char *filename, unsigned char relative_path, unsigned int flags, unsigned char filter, float anisotropic_filter, unsigned char lod )
+{
+	TEXTUREREQUEST *texturerequest = ( TEXTUREREQUEST * ) calloc( 1, sizeof( TEXTUREREQUEST ) );
+
+	texturerequest->texture			   = texture;
+	texturerequest->staging			   = TEXTURE_init( texture->name );
+	texturerequest->relative_path	   = relative_path;
+	texturerequest->flags			   = flags;
+	texturerequest->filter			   = filter;
+	texturerequest->anisotropic_filter = anisotropic_filter;
+	texturerequest->lod				   = lod;
+	texturerequest->state			   = TEXTURE_REQUEST_PENDING;
+
+	// The support is checked here since it query the OpenGLES context.
+	if( ( flags & TEXTURE_COMPRESS_ETC1 ) && !TEXTURE_is_compression_supported( GL_ETC1_RGB8_OES ) ) texturerequest->flags &= ~TEXTURE_COMPRESS_ETC1;
+
+	strcpy( texturerequest->filename, filename );
+
+	texture->pending = 1;
+
+	++texturestream->n_request;
+
+	texturestream->texturerequest = ( TEXTUREREQUEST ** ) realloc( texturestream->texturerequest,
+																	texturestream->n_request * sizeof( TEXTUREREQUEST * ) );
+
+	texturestream->texturerequest[ texturestream->n_request - 1 ] = texturerequest;
+
+	WORKER_push( texturestream->worker, TEXTURESTREAM_decode, texturerequest, &texturerequest->counter );
+}
+
+
+/*!
+	Queue a texture to be streamed. The texture receive a placeholder texture id right away (unless
+	it already have a texture id) and will receive its final texture id once decoded and uploaded by
+	TEXTURESTREAM_pump. The TEXTURE structure should not be used (other than for drawing) or freed
+	until then, use TEXTURESTREAM_cancel to free it before.
+
+	\param[in,out] texturestream A valid TEXTURESTREAM structure pointer.
+	\param[in,out] texture A valid TEXTURE structure pointer.
+	\param[in] filename The file to load.
+	\param[in] relative_path Determine if the filename is a relative (1) or absolute (0) path.
+	\param[in] flags The TEXTURE flags to use.
+	\param[in] filter The mipmap filtering to use.
+	\param[in] anisotropic_filter The anisotropic filtering to use for the texture.
+*/
+void TEXTURESTREAM_request( TEXTURESTREAM *texturestream, TEXTURE *texture, char *filename, unsigned char relative_path, unsigned int flags, unsigned char filter, float anisotropic_filter )
+{
+	if( !texture->tid ) TEXTURESTREAM_placeholder( texture );
+
+	TEXTURESTREAM_queue( texturestream,
+						 texture,
+						 filename,
+						 relative_path,
+						 flags,
+						 filter,
+						 anisotropic_filter,
+						 0 );
+}
+
+
+/*!
+	Helper function to create a TEXTURE and queue it to be streamed, the asynchronous
+	version of TEXTURE_create. Like TEXTURE_create, a texture already created from the same
+	file with the same parameters is shared instead of being streamed again.
+
+	\param[in,out] texturestream A valid TEXTURESTREAM structure pointer.
+	\param[in] name The internal name to use for the new TEXTURE.
+	\param[in] filename The file to load.
+	\param[in] relative_path Determine if the filename is a relative (1) or absolute (0) path.
+	\param[in] flags The TEXTURE flags to use.
+	\param[in] filter The mipmap filtering to use.
+	\param[in] anisotropic_filter The anisotropic filtering to use for the texture.
+
+	\return Return a TEXTURE structure pointer using a placeholder texture id until it is uploaded.
+*/
+TEXTURE *TEXTURESTREAM_create( TEXTURESTREAM *texturestream, char *name, char *filename, unsigned char relative_path, unsigned int flags, unsigned char filter, float anisotropic_filter )
+{
+	char path[ MAX_PATH ] = {""};
+
+	TEXTURE *texture;
+
+	mresolve( filename, relative_path, path );
+
+	texture = TEXTURE_registry_get( path, flags, filter, anisotropic_filter );
+
+	if( texture ) return texture;
+
+	texture = TEXTURE_init( name );
+
+	TEXTURE_registry_add( texture, path, flags, filter, anisotropic_filter );
+
+	TEXTURESTREAM_request( texturestream, texture, filename, relative_path, flags, filter, anisotropic_filter );
+
+	return texture;
+}
+
+
+/*!
+	Remove a request from the queue, its staging texture (if still attached) is freed. This
+	function is used internally.
+
+	\param[in,out] texturestream A valid TEXTURESTREAM structure pointer.
+	\param[in] index The index of the request to remove.
+*/
+void TEXTURESTREAM_remove( TEXTURESTREAM *texturestream, unsigned int index )
+{
+	if( texturestream->texturerequest[ index ]->staging ) TEXTURE_free( texturestream->texturerequest[ index ]->staging );
+	
+	free( texturestream->texturerequest[ index ] );
+
+	--texturestream->n_request;
+
+	memmove( &texturestream->texturerequest[ index ],
+			 &texturestream->texturerequest[ index + 1 ],
+			 ( texturestream->n_request - index ) * sizeof( TEXTUREREQUEST * ) );
+}
+
+
+/*!
+	Cancel the streaming of a texture. If the texture is being decoded the function wait until
+	the decoding is done. The texture keep its placeholder texture id and can then be freed.
+
+	\param[in,out] texturestream A valid TEXTURESTREAM structure pointer.
+	\param[in,out] texture The TEXTURE to cancel.
+*/
+void TEXTURESTREAM_cancel( TEXTURESTREAM *texturestream, TEXTURE *texture )
+{
+	unsigned int i = 0;
+
+	while( i != texturestream->n_request )
+	{
+		TEXTUREREQUEST *texturerequest = texturestream->texturerequest[ i ];
+
+		if( texturerequest->texture == texture )
+		{
+			WORKER_wait( texturestream->worker, &texturerequest->counter );
+
+			texture->pending = 0;
+
+			TEXTURESTREAM_remove( texturestream, i );
+
+			return;
+		}
+
+		++i;
+	}
+}
+
+
+/*!
+	Move the decoded data of a staging texture (and of its alpha texture) into the texture it
+	have been decoded for, and free the staging texture. The texture keep its texture id until
+	TEXTURE_generate_id is called. This function is used internally.
+
+	\param[in,out] texture A valid TEXTURE structure pointer.
+	\param[in,out] staging The staging TEXTURE structure pointer, freed by the function.
+*/
+void TEXTURESTREAM_swap( TEXTURE *texture, TEXTURE *staging )
+{
+	strcpy( texture->name, staging->name );
+
+	texture->width			 = staging->width;
+	texture->height			 = staging->height;
+	texture->byte			 = staging->byte;
+	texture->size			 = staging->size;
+	texture->target			 = staging->target;
+	texture->internal_format = staging->internal_format;
+	texture->format			 = staging->format;
+	texture->texel_type		 = staging->texel_type;
+	texture->n_mipmap		 = staging->n_mipmap;
+	texture->compression	 = staging->compression;
+	texture->hash			 = staging->hash;
+	texture->hash_size		 = staging->hash_size;
+	texture->hash_check		 = staging->hash_check;
+
+	if( texture->texel_array ) free( texture->texel_array );
+
+	texture->texel_array = staging->texel_array;
+	staging->texel_array = NULL;
+
+	if( staging->texture_alpha )
+	{
+		if( texture->texture_alpha ) TEXTURESTREAM_swap( texture->texture_alpha, staging->texture_alpha );
+
+		else texture->texture_alpha = staging->texture_alpha;
+
+		staging->texture_alpha = NULL;
+	}
+
+	TEXTURE_free( staging );
+}
+
+
+/*!
+	Upload the textures that have been decoded, in the order they have been requested, until
+	the byte or time budget of the stream is reached (at least one texture is uploaded per call).
+	This function have to be called from the thread that own the OpenGLES context, usually once
+	per frame.
+
+	\param[in,out] texturestream A valid TEXTURESTREAM structure pointer.
+
+	\return Return the number of requests left in the queue.
+*/
+unsigned int TEXTURESTREAM_pump( TEXTURESTREAM *texturestream )
+{
+	unsigned int i		= 0,
+				 n_byte = 0,
+				 start	= get_micro_time();
+
+	while( i != texturestream->n_request )
+	{
+		TEXTUREREQUEST *texturerequest = texturestream->texturerequest[ i ];
+
+		unsigned char state;
+
+		// The counter is decremented under the WORKER mutex once the decoding is done.
+		pthread_mutex_lock( &texturestream->worker->mutex );
+
+		state = texturerequest->counter ? ( unsigned char )TEXTURE_REQUEST_PENDING : texturerequest->state;
+
+		pthread_mutex_unlock( &texturestream->worker->mutex );
+
+		if( state == TEXTURE_REQUEST_PENDING ) ++i;
+		
+		else
+		{
+			TEXTURE *texture = texturerequest->texture;
+
+			if( state == TEXTURE_REQUEST_DECODED )
+			{
+				TEXTURESTREAM_swap( texture, texturerequest->staging );
+
+				texturerequest->staging = NULL;
+
+				TEXTURE_generate_id( texture,
+									 texturerequest->flags,
+									 texturerequest->filter,
+									 texturerequest->anisotropic_filter );
+
+				n_byte += texture->compression || texture->texel_type == GL_UNSIGNED_BYTE ?
+						  texture->size :
+						  texture->width * texture->height * 2;
+
+				TEXTURE_free_texel_array( texture );
+			}
+			else
+			{
+				texture->pending = 0;
+				
+				// A texture that never loaded must not be shared anymore, its current owners keep the placeholder.
+				if( texture->n_ref && !texture->width )
+				{
+					unsigned int n_ref = texture->n_ref;
+					
+					TEXTURE_registry_remove( texture );
+					
+					texture->n_ref = n_ref;
+				}
+				
+				console_print( "TEXTURESTREAM: Unable to load %s\n", texturerequest->filename );
+			}
+
+			TEXTURESTREAM_remove( texturestream, i );
+
+			if( texturestream->budget_byte && n_byte >= texturestream->budget_byte ) break;
+
+			if( texturestream->budget_time && get_micro_time() - start >= texturestream->budget_time ) break;
+		}
+	}
+
+	return texturestream->n_request;
+}
+
+
+/*!
+	Wait until all the requests of the queue are decoded and upload them, ignoring the budget.
+	Use it for example at the end of a loading screen.
+
+	\param[in,out] texturestream A valid TEXTURESTREAM structure pointer.
+*/
+void TEXTURESTREAM_flush( TEXTURESTREAM *texturestream )
+{
+	unsigned int budget_byte = texturestream->budget_byte,
+				 budget_time = texturestream->budget_time;
+
+	while( texturestream->n_request )
+	{
+		WORKER_wait( texturestream->worker, &texturestream->texturerequest[ 0 ]->counter );
+
+		texturestream->budget_byte =
+		texturestream->budget_time = 0;
+
+		TEXTURESTREAM_pump( texturestream );
+	}
+
+	texturestream->budget_byte = budget_byte;
+	texturestream->budget_time = budget_time;
+}
+
+
+/*!
+	Reload a registered texture asynchronously, while it keep its current texture id for drawing.
+	Used by the residency manager to reduce a texture to a lower resolution, or to bring it back
+	at full resolution.
+
+	\param[in,out] texturestream A valid TEXTURESTREAM structure pointer.
+	\param[in,out] texture A valid registered TEXTURE structure pointer.
+	\param[in] lod The number of top mipmap levels to drop, 0 for the full resolution.
+*/
+void TEXTURESTREAM_reload( TEXTURESTREAM *texturestream, TEXTURE *texture, unsigned char lod )
+{
+	if( !texture->n_ref || texture->pending ) return;
+
+	TEXTURESTREAM_queue( texturestream,
+						 texture,
+						 texture->filename,
+						 0,
+						 texture->flags,
+						 texture->filter,
+						 texture->anisotropic_filter,
+						 lod );
+
+	if( lod )
+	{
+		// Account for the reduced copy right away, TEXTURE_generate_id set the exact amount on upload.
+		texture->memory >>= lod << 1;
+
+		++textureresidency.n_evict;
+	}
+	else ++textureresidency.n_reload;
+
+	texture->lod = lod;
+}
+
+
+/*!
+	Evict a texture from video memory, it is replaced by a 1x1 placeholder until it is drawn again.
+
+	\param[in,out] texture A valid registered TEXTURE structure pointer.
+*/
+void TEXTURESTREAM_evict( TEXTURE *texture )
+{
+	if( texture->texture_alpha ) TEXTURE_delete_id( texture->texture_alpha );
+
+	TEXTURESTREAM_placeholder( texture );
+
+	texture->memory = 4;
+	texture->lod	= TEXTURE_LOD_PLACEHOLDER;
+
+	++textureresidency.n_evict;
+}
+
+
+/*!
+	Set the video memory budget of the registered textures.
+
+	\param[in] texturestream The TEXTURESTREAM to use to reload the textures (NULL to disable
+	the residency manager).
+	\param[in] budget The budget in bytes (0 for no limit).
+*/
+void TEXTURESTREAM_set_budget( TEXTURESTREAM *texturestream, unsigned int budget )
+{
+	textureresidency.texturestream = texturestream;
+	textureresidency.budget		   = budget;
+}
+
+
+/*!
+	Enforce the video memory budget of the registered textures. While over budget, the least
+	recently drawn texture is first reloaded two mipmap levels lower (1/16 of its memory), and
+	evicted to a placeholder if it is already reduced. Textures drawn during the current frame
+	or being reloaded are never selected. This function have to be called once per frame from
+	the thread that own the OpenGLES context, after drawing.
+
+	\return Return the video memory in bytes used by the registered textures.
+*/
+unsigned int TEXTURESTREAM_update_residency( void )
+{
+	unsigned int i		= 0,
+				 memory = 0;
+
+	while( i != textureregistry.n_texture )
+	{
+		memory += textureregistry.texture[ i ]->memory;
+		++i;
+	}
+
+	while( textureresidency.budget && textureresidency.texturestream && memory > textureresidency.budget )
+	{
+		TEXTURE *victim = NULL;
+
+		i = 0;
+		while( i != textureregistry.n_texture )
+		{
+			TEXTURE *texture = textureregistry.texture[ i ];
+
+			if( texture->tid &&
+				!texture->pending &&
+				texture->lod != TEXTURE_LOD_PLACEHOLDER &&
+				texture->last_use != textureresidency.frame &&
+				( !victim || texture->last_use < victim->last_use ) ) victim = texture;
+
+			++i;
+		}
+
+		if( !victim ) break;
+
+		if( !victim->lod && ( victim->width > 4 || victim->height > 4 ) )
+		{
+			memory -= victim->memory;
+
+			TEXTURESTREAM_reload( textureresidency.texturestream, victim, 2 );
+
+			memory += victim->memory;
+		}
+		else
+		{
+			memory -= victim->memory - 4;
+
+			TEXTURESTREAM_evict( victim );
+		}
+	}
+
+	textureresidency.memory = memory;
+
+	++textureresidency.frame;
+
+	return memory;
+}
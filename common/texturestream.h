@@ -0,0 +1,166 @@
+/*
+
+GFX Lightweight OpenGLES 2.0 Game and Graphics Engine
+
+Copyright (C) 2011 Romain Marucchi-Foino http://gfx.sio2interactive.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of
+this software. Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that
+you wrote the original software. If you use this software in a product, an acknowledgment
+in the product would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented
+as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef TEXTURESTREAM_H
+#define TEXTURESTREAM_H
+
+/*!
+	\file texturestream.h
+
+    \brief Contains structure definition and functions to use with a TEXTURESTREAM.
+*/
+
+
+enum
+{
+	//! The texture is waiting to be decoded by the worker pool.
+	TEXTURE_REQUEST_PENDING = 0,
+	
+	//! The texture have been decoded and is waiting to be uploaded.
+	TEXTURE_REQUEST_DECODED = 1,
+	
+	//! The texture file could not be opened.
+	TEXTURE_REQUEST_FAILED	= 2
+};
+
+
+enum
+{
+	//! The lod of a texture evicted to a placeholder by the residency manager.
+	TEXTURE_LOD_PLACEHOLDER = 0xFF
+};
+
+
+//! Structure definition of a texture waiting to be streamed.
+typedef struct
+{
+	//! The TEXTURE to stream.
+	TEXTURE			*texture;
+	
+	//! The TEXTURE the file is decoded into by the WORKER pool, swapped into the texture by TEXTURESTREAM_pump.
+	TEXTURE			*staging;
+	
+	//! The file to load.
+	char			filename[ MAX_PATH ];
+	
+	//! Determine if the filename is relative (1) or absolute (0).
+	unsigned char	relative_path;
+	
+	//! The TEXTURE flags to use.
+	unsigned int	flags;
+	
+	//! The mipmap filtering to use.
+	unsigned char	filter;
+	
+	//! The anisotropic filtering to use.
+	float			anisotropic_filter;
+	
+	//! The number of top mipmap levels to drop once decoded. \sa TEXTURE_drop_levels
+	unsigned char	lod;
+	
+	//! The state of the request, either TEXTURE_REQUEST_PENDING, TEXTURE_REQUEST_DECODED or TEXTURE_REQUEST_FAILED (only valid once the counter is 0).
+	unsigned char	state;
+	
+	//! The counter of the decoding task. \sa WORKER_wait
+	unsigned int	counter;
+	
+} TEXTUREREQUEST;
+
+
+//! Structure definition of a queue of textures decoded on a WORKER pool and uploaded with a budget.
+typedef struct
+{
+	//! The internal name of the stream.
+	char			name[ MAX_CHAR ];
+	
+	//! The WORKER pool used to decode the textures.
+	WORKER			*worker;
+	
+	//! Determine if the WORKER pool have been created by the stream (1) or not (0).
+	unsigned char	own_worker;
+	
+	//! The number of requests in the queue.
+	unsigned int	n_request;
+	
+	//! Array of requests in the order they have been queued.
+	TEXTUREREQUEST	**texturerequest;
+	
+	//! The maximum amount of bytes uploaded by TEXTURESTREAM_pump (0 for no limit).
+	unsigned int	budget_byte;
+	
+	//! The maximum amount of time spent in TEXTURESTREAM_pump in micro seconds (0 for no limit).
+	unsigned int	budget_time;
+	
+} TEXTURESTREAM;
+
+
+//! Structure definition of the texture residency manager, that keep the registered textures within a video memory budget.
+typedef struct
+{
+	//! The TEXTURESTREAM used to reload the textures asynchronously.
+	TEXTURESTREAM	*texturestream;
+	
+	//! The maximum amount of video memory in bytes the registered textures can use (0 for no limit).
+	unsigned int	budget;
+	
+	//! The video memory in bytes used by the registered textures after the last update.
+	unsigned int	memory;
+	
+	//! The current residency frame, incremented by TEXTURESTREAM_update_residency.
+	unsigned int	frame;
+	
+	//! The number of textures reduced or evicted since the start.
+	unsigned int	n_evict;
+	
+	//! The number of textures reloaded at full resolution since the start.
+	unsigned int	n_reload;
+	
+} TEXTURERESIDENCY;
+
+//! Global texture residency manager. Declared as extern in texturestream.h and implemented in texturestream.cpp
+extern TEXTURERESIDENCY textureresidency;
+
+
+TEXTURESTREAM *TEXTURESTREAM_init( char *name, WORKER *worker, unsigned int budget_byte, unsigned int budget_time );
+
+TEXTURESTREAM *TEXTURESTREAM_free( TEXTURESTREAM *texturestream );
+
+void TEXTURESTREAM_request( TEXTURESTREAM *texturestream, TEXTURE *texture, char *filename, unsigned char relative_path, unsigned int flags, unsigned char filter, float anisotropic_filter );
+
+TEXTURE *TEXTURESTREAM_create( TEXTURESTREAM *texturestream, char *name, char *filename, unsigned char relative_path, unsigned int flags, unsigned char filter, float anisotropic_filter );
+
+void TEXTURESTREAM_cancel( TEXTURESTREAM *texturestream, TEXTURE *texture );
+
+unsigned int TEXTURESTREAM_pump( TEXTURESTREAM *texturestream );
+
+void TEXTURESTREAM_flush( TEXTURESTREAM *texturestream );
+
+void TEXTURESTREAM_reload( TEXTURESTREAM *texturestream, TEXTURE *texture, unsigned char lod );
+
+void TEXTURESTREAM_evict( TEXTURE *texture );
+
+void TEXTURESTREAM_set_budget( TEXTURESTREAM *texturestream, unsigned int budget );
+
+unsigned int TEXTURESTREAM_update_residency( void );
+
+#endif
@@ -34,6 +34,10 @@ as being the original software.
 	doesn't use a shared OpenGLES context, so every GFX functions that directly access some
 	OpenGLES calls cannot inside the thread function callback cannot be used and should be
 	called from the main thread.
+	
+	A thread sleeps on a condition variable between its updates: it wakes up on the next tick
+	of its period, on THREAD_signal or on a state change, without polling. The ticks are
+	absolute deadlines, so the time spent in the callback does not drift the update rate.
 */
 
 #ifdef _WIN32
@@ -43,32 +47,227 @@ void usleep(int ms) {
 #endif
 
 
+/*!
+	Get the current time as an absolute timeout for pthread_cond_timedwait, on the clock of
+	the condition variable of the THREAD (monotonic on Android, so a change of the wall clock
+	do not stretch or cut the waits). This function is used internally.
+	
+	\param[out] t The current time.
+*/
+void THREAD_get_time( struct timespec *t )
+{
+	#if __IPHONE_4_0 || _WIN32
+	{
+		struct timeval tv;
+		
+		gettimeofday( &tv, NULL );
+		
+		t->tv_sec  = tv.tv_sec;
+		t->tv_nsec = tv.tv_usec * 1000;
+	}
+	#else
+	
+		clock_gettime( CLOCK_MONOTONIC, t );
+	#endif
+}
+
+
+/*!
+	Add a number of milliseconds to a time. This function is used internally.
+	
+	\param[in,out] t The time to adjust.
+	\param[in] ms The number of milliseconds to add.
+*/
+void THREAD_add_time( struct timespec *t, unsigned int ms )
+{
+	t->tv_sec  += ms / 1000;
+	t->tv_nsec += ( ms % 1000 ) * 1000000;
+	
+	if( t->tv_nsec >= 1000000000 )
+	{
+		++t->tv_sec;
+		t->tv_nsec -= 1000000000;
+	}
+}
+
+
+/*!
+	Determine if a time is earlier than another one. This function is used internally.
+	
+	\param[in] a The first time.
+	\param[in] b The second time.
+	
+	\return Return 1 if a is before b, 0 otherwise.
+*/
+unsigned char THREAD_is_before( struct timespec *a, struct timespec *b )
+{ return a->tv_sec < b->tv_sec || ( a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec ); }
+
+
+/*!
+	Apply the priority of a THREAD to the calling thread. The priority, expressed between
+	THREAD_PRIORITY_VERY_LOW and THREAD_PRIORITY_VERY_HIGH, is mapped to the range of the
+	current scheduling policy. On Android every thread have the same static priority, the
+	nice value of the thread is used instead. This function is used internally.
+	
+	\param[in] priority The THREAD priority.
+*/
+void THREAD_apply_priority( int priority )
+{
+	if( priority < THREAD_PRIORITY_VERY_LOW ) priority = THREAD_PRIORITY_VERY_LOW;
+	
+	else if( priority > THREAD_PRIORITY_VERY_HIGH ) priority = THREAD_PRIORITY_VERY_HIGH;
+	
+	#if __IPHONE_4_0 || _WIN32
+	{
+		struct sched_param param;
+		
+		int policy,
+			min,
+			max;
+		
+		pthread_getschedparam( pthread_self(), &policy, &param );
+		
+		min = sched_get_priority_min( policy );
+		max = sched_get_priority_max( policy );
+		
+		param.sched_priority = min + ( priority - THREAD_PRIORITY_VERY_LOW ) * ( max - min ) /
+											( THREAD_PRIORITY_VERY_HIGH - THREAD_PRIORITY_VERY_LOW );
+		
+		pthread_setschedparam( pthread_self(), policy, &param );
+	}
+	#else
+	
+		// Raising the priority above normal is only allowed to privileged processes.
+		setpriority( PRIO_PROCESS, gettid(), ( THREAD_PRIORITY_NORMAL_ - priority ) >> 2 );
+	#endif
+}
+
+
+/*!
+	Bind the calling thread to a core. iOS does not allow to bind a thread to a core, the
+	affinity is ignored. This function is used internally.
+	
+	\param[in] cpu The index of the core, -1 to allow all the cores.
+*/
+void THREAD_apply_affinity( int cpu )
+{
+	#ifdef _WIN32
+	{
+		DWORD_PTR process_mask,
+				  system_mask;
+		
+		GetProcessAffinityMask( GetCurrentProcess(), &process_mask, &system_mask );
+		
+		SetThreadAffinityMask( GetCurrentThread(), cpu < 0 ? process_mask : ( DWORD_PTR )1 << cpu );
+	}
+	#elif __IPHONE_4_0
+	
+	#else
+	{
+		cpu_set_t set;
+		
+		int i = 0,
+			n = cpu < 0 ? WORKER_get_core_count() : 1;
+		
+		CPU_ZERO( &set );
+		
+		while( i != n )
+		{
+			CPU_SET( cpu < 0 ? i : cpu, &set );
+			++i;
+		}
+		
+		sched_setaffinity( gettid(), sizeof( cpu_set_t ), &set );
+	}
+	#endif
+}
+
+
 /*!
 	The internal thread callback used by the THREAD structure. This function is the default
 	function used by every new THREAD created and contain a loop that will dispatch to execution
 	pointer to the appropriate THREADCALLBACK function linked to each specific thread.
 	
+	The thread sleeps on the condition of the THREAD while it is paused. While playing, the
+	callback is executed on each tick of the period (if any) and every time the thread is
+	signaled. If the callback takes longer than the period, the missed ticks are dropped.
+	
 	\param[in] ptr Used internally to dispatch the current THREAD pointer to the callback (see code below).
 */
 void *THREAD_run( void *ptr )
 {
 	THREAD *thread = ( THREAD * )ptr;
+	
+	struct timespec deadline,
+					now;
 
-	struct sched_param param;
-
-	pthread_setschedparam( thread->thread, SCHED_RR, &param );
-
-	param.sched_priority = thread->priority;
+	int cpu = -1;
+	
+	THREAD_apply_priority( thread->priority );
+	
+	pthread_mutex_lock( &thread->mutex );
+	
+	THREAD_get_time( &deadline );
 
-	while( thread->state )
+	while( thread->state != STOP )
 	{
-		if( thread->state == PLAY && thread->threadcallback )
-		{ thread->threadcallback( thread ); }
+		if( thread->cpu != cpu )
+		{
+			cpu = thread->cpu;
+			THREAD_apply_affinity( cpu );
+		}
+		
+		if( thread->state != PLAY || !thread->threadcallback )
+		{
+			pthread_cond_wait( &thread->cond, &thread->mutex );
+			
+			// Restart the period when resumed.
+			THREAD_get_time( &deadline );
+			continue;
+		}
+		
+		thread->signaled = 0;
+		thread->running  = 1;
+		
+		pthread_mutex_unlock( &thread->mutex );
+		
+		thread->threadcallback( thread );
+		
+		pthread_mutex_lock( &thread->mutex );
 		
-		usleep( thread->timeout * 1000 );
+		thread->running = 0;
+		
+		pthread_cond_broadcast( &thread->cond );
+		
+		if( !thread->timeout )
+		{
+			while( !thread->signaled && thread->state == PLAY )
+			{ pthread_cond_wait( &thread->cond, &thread->mutex ); }
+			
+			continue;
+		}
+		
+		THREAD_get_time( &now );
+		
+		// The update of this tick is done, schedule the next one.
+		if( !THREAD_is_before( &now, &deadline ) )
+		{
+			THREAD_add_time( &deadline, thread->timeout );
+			
+			if( !THREAD_is_before( &now, &deadline ) )
+			{
+				deadline = now;
+				THREAD_add_time( &deadline, thread->timeout );
+			}
+		}
+		
+		while( !thread->signaled && thread->state == PLAY )
+		{
+			if( pthread_cond_timedwait( &thread->cond, &thread->mutex, &deadline ) ) break;
+		}
 	}
 	
-	pthread_exit( NULL );
+	pthread_mutex_unlock( &thread->mutex );
 	
 	return NULL;
 }
@@ -81,7 +280,7 @@ void *THREAD_run( void *ptr )
 	\param[in] threadcallback The newly created thread callback function.
 	\param[in] userdata You can use this variable to attach any other type of information to the THREAD structure and then get access to it from your THREADCALLBACK function.
 	\param[in] priority The thread priority.
-	\param[in] timeout The thread timeout value in millisecond. This can be use to adjust the thread FPS.
+	\param[in] timeout The thread period in millisecond. This can be use to adjust the thread FPS. Pass 0 to only execute the callback when the thread is signaled.
 
 	\return Return a THREAD structure pointer.
 */
@@ -90,15 +289,35 @@ THREAD *THREAD_create( THREADCALLBACK *threadcallback,
 					   int			   priority,
 					   unsigned int	   timeout )
 {
-	THREAD *thread = ( THREAD * ) calloc( 1, sizeof( THREAD ) );
+	THREAD *thread = ( THREAD * ) POOL_alloc( &allocator.pool[ POOL_THREAD ] );
 
 	thread->threadcallback = threadcallback;
 	
 	thread->priority = priority;
 	thread->userdata = userdata;
 	thread->timeout  = timeout;
-
-	THREAD_pause( thread );
+	thread->state	 = PAUSE;
+	thread->cpu		 = -1;
+	
+	pthread_mutex_init( &thread->mutex, NULL );
+	
+	#if __IPHONE_4_0 || _WIN32
+	
+		pthread_cond_init( &thread->cond, NULL );
+	#else
+	{
+		pthread_condattr_t condattr;
+		
+		pthread_condattr_init( &condattr );
+		
+		// Must match the clock of THREAD_get_time.
+		pthread_condattr_setclock( &condattr, CLOCK_MONOTONIC );
+		
+		pthread_cond_init( &thread->cond, &condattr );
+		
+		pthread_condattr_destroy( &condattr );
+	}
+	#endif
 
 	thread->thread_hdl = pthread_create( &thread->thread,
 										 NULL,
@@ -122,7 +341,11 @@ THREAD *THREAD_free( THREAD *thread )
 	
 	pthread_join( thread->thread, NULL );
 	
-	free( thread );
+	pthread_cond_destroy( &thread->cond );
+	
+	pthread_mutex_destroy( &thread->mutex );
+	
+	POOL_release( &allocator.pool[ POOL_THREAD ], thread );
 	return NULL;
 }
 
@@ -135,7 +358,39 @@ THREAD *THREAD_free( THREAD *thread )
 	
 */
 void THREAD_set_callback( THREAD *thread, THREADCALLBACK *threadcallback )
-{ thread->threadcallback = threadcallback; }
+{
+	pthread_mutex_lock( &thread->mutex );
+	
+	thread->threadcallback = threadcallback;
+	
+	pthread_cond_broadcast( &thread->cond );
+	
+	pthread_mutex_unlock( &thread->mutex );
+}
+
+
+/*!
+	Change the state of a THREAD and wake it up. Unless called from the thread itself, wait
+	for the callback to return. This function is used internally.
+	
+	\param[in] thread A valid THREAD structure pointer.
+	\param[in] state The new state, either PLAY, PAUSE or STOP.
+*/
+void THREAD_set_state( THREAD *thread, unsigned char state )
+{
+	pthread_mutex_lock( &thread->mutex );
+	
+	thread->state = state;
+	
+	pthread_cond_broadcast( &thread->cond );
+	
+	if( state != PLAY && !pthread_equal( pthread_self(), thread->thread ) )
+	{
+		while( thread->running ) pthread_cond_wait( &thread->cond, &thread->mutex );
+	}
+	
+	pthread_mutex_unlock( &thread->mutex );
+}
 
 
 /*!
@@ -144,32 +399,63 @@ void THREAD_set_callback( THREAD *thread, THREADCALLBACK *threadcallback )
 	\param[in] thread A valid THREAD structure pointer.
 */
 void THREAD_play( THREAD *thread )
-{ thread->state = PLAY; }
+{ THREAD_set_state( thread, PLAY ); }
 
 
 /*!
-	Set the THREAD state to PAUSE.
+	Set the THREAD state to PAUSE. When the function returns, the callback is not executing
+	anymore (unless the function is called from the callback itself).
 	
 	\param[in] thread A valid THREAD structure pointer.
 */
 void THREAD_pause( THREAD *thread )
-{
-	thread->state = PAUSE;
-	
-	usleep( thread->timeout * 1000 );
-}
+{ THREAD_set_state( thread, PAUSE ); }
 
 
 /*!
 	Set the THREAD state to STOP. Take note that this will also release the thread
-	handle and the THREAD state cannot be set to PLAY again.
+	handle and the THREAD state cannot be set to PLAY again. When the function returns,
+	the callback is not executing anymore (unless the function is called from the callback
+	itself).
 	
 	\param[in] thread A valid THREAD structure pointer.
 */
 
 void THREAD_stop( THREAD *thread )
+{ THREAD_set_state( thread, STOP ); }
+
+
+/*!
+	Wake up a playing THREAD to execute its callback immediately, without waiting for the
+	end of its period. Signals received while the callback is executing trigger one more
+	execution.
+	
+	\param[in] thread A valid THREAD structure pointer.
+*/
+void THREAD_signal( THREAD *thread )
 {
-	thread->state = STOP;
+	pthread_mutex_lock( &thread->mutex );
+	
+	thread->signaled = 1;
+	
+	pthread_cond_broadcast( &thread->cond );
+	
+	pthread_mutex_unlock( &thread->mutex );
+}
 
-	usleep( thread->timeout * 1000 );
+
+/*!
+	Bind a THREAD to a core. The affinity is applied by the thread itself the next time it
+	wakes up. Not supported on iOS.
+	
+	\param[in] thread A valid THREAD structure pointer.
+	\param[in] cpu The index of the core, -1 to allow all the cores.
+*/
+void THREAD_set_affinity( THREAD *thread, int cpu )
+{
+	pthread_mutex_lock( &thread->mutex );
+	
+	thread->cpu = cpu;
+	
+	pthread_mutex_unlock( &thread->mutex );
 }
@@ -66,7 +66,7 @@ typedef struct
 	//! The priority of the thread.
 	int				priority;
 
-	//! The time interval between the thread update in milliseconds.
+	//! The period of the thread update in milliseconds, 0 to only update the thread when it is signaled.
 	unsigned int	timeout;
 		
 	//! The thread structure.
@@ -80,6 +80,21 @@ typedef struct
 
 	//! Userdata handle used to pass user data pointer to the THREAD function callback.
 	void			*userdata;
+	
+	//! The core the thread is bound to, -1 to let the system decide. \sa THREAD_set_affinity
+	int				cpu;
+	
+	//! Determine if the thread have been signaled since the last callback. \sa THREAD_signal
+	unsigned char	signaled;
+	
+	//! Determine if the callback is currently executing.
+	unsigned char	running;
+	
+	//! The mutex protecting the state of the thread.
+	pthread_mutex_t	mutex;
+	
+	//! Condition broadcasted on every state change, signal and end of callback.
+	pthread_cond_t	cond;
 
 } THREAD;
 
@@ -96,4 +111,8 @@ void THREAD_pause( THREAD *thread );
 
 void THREAD_stop( THREAD *thread );
 
+void THREAD_signal( THREAD *thread );
+
+void THREAD_set_affinity( THREAD *thread, int cpu );
+
 #endif
@@ -19,10 +19,29 @@
 
 /* make it easy on the folks that want to compile the libs with a
    different malloc than stdlib */
-#define _ogg_malloc  malloc
-#define _ogg_calloc  calloc
-#define _ogg_realloc realloc
-#define _ogg_free    free
+#if defined(GFX_TRACK_ALLOCATION) || defined(DEBUG) || defined(_DEBUG)
+/* GFX: record the allocations under ALLOCATOR_TAG_AUDIO, see allocator.cpp */
+#  include <stddef.h>
+#  ifdef __cplusplus
+extern "C" {
+#  endif
+void *ALLOCATOR_ogg_malloc(size_t size);
+void *ALLOCATOR_ogg_calloc(size_t n, size_t size);
+void *ALLOCATOR_ogg_realloc(void *ptr, size_t size);
+void ALLOCATOR_ogg_free(void *ptr);
+#  ifdef __cplusplus
+}
+#  endif
+#  define _ogg_malloc  ALLOCATOR_ogg_malloc
+#  define _ogg_calloc  ALLOCATOR_ogg_calloc
+#  define _ogg_realloc ALLOCATOR_ogg_realloc
+#  define _ogg_free    ALLOCATOR_ogg_free
+#else
+#  define _ogg_malloc  malloc
+#  define _ogg_calloc  calloc
+#  define _ogg_realloc realloc
+#  define _ogg_free    free
+#endif
 
 #if defined(_WIN32) 
 
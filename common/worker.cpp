@@ -0,0 +1,307 @@
+/*
+
+GFX Lightweight OpenGLES 2.0 Game and Graphics Engine
+
+Copyright (C) 2011 Romain Marucchi-Foino http://gfx.sio2interactive.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of
+this software. Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that
+you wrote the original software. If you use this software in a product, an acknowledgment
+in the product would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented
+as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#define ALLOCATOR_TAG ALLOCATOR_TAG_THREAD
+
+#include "gfx.h"
+
+/*!
+	\file worker.cpp
+
+    \brief Fixed pool of threads to execute small tasks in parallel.
+
+	\details Contrarily to the THREAD structure that keep calling the same callback at a
+	fixed interval, a WORKER pool sleep until some tasks are pushed and then execute each
+	of them once, on the first thread available. Tasks can be grouped using a counter in
+	order to wait for a batch of tasks without waiting for every tasks of the pool. Like
+	for the THREAD structure, OpenGLES calls cannot be done inside a task callback.
+*/
+
+
+/*!
+	Return the number of cores available on the system.
+
+	\return Return the number of cores (at least 1).
+*/
+unsigned int WORKER_get_core_count( void )
+{
+	#ifdef _WIN32
+
+		SYSTEM_INFO system_info;
+
+		GetSystemInfo( &system_info );
+
+		return system_info.dwNumberOfProcessors ? system_info.dwNumberOfProcessors : 1;
+
+	#else
+
+		long n = sysconf( _SC_NPROCESSORS_ONLN );
+
+		return n > 0 ? ( unsigned int )n : 1;
+
+	#endif
+}
+
+
+/*!
+	Pop the first task of the queue. This function have to be called with the
+	WORKER mutex locked.
+
+	\param[in,out] worker A valid WORKER structure pointer with at least one task queued.
+	\param[out] workertask The task that have been removed from the queue.
+*/
+void WORKER_pop( WORKER *worker, WORKERTASK *workertask )
+{
+	memcpy( workertask,
+			&worker->workertask[ worker->first_task ],
+			sizeof( WORKERTASK ) );
+
+	worker->first_task = ( worker->first_task + 1 ) % worker->max_task;
+
+	--worker->n_task;
+}
+
+
+/*!
+	Execute a task and signal its completion. This function have to be called with
+	the WORKER mutex unlocked.
+
+	\param[in,out] worker A valid WORKER structure pointer.
+	\param[in] workertask The task to execute.
+*/
+void WORKER_execute( WORKER *worker, WORKERTASK *workertask )
+{
+	workertask->workercallback( workertask->userdata );
+
+	pthread_mutex_lock( &worker->mutex );
+
+	if( workertask->counter ) --( *workertask->counter );
+
+	--worker->n_pending;
+
+	pthread_cond_broadcast( &worker->done_cond );
+
+	pthread_mutex_unlock( &worker->mutex );
+}
+
+
+/*!
+	The internal thread function of each thread of the pool.
+
+	\param[in] ptr The WORKER structure pointer the thread belongs to.
+*/
+void *WORKER_run( void *ptr )
+{
+	WORKER *worker = ( WORKER * )ptr;
+
+	WORKERTASK workertask;
+
+	pthread_mutex_lock( &worker->mutex );
+
+	while( 1 )
+	{
+		while( !worker->n_task && worker->state == PLAY )
+		{ pthread_cond_wait( &worker->task_cond, &worker->mutex ); }
+
+		if( !worker->n_task ) break;
+
+		WORKER_pop( worker, &workertask );
+
+		pthread_mutex_unlock( &worker->mutex );
+
+		WORKER_execute( worker, &workertask );
+
+		pthread_mutex_lock( &worker->mutex );
+	}
+
+	pthread_mutex_unlock( &worker->mutex );
+
+	return NULL;
+}
+
+
+/*!
+	Create a new WORKER pool and start its threads.
+
+	\param[in] name The internal name of the pool.
+	\param[in] n_thread The number of threads to create. Pass 0 to create one thread per core.
+
+	\return Return a new WORKER structure pointer.
+*/
+WORKER *WORKER_init( char *name, unsigned int n_thread )
+{
+	unsigned int i = 0;
+
+	WORKER *worker = ( WORKER * ) calloc( 1, sizeof( WORKER ) );
+
+	strcpy( worker->name, name );
+
+	worker->state	 = PLAY;
+	worker->n_thread = n_thread ? n_thread : WORKER_get_core_count();
+	worker->max_task = 64;
+
+	worker->workertask = ( WORKERTASK * ) malloc( worker->max_task * sizeof( WORKERTASK ) );
+
+	pthread_mutex_init( &worker->mutex, NULL );
+
+	pthread_cond_init( &worker->task_cond, NULL );
+
+	pthread_cond_init( &worker->done_cond, NULL );
+
+	worker->thread = ( pthread_t * ) malloc( worker->n_thread * sizeof( pthread_t ) );
+
+	while( i != worker->n_thread )
+	{
+		pthread_create( &worker->thread[ i ],
+						NULL,
+						WORKER_run,
+						( void * )worker );
+		++i;
+	}
+
+	return worker;
+}
+
+
+/*!
+	Free a WORKER pool. All the tasks already queued are executed before the threads exit.
+
+	\param[in,out] worker A valid WORKER structure pointer.
+
+	\return Return a NULL WORKER structure pointer.
+*/
+WORKER *WORKER_free( WORKER *worker )
+{
+	unsigned int i = 0;
+
+	pthread_mutex_lock( &worker->mutex );
+
+	worker->state = STOP;
+
+	pthread_cond_broadcast( &worker->task_cond );
+
+	pthread_mutex_unlock( &worker->mutex );
+
+	while( i != worker->n_thread )
+	{
+		pthread_join( worker->thread[ i ], NULL );
+		++i;
+	}
+
+	pthread_cond_destroy( &worker->done_cond );
+
+	pthread_cond_destroy( &worker->task_cond );
+
+	pthread_mutex_destroy( &worker->mutex );
+
+	free( worker->thread );
+
+	free( worker->workertask );
+
+	free( worker );
+	return NULL;
+}
+
+
+/*!
+	Queue a new task. The task will be executed once by the first thread available.
+
+	\param[in,out] worker A valid WORKER structure pointer.
+	\param[in] workercallback The function to execute.
+	\param[in] userdata The pointer to send to the callback.
+	\param[in,out] counter A counter that will be incremented now and decremented when the task
+	is done, use it with WORKER_wait to wait for a group of tasks (can be NULL).
+*/
+void WORKER_push( WORKER *worker, WORKERCALLBACK *workercallback, void *userdata, unsigned int *counter )
+{
+	pthread_mutex_lock( &worker->mutex );
+
+	if( worker->n_task == worker->max_task )
+	{
+		unsigned int i = 0;
+
+		WORKERTASK *workertask = ( WORKERTASK * ) malloc( ( worker->max_task << 1 ) * sizeof( WORKERTASK ) );
+
+		while( i != worker->n_task )
+		{
+			memcpy( &workertask[ i ],
+					&worker->workertask[ ( worker->first_task + i ) % worker->max_task ],
+					sizeof( WORKERTASK ) );
+			++i;
+		}
+
+		free( worker->workertask );
+
+		worker->workertask = workertask;
+		worker->first_task = 0;
+		worker->max_task <<= 1;
+	}
+
+	WORKERTASK *workertask = &worker->workertask[ ( worker->first_task + worker->n_task ) % worker->max_task ];
+
+	workertask->workercallback = workercallback;
+	workertask->userdata	   = userdata;
+	workertask->counter		   = counter;
+
+	if( counter ) ++( *counter );
+
+	++worker->n_task;
+	++worker->n_pending;
+
+	pthread_cond_signal( &worker->task_cond );
+
+	pthread_mutex_unlock( &worker->mutex );
+}
+
+
+/*!
+	Wait until a group of tasks is done. While waiting, the calling thread help
+	executing the queued tasks instead of sleeping.
+
+	\param[in,out] worker A valid WORKER structure pointer.
+	\param[in] counter The counter used when pushing the tasks to wait for, or NULL to wait
+	until all the tasks of the pool are done.
+*/
+void WORKER_wait( WORKER *worker, unsigned int *counter )
+{
+	WORKERTASK workertask;
+
+	pthread_mutex_lock( &worker->mutex );
+
+	while( counter ? *counter : worker->n_pending )
+	{
+		if( worker->n_task )
+		{
+			WORKER_pop( worker, &workertask );
+
+			pthread_mutex_unlock( &worker->mutex );
+
+			WORKER_execute( worker, &workertask );
+
+			pthread_mutex_lock( &worker->mutex );
+		}
+		else pthread_cond_wait( &worker->done_cond, &worker->mutex );
+	}
+
+	pthread_mutex_unlock( &worker->mutex );
+}
@@ -0,0 +1,105 @@
+/*
+
+GFX Lightweight OpenGLES 2.0 Game and Graphics Engine
+
+Copyright (C) 2011 Romain Marucchi-Foino http://gfx.sio2interactive.com
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of
+this software. Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that
+you wrote the original software. If you use this software in a product, an acknowledgment
+in the product would be appreciated but is not required.
+
+2. Altered source versions must be plainly marked as such, and must not be misrepresented
+as being the original software.
+
+3. This notice may not be removed or altered from any source distribution.
+
+*/
+
+#ifndef WORKER_H
+#define WORKER_H
+
+/*!
+	\file worker.h
+
+    \brief Contains structure definition and functions to use with a WORKER pool.
+*/
+
+
+//! The worker task callback prototype.
+typedef void( WORKERCALLBACK( void * ) );
+
+
+//! Structure definition of a task waiting to be executed by a WORKER pool.
+typedef struct
+{
+	//! The task callback.
+	WORKERCALLBACK	*workercallback;
+
+	//! Userdata pointer sent to the task callback.
+	void			*userdata;
+
+	//! The counter to decrement when the task is done (if any). \sa WORKER_wait
+	unsigned int	*counter;
+
+} WORKERTASK;
+
+
+//! Structure definition of a fixed pool of threads executing tasks in FIFO order.
+typedef struct
+{
+	//! The internal name of the pool.
+	char			name[ MAX_CHAR ];
+
+	//! The current state of the pool, either PLAY or STOP.
+	unsigned char	state;
+
+	//! The number of threads of the pool.
+	unsigned int	n_thread;
+
+	//! Array of threads.
+	pthread_t		*thread;
+
+	//! The mutex protecting the task queue.
+	pthread_mutex_t	mutex;
+
+	//! Condition signaled when a new task is available.
+	pthread_cond_t	task_cond;
+
+	//! Condition signaled every time a task is done.
+	pthread_cond_t	done_cond;
+
+	//! The number of tasks the queue can hold before growing.
+	unsigned int	max_task;
+
+	//! The number of tasks currently queued.
+	unsigned int	n_task;
+
+	//! The index of the first queued task in the ring.
+	unsigned int	first_task;
+
+	//! The number of tasks queued or running.
+	unsigned int	n_pending;
+
+	//! Ring of queued tasks.
+	WORKERTASK		*workertask;
+
+} WORKER;
+
+
+unsigned int WORKER_get_core_count( void );
+
+WORKER *WORKER_init( char *name, unsigned int n_thread );
+
+WORKER *WORKER_free( WORKER *worker );
+
+void WORKER_push( WORKER *worker, WORKERCALLBACK *workercallback, void *userdata, unsigned int *counter );
+
+void WORKER_wait( WORKER *worker, unsigned int *counter );
+
+#endif